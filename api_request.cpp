@@ -0,0 +1,144 @@
+#include "api_request.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string urlDecode(const std::string& text) {
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '+') {
+            out.push_back(' ');
+        } else if (text[i] == '%' && i + 2 < text.size() && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+            out.push_back(char(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2])));
+            i += 2;
+        } else {
+            out.push_back(text[i]);
+        }
+    }
+    return out;
+}
+
+// Responses are built in one writer per thread so its buffer is reused
+JsonWriter& responseWriter() {
+    thread_local JsonWriter writer;
+    writer.clear();
+    return writer;
+}
+
+} // namespace
+
+ApiRequest ApiRequest::parse(const std::string& url) {
+    ApiRequest request;
+    size_t query = url.find('?');
+    std::string path = url.substr(0, query);
+    size_t api = path.find("/api/v2/");
+    request.method = api == std::string::npos ? path : path.substr(api + 8);
+
+    if (query != std::string::npos) {
+        size_t begin = query + 1;
+        while (begin <= url.size()) {
+            size_t end = url.find('&', begin);
+            if (end == std::string::npos) end = url.size();
+            size_t equals = url.find('=', begin);
+            if (equals != std::string::npos && equals < end) {
+                request.params[urlDecode(url.substr(begin, equals - begin))] = urlDecode(url.substr(equals + 1, end - equals - 1));
+            } else if (end > begin) {
+                request.params[urlDecode(url.substr(begin, end - begin))] = "";
+            }
+            begin = end + 1;
+        }
+    }
+    return request;
+}
+
+std::string ApiRequest::text(const std::string& key, const std::string& fallback) const {
+    auto it = params.find(key);
+    return it == params.end() ? fallback : it->second;
+}
+
+double ApiRequest::number(const std::string& key, double fallback) const {
+    auto it = params.find(key);
+    if (it == params.end() || it->second.empty()) return fallback;
+    return std::strtod(it->second.c_str(), nullptr);
+}
+
+std::string api_response::result(JsonValue result) {
+    JsonWriter& writer = responseWriter();
+    writer.beginObject().key("jsonrpc").value("2.0").key("result").value(result).endObject();
+    return writer.str();
+}
+
+std::string api_response::error(int code, const std::string& message) {
+    JsonWriter& writer = responseWriter();
+    writer.beginObject().key("jsonrpc").value("2.0");
+    writer.key("error").beginObject().key("code").value(code).key("message").value(message).endObject();
+    writer.endObject();
+    return writer.str();
+}
+
+bool api_response::referenceData(const ApiRequest& request, const std::unordered_map<std::string, Instrument>& instruments,
+    std::string& response) {
+    const std::string& method = request.method;
+    if (method == "public/auth") {
+        JsonObject token;
+        token.emplace("access_token", JsonValue(std::string("simulated")));
+        response = result(JsonValue(std::move(token)));
+    } else if (method == "public/get_currencies") {
+        std::vector<std::string> currencies;
+        for (const auto& [instrument_name, instrument] : instruments) {
+            for (const std::string* currency : {&instrument.base_currency, &instrument.settlement_currency}) {
+                if (std::find(currencies.begin(), currencies.end(), *currency) == currencies.end()) {
+                    currencies.push_back(*currency);
+                }
+            }
+        }
+        JsonArray entries;
+        for (const std::string& currency : currencies) {
+            JsonObject entry;
+            entry.emplace("currency", JsonValue(currency));
+            entries.push_back(JsonValue(std::move(entry)));
+        }
+        response = result(JsonValue(std::move(entries)));
+    } else if (method == "public/get_index_price_names") {
+        response = result(JsonValue(JsonArray()));
+    } else if (method == "public/get_instruments") {
+        std::string kind = request.text("kind", "any");
+        JsonArray entries;
+        for (const auto& [instrument_name, instrument] : instruments) {
+            if (kind != "any" && instrument.kind != kind) continue;
+            JsonObject entry;
+            entry.emplace("instrument_name", JsonValue(instrument_name));
+            entry.emplace("base_currency", JsonValue(instrument.base_currency));
+            entry.emplace("quote_currency", JsonValue(instrument.quote_currency));
+            entry.emplace("settlement_currency", JsonValue(instrument.settlement_currency));
+            entry.emplace("kind", JsonValue(instrument.kind));
+            entry.emplace("is_active", JsonValue(instrument.is_active));
+            if (instrument.kind == "option") {
+                entry.emplace("strike", JsonValue(instrument.strike));
+                entry.emplace("option_type", JsonValue(instrument.option_type));
+            }
+            if (instrument.expiration_timestamp != 0) {
+                entry.emplace("expiration_timestamp", JsonValue(double(instrument.expiration_timestamp)));
+            }
+            if (instrument.tick_size != 0) entry.emplace("tick_size", JsonValue(instrument.tick_size));
+            if (instrument.contract_size != 0) entry.emplace("contract_size", JsonValue(instrument.contract_size));
+            if (instrument.min_trade_amount != 0) entry.emplace("min_trade_amount", JsonValue(instrument.min_trade_amount));
+            entries.push_back(JsonValue(std::move(entry)));
+        }
+        response = result(JsonValue(std::move(entries)));
+    } else {
+        return false;
+    }
+    return true;
+}
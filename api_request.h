@@ -0,0 +1,40 @@
+#pragma once
+
+#include "instruments.h"
+#include "json_parser.h"
+
+#include <string>
+#include <unordered_map>
+
+// A parsed API URL: "private/buy" and its query parameters
+struct ApiRequest {
+    std::string method;
+    std::unordered_map<std::string, std::string> params;
+
+    static ApiRequest parse(const std::string& url);
+
+    bool has(const std::string& key) const { return params.find(key) != params.end(); }
+    std::string text(const std::string& key, const std::string& fallback = "") const;
+    double number(const std::string& key, double fallback = 0) const;
+    bool flag(const std::string& key) const { return text(key) == "true"; }
+};
+
+// JSON-RPC responses for in-process transports such as Backtester and MatchingEngine
+namespace api_response {
+
+// Error codes as the exchange reports them
+constexpr int INVALID_PARAMS = -32602;
+constexpr int METHOD_NOT_FOUND = -32601;
+constexpr int NOT_OPEN_ORDER = 11044;
+constexpr int POST_ONLY_REJECT = 11054;
+constexpr int REDUCE_ONLY_REJECT = 11099;
+
+std::string result(JsonValue result);
+std::string error(int code, const std::string& message);
+
+// Answers public/auth, get_currencies, get_index_price_names and get_instruments from an
+// instrument table, which is all TradingSystem needs to start up; false for other methods
+bool referenceData(const ApiRequest& request, const std::unordered_map<std::string, Instrument>& instruments,
+    std::string& response);
+
+} // namespace api_response
@@ -0,0 +1,122 @@
+#include "async_trading.h"
+#include "logger.h"
+
+// The request is validated before the first suspension, so a rejected call completes
+// without touching the loop. In-process transports answer immediately and are called inline.
+Task<Result<JsonValue>> AsyncTrading::attempt(TradingSystem::Prepared request) {
+    if (request.url.empty()) {
+        if (!request.rejection.empty()) {
+            co_return Result<JsonValue>::failure(ErrorCode::Validation, request.rejection);
+        }
+        co_return Result<JsonValue>(request.local);
+    }
+    // The loop must not sleep for the account's budget, so a request over it is rejected
+    if (request.authenticated && !trading.rate_limiter.tryAcquire()) {
+        logging::warn("Rate limit exceeded");
+        co_return Result<JsonValue>::failure(ErrorCode::Validation, "Rate limit exceeded");
+    }
+    std::string token = request.authenticated ? trading.auth_token : "";
+    // Loop responses arrive in pooled buffers, which go back to the pool once parsed. Not a
+    // conditional expression: GCC 12 destroys a temporary twice when one arm of it is a co_await.
+    PooledBuffer response;
+    if (trading.transport) {
+        response = PooledBuffer(trading.transport->get(request.url, token));
+    } else {
+        response = co_await loop.get(request.url, token);
+    }
+    co_return trading.complete(request, response.str());
+}
+
+Task<JsonValue> AsyncTrading::run(TradingSystem::Prepared request) {
+    co_return TradingSystem::unwrap(co_await attempt(std::move(request)));
+}
+
+Task<JsonValue> AsyncTrading::getOrderBook(const std::string& instrument_name, int depth) {
+    return run(trading.prepareOrderBook(instrument_name, depth));
+}
+
+Task<JsonValue> AsyncTrading::buy(const std::string instrument_name, int amount, int contracts,
+        const std::string type, const std::string label, int price,
+        const std::string time_in_force, int max_show, int post_only,
+        int reject_post_only, int reduce_only, int trigger_price,
+        int trigger_offset, const std::string trigger, const std::string advanced,
+        int mmp, int valid_until, const std::string linked_order_type,
+        const std::string trigger_fill_condition) {
+    return run(trading.prepareOrder(true, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition));
+}
+
+Task<JsonValue> AsyncTrading::sell(const std::string instrument_name, int amount, int contracts,
+        const std::string type, const std::string label, int price,
+        const std::string time_in_force, int max_show, int post_only,
+        int reject_post_only, int reduce_only, int trigger_price,
+        int trigger_offset, const std::string trigger, const std::string advanced,
+        int mmp, int valid_until, const std::string linked_order_type,
+        const std::string trigger_fill_condition) {
+    return run(trading.prepareOrder(false, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition));
+}
+
+Task<JsonValue> AsyncTrading::edit(const std::string order_id, int amount, int contracts, int price,
+    int post_only, int reduce_only, int reject_post_only, std::string advanced,
+    int trigger_price, int trigger_offset, int mmp, int valid_until) {
+    return run(trading.prepareEdit(order_id, EditRequest{amount, contracts, price, post_only, reduce_only,
+        reject_post_only, advanced, trigger_price, trigger_offset, mmp, valid_until}));
+}
+
+Task<JsonValue> AsyncTrading::cancel(const std::string order_id) {
+    return run(trading.prepareCancel(order_id));
+}
+
+Task<JsonValue> AsyncTrading::getOpenOrders(const std::string kind, const std::string type) {
+    return run(trading.prepareOpenOrders(kind, type));
+}
+
+Task<JsonValue> AsyncTrading::getOpenOrdersByCurrency(const std::string currency, const std::string kind, const std::string type) {
+    return run(trading.prepareOpenOrdersByCurrency(currency, kind, type));
+}
+
+Task<JsonValue> AsyncTrading::getOpenOrdersByInstrument(const std::string instrument_name, const std::string type) {
+    return run(trading.prepareOpenOrdersByInstrument(instrument_name, type));
+}
+
+Task<JsonValue> AsyncTrading::getOpenOrdersByLabel(const std::string currency, const std::string label) {
+    return run(trading.prepareOpenOrdersByLabel(currency, label));
+}
+
+Task<JsonValue> AsyncTrading::getOrderState(const std::string order_id) {
+    return run(trading.prepareOrderState(order_id));
+}
+
+Task<JsonValue> AsyncTrading::getOrderStateByLabel(const std::string currency, const std::string label) {
+    return run(trading.prepareOrderStateByLabel(currency, label));
+}
+
+Task<Result<JsonValue>> AsyncTrading::tryBuy(const std::string instrument_name, int amount, int contracts,
+        const std::string type, const std::string label, int price,
+        const std::string time_in_force, int max_show, int post_only,
+        int reject_post_only, int reduce_only, int trigger_price,
+        int trigger_offset, const std::string trigger, const std::string advanced,
+        int mmp, int valid_until, const std::string linked_order_type,
+        const std::string trigger_fill_condition) {
+    return attempt(trading.prepareOrder(true, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition));
+}
+
+Task<Result<JsonValue>> AsyncTrading::trySell(const std::string instrument_name, int amount, int contracts,
+        const std::string type, const std::string label, int price,
+        const std::string time_in_force, int max_show, int post_only,
+        int reject_post_only, int reduce_only, int trigger_price,
+        int trigger_offset, const std::string trigger, const std::string advanced,
+        int mmp, int valid_until, const std::string linked_order_type,
+        const std::string trigger_fill_condition) {
+    return attempt(trading.prepareOrder(false, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition));
+}
+
+Task<Result<JsonValue>> AsyncTrading::tryEdit(const std::string order_id, int amount, int contracts, int price,
+    int post_only, int reduce_only, int reject_post_only, std::string advanced,
+    int trigger_price, int trigger_offset, int mmp, int valid_until) {
+    return attempt(trading.prepareEdit(order_id, EditRequest{amount, contracts, price, post_only, reduce_only,
+        reject_post_only, advanced, trigger_price, trigger_offset, mmp, valid_until}));
+}
+
+Task<Result<JsonValue>> AsyncTrading::tryCancel(const std::string order_id) {
+    return attempt(trading.prepareCancel(order_id));
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "event_loop.h"
+#include "trading_system.h"
+
+// Awaitable counterparts of the TradingSystem calls, run on an EventLoop:
+//
+//     Task<void> placeThenHedge(AsyncTrading& trading) {
+//         JsonValue ack = co_await trading.buy("BTC-PERPETUAL", 10, 0, "limit", "", 60000);
+//         if (!ack.isNull()) co_await trading.sell("ETH-PERPETUAL", 10, 0, "market");
+//     }
+//     loop.spawn(placeThenHedge(trading));
+//     loop.run();
+//
+// Validation, risk checks, the local order cache and result bookkeeping are the same as for
+// the blocking calls. Tasks resume on the loop thread only. Edits are sent as they come: the
+// per-order coalescing of TradingSystem::edit blocks the calling thread, which the loop must not.
+// For the same reason a request over the account's rate limit is rejected instead of delayed.
+class AsyncTrading {
+private:
+    TradingSystem& trading;
+    EventLoop& loop;
+
+    Task<Result<JsonValue>> attempt(TradingSystem::Prepared request);
+    Task<JsonValue> run(TradingSystem::Prepared request);
+
+public:
+    AsyncTrading(TradingSystem& trading, EventLoop& loop) : trading(trading), loop(loop) {}
+
+    Task<JsonValue> getOrderBook(const std::string& instrument_name, int depth = 5);
+
+    Task<JsonValue> buy(const std::string instrument_name = "", int amount = 0, int contracts = 0,
+        const std::string type = "", const std::string label = "", int price = -1,
+        const std::string time_in_force = "", int max_show = -1, int post_only = -1,
+        int reject_post_only = -1, int reduce_only = -1, int trigger_price = -1,
+        int trigger_offset = -1, const std::string trigger = "", const std::string advanced = "",
+        int mmp = -1, int valid_until = 0, const std::string linked_order_type = "",
+        const std::string trigger_fill_condition = "");
+    Task<JsonValue> sell(const std::string instrument_name = "", int amount = 0, int contracts = 0,
+        const std::string type = "", const std::string label = "", int price = -1,
+        const std::string time_in_force = "", int max_show = -1, int post_only = -1,
+        int reject_post_only = -1, int reduce_only = -1, int trigger_price = -1,
+        int trigger_offset = -1, const std::string trigger = "", const std::string advanced = "",
+        int mmp = -1, int valid_until = 0, const std::string linked_order_type = "",
+        const std::string trigger_fill_condition = "");
+
+    Task<JsonValue> edit(const std::string order_id, int amount = -1, int contracts = -1, int price = -1,
+        int post_only = -1, int reduce_only = -1, int reject_post_only = -1, std::string advanced = "",
+        int trigger_price = -1, int trigger_offset = -1, int mmp = -1, int valid_until = 0);
+    Task<JsonValue> cancel(const std::string order_id);
+
+    // Exception-free order entry, as TradingSystem::tryBuy and the rest: every failure, including
+    // a request over the rate limit, comes back as a TradingError
+    Task<Result<JsonValue>> tryBuy(const std::string instrument_name = "", int amount = 0, int contracts = 0,
+        const std::string type = "", const std::string label = "", int price = -1,
+        const std::string time_in_force = "", int max_show = -1, int post_only = -1,
+        int reject_post_only = -1, int reduce_only = -1, int trigger_price = -1,
+        int trigger_offset = -1, const std::string trigger = "", const std::string advanced = "",
+        int mmp = -1, int valid_until = 0, const std::string linked_order_type = "",
+        const std::string trigger_fill_condition = "");
+    Task<Result<JsonValue>> trySell(const std::string instrument_name = "", int amount = 0, int contracts = 0,
+        const std::string type = "", const std::string label = "", int price = -1,
+        const std::string time_in_force = "", int max_show = -1, int post_only = -1,
+        int reject_post_only = -1, int reduce_only = -1, int trigger_price = -1,
+        int trigger_offset = -1, const std::string trigger = "", const std::string advanced = "",
+        int mmp = -1, int valid_until = 0, const std::string linked_order_type = "",
+        const std::string trigger_fill_condition = "");
+    Task<Result<JsonValue>> tryEdit(const std::string order_id, int amount = -1, int contracts = -1, int price = -1,
+        int post_only = -1, int reduce_only = -1, int reject_post_only = -1, std::string advanced = "",
+        int trigger_price = -1, int trigger_offset = -1, int mmp = -1, int valid_until = 0);
+    Task<Result<JsonValue>> tryCancel(const std::string order_id);
+
+    Task<JsonValue> getOpenOrders(const std::string kind = "", const std::string type = "all");
+    Task<JsonValue> getOpenOrdersByCurrency(const std::string currency, const std::string kind = "", const std::string type = "all");
+    Task<JsonValue> getOpenOrdersByInstrument(const std::string instrument_name, const std::string type = "all");
+    Task<JsonValue> getOpenOrdersByLabel(const std::string currency, const std::string label);
+    Task<JsonValue> getOrderState(const std::string order_id);
+    Task<JsonValue> getOrderStateByLabel(const std::string currency, const std::string label);
+};
@@ -0,0 +1,603 @@
+#include "backtester.h"
+#include "order_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+namespace {
+
+constexpr double EPSILON = 1e-9;
+
+} // namespace
+
+Backtester::Backtester(std::unordered_map<std::string, Instrument> instruments) : instruments(std::move(instruments)) {
+    for (const auto& [instrument_name, instrument] : this->instruments) {
+        markets[instrument_name];
+    }
+}
+
+std::unordered_map<std::string, Instrument> Backtester::instrumentsFromNames(const std::vector<std::string>& names) {
+    std::unordered_map<std::string, Instrument> result;
+    for (const std::string& name : names) {
+        std::vector<std::string> parts;
+        size_t begin = 0;
+        while (true) {
+            size_t end = name.find('-', begin);
+            parts.push_back(name.substr(begin, end - begin));
+            if (end == std::string::npos) break;
+            begin = end + 1;
+        }
+        size_t underscore = parts[0].find('_');
+        if (parts.size() == 1 && underscore != std::string::npos) {
+            // Spot pairs such as BTC_USDC
+            result[name] = Instrument(parts[0].substr(0, underscore), parts[0].substr(underscore + 1), "spot", true);
+        } else if (parts.size() == 4 && (parts[3] == "C" || parts[3] == "P")) {
+            result[name] = Instrument(parts[0], "USD", "option", true, std::strtod(parts[2].c_str(), nullptr),
+                parts[3] == "C" ? "call" : "put");
+        } else {
+            std::string base = parts[0].substr(0, underscore);
+            std::string quote = underscore == std::string::npos ? "USD" : parts[0].substr(underscore + 1);
+            result[name] = Instrument(base, quote, "future", true);
+        }
+    }
+    return result;
+}
+
+std::string Backtester::get(const std::string& url, const std::string&) {
+    ApiRequest request = ApiRequest::parse(url);
+    std::lock_guard lock(mutex);
+    return handle(request);
+}
+
+std::string Backtester::handle(const ApiRequest& request) {
+    const std::string& method = request.method;
+
+    std::string response;
+    if (api_response::referenceData(request, instruments, response)) {
+        return response;
+    }
+    if (method == "public/get_order_book") {
+        std::string instrument_name = request.text("instrument_name");
+        if (markets.find(instrument_name) == markets.end()) {
+            return api_response::error(api_response::INVALID_PARAMS, "Instrument not found: " + instrument_name);
+        }
+        return api_response::result(orderBookJson(instrument_name, (size_t)request.number("depth", 5)));
+    }
+
+    if (method == "private/buy" || method == "private/sell") {
+        JsonValue result = placeOrder(method == "private/buy", request);
+        if (std::holds_alternative<std::string>(result.value)) {
+            ++stats.rejected;
+            const std::string& reason = result.get<std::string>();
+            int code = reason.rfind("post_only", 0) == 0 ? api_response::POST_ONLY_REJECT
+                : reason.rfind("reduce_only", 0) == 0 ? api_response::REDUCE_ONLY_REJECT : api_response::INVALID_PARAMS;
+            return api_response::error(code, reason);
+        }
+        return api_response::result(std::move(result));
+    }
+    if (method == "private/edit" || method == "private/cancel" || method == "private/get_order_state") {
+        auto it = orders.find(request.text("order_id"));
+        if (it == orders.end()) {
+            return api_response::error(api_response::INVALID_PARAMS, "Order not found: " + request.text("order_id"));
+        }
+        SimOrder& order = it->second;
+        if (method == "private/get_order_state") {
+            return api_response::result(orderJson(order));
+        }
+        if (!OrderCache::isOpenState(order.order_state)) {
+            return api_response::error(api_response::NOT_OPEN_ORDER, "not_open_order");
+        }
+        if (method == "private/cancel") {
+            return api_response::result(cancelOrder(order));
+        }
+        JsonValue result = editOrder(order, request);
+        if (std::holds_alternative<std::string>(result.value)) {
+            return api_response::error(api_response::INVALID_PARAMS, result.get<std::string>());
+        }
+        return api_response::result(std::move(result));
+    }
+    if (method == "private/edit_by_label") {
+        std::string label = request.text("label");
+        std::string instrument_name = request.text("instrument_name");
+        for (auto& [order_id, order] : orders) {
+            if (order.label == label && order.instrument_name == instrument_name && OrderCache::isOpenState(order.order_state)) {
+                JsonValue result = editOrder(order, request);
+                if (std::holds_alternative<std::string>(result.value)) {
+                    return api_response::error(api_response::INVALID_PARAMS, result.get<std::string>());
+                }
+                return api_response::result(std::move(result));
+            }
+        }
+        return api_response::error(api_response::NOT_OPEN_ORDER, "not_open_order");
+    }
+
+    // Mass cancels
+    std::string type = request.text("type", "all");
+    std::string kind = request.text("kind", "any");
+    auto instrumentMatches = [&](const SimOrder& order, const std::string& currency) {
+        const Instrument& instrument = instruments.at(order.instrument_name);
+        return (currency == "any" || currency.empty() || instrument.settlement_currency == currency) &&
+            (kind == "any" || instrument.kind == kind) && OrderCache::matchesType(order.order_type, type);
+    };
+    if (method == "private/cancel_all") {
+        return api_response::result(JsonValue(double(cancelWhere([](const SimOrder&) { return true; }))));
+    }
+    if (method == "private/cancel_all_by_currency" || method == "private/cancel_all_by_kind_or_type") {
+        std::string currency = request.text("currency", "any");
+        return api_response::result(JsonValue(double(cancelWhere([&](const SimOrder& order) {
+            return instrumentMatches(order, currency);
+        }))));
+    }
+    if (method == "private/cancel_all_by_currency_pair") {
+        std::string pair = request.text("currency_pair");
+        return api_response::result(JsonValue(double(cancelWhere([&](const SimOrder& order) {
+            const Instrument& instrument = instruments.at(order.instrument_name);
+            std::string order_pair = instrument.base_currency + "_" + instrument.quote_currency;
+            std::transform(order_pair.begin(), order_pair.end(), order_pair.begin(), ::tolower);
+            std::string wanted = pair;
+            std::transform(wanted.begin(), wanted.end(), wanted.begin(), ::tolower);
+            return order_pair == wanted && instrumentMatches(order, "any");
+        }))));
+    }
+    if (method == "private/cancel_all_by_instrument") {
+        std::string instrument_name = request.text("instrument_name");
+        return api_response::result(JsonValue(double(cancelWhere([&](const SimOrder& order) {
+            return order.instrument_name == instrument_name && OrderCache::matchesType(order.order_type, type);
+        }))));
+    }
+    if (method == "private/cancel_by_label") {
+        std::string label = request.text("label");
+        std::string currency = request.text("currency", "any");
+        return api_response::result(JsonValue(double(cancelWhere([&](const SimOrder& order) {
+            return order.label == label && instrumentMatches(order, currency);
+        }))));
+    }
+
+    // Queries
+    if (method == "private/get_open_orders") {
+        return api_response::result(JsonValue(openOrdersWhere([&](const SimOrder& order) {
+            return instrumentMatches(order, "any");
+        })));
+    }
+    if (method == "private/get_open_orders_by_currency") {
+        std::string currency = request.text("currency");
+        return api_response::result(JsonValue(openOrdersWhere([&](const SimOrder& order) {
+            return instrumentMatches(order, currency);
+        })));
+    }
+    if (method == "private/get_open_orders_by_instrument") {
+        std::string instrument_name = request.text("instrument_name");
+        return api_response::result(JsonValue(openOrdersWhere([&](const SimOrder& order) {
+            return order.instrument_name == instrument_name && OrderCache::matchesType(order.order_type, type);
+        })));
+    }
+    if (method == "private/get_open_orders_by_label") {
+        std::string label = request.text("label");
+        std::string currency = request.text("currency");
+        return api_response::result(JsonValue(openOrdersWhere([&](const SimOrder& order) {
+            return order.label == label && instrumentMatches(order, currency);
+        })));
+    }
+    if (method == "private/get_order_state_by_label") {
+        std::string label = request.text("label");
+        std::string currency = request.text("currency");
+        JsonArray result;
+        for (const auto& [order_id, order] : orders) {
+            if (order.label == label && instruments.at(order.instrument_name).settlement_currency == currency) {
+                result.push_back(orderJson(order));
+            }
+        }
+        return api_response::result(JsonValue(std::move(result)));
+    }
+    return api_response::error(api_response::METHOD_NOT_FOUND, "Method not found: " + method);
+}
+
+JsonValue Backtester::placeOrder(bool isBuy, const ApiRequest& request) {
+    std::string instrument_name = request.text("instrument_name");
+    auto market = markets.find(instrument_name);
+    if (market == markets.end()) {
+        return JsonValue(std::string("Instrument not found: " + instrument_name));
+    }
+
+    SimOrder order;
+    order.order_id = "BT-" + std::to_string(next_order_id++);
+    order.instrument_name = instrument_name;
+    order.isBuy = isBuy;
+    order.order_type = request.text("type", "limit");
+    order.time_in_force = request.text("time_in_force", "good_til_cancelled");
+    order.label = request.text("label");
+    order.amount = request.has("amount") ? request.number("amount") : request.number("contracts");
+    order.price = request.number("price");
+    order.trigger_price = request.number("trigger_price");
+    order.trigger_offset = request.number("trigger_offset");
+    order.post_only = request.flag("post_only");
+    order.reject_post_only = request.flag("reject_post_only");
+    order.reduce_only = request.flag("reduce_only");
+    order.creation_timestamp = now;
+    order.last_update_timestamp = now;
+    if (order.amount <= 0) {
+        return JsonValue(std::string("Invalid amount"));
+    }
+
+    if (order.reduce_only) {
+        double position = market->second.position;
+        double reducible = isBuy ? std::max(-position, 0.0) : std::max(position, 0.0);
+        if (reducible <= EPSILON) {
+            return JsonValue(std::string("reduce_only order would increase the position"));
+        }
+        order.amount = std::min(order.amount, reducible);
+    }
+
+    bool is_trigger = order.order_type == "stop_limit" || order.order_type == "stop_market" ||
+        order.order_type == "take_limit" || order.order_type == "take_market" || order.order_type == "trailing_stop";
+    const BookSnapshot& book = market->second.book;
+    if (!is_trigger && order.post_only && order.order_type == "limit") {
+        const BookSide& opposite = isBuy ? book.asks : book.bids;
+        bool crosses = opposite.size() > 0 && (isBuy ? order.price >= opposite.prices[0] : order.price <= opposite.prices[0]);
+        if (crosses) {
+            const BookSide& own = isBuy ? book.bids : book.asks;
+            if (order.reject_post_only || own.size() == 0) {
+                return JsonValue(std::string("post_only order would take liquidity"));
+            }
+            order.price = own.prices[0];
+        }
+    }
+
+    ++stats.orders;
+    auto [it, inserted] = orders.emplace(order.order_id, std::move(order));
+    SimOrder& placed = it->second;
+    Fills fills;
+    if (is_trigger) {
+        placed.order_state = "untriggered";
+        double mid = book_analytics::midPrice(book);
+        placed.trail_extreme = mid;
+        market->second.active.push_back(placed.order_id);
+    } else {
+        arrive(placed, fills);
+    }
+
+    JsonObject result;
+    result.emplace("order", orderJson(placed));
+    result.emplace("trades", JsonValue(std::move(fills.trades)));
+    return JsonValue(std::move(result));
+}
+
+void Backtester::arrive(SimOrder& order, Fills& fills) {
+    order.order_state = "open";
+    Market& market = markets[order.instrument_name];
+    bool is_market = order.order_type == "market" || order.order_type == "stop_market" ||
+        order.order_type == "take_market" || order.order_type == "trailing_stop";
+
+    if (order.time_in_force == "fill_or_kill") {
+        // All or nothing: check the reachable liquidity first
+        const BookSide& opposite = order.isBuy ? market.book.asks : market.book.bids;
+        double available = 0;
+        for (size_t i = 0; i < opposite.size(); ++i) {
+            if (!is_market && (order.isBuy ? opposite.prices[i] > order.price : opposite.prices[i] < order.price)) break;
+            available += opposite.amounts[i];
+        }
+        if (available + EPSILON < order.remaining()) {
+            close(order, "cancelled");
+            return;
+        }
+    }
+
+    execute(order, false, fills);
+    if (order.order_state != "open") return;
+    if (is_market || order.time_in_force == "immediate_or_cancel" || order.time_in_force == "fill_or_kill") {
+        close(order, "cancelled");
+        return;
+    }
+    if (std::find(market.active.begin(), market.active.end(), order.order_id) == market.active.end()) {
+        market.active.push_back(order.order_id);
+    }
+}
+
+void Backtester::execute(SimOrder& order, bool passive, Fills& fills) {
+    const BookSnapshot& book = markets[order.instrument_name].book;
+    const BookSide& opposite = order.isBuy ? book.asks : book.bids;
+    bool is_market = order.price <= 0;
+    for (size_t i = 0; i < opposite.size() && order.remaining() > EPSILON; ++i) {
+        double level_price = opposite.prices[i];
+        if (!is_market && (order.isBuy ? level_price > order.price : level_price < order.price)) break;
+        double amount = std::min(order.remaining(), opposite.amounts[i]);
+        fill(order, passive ? order.price : level_price, amount, passive, fills);
+    }
+}
+
+void Backtester::fill(SimOrder& order, double price, double amount, bool maker, Fills& fills) {
+    Market& market = markets[order.instrument_name];
+    order.filled_amount += amount;
+    order.notional += price * amount;
+    order.last_update_timestamp = now;
+    double signed_amount = order.isBuy ? amount : -amount;
+    market.position += signed_amount;
+    market.cash -= signed_amount * price;
+    if (order.remaining() <= EPSILON) {
+        close(order, "filled");
+    }
+    ++stats.trades;
+
+    JsonObject trade;
+    trade.emplace("trade_id", JsonValue("BT-T" + std::to_string(next_trade_id++)));
+    trade.emplace("order_id", JsonValue(order.order_id));
+    trade.emplace("instrument_name", JsonValue(order.instrument_name));
+    trade.emplace("direction", JsonValue(std::string(order.isBuy ? "buy" : "sell")));
+    trade.emplace("amount", JsonValue(amount));
+    trade.emplace("price", JsonValue(price));
+    trade.emplace("timestamp", JsonValue(double(now)));
+    trade.emplace("state", JsonValue(order.order_state));
+    trade.emplace("liquidity", JsonValue(std::string(maker ? "M" : "T")));
+    trade.emplace("label", JsonValue(order.label));
+    trade.emplace("fee", JsonValue(0.0));
+    fills.trades.push_back(JsonValue(std::move(trade)));
+    fills.changed.push_back(order.order_id);
+}
+
+void Backtester::close(SimOrder& order, const std::string& state) {
+    order.order_state = state;
+    order.last_update_timestamp = now;
+    std::vector<std::string>& active = markets[order.instrument_name].active;
+    active.erase(std::remove(active.begin(), active.end(), order.order_id), active.end());
+}
+
+JsonValue Backtester::editOrder(SimOrder& order, const ApiRequest& request) {
+    double amount = request.has("amount") ? request.number("amount")
+        : request.has("contracts") ? request.number("contracts") : order.amount;
+    if (amount < order.filled_amount + EPSILON) {
+        return JsonValue(std::string("Amount must exceed the filled amount"));
+    }
+    order.amount = amount;
+    if (request.has("price")) order.price = request.number("price");
+    if (request.has("trigger_price")) order.trigger_price = request.number("trigger_price");
+    if (request.has("trigger_offset")) order.trigger_offset = request.number("trigger_offset");
+    if (request.has("post_only")) order.post_only = request.flag("post_only");
+    if (request.has("reduce_only")) order.reduce_only = request.flag("reduce_only");
+    order.last_update_timestamp = now;
+
+    Fills fills;
+    if (order.order_state == "open") {
+        const BookSnapshot& book = markets[order.instrument_name].book;
+        const BookSide& opposite = order.isBuy ? book.asks : book.bids;
+        bool crosses = opposite.size() > 0 && (order.isBuy ? order.price >= opposite.prices[0] : order.price <= opposite.prices[0]);
+        if (crosses && order.post_only) {
+            close(order, "cancelled");
+        } else {
+            execute(order, false, fills);
+        }
+    }
+    JsonObject result;
+    result.emplace("order", orderJson(order));
+    result.emplace("trades", JsonValue(std::move(fills.trades)));
+    return JsonValue(std::move(result));
+}
+
+JsonValue Backtester::cancelOrder(SimOrder& order) {
+    close(order, "cancelled");
+    return orderJson(order);
+}
+
+size_t Backtester::cancelWhere(const std::function<bool(const SimOrder&)>& matches) {
+    size_t cancelled = 0;
+    for (auto& [instrument_name, market] : markets) {
+        std::vector<std::string> active = market.active;
+        for (const std::string& order_id : active) {
+            SimOrder& order = orders.at(order_id);
+            if (matches(order)) {
+                close(order, "cancelled");
+                ++cancelled;
+            }
+        }
+    }
+    return cancelled;
+}
+
+JsonArray Backtester::openOrdersWhere(const std::function<bool(const SimOrder&)>& matches) const {
+    JsonArray result;
+    for (const auto& [instrument_name, market] : markets) {
+        for (const std::string& order_id : market.active) {
+            const SimOrder& order = orders.at(order_id);
+            if (matches(order)) result.push_back(orderJson(order));
+        }
+    }
+    return result;
+}
+
+bool Backtester::triggers(SimOrder& order, double reference) const {
+    if (reference != reference) return false;
+    const std::string& type = order.order_type;
+    if (type == "trailing_stop") {
+        // A sell trails the highest price seen, a buy the lowest
+        order.trail_extreme = order.isBuy ? std::min(order.trail_extreme, reference) : std::max(order.trail_extreme, reference);
+        return order.isBuy ? reference >= order.trail_extreme + order.trigger_offset
+                           : reference <= order.trail_extreme - order.trigger_offset;
+    }
+    bool is_stop = type == "stop_limit" || type == "stop_market";
+    bool rising = is_stop == order.isBuy;   // buy stops and sell takes fire on a rising price
+    return rising ? reference >= order.trigger_price : reference <= order.trigger_price;
+}
+
+void Backtester::onBook(const std::string& instrument_name, long long timestamp, const BookSnapshot& book,
+    const Strategy& strategy) {
+    Fills fills;
+    {
+        std::lock_guard lock(mutex);
+        ++stats.events;
+        now = timestamp;
+        Market& market = markets[instrument_name];
+        market.book.bids.prices.assign(book.bids.prices.begin(), book.bids.prices.end());
+        market.book.bids.amounts.assign(book.bids.amounts.begin(), book.bids.amounts.end());
+        market.book.asks.prices.assign(book.asks.prices.begin(), book.asks.prices.end());
+        market.book.asks.amounts.assign(book.asks.amounts.begin(), book.asks.amounts.end());
+        market.timestamp = timestamp;
+
+        if (!market.active.empty()) {
+            double mid = book_analytics::midPrice(market.book);
+            std::vector<std::string> active = market.active;
+            for (const std::string& order_id : active) {
+                SimOrder& order = orders.at(order_id);
+                if (order.order_state == "untriggered") {
+                    if (!triggers(order, mid)) continue;
+                    bool is_limit = order.order_type == "stop_limit" || order.order_type == "take_limit";
+                    if (!is_limit) order.price = 0;
+                    order.triggered = true;
+                    close(order, "open");
+                    arrive(order, fills);
+                    fills.changed.push_back(order_id);
+                } else if (order.order_state == "open") {
+                    execute(order, true, fills);
+                }
+            }
+        }
+    }
+
+    if (listener && !fills.changed.empty()) {
+        JsonArray changed;
+        std::vector<std::string> reported;
+        {
+            std::lock_guard lock(mutex);
+            for (const std::string& order_id : fills.changed) {
+                if (std::find(reported.begin(), reported.end(), order_id) != reported.end()) continue;
+                reported.push_back(order_id);
+                changed.push_back(orderJson(orders.at(order_id)));
+            }
+        }
+        JsonObject data;
+        data.emplace("instrument_name", JsonValue(instrument_name));
+        data.emplace("trades", JsonValue(std::move(fills.trades)));
+        data.emplace("orders", JsonValue(std::move(changed)));
+        JsonObject params;
+        params.emplace("channel", JsonValue("user.changes." + instrument_name + ".raw"));
+        params.emplace("data", JsonValue(std::move(data)));
+        listener(JsonValue(std::move(params)));
+    }
+    if (strategy) {
+        strategy(instrument_name, timestamp, book);
+    }
+}
+
+size_t Backtester::run(const TickReader& reader, long long from, long long to, const Strategy& strategy) {
+    // Each instrument replays one block at a time into a buffer; a heap merges them by time
+    struct Cursor {
+        std::string instrument_name;
+        std::vector<TickReader::Block> blocks;
+        size_t next_block = 0;
+        std::vector<long long> timestamps;
+        std::vector<BookSnapshot> books;
+        size_t count = 0;
+        size_t position = 0;
+    };
+
+    std::vector<Cursor> cursors;
+    for (const std::string& instrument_name : reader.instruments()) {
+        Cursor cursor;
+        cursor.instrument_name = instrument_name;
+        cursor.blocks = reader.blocks(instrument_name, from, to);
+        if (!cursor.blocks.empty()) cursors.push_back(std::move(cursor));
+    }
+
+    auto refill = [&](Cursor& cursor) {
+        cursor.count = 0;
+        cursor.position = 0;
+        while (cursor.count == 0 && cursor.next_block < cursor.blocks.size()) {
+            reader.replay(cursor.blocks[cursor.next_block++], from, to, [&](long long timestamp, const BookSnapshot& book) {
+                if (cursor.count == cursor.books.size()) {
+                    cursor.books.emplace_back();
+                    cursor.timestamps.push_back(0);
+                }
+                BookSnapshot& slot = cursor.books[cursor.count];
+                slot.bids.prices.assign(book.bids.prices.begin(), book.bids.prices.end());
+                slot.bids.amounts.assign(book.bids.amounts.begin(), book.bids.amounts.end());
+                slot.asks.prices.assign(book.asks.prices.begin(), book.asks.prices.end());
+                slot.asks.amounts.assign(book.asks.amounts.begin(), book.asks.amounts.end());
+                cursor.timestamps[cursor.count++] = timestamp;
+            });
+        }
+        return cursor.count > 0;
+    };
+
+    using Entry = std::pair<long long, size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        if (refill(cursors[i])) heap.emplace(cursors[i].timestamps[0], i);
+    }
+
+    size_t events = 0;
+    while (!heap.empty()) {
+        size_t i = heap.top().second;
+        heap.pop();
+        Cursor& cursor = cursors[i];
+        onBook(cursor.instrument_name, cursor.timestamps[cursor.position], cursor.books[cursor.position], strategy);
+        ++events;
+        if (++cursor.position < cursor.count || refill(cursor)) {
+            heap.emplace(cursor.timestamps[cursor.position], i);
+        }
+    }
+    return events;
+}
+
+JsonValue Backtester::orderJson(const SimOrder& order) const {
+    JsonObject fields;
+    fields.emplace("order_id", JsonValue(order.order_id));
+    fields.emplace("instrument_name", JsonValue(order.instrument_name));
+    fields.emplace("direction", JsonValue(std::string(order.isBuy ? "buy" : "sell")));
+    fields.emplace("order_type", JsonValue(order.order_type));
+    fields.emplace("time_in_force", JsonValue(order.time_in_force));
+    fields.emplace("order_state", JsonValue(order.order_state));
+    fields.emplace("label", JsonValue(order.label));
+    fields.emplace("amount", JsonValue(order.amount));
+    fields.emplace("filled_amount", JsonValue(order.filled_amount));
+    fields.emplace("price", JsonValue(order.price));
+    fields.emplace("average_price", JsonValue(order.filled_amount > 0 ? order.notional / order.filled_amount : 0.0));
+    fields.emplace("post_only", JsonValue(order.post_only));
+    fields.emplace("reduce_only", JsonValue(order.reduce_only));
+    if (order.trigger_price != 0) fields.emplace("trigger_price", JsonValue(order.trigger_price));
+    if (order.trigger_offset != 0) fields.emplace("trigger_offset", JsonValue(order.trigger_offset));
+    fields.emplace("triggered", JsonValue(order.triggered));
+    fields.emplace("creation_timestamp", JsonValue(double(order.creation_timestamp)));
+    fields.emplace("last_update_timestamp", JsonValue(double(order.last_update_timestamp)));
+    fields.emplace("api", JsonValue(true));
+    return JsonValue(std::move(fields));
+}
+
+JsonValue Backtester::orderBookJson(const std::string& instrument_name, size_t depth) const {
+    const Market& market = markets.at(instrument_name);
+    auto levels = [depth](const BookSide& side) {
+        JsonArray result;
+        for (size_t i = 0; i < side.size() && i < depth; ++i) {
+            result.push_back(JsonValue(JsonArray{JsonValue(side.prices[i]), JsonValue(side.amounts[i])}));
+        }
+        return result;
+    };
+    double mid = book_analytics::midPrice(market.book);
+    JsonObject result;
+    result.emplace("instrument_name", JsonValue(instrument_name));
+    result.emplace("timestamp", JsonValue(double(market.timestamp)));
+    result.emplace("bids", JsonValue(levels(market.book.bids)));
+    result.emplace("asks", JsonValue(levels(market.book.asks)));
+    result.emplace("mark_price", JsonValue(mid == mid ? mid : 0.0));
+    result.emplace("best_bid_price", JsonValue(market.book.bids.size() > 0 ? market.book.bids.prices[0] : 0.0));
+    result.emplace("best_ask_price", JsonValue(market.book.asks.size() > 0 ? market.book.asks.prices[0] : 0.0));
+    result.emplace("state", JsonValue(std::string("open")));
+    return JsonValue(std::move(result));
+}
+
+double Backtester::position(const std::string& instrument_name) const {
+    std::lock_guard lock(mutex);
+    auto it = markets.find(instrument_name);
+    return it == markets.end() ? 0 : it->second.position;
+}
+
+double Backtester::pnl(const std::string& instrument_name) const {
+    std::lock_guard lock(mutex);
+    auto it = markets.find(instrument_name);
+    if (it == markets.end()) return 0;
+    double mid = book_analytics::midPrice(it->second.book);
+    return it->second.cash + (it->second.position != 0 ? it->second.position * mid : 0);
+}
+
+Backtester::Stats Backtester::statistics() const {
+    std::lock_guard lock(mutex);
+    return stats;
+}
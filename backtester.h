@@ -0,0 +1,133 @@
+#pragma once
+
+#include "api_request.h"
+#include "book_analytics.h"
+#include "instruments.h"
+#include "json_parser.h"
+#include "tick_store.h"
+#include "transport.h"
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Simulated exchange for backtests. It answers the API calls TradingSystem makes (order book,
+// buy/sell/edit/cancel and their variants, open orders and order states) behind the Transport
+// interface, so a TradingSystem built on it runs strategies unchanged against recorded books:
+//
+//     auto backtester = std::make_shared<Backtester>(Backtester::instrumentsFromNames(reader.instruments()));
+//     TradingSystem trading(backtester);
+//     backtester->setEventListener([&](const JsonValue& params) { trading.onOrderEvent(params); });
+//     backtester->run(reader, from, to, [&](const std::string& name, long long ts, const BookSnapshot& book) {
+//         ... trading.buy(...) ...
+//     });
+//
+// Fill model: orders that cross the book on arrival take liquidity level by level up to their
+// limit; resting orders fill at their own price once the opposite side trades through or
+// touches it, up to the size shown there. Liquidity we take is not removed from later books.
+// Trigger orders fire on the mid price, which stands in for the index, mark and last prices.
+// A post_only order that would cross is rejected with reject_post_only, otherwise it joins the
+// best price on its own side. Positions and cash are linear (price * amount).
+class Backtester : public Transport {
+public:
+    using Strategy = std::function<void(const std::string& instrument_name, long long timestamp, const BookSnapshot& book)>;
+    // Receives user.changes-style notifications ({"channel", "data": {"trades", "orders"}}) for
+    // fills and triggers that happen between requests; pass them to TradingSystem::onOrderEvent
+    using EventListener = std::function<void(const JsonValue& params)>;
+
+    struct Stats {
+        size_t events = 0;
+        size_t orders = 0;
+        size_t trades = 0;
+        size_t rejected = 0;
+    };
+
+private:
+    struct SimOrder {
+        std::string order_id;
+        std::string instrument_name;
+        bool isBuy = true;
+        std::string order_type;         // limit, market, stop_limit, ...
+        std::string time_in_force;
+        std::string label;
+        std::string order_state;        // open, untriggered, filled, cancelled
+        double amount = 0;
+        double filled_amount = 0;
+        double price = 0;               // limit price; 0 for market orders
+        double notional = 0;            // sum of fill price * amount
+        double trigger_price = 0;
+        double trigger_offset = 0;
+        double trail_extreme = 0;       // best reference price seen by a trailing stop
+        bool post_only = false;
+        bool reject_post_only = false;
+        bool reduce_only = false;
+        bool triggered = false;
+        long long creation_timestamp = 0;
+        long long last_update_timestamp = 0;
+
+        double remaining() const { return amount - filled_amount; }
+    };
+
+    struct Market {
+        BookSnapshot book;
+        long long timestamp = 0;
+        std::vector<std::string> active;    // open and untriggered orders
+        double position = 0;
+        double cash = 0;
+    };
+
+    struct Fills {
+        JsonArray trades;
+        std::vector<std::string> changed;   // order ids to report
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Instrument> instruments;
+    std::unordered_map<std::string, Market> markets;
+    std::unordered_map<std::string, SimOrder> orders;
+    EventListener listener;
+    long long now = 0;
+    uint64_t next_order_id = 1;
+    uint64_t next_trade_id = 1;
+    Stats stats;
+
+    std::string handle(const ApiRequest& request);
+    JsonValue placeOrder(bool isBuy, const ApiRequest& request);
+    JsonValue editOrder(SimOrder& order, const ApiRequest& request);
+    JsonValue cancelOrder(SimOrder& order);
+    size_t cancelWhere(const std::function<bool(const SimOrder&)>& matches);
+    JsonArray openOrdersWhere(const std::function<bool(const SimOrder&)>& matches) const;
+
+    // Match an order against the book; `passive` fills at the order's price
+    void execute(SimOrder& order, bool passive, Fills& fills);
+    void fill(SimOrder& order, double price, double amount, bool maker, Fills& fills);
+    void arrive(SimOrder& order, Fills& fills);
+    void close(SimOrder& order, const std::string& state);
+    bool triggers(SimOrder& order, double reference) const;
+    JsonValue orderJson(const SimOrder& order) const;
+    JsonValue orderBookJson(const std::string& instrument_name, size_t depth) const;
+
+public:
+    explicit Backtester(std::unordered_map<std::string, Instrument> instruments);
+
+    // Instrument table derived from Deribit instrument names, for stores recorded without one
+    static std::unordered_map<std::string, Instrument> instrumentsFromNames(const std::vector<std::string>& names);
+
+    void setEventListener(EventListener listener) { this->listener = std::move(listener); }
+
+    // Apply one book update: fire triggers and fill resting orders, then run the strategy
+    void onBook(const std::string& instrument_name, long long timestamp, const BookSnapshot& book,
+        const Strategy& strategy = nullptr);
+
+    // Replay every instrument of a store in time order; returns the number of events
+    size_t run(const TickReader& reader, long long from, long long to, const Strategy& strategy);
+
+    std::string get(const std::string& url, const std::string& authToken) override;
+
+    double position(const std::string& instrument_name) const;
+    // Cash plus the position marked at the current mid
+    double pnl(const std::string& instrument_name) const;
+    Stats statistics() const;
+};
@@ -0,0 +1,286 @@
+#include "batch_runner.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <optional>
+#include <utility>
+
+namespace {
+
+// Splits on spaces and tabs; double quotes keep spaces in a value and are dropped. False for an
+// unterminated quote.
+bool tokenize(const std::string& line, std::vector<std::string>& tokens) {
+    std::string token;
+    bool quoted = false;
+    bool in_token = false;
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+            in_token = true;
+        } else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+            if (in_token) tokens.push_back(std::move(token));
+            token.clear();
+            in_token = false;
+        } else {
+            token += c;
+            in_token = true;
+        }
+    }
+    if (in_token) tokens.push_back(std::move(token));
+    return !quoted;
+}
+
+bool parseInt(const std::string& text, int& value) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+}
+
+// Queries only have the JsonValue API: null when rejected locally (the reason is logged) and the
+// error response when the exchange refused
+Result<JsonValue> classify(JsonValue response) {
+    if (response.isNull()) {
+        return Result<JsonValue>::failure(ErrorCode::Validation, "Rejected locally; the reason is in the log");
+    }
+    return exchangeResult(std::move(response));
+}
+
+} // namespace
+
+void BatchRunner::parse(const std::string& line, Command& command) {
+    using Op = Command::Op;
+    struct IntField {
+        const char* name;
+        int Command::* member;
+        bool editable;
+    };
+    struct StringField {
+        const char* name;
+        std::string Command::* member;
+        bool editable;
+    };
+    static const std::pair<const char*, Op> ops[] = {
+        {"buy", Op::Buy}, {"sell", Op::Sell}, {"edit", Op::Edit}, {"cancel", Op::Cancel},
+        {"book", Op::Book}, {"orders", Op::Orders}, {"state", Op::State}};
+    static const IntField int_fields[] = {
+        {"amount", &Command::amount, true}, {"contracts", &Command::contracts, true},
+        {"price", &Command::price, true}, {"max_show", &Command::max_show, false},
+        {"post_only", &Command::post_only, true}, {"reject_post_only", &Command::reject_post_only, true},
+        {"reduce_only", &Command::reduce_only, true}, {"trigger_price", &Command::trigger_price, true},
+        {"trigger_offset", &Command::trigger_offset, true}, {"mmp", &Command::mmp, true},
+        {"valid_until", &Command::valid_until, true}};
+    static const StringField string_fields[] = {
+        {"type", &Command::type, false}, {"label", &Command::label, false},
+        {"time_in_force", &Command::time_in_force, false}, {"trigger", &Command::trigger, false},
+        {"advanced", &Command::advanced, true}, {"linked_order_type", &Command::linked_order_type, false},
+        {"trigger_fill_condition", &Command::trigger_fill_condition, false}};
+
+    std::vector<std::string> tokens;
+    bool complete = tokenize(line, tokens);
+    command.name = tokens[0];
+    if (!complete) {
+        command.error = "Unterminated quote";
+        return;
+    }
+    auto op = std::find_if(std::begin(ops), std::end(ops), [&](const auto& entry) { return command.name == entry.first; });
+    if (op == std::end(ops)) {
+        command.error = "Unknown operation " + command.name;
+        return;
+    }
+    command.op = op->second;
+
+    // The instrument or order id comes first; only orders may leave it out
+    size_t next = 1;
+    if (next < tokens.size() && tokens[next].find('=') == std::string::npos) {
+        command.target = tokens[next++];
+    } else if (command.op != Op::Orders) {
+        bool by_instrument = command.op == Op::Buy || command.op == Op::Sell || command.op == Op::Book;
+        command.error = by_instrument ? "Missing instrument name" : "Missing order id";
+        return;
+    }
+    if (command.op == Op::Book && next < tokens.size() && tokens[next].find('=') == std::string::npos) {
+        if (!parseInt(tokens[next++], command.depth)) {
+            command.error = "Invalid depth";
+            return;
+        }
+    }
+    if (command.op == Op::Edit) {
+        // Unset fields are left as they are
+        command.amount = -1;
+        command.contracts = -1;
+    }
+
+    bool takes_fields = command.op == Op::Buy || command.op == Op::Sell || command.op == Op::Edit;
+    for (; next < tokens.size(); ++next) {
+        const std::string& token = tokens[next];
+        size_t equals = token.find('=');
+        if (!takes_fields || equals == std::string::npos) {
+            command.error = "Unexpected " + token;
+            return;
+        }
+        std::string key = token.substr(0, equals);
+        std::string value = token.substr(equals + 1);
+        bool editing = command.op == Op::Edit;
+        auto int_field = std::find_if(std::begin(int_fields), std::end(int_fields),
+            [&](const IntField& field) { return key == field.name && (field.editable || !editing); });
+        if (int_field != std::end(int_fields)) {
+            if (!parseInt(value, command.*int_field->member)) {
+                command.error = "Invalid value for " + key;
+                return;
+            }
+            continue;
+        }
+        auto string_field = std::find_if(std::begin(string_fields), std::end(string_fields),
+            [&](const StringField& field) { return key == field.name && (field.editable || !editing); });
+        if (string_field == std::end(string_fields)) {
+            command.error = "Unknown parameter " + key + " for " + command.name;
+            return;
+        }
+        command.*string_field->member = std::move(value);
+    }
+}
+
+bool BatchRunner::next(Command& command) {
+    std::string line;
+    while (std::getline(*input, line)) {
+        ++line_number;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+        command = Command();
+        command.line = line_number;
+        parse(line, command);
+        return true;
+    }
+    return false;
+}
+
+Task<Result<JsonValue>> BatchRunner::execute(AsyncTrading& async, const Command& command) {
+    using Op = Command::Op;
+    switch (command.op) {
+        case Op::Buy:
+            co_return co_await async.tryBuy(command.target, command.amount, command.contracts, command.type,
+                command.label, command.price, command.time_in_force, command.max_show, command.post_only,
+                command.reject_post_only, command.reduce_only, command.trigger_price, command.trigger_offset,
+                command.trigger, command.advanced, command.mmp, command.valid_until, command.linked_order_type,
+                command.trigger_fill_condition);
+        case Op::Sell:
+            co_return co_await async.trySell(command.target, command.amount, command.contracts, command.type,
+                command.label, command.price, command.time_in_force, command.max_show, command.post_only,
+                command.reject_post_only, command.reduce_only, command.trigger_price, command.trigger_offset,
+                command.trigger, command.advanced, command.mmp, command.valid_until, command.linked_order_type,
+                command.trigger_fill_condition);
+        case Op::Edit:
+            co_return co_await async.tryEdit(command.target, command.amount, command.contracts, command.price,
+                command.post_only, command.reduce_only, command.reject_post_only, command.advanced,
+                command.trigger_price, command.trigger_offset, command.mmp, command.valid_until);
+        case Op::Cancel:
+            co_return co_await async.tryCancel(command.target);
+        case Op::Book:
+            co_return classify(co_await async.getOrderBook(command.target, command.depth));
+        case Op::Orders:
+            if (command.target.empty()) co_return classify(co_await async.getOpenOrders());
+            co_return classify(co_await async.getOpenOrdersByInstrument(command.target));
+        case Op::State:
+            co_return classify(co_await async.getOrderState(command.target));
+    }
+    co_return Result<JsonValue>::failure(ErrorCode::Validation, "Unknown operation");
+}
+
+void BatchRunner::record(const Command& command, const Result<JsonValue>& result, double us) {
+    JsonWriter& out = *output;
+    out.beginObject().key("line").value(command.line).key("op").value(command.name)
+        .key("ok").value(result.ok()).key("us").value(std::round(us * 10) / 10);
+    if (result) {
+        const JsonValue& response = result.value();
+        bool wrapped = std::holds_alternative<JsonObject>(response.value) && response.get<JsonObject>().count("result");
+        out.key("result").value(wrapped ? response.at("result") : response);
+        ++summary.succeeded;
+    } else {
+        const TradingError& error = result.error();
+        out.key("error").beginObject().key("kind").value(command.error.empty() ? errorCodeString(error.code) : "command");
+        if (error.code == ErrorCode::Exchange) out.key("code").value(error.exchange_code);
+        out.key("message").value(error.message).endObject();
+        ++summary.failed;
+    }
+    out.endObject().newline();
+    // One write per result: a reader of a pipe should not wait for the buffer to fill
+    out.flush(output_fd);
+    ++summary.operations;
+}
+
+Task<void> BatchRunner::worker(AsyncTrading& async) {
+    Command command;
+    while (next(command)) {
+        if (!command.error.empty()) {
+            record(command, Result<JsonValue>::failure(ErrorCode::Validation, command.error), 0);
+            continue;
+        }
+        auto start = Clock::now();
+        std::optional<Result<JsonValue>> result;
+        std::string failure;
+        try {
+            result.emplace(co_await execute(async, command));
+        } catch (const std::exception& e) {
+            // What the JsonValue API throws: "transport error: ..." or "parse error: ..."
+            failure = e.what();
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        if (!result) {
+            ErrorCode code = failure.rfind("parse", 0) == 0 ? ErrorCode::Parse : ErrorCode::Transport;
+            result.emplace(Result<JsonValue>::failure(code, failure));
+        }
+        latencies_us.push_back(us);
+        record(command, *result, us);
+    }
+}
+
+BatchRunner::Summary BatchRunner::run(std::istream& commands, int fd) {
+    JsonWriter writer(fd);
+    input = &commands;
+    output = &writer;
+    output_fd = fd;
+    line_number = 0;
+    latencies_us.clear();
+    summary = Summary();
+
+    AsyncTrading async(trading, loop);
+    auto start = Clock::now();
+    for (size_t i = 0; i < concurrency; ++i) {
+        loop.spawn(worker(async));
+    }
+    loop.run();
+    summary.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (!latencies_us.empty()) {
+        std::sort(latencies_us.begin(), latencies_us.end());
+        auto percentile = [&](double p) {
+            return latencies_us[std::min(latencies_us.size() - 1, size_t(p * double(latencies_us.size())))];
+        };
+        summary.p50_us = percentile(0.50);
+        summary.p90_us = percentile(0.90);
+        summary.p99_us = percentile(0.99);
+        summary.max_us = latencies_us.back();
+    }
+    writer.beginObject().key("summary").beginObject()
+        .key("operations").value(summary.operations)
+        .key("succeeded").value(summary.succeeded)
+        .key("failed").value(summary.failed)
+        .key("concurrency").value(concurrency)
+        .key("seconds").value(summary.seconds)
+        .key("ops_per_second").value(std::round(summary.throughput()))
+        .key("latency_us").beginObject()
+            .key("p50").value(std::round(summary.p50_us * 10) / 10)
+            .key("p90").value(std::round(summary.p90_us * 10) / 10)
+            .key("p99").value(std::round(summary.p99_us * 10) / 10)
+            .key("max").value(std::round(summary.max_us * 10) / 10)
+        .endObject()
+        .endObject().endObject().newline();
+    if (!writer.flush(fd)) {
+        logging::error("Writing batch results failed");
+    }
+    input = nullptr;
+    output = nullptr;
+    output_fd = -1;
+    return summary;
+}
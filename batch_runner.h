@@ -0,0 +1,107 @@
+#pragma once
+
+#include "async_trading.h"
+#include "json_writer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Runs a stream of operations, one per line, through AsyncTrading with up to `concurrency` of
+// them in flight on one EventLoop, and writes a compact JSON line for each as it completes:
+//
+//     buy BTC-PERPETUAL amount=10 type=limit price=60000 label="hedge 1"
+//     sell ETH-PERPETUAL amount=5 type=market
+//     edit 31457280 amount=20 price=61000
+//     cancel 31457280
+//     book BTC-PERPETUAL 10
+//     orders BTC-PERPETUAL
+//     state 31457280
+//
+//     {"line":1,"op":"buy","ok":true,"us":412,"result":{"order":{...},"trades":[]}}
+//     {"line":4,"op":"cancel","ok":false,"us":380,"error":{"kind":"exchange","code":11044,"message":"not_open_order"}}
+//
+// Parameters are named after the TradingSystem arguments. Blank lines and lines starting with
+// '#' are skipped; a line that does not parse fails with kind "command" and the rest still run.
+// Results come out in completion order, so "line" ties each one to its command, and each is
+// written out as soon as it completes, so a reader at the other end of a pipe sees it at once. After the last
+// one comes a {"summary":{...}} line with throughput and latency percentiles.
+//
+// Commands are read as the workers need them, so a file of any length runs in constant memory;
+// reading blocks the loop, so a slow pipe holds up the responses too. Over an in-process
+// transport every request completes inline and the batch runs one at a time.
+class BatchRunner {
+public:
+    struct Summary {
+        uint64_t operations = 0;
+        uint64_t succeeded = 0;
+        uint64_t failed = 0;
+        double seconds = 0;
+        double p50_us = 0;
+        double p90_us = 0;
+        double p99_us = 0;
+        double max_us = 0;
+
+        double throughput() const { return seconds > 0 ? double(operations) / seconds : 0.0; }
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Command {
+        enum class Op : uint8_t { Buy, Sell, Edit, Cancel, Book, Orders, State };
+
+        Op op = Op::Buy;
+        std::string name;           // as written, for the result line
+        uint64_t line = 0;
+        std::string error;          // why the line did not parse
+        std::string target;         // instrument name or order id
+        int depth = 5;
+        // Order and edit fields, with the defaults of the TradingSystem calls
+        int amount = 0;
+        int contracts = 0;
+        int price = -1;
+        int max_show = -1;
+        int post_only = -1;
+        int reject_post_only = -1;
+        int reduce_only = -1;
+        int trigger_price = -1;
+        int trigger_offset = -1;
+        int mmp = -1;
+        int valid_until = 0;
+        std::string type;
+        std::string label;
+        std::string time_in_force;
+        std::string trigger;
+        std::string advanced;
+        std::string linked_order_type;
+        std::string trigger_fill_condition;
+    };
+
+    TradingSystem& trading;
+    EventLoop& loop;
+    size_t concurrency;
+
+    // State of the current run()
+    std::istream* input = nullptr;
+    JsonWriter* output = nullptr;
+    int output_fd = -1;
+    uint64_t line_number = 0;
+    std::vector<double> latencies_us;
+    Summary summary;
+
+    static void parse(const std::string& line, Command& command);
+    bool next(Command& command);
+    Task<Result<JsonValue>> execute(AsyncTrading& async, const Command& command);
+    void record(const Command& command, const Result<JsonValue>& result, double us);
+    Task<void> worker(AsyncTrading& async);
+
+public:
+    BatchRunner(TradingSystem& trading, EventLoop& loop, size_t concurrency = 8)
+        : trading(trading), loop(loop), concurrency(concurrency ? concurrency : 1) {}
+
+    // Runs every command in `input` and writes the result lines and the summary to `output_fd`
+    Summary run(std::istream& input, int output_fd);
+};
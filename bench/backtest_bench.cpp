@@ -0,0 +1,99 @@
+#include "backtester.h"
+#include "tick_store.h"
+#include "trading_system.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+
+// Records synthetic random-walk books, then replays them through a Backtester: once without a
+// strategy (raw replay speed) and once with a TradingSystem quoting both sides every
+// `quote_every` events. Usage: bench_backtest_bench [instruments] [snapshots_per_instrument] [quote_every] [path]
+int main(int argc, char* argv[]) {
+    int instruments = argc > 1 ? std::stoi(argv[1]) : 10;
+    int snapshots = argc > 2 ? std::stoi(argv[2]) : 100000;
+    int quote_every = argc > 3 ? std::stoi(argv[3]) : 100;
+    std::string path = argc > 4 ? argv[4] : "/tmp/backtest_bench.ticks";
+    const int levels = 10;
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> step(-2, 2);
+    std::uniform_int_distribution<int> lots(1, 500);
+    std::bernoulli_distribution touch(0.2);
+
+    long long timestamp = 1700000000000;
+    {
+        TickRecorder recorder(path);
+        std::vector<BookSnapshot> books(instruments);
+        std::vector<double> mids(instruments);
+        for (int i = 0; i < instruments; ++i) {
+            recorder.setIncrements("BTC-FUTURE-" + std::to_string(i), 0.5, 10);
+            mids[i] = 60000 + 100 * i;
+            for (int l = 0; l < levels; ++l) {
+                books[i].bids.prices.push_back(mids[i] - 0.5 * (l + 1));
+                books[i].bids.amounts.push_back(lots(rng) * 10);
+                books[i].asks.prices.push_back(mids[i] + 0.5 * (l + 1));
+                books[i].asks.amounts.push_back(lots(rng) * 10);
+            }
+        }
+        for (int s = 0; s < snapshots; ++s) {
+            for (int i = 0; i < instruments; ++i) {
+                timestamp += 1;
+                BookSnapshot& book = books[i];
+                int move = step(rng);
+                if (move != 0) {
+                    mids[i] += 0.5 * move;
+                    for (int l = 0; l < levels; ++l) {
+                        book.bids.prices[l] = mids[i] - 0.5 * (l + 1);
+                        book.asks.prices[l] = mids[i] + 0.5 * (l + 1);
+                    }
+                }
+                for (int l = 0; l < levels; ++l) {
+                    if (touch(rng)) book.bids.amounts[l] = lots(rng) * 10;
+                    if (touch(rng)) book.asks.amounts[l] = lots(rng) * 10;
+                }
+                recorder.recordSnapshot("BTC-FUTURE-" + std::to_string(i), timestamp, book);
+            }
+        }
+    }
+
+    TickReader reader(path);
+    std::cout << "mode,events,orders,trades,ms,events_per_second\n";
+
+    auto report = [](const char* mode, const Backtester& backtester, double ms) {
+        Backtester::Stats stats = backtester.statistics();
+        std::cout << mode << "," << stats.events << "," << stats.orders << "," << stats.trades << "," << ms << ","
+            << stats.events / (ms / 1000) << "\n";
+    };
+
+    // Raw replay
+    {
+        Backtester backtester(Backtester::instrumentsFromNames(reader.instruments()));
+        auto start = std::chrono::steady_clock::now();
+        backtester.run(reader, 0, timestamp, nullptr);
+        report("replay", backtester, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // A strategy going through the TradingSystem API: cancel and requote one lot inside the spread
+    {
+        auto backtester = std::make_shared<Backtester>(Backtester::instrumentsFromNames(reader.instruments()));
+        TradingSystem trading(backtester);
+        backtester->setEventListener([&](const JsonValue& params) { trading.onOrderEvent(params); });
+        size_t seen = 0;
+        auto start = std::chrono::steady_clock::now();
+        backtester->run(reader, 0, timestamp, [&](const std::string& name, long long, const BookSnapshot& book) {
+            if (++seen % quote_every != 0 || book.bids.size() == 0 || book.asks.size() == 0) return;
+            trading.cancelAllByInstrument(name);
+            trading.buy(name, 10, 0, "limit", "mm", (int)std::floor(book.bids.prices[0]));
+            trading.sell(name, 10, 0, "limit", "mm", (int)std::ceil(book.asks.prices[0]));
+        });
+        report("strategy", *backtester, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        std::string first = reader.instruments().front();
+        std::cout << first << " position " << backtester->position(first) << " pnl " << backtester->pnl(first) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "batch_runner.h"
+#include "json_utils.h"
+#include "logger.h"
+#include "matching_engine.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+
+namespace {
+
+// A command stream of new limit orders, edits and cancels of resting orders, order book queries
+// and order state lookups
+std::string commands(int count, int instruments, const std::vector<std::string>& resting, std::mt19937& rng) {
+    std::uniform_int_distribution<int> pick(0, instruments - 1);
+    std::uniform_int_distribution<size_t> order(0, resting.size() - 1);
+    std::uniform_int_distribution<int> action(0, 99);
+    std::uniform_int_distribution<int> offset(1, 50);
+    std::ostringstream out;
+    out << "# synthetic batch\n";
+    for (int n = 0; n < count; ++n) {
+        int roll = action(rng);
+        std::string instrument = "BTC-FUTURE-" + std::to_string(pick(rng));
+        if (roll < 50) {
+            bool buy = roll < 25;
+            out << (buy ? "buy " : "sell ") << instrument << " amount=" << offset(rng) << " type=limit price="
+                << (buy ? 59000 - offset(rng) : 61000 + offset(rng)) << " label=\"batch " << n % 10 << "\"\n";
+        } else if (roll < 70) {
+            out << "edit " << resting[order(rng)] << " amount=" << offset(rng) << " price=" << 58000 + offset(rng) << "\n";
+        } else if (roll < 85) {
+            out << "cancel " << resting[order(rng)] << "\n";
+        } else if (roll < 95) {
+            out << "book " << instrument << " 10\n";
+        } else {
+            out << "state " << resting[order(rng)] << "\n";
+        }
+    }
+    return out.str();
+}
+
+} // namespace
+
+// Runs a synthetic command file of orders, edits, cancels and queries against a MatchingEngine:
+// one command at a time through the blocking calls with the interactive CLI's pretty-printed
+// output, and through BatchRunner writing JSON lines, at concurrency 1 and `concurrency`. Output
+// goes to /dev/null. Over an in-process transport requests complete inline, so this measures
+// the per-command cost of the batch path rather than its overlap of network round trips.
+// Usage: bench_batch_bench [commands] [instruments] [concurrency]
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 100000;
+    int instruments = argc > 2 ? std::stoi(argv[2]) : 10;
+    size_t concurrency = argc > 3 ? std::stoul(argv[3]) : 64;
+
+    std::unordered_map<std::string, Instrument> universe;
+    for (int i = 0; i < instruments; ++i) {
+        universe["BTC-FUTURE-" + std::to_string(i)] = Instrument("BTC", "USD", "future", true);
+    }
+    int null_fd = ::open("/dev/null", O_WRONLY);
+    logging::setOutput(null_fd);
+    std::mt19937 rng(5);
+
+    std::cout << "mode,concurrency,commands,succeeded,ms,commands_per_second,p50_us,p99_us\n";
+    auto fresh = [&](TradingSystem& trading, std::vector<std::string>& resting) {
+        for (int i = 0; i < 2000; ++i) {
+            JsonValue placed = trading.buy("BTC-FUTURE-" + std::to_string(i % instruments), 1, 0, "limit", "", 50000 + i % 100);
+            resting.push_back(placed.at("result").at("order").at("order_id").get<std::string>());
+        }
+    };
+
+    {
+        TradingSystem trading(std::make_shared<MatchingEngine>(universe));
+        std::vector<std::string> resting;
+        fresh(trading, resting);
+        std::string text = commands(count, instruments, resting, rng);
+        std::streambuf* previous = std::cout.rdbuf();
+        std::ofstream sink("/dev/null");
+        std::istringstream input(text);
+        std::string line, op, target;
+        size_t succeeded = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::cout.rdbuf(sink.rdbuf());
+        // The interactive path: one blocking call and a pretty-printed result per command
+        while (std::getline(input, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            fields >> op >> target;
+            JsonValue result;
+            if (op == "buy" || op == "sell") {
+                std::string amount, type, price;
+                fields >> amount >> type >> price;
+                int lots = std::stoi(amount.substr(7));
+                int limit = std::stoi(price.substr(6));
+                result = op == "buy" ? trading.buy(target, lots, 0, "limit", "batch", limit)
+                                     : trading.sell(target, lots, 0, "limit", "batch", limit);
+            } else if (op == "edit") {
+                std::string amount, price;
+                fields >> amount >> price;
+                result = trading.edit(target, std::stoi(amount.substr(7)), -1, std::stoi(price.substr(6)));
+            } else if (op == "cancel") {
+                result = trading.cancel(target);
+            } else if (op == "book") {
+                result = trading.getOrderBook(target, 10);
+            } else {
+                result = trading.getOrderState(target);
+            }
+            json_utils::printJson(result);
+            succeeded += !result.isNull() && !result.get<JsonObject>().count("error");
+        }
+        std::cout.rdbuf(previous);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "blocking_pretty,1," << count << "," << succeeded << "," << ms << "," << count / (ms / 1000) << ",,\n";
+    }
+
+    for (size_t workers : {size_t(1), concurrency}) {
+        TradingSystem trading(std::make_shared<MatchingEngine>(universe));
+        std::vector<std::string> resting;
+        fresh(trading, resting);
+        std::istringstream input(commands(count, instruments, resting, rng));
+        EventLoop loop;
+        BatchRunner runner(trading, loop, workers);
+        BatchRunner::Summary summary = runner.run(input, null_fd);
+        std::cout << "batch," << workers << "," << summary.operations << "," << summary.succeeded << ","
+            << summary.seconds * 1000 << "," << summary.throughput() << "," << summary.p50_us << "," << summary.p99_us << "\n";
+    }
+    logging::flush();
+    ::close(null_fd);
+    return 0;
+}
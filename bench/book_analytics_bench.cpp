@@ -0,0 +1,181 @@
+#include "book_analytics.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+
+// Level-by-level references for the SIMD kernels, written the obvious way
+namespace reference {
+
+double depth(const BookSide& side, size_t levels) {
+    size_t n = levels == 0 ? side.size() : std::min(levels, side.size());
+    double total = 0;
+    for (size_t i = 0; i < n; ++i) total += side.amounts[i];
+    return total;
+}
+
+double vwap(const BookSide& side, double size) {
+    if (size <= 0) return NaN;
+    double filled = 0;
+    double notional = 0;
+    for (size_t i = 0; i < side.size() && filled < size; ++i) {
+        double take = std::min(side.amounts[i], size - filled);
+        filled += take;
+        notional += take * side.prices[i];
+    }
+    return filled < size ? NaN : notional / size;
+}
+
+double mid(const BookSnapshot& book) {
+    if (book.bids.size() == 0 || book.asks.size() == 0) return NaN;
+    return (book.bids.prices[0] + book.asks.prices[0]) / 2;
+}
+
+double microprice(const BookSnapshot& book) {
+    if (book.bids.size() == 0 || book.asks.size() == 0) return NaN;
+    double bid_size = book.bids.amounts[0];
+    double ask_size = book.asks.amounts[0];
+    return (book.bids.prices[0] * ask_size + book.asks.prices[0] * bid_size) / (bid_size + ask_size);
+}
+
+double imbalance(const BookSnapshot& book, size_t levels) {
+    double bids = depth(book.bids, levels);
+    double asks = depth(book.asks, levels);
+    return bids + asks == 0 ? NaN : (bids - asks) / (bids + asks);
+}
+
+double slippage(const BookSnapshot& book, bool isBuy, double size) {
+    double fill = vwap(isBuy ? book.asks : book.bids, size);
+    return isBuy ? fill - mid(book) : mid(book) - fill;
+}
+
+} // namespace reference
+
+// Sums are reassociated across SIMD lanes, so results agree to rounding, and NaN with NaN
+bool same(double simd, double scalar) {
+    if (std::isnan(simd) || std::isnan(scalar)) return std::isnan(simd) && std::isnan(scalar);
+    return std::abs(simd - scalar) <= 1e-9 * std::max(1.0, std::abs(scalar));
+}
+
+BookSide side(std::mt19937& rng, size_t levels, double best, double step) {
+    std::uniform_real_distribution<double> amount(0.1, 10);
+    BookSide result;
+    for (size_t i = 0; i < levels; ++i) {
+        result.prices.push_back(best + step * double(i));
+        result.amounts.push_back(std::round(amount(rng) * 10) / 10);
+    }
+    return result;
+}
+
+template<typename F>
+double microseconds(int rounds, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) f();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+} // namespace
+
+// Checks every kernel and batch variant against a scalar reference on random books of 0 to
+// `levels` levels (empty sides included), then times both on full-depth books. Exits 1 if any
+// result differs beyond rounding.
+// Usage: bench_book_analytics_bench [books] [levels] [rounds]
+int main(int argc, char* argv[]) {
+    size_t book_count = argc > 1 ? std::stoul(argv[1]) : 1000;
+    size_t levels = argc > 2 ? std::stoul(argv[2]) : 10000;
+    int rounds = argc > 3 ? std::stoi(argv[3]) : 20;
+
+    std::mt19937 rng(11);
+    std::vector<BookSnapshot> books(book_count);
+    std::vector<double> sizes(book_count);
+    std::uniform_int_distribution<size_t> depth_of(0, 40);
+    std::uniform_real_distribution<double> size_of(0, 300);
+    for (size_t i = 0; i < book_count; ++i) {
+        // Mostly shallow books, whose lengths hit every SIMD tail, and some at full depth
+        size_t n = i % 10 == 0 ? levels : depth_of(rng);
+        double mid = 60000 + double(i % 100);
+        books[i].bids = side(rng, n, mid - 0.5, -0.5);
+        books[i].asks = side(rng, i % 17 == 0 ? 0 : n, mid + 0.5, 0.5);
+        sizes[i] = i % 13 == 0 ? 0 : size_of(rng);
+    }
+
+    size_t mismatches = 0;
+    auto expect = [&](const char* kernel, size_t book, double simd, double scalar) {
+        if (same(simd, scalar)) return;
+        if (mismatches++ < 10) {
+            std::cerr << kernel << " book " << book << ": " << simd << " != " << scalar << "\n";
+        }
+    };
+    std::vector<double> out(book_count);
+    for (size_t depth_levels : {size_t(0), size_t(1), size_t(5), size_t(7)}) {
+        for (size_t i = 0; i < book_count; ++i) {
+            expect("depth", i, book_analytics::depth(books[i].bids, depth_levels), reference::depth(books[i].bids, depth_levels));
+            expect("depthImbalance", i, book_analytics::depthImbalance(books[i], depth_levels),
+                reference::imbalance(books[i], depth_levels));
+        }
+        book_analytics::batchDepthImbalance(books, depth_levels, out.data());
+        for (size_t i = 0; i < book_count; ++i) {
+            expect("batchDepthImbalance", i, out[i], reference::imbalance(books[i], depth_levels));
+        }
+    }
+    for (size_t i = 0; i < book_count; ++i) {
+        expect("midPrice", i, book_analytics::midPrice(books[i]), reference::mid(books[i]));
+        expect("microprice", i, book_analytics::microprice(books[i]), reference::microprice(books[i]));
+    }
+    book_analytics::batchMicroprice(books, out.data());
+    for (size_t i = 0; i < book_count; ++i) {
+        expect("batchMicroprice", i, out[i], reference::microprice(books[i]));
+    }
+    for (bool isBuy : {true, false}) {
+        for (size_t i = 0; i < book_count; ++i) {
+            const BookSide& taken = isBuy ? books[i].asks : books[i].bids;
+            expect("vwap", i, book_analytics::vwap(taken, sizes[i]), reference::vwap(taken, sizes[i]));
+            expect("slippage", i, book_analytics::slippage(books[i], isBuy, sizes[i]),
+                reference::slippage(books[i], isBuy, sizes[i]));
+        }
+        book_analytics::batchVwap(books, isBuy, sizes.data(), out.data());
+        for (size_t i = 0; i < book_count; ++i) {
+            expect("batchVwap", i, out[i], reference::vwap(isBuy ? books[i].asks : books[i].bids, sizes[i]));
+        }
+        book_analytics::batchSlippage(books, isBuy, sizes.data(), out.data());
+        for (size_t i = 0; i < book_count; ++i) {
+            expect("batchSlippage", i, out[i], reference::slippage(books[i], isBuy, sizes[i]));
+        }
+    }
+
+    // Timing on one full-depth book, taking nearly all of it, and on the batch
+    BookSnapshot full;
+    full.bids = side(rng, levels, 59999.5, -0.5);
+    full.asks = side(rng, levels, 60000.5, 0.5);
+    double take = reference::depth(full.asks, 0) * 0.99;
+    volatile double sink = 0;
+    std::cout << "kernel,levels_or_books,scalar_us,simd_us,speedup\n";
+    auto row = [&](const char* kernel, size_t n, double scalar_us, double simd_us) {
+        std::cout << kernel << "," << n << "," << scalar_us << "," << simd_us << "," << scalar_us / simd_us << "\n";
+    };
+    row("depth", levels, microseconds(rounds, [&] { sink = sink + reference::depth(full.bids, 0); }),
+        microseconds(rounds, [&] { sink = sink + book_analytics::depth(full.bids, 0); }));
+    row("vwap", levels, microseconds(rounds, [&] { sink = sink + reference::vwap(full.asks, take); }),
+        microseconds(rounds, [&] { sink = sink + book_analytics::vwap(full.asks, take); }));
+    row("batchDepthImbalance", book_count, microseconds(rounds, [&] {
+            for (size_t i = 0; i < book_count; ++i) out[i] = reference::imbalance(books[i], 0);
+        }), microseconds(rounds, [&] { book_analytics::batchDepthImbalance(books, 0, out.data()); }));
+    row("batchMicroprice", book_count, microseconds(rounds, [&] {
+            for (size_t i = 0; i < book_count; ++i) out[i] = reference::microprice(books[i]);
+        }), microseconds(rounds, [&] { book_analytics::batchMicroprice(books, out.data()); }));
+
+    std::cout << "mismatches\n" << mismatches << "\n";
+    if (mismatches != 0) {
+        std::cerr << mismatches << " results differ from the scalar reference\n";
+        return 1;
+    }
+    return 0;
+}
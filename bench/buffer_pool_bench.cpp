@@ -0,0 +1,177 @@
+#include "event_loop.h"
+#include "http_client.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <new>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Allocations of at least 4KB made through operator new on the client thread, and their bytes.
+// The server runs in process and allocates its own bodies; those are not counted.
+static std::atomic<size_t> large_allocations{0};
+static std::atomic<size_t> large_bytes{0};
+static thread_local bool counting = false;
+
+// Not inlined: GCC would otherwise pair the inlined malloc with operator delete and warn
+__attribute__((noinline)) void* operator new(size_t bytes) {
+    void* block = std::malloc(bytes);
+    if (!block) throw std::bad_alloc();
+    if (counting && bytes >= 4096) {
+        ++large_allocations;
+        large_bytes += bytes;
+    }
+    return block;
+}
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+void operator delete(void* block, size_t) noexcept {
+    std::free(block);
+}
+
+namespace {
+
+// Keep-alive HTTP server answering /<n> with an n-byte JSON body, a thread per connection
+class LocalServer {
+private:
+    int listener = -1;
+    std::thread thread;
+
+    static std::string body(size_t bytes) {
+        std::string json = "{\"jsonrpc\":\"2.0\",\"result\":{\"bids\":[";
+        while (json.size() + 32 < bytes) json += "[60000.5,1250.0],";
+        json += "[60000.5,1250.0]]}}";
+        return json;
+    }
+
+    void serve(int connection) {
+        std::string request;
+        char buffer[4096];
+        while (true) {
+            ssize_t n = ::recv(connection, buffer, sizeof(buffer), 0);
+            if (n <= 0) return;
+            request.append(buffer, n);
+            size_t end;
+            while ((end = request.find("\r\n\r\n")) != std::string::npos) {
+                size_t bytes = std::stoul(request.substr(5));
+                request.erase(0, end + 4);
+                std::string payload = body(bytes);
+                std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                    std::to_string(payload.size()) + "\r\n\r\n" + payload;
+                if (::send(connection, response.data(), response.size(), MSG_NOSIGNAL) < 0) return;
+            }
+        }
+    }
+
+public:
+    LocalServer() {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        ::listen(listener, 16);
+        thread = std::thread([this] {
+            while (true) {
+                int connection = ::accept(listener, nullptr, nullptr);
+                if (connection < 0) return;
+                int one = 1;
+                ::setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                // RestClient and EventLoop each keep a connection open
+                std::thread([this, connection] {
+                    serve(connection);
+                    ::close(connection);
+                }).detach();
+            }
+        });
+    }
+
+    ~LocalServer() {
+        ::shutdown(listener, SHUT_RDWR);
+        thread.join();
+        ::close(listener);
+    }
+
+    int port() const {
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        return ntohs(address.sin_port);
+    }
+};
+
+Task<void> fetchAll(EventLoop& loop, const std::vector<std::string>& urls, size_t& bytes) {
+    for (const std::string& url : urls) {
+        PooledBuffer response = co_await loop.get(url);
+        bytes += response.size();
+    }
+}
+
+} // namespace
+
+// Fetches responses of mixed sizes (1x, 4x and 16x `kb` KB) from a local server and reports, per
+// request, the time and the client's allocations of 4KB or more: copied out of a buffer the
+// client keeps, as RestClient::get used to; moved out as a string; handed over in a pooled
+// buffer by RestClient and by EventLoop. Ends with the shared pool's counters.
+// Usage: bench_buffer_pool_bench [requests] [kb]
+int main(int argc, char* argv[]) {
+    int requests = argc > 1 ? std::stoi(argv[1]) : 3000;
+    size_t kb = argc > 2 ? std::stoul(argv[2]) : 16;
+
+    LocalServer server;
+    std::vector<std::string> urls;
+    for (int i = 0; i < requests; ++i) {
+        size_t bytes = kb * 1024 * (i % 3 == 0 ? 1 : i % 3 == 1 ? 4 : 16);
+        urls.push_back("http://127.0.0.1:" + std::to_string(server.port()) + "/" + std::to_string(bytes));
+    }
+
+    RestClient client;
+    size_t bytes = 0;
+    std::cout << "mode,requests,us_per_request,large_allocs_per_request,large_kb_per_request\n";
+    counting = true;
+    auto run = [&](const char* name, auto&& fetch) {
+        for (int i = 0; i < 30; ++i) fetch(urls[i]);  // warm the connection and the pool
+        size_t allocations = large_allocations;
+        size_t allocated = large_bytes;
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& url : urls) fetch(url);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << "," << requests << "," << us / requests << ","
+            << double(large_allocations - allocations) / requests << ","
+            << double(large_bytes - allocated) / 1024 / requests << "\n";
+    };
+
+    // A buffer kept by the client and a copy out of it per response: the old RestClient::get
+    PooledBuffer kept;
+    run("copy_out", [&](const std::string& url) {
+        kept = client.getBuffer(url);
+        std::string response = kept.str();
+        bytes += response.size();
+    });
+    run("move_out_string", [&](const std::string& url) { bytes += client.get(url).size(); });
+    run("pooled_rest_client", [&](const std::string& url) { bytes += client.getBuffer(url).size(); });
+
+    EventLoop loop;
+    run("pooled_event_loop", [&](const std::string& url) {
+        std::vector<std::string> one{url};
+        loop.spawn(fetchAll(loop, one, bytes));
+        loop.run();
+    });
+
+    BufferPool::Stats stats = BufferPool::shared().stats();
+    std::cout << "\nacquired,hits,misses,hit_rate,recycled,discarded,released,retained_kb\n";
+    std::cout << stats.acquired << "," << stats.hits << "," << stats.misses << "," << stats.hitRate() << ","
+        << stats.recycled << "," << stats.discarded << "," << stats.released << "," << stats.retained_bytes / 1024 << "\n";
+    if (bytes == 0) std::cerr << "no bytes received\n";
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "trading_system.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Stress test for a single TradingSystem shared by many threads.
+// Usage: bench_concurrency_bench [instrument] [requests_per_thread] [max_threads]
+int main(int argc, char* argv[]) {
+    std::string instrument_name = argc > 1 ? argv[1] : "BTC-PERPETUAL";
+    int requests_per_thread = argc > 2 ? std::stoi(argv[2]) : 50;
+    int max_threads = argc > 3 ? std::stoi(argv[3]) : 16;
+
+    TradingSystem trading;
+
+    std::cout << "threads,requests,errors,seconds,requests_per_second\n";
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::atomic<int> errors = 0;
+        std::vector<std::thread> workers;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&]() {
+                for (int i = 0; i < requests_per_thread; ++i) {
+                    try {
+                        JsonValue book = trading.getOrderBook(instrument_name, 5);
+                        if (book.isNull() || book.at("result").at("instrument_name").get<std::string>() != instrument_name) {
+                            ++errors;
+                        }
+                    } catch (const std::exception&) {
+                        ++errors;
+                    }
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int total = threads * requests_per_thread;
+        std::cout << threads << "," << total << "," << errors.load() << "," << seconds << "," << total / seconds << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "logger.h"
+#include "matching_engine.h"
+#include "trading_system.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Forwards to a MatchingEngine and counts the edit messages that reach it
+class CountingTransport : public Transport {
+private:
+    std::shared_ptr<MatchingEngine> engine;
+
+public:
+    std::atomic<uint64_t> edits{0};
+
+    explicit CountingTransport(std::shared_ptr<MatchingEngine> engine) : engine(std::move(engine)) {}
+
+    std::string get(const std::string& url, const std::string& authToken) override {
+        if (url.find("/private/edit?") != std::string::npos) edits.fetch_add(1, std::memory_order_relaxed);
+        return engine->get(url, authToken);
+    }
+};
+
+} // namespace
+
+// Edits a handful of resting orders from many threads at once through TradingSystem::edit, so
+// that requests for the same order keep overlapping, queueing and folding together in
+// InflightOrders. Reports edits per second, the messages sent and the edits coalesced, and
+// exits 1 if an edit fails or sent + coalesced does not account for every edit.
+// Usage: bench_inflight_bench [threads] [orders] [edits_per_thread]
+int main(int argc, char* argv[]) {
+    int threads = argc > 1 ? std::stoi(argv[1]) : 16;
+    int orders = argc > 2 ? std::stoi(argv[2]) : 4;
+    int edits = argc > 3 ? std::stoi(argv[3]) : 20000;
+
+    std::unordered_map<std::string, Instrument> universe;
+    universe["BTC-FUTURE-0"] = Instrument("BTC", "USD", "future", true);
+    auto transport = std::make_shared<CountingTransport>(std::make_shared<MatchingEngine>(universe));
+    TradingSystem trading(transport);
+
+    std::vector<std::string> order_ids;
+    for (int i = 0; i < orders; ++i) {
+        JsonValue placed = trading.buy("BTC-FUTURE-0", 10, 0, "limit", "", 50000 + i);
+        order_ids.push_back(placed.at("result").at("order").at("order_id").get<std::string>());
+    }
+
+    std::atomic<uint64_t> failed{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<size_t> pick(0, order_ids.size() - 1);
+            std::uniform_int_distribution<int> amount(1, 20);
+            std::uniform_int_distribution<int> price(49000, 49900);
+            for (int n = 0; n < edits; ++n) {
+                Result<JsonValue> result = trading.tryEdit(order_ids[pick(rng)], amount(rng), -1, price(rng));
+                if (!result) failed.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t total = uint64_t(threads) * edits;
+    uint64_t coalesced = trading.coalescedRequests();
+    uint64_t sent = transport->edits.load();
+    std::cout << "threads,orders,edits,edits_per_second,messages_sent,coalesced,failed\n";
+    std::cout << threads << "," << orders << "," << total << "," << total / (ms / 1000) << "," << sent << ","
+        << coalesced << "," << failed << "\n";
+
+    bool live = true;
+    for (const std::string& order_id : order_ids) live &= trading.orderFlightState(order_id) == FlightState::Live;
+    logging::flush();
+    if (failed || sent + coalesced != total || !live) {
+        std::cerr << "edits lost, failed or left in flight\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "instrument_universe.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A synthetic exchange: BTC and ETH options and futures, served as get_instruments responses per
+// (currency, kind) the way Deribit pages them, timings included
+class Exchange {
+private:
+    std::mutex mutex;
+    std::map<std::string, Instrument> listed;
+    std::map<std::string, std::string> responses;  // by URL, dropped when a listing changes
+
+    static std::string entry(const std::string& name, const Instrument& instrument) {
+        std::string json = "{\"instrument_name\":\"" + name + "\",\"base_currency\":\"" + instrument.base_currency
+            + "\",\"quote_currency\":\"USD\",\"kind\":\"" + instrument.kind + "\",\"is_active\":true"
+            + ",\"tick_size\":0.0005,\"contract_size\":1,\"min_trade_amount\":0.1"
+            + ",\"expiration_timestamp\":" + std::to_string(instrument.expiration_timestamp);
+        if (instrument.kind == "option") {
+            json += ",\"strike\":" + std::to_string(int(instrument.strike)) + ",\"option_type\":\"call\"";
+        }
+        return json + "}";
+    }
+
+public:
+    long long expiry = 0;
+
+    void list(const std::string& currency, int index) {
+        std::lock_guard lock(mutex);
+        listed[currency + "-" + std::to_string(index) + "-C"] = Instrument(currency, "USD", "option", true,
+            1000 + index, "call", expiry, 0.0005, 1, 0.1);
+        responses.clear();
+    }
+    void delist(const std::string& currency, int index) {
+        std::lock_guard lock(mutex);
+        listed.erase(currency + "-" + std::to_string(index) + "-C");
+        responses.clear();
+    }
+
+    // Wrapped like a Deribit response, with timings that differ on every call
+    static std::string response(const std::string& result) {
+        long long us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        return "{\"jsonrpc\":\"2.0\",\"result\":" + result + ",\"usIn\":" + std::to_string(us) +
+            ",\"usOut\":" + std::to_string(us + 42) + ",\"usDiff\":42,\"testnet\":true}";
+    }
+
+    std::string get(const std::string& url) {
+        if (url.find("get_currencies") != std::string::npos) {
+            return response("[{\"currency\":\"BTC\"},{\"currency\":\"ETH\"}]");
+        }
+        if (url.find("get_index_price_names") != std::string::npos) return response("[\"btc_usd\",\"eth_usd\"]");
+        std::string currency = url.substr(url.find("currency=") + 9, url.find('&') - url.find("currency=") - 9);
+        std::string kind = url.substr(url.find("kind=") + 5);
+        std::lock_guard lock(mutex);
+        auto cached = responses.find(url);
+        if (cached != responses.end()) return response(cached->second);
+        std::string json = "[";
+        for (const auto& [name, instrument] : listed) {
+            if (instrument.kind != kind || (currency != "any" && instrument.base_currency != currency)) continue;
+            if (json.back() == '}') json += ',';
+            json += entry(name, instrument);
+        }
+        json += "]";
+        return response(responses[url] = json);
+    }
+};
+
+// Keeps `instruments` options listed, then lists and delists `changes` of them per round and
+// times a full reload of the registry against an incremental refresh of the partition marked
+// changed, and against full refreshes with and without changes. Responses are cached by the
+// synthetic exchange, so the times are parsing, diffing and publishing. Then reader threads look
+// instruments up through read() while a writer keeps publishing; reports lookup percentiles.
+// Usage: bench_instrument_refresh_bench [instruments] [changes] [readers] [rounds]
+int main(int argc, char* argv[]) {
+    int instrument_count = argc > 1 ? std::stoi(argv[1]) : 20000;
+    int changes = argc > 2 ? std::stoi(argv[2]) : 20;
+    int readers = argc > 3 ? std::stoi(argv[3]) : 2;
+    int rounds = argc > 4 ? std::stoi(argv[4]) : 10;
+    logging::setLevel(logging::Level::Error);
+
+    Exchange exchange;
+    exchange.expiry = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() + 86400000LL * 365;
+    for (int i = 0; i < instrument_count; ++i) {
+        exchange.list(i % 2 ? "ETH" : "BTC", i);
+    }
+    InstrumentRegistry::Fetch fetch = [&exchange](const std::string& url) { return exchange.get(url); };
+
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    InstrumentUniverse universe(InstrumentRegistry::load(fetch));
+    universe.refresh(fetch, true);
+
+    // Lists `changes` new BTC options and delists as many old ones
+    int next_listing = instrument_count;
+    int next_delisting = 0;
+    auto churn = [&] {
+        for (int i = 0; i < changes; ++i) {
+            exchange.list("BTC", next_listing++);
+            exchange.delist("BTC", next_delisting);
+            next_delisting += 2;
+        }
+    };
+
+    double reload_ms = 0;
+    double marked_ms = 0;
+    double unchanged_ms = 0;
+    double full_ms = 0;
+    size_t fetched = 0;
+    for (int round = 0; round < rounds; ++round) {
+        churn();
+        InstrumentRegistry::load(fetch);    // fills the exchange's response cache
+        auto start = Clock::now();
+        InstrumentRegistry::load(fetch);
+        reload_ms += ms(start);
+
+        universe.markChanged("BTC", "option");
+        universe.refresh(fetch, false);     // fills the cache for the partition URLs
+        churn();
+        fetch("https://test.deribit.com/api/v2/public/get_instruments?currency=BTC&kind=option");
+        universe.markChanged("BTC", "option");
+        start = Clock::now();
+        RefreshStats stats = universe.refresh(fetch, false);
+        marked_ms += ms(start);
+        fetched += stats.partitions_fetched;
+        if (stats.added != size_t(changes) || stats.removed != size_t(changes)) {
+            std::cerr << "round " << round << ": " << stats.added << " added, " << stats.removed << " removed\n";
+        }
+
+        start = Clock::now();
+        stats = universe.refresh(fetch, true);
+        unchanged_ms += ms(start);
+        if (stats.partitions_changed != 0) {
+            std::cerr << "round " << round << ": " << stats.partitions_changed << " unchanged partitions parsed\n";
+        }
+
+        churn();
+        universe.refresh(fetch, false);     // nothing marked: fills the cache, publishes nothing
+        for (const char* currency : {"BTC", "ETH"}) {
+            for (const char* kind : {"future", "option", "future_combo", "option_combo"}) {
+                fetch(std::string("https://test.deribit.com/api/v2/public/get_instruments?currency=") + currency + "&kind=" + kind);
+            }
+        }
+        start = Clock::now();
+        universe.refresh(fetch, true);
+        full_ms += ms(start);
+    }
+
+    std::cout << "operation,instruments,changes,ms\n";
+    std::cout << "full_reload," << instrument_count << "," << changes * 2 << "," << reload_ms / rounds << "\n";
+    std::cout << "refresh_marked_partition," << instrument_count << "," << changes * 2 << "," << marked_ms / rounds << "\n";
+    std::cout << "refresh_full_unchanged," << instrument_count << ",0," << unchanged_ms / rounds << "\n";
+    std::cout << "refresh_full_changed," << instrument_count << "," << changes * 2 << "," << full_ms / rounds << "\n";
+    std::cout << "partitions_fetched_per_marked_refresh,,," << double(fetched) / rounds << "\n";
+
+    // Readers against a writer publishing a new version as fast as it can
+    std::atomic<bool> stop{false};
+    std::vector<std::vector<double>> samples(readers);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < readers; ++t) {
+        threads.emplace_back([&, t] {
+            size_t found = 0;
+            for (size_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+                std::string name = std::string(i % 2 ? "ETH" : "BTC") + "-" + std::to_string(i % instrument_count) + "-C";
+                auto before = Clock::now();
+                found += universe.read()->hasInstrument(name);
+                if (i % 16 == 0) samples[t].push_back(std::chrono::duration<double, std::nano>(Clock::now() - before).count());
+            }
+            if (found == 0) std::cerr << "no instrument found\n";
+        });
+    }
+    uint64_t version_before = universe.lastRefresh().version;
+    auto start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        churn();
+        universe.markChanged("BTC", "option");
+        universe.refresh(fetch, false);
+    }
+    double publish_seconds = ms(start) / 1000;
+    stop = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<double> all;
+    for (const std::vector<double>& thread_samples : samples) {
+        all.insert(all.end(), thread_samples.begin(), thread_samples.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto at = [&all](double q) { return all.empty() ? 0.0 : all[size_t(q * (all.size() - 1))]; };
+    std::cout << "\nreaders,versions_published,seconds,lookups_sampled,p50_ns,p99_ns,p999_ns,max_ns\n";
+    std::cout << readers << "," << universe.lastRefresh().version - version_before << "," << publish_seconds << ","
+        << all.size() << "," << at(0.5) << "," << at(0.99) << "," << at(0.999) << "," << (all.empty() ? 0.0 : all.back()) << "\n";
+    return 0;
+}
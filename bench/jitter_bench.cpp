@@ -0,0 +1,146 @@
+#include "event_loop.h"
+#include "logger.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Minimal keep-alive HTTP server answering every request with the same small JSON body
+class LocalServer {
+private:
+    int listener = -1;
+    std::thread thread;
+
+    void serve(int connection) {
+        static const std::string body = R"({"jsonrpc":"2.0","result":{"best_bid_price":60000.5,"best_ask_price":60001.0}})";
+        static const std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+            std::to_string(body.size()) + "\r\n\r\n" + body;
+        std::string request;
+        char buffer[4096];
+        while (true) {
+            ssize_t n = ::recv(connection, buffer, sizeof(buffer), 0);
+            if (n <= 0) return;
+            request.append(buffer, n);
+            size_t end;
+            while ((end = request.find("\r\n\r\n")) != std::string::npos) {
+                request.erase(0, end + 4);
+                if (::send(connection, response.data(), response.size(), MSG_NOSIGNAL) < 0) return;
+            }
+        }
+    }
+
+public:
+    explicit LocalServer(int cpu) {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        ::listen(listener, 16);
+        thread = std::thread([this, cpu] {
+            if (cpu >= 0) runtime::pinCurrentThread(cpu);
+            while (true) {
+                int connection = ::accept(listener, nullptr, nullptr);
+                if (connection < 0) return;
+                int one = 1;
+                ::setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                serve(connection);
+                ::close(connection);
+            }
+        });
+    }
+
+    ~LocalServer() {
+        ::shutdown(listener, SHUT_RDWR);
+        thread.join();
+        ::close(listener);
+    }
+
+    int port() const {
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        return ntohs(address.sin_port);
+    }
+};
+
+Task<void> roundTrips(EventLoop& loop, const std::string& url, int requests, std::vector<double>& samples) {
+    for (int i = 0; i < requests; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        PooledBuffer response = co_await loop.get(url);
+        samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        if (response.str().rfind("Error: ", 0) == 0) {
+            logging::error("Request failed: {}", response.str());
+            co_return;
+        }
+    }
+}
+
+} // namespace
+
+// Round-trip latency of sequential requests over one keep-alive connection to a local HTTP
+// server, for the default blocking event loop and for a busy-polling one pinned to its own core
+// with prefaulted memory. Reports percentiles and the spread (p99.9 - p50) as jitter. The
+// server runs on `server_cpu`; with a single core, busy polling competes with it and the
+// pinned numbers show what that costs.
+// Usage: bench_jitter_bench [requests] [client_cpu] [server_cpu]
+int main(int argc, char* argv[]) {
+    int requests = argc > 1 ? std::stoi(argv[1]) : 20000;
+    int cores = int(std::max(1u, std::thread::hardware_concurrency()));
+    int client_cpu = argc > 2 ? std::stoi(argv[2]) : 0;
+    int server_cpu = argc > 3 ? std::stoi(argv[3]) : (cores > 1 ? 1 : 0);
+
+    LocalServer server(server_cpu);
+    std::string url = "http://127.0.0.1:" + std::to_string(server.port()) + "/api/v2/public/ticker";
+
+    auto run = [&](PollMode mode, bool pinned) {
+        std::vector<double> samples;
+        samples.reserve(requests);
+        // Separate thread, so pinning and prefaulting stay with this configuration
+        std::thread client([&] {
+            if (pinned) {
+                runtime::pinCurrentThread(client_cpu);
+                runtime::prefaultStack(256 << 10);
+                runtime::prefaultHeap(16 << 20);
+            }
+            EventLoop loop(8, mode);
+            // Warm the connection and the transfer before timing
+            std::vector<double> warmup;
+            loop.spawn(roundTrips(loop, url, 100, warmup));
+            loop.run();
+            loop.spawn(roundTrips(loop, url, requests, samples));
+            loop.run();
+        });
+        client.join();
+        return samples;
+    };
+
+    std::cout << "mode,pinned,cores,requests,mean_us,p50_us,p99_us,p999_us,max_us,jitter_us\n";
+    auto report = [&](const char* name, bool pinned, std::vector<double> samples) {
+        if (samples.empty()) return;
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (double sample : samples) sum += sample;
+        auto at = [&](double quantile) { return samples[std::min(samples.size() - 1, size_t(samples.size() * quantile))]; };
+        std::cout << name << "," << pinned << "," << cores << "," << samples.size() << "," << sum / samples.size() << ","
+            << at(0.5) << "," << at(0.99) << "," << at(0.999) << "," << samples.back() << "," << at(0.999) - at(0.5) << "\n";
+    };
+
+    report("blocking", false, run(PollMode::Blocking, false));
+    report("blocking", true, run(PollMode::Blocking, true));
+    report("busy_poll", true, run(PollMode::BusyPoll, true));
+    return 0;
+}
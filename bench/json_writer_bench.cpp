@@ -0,0 +1,129 @@
+#include "json_writer.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+
+// Stream insertion as printJson used to do it, for comparison
+static void streamJson(const JsonValue& value, std::ostream& out) {
+    if (std::holds_alternative<std::nullptr_t>(value.value)) {
+        out << "null";
+    } else if (std::holds_alternative<bool>(value.value)) {
+        out << (value.get<bool>() ? "true" : "false");
+    } else if (std::holds_alternative<double>(value.value)) {
+        out << value.get<double>();
+    } else if (std::holds_alternative<std::string>(value.value)) {
+        out << "\"" << value.get<std::string>() << "\"";
+    } else if (std::holds_alternative<JsonArray>(value.value)) {
+        out << "[";
+        const auto& array = value.get<JsonArray>();
+        for (size_t i = 0; i < array.size(); ++i) {
+            if (i) out << ",";
+            streamJson(array[i], out);
+        }
+        out << "]";
+    } else {
+        out << "{";
+        size_t i = 0;
+        for (const auto& [key, element] : value.get<JsonObject>()) {
+            if (i++) out << ",";
+            out << "\"" << key << "\":";
+            streamJson(element, out);
+        }
+        out << "}";
+    }
+}
+
+// Serializes a synthetic order book response (`levels` per side) `rounds` times with a
+// std::ostringstream, a reused compact JsonWriter, a pretty JsonWriter with sorted keys and a
+// writer streaming newline-delimited records to /dev/null, and checks the compact output
+// parses back to the same prices.
+// Usage: bench_json_writer_bench [levels] [rounds]
+int main(int argc, char* argv[]) {
+    int levels = argc > 1 ? std::stoi(argv[1]) : 20;
+    int rounds = argc > 2 ? std::stoi(argv[2]) : 100000;
+
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> size(0.1, 50);
+    JsonArray bids, asks;
+    for (int i = 0; i < levels; ++i) {
+        bids.push_back(JsonValue(JsonArray{JsonValue(60000 - i * 0.5), JsonValue(size(rng))}));
+        asks.push_back(JsonValue(JsonArray{JsonValue(60000.5 + i * 0.5), JsonValue(size(rng))}));
+    }
+    JsonObject book;
+    book.emplace("instrument_name", JsonValue(std::string("BTC-PERPETUAL")));
+    book.emplace("timestamp", JsonValue(1700000000000.0));
+    book.emplace("bids", JsonValue(std::move(bids)));
+    book.emplace("asks", JsonValue(std::move(asks)));
+    book.emplace("mark_price", JsonValue(60000.27));
+    book.emplace("state", JsonValue(std::string("open")));
+    JsonObject response;
+    response.emplace("jsonrpc", JsonValue(std::string("2.0")));
+    response.emplace("result", JsonValue(std::move(book)));
+    JsonValue value(std::move(response));
+
+    auto time = [&](auto&& body) {
+        auto start = std::chrono::steady_clock::now();
+        size_t bytes = 0;
+        for (int r = 0; r < rounds; ++r) {
+            bytes += body();
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(ms, bytes);
+    };
+
+    std::cout << "path,rounds,bytes_per_round,ms,ns_per_round,mb_per_second\n";
+    auto report = [&](const char* path, std::pair<double, size_t> result) {
+        auto [ms, bytes] = result;
+        std::cout << path << "," << rounds << "," << bytes / rounds << "," << ms << "," << ms * 1e6 / rounds << ","
+            << bytes / (ms / 1000) / 1e6 << "\n";
+    };
+
+    report("ostringstream", time([&]() {
+        std::ostringstream out;
+        streamJson(value, out);
+        return out.str().size();
+    }));
+
+    JsonWriter compact;
+    report("writer_compact", time([&]() {
+        compact.clear();
+        compact.value(value);
+        return compact.size();
+    }));
+
+    JsonWriter pretty(JsonWriter::Style::Pretty, true);
+    report("writer_pretty_sorted", time([&]() {
+        pretty.clear();
+        pretty.value(value);
+        return pretty.size();
+    }));
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    {
+        JsonWriter stream(null_fd);
+        report("writer_fd_ndjson", time([&]() {
+            size_t before = stream.size();
+            stream.value(value).newline();
+            // A flush empties the buffer; count what this record added either way
+            return stream.size() > before ? stream.size() - before : compact.size() + 1;
+        }));
+    }
+    close(null_fd);
+
+    JsonParser parser;
+    compact.clear();
+    compact.value(value);
+    JsonValue parsed = parser.parse(compact.str());
+    const JsonArray& original = value.at("result").at("bids").get<JsonArray>();
+    const JsonArray& reread = parsed.at("result").at("bids").get<JsonArray>();
+    bool same = original.size() == reread.size();
+    for (size_t i = 0; same && i < original.size(); ++i) {
+        same = original[i].get<JsonArray>()[1].get<double>() == reread[i].get<JsonArray>()[1].get<double>();
+    }
+    std::cout << "roundtrip," << (same ? "exact" : "MISMATCH") << "\n";
+    return same ? 0 : 1;
+}
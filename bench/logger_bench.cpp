@@ -0,0 +1,86 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Times a validation-style message ("Instrument not found: {} at {} for {} contracts") logged
+// from 1 to `max_threads` threads, through logging:: into a file and through a std::ofstream
+// with std::endl as the old code did. Every 16th call is timed on its own for percentiles; a
+// short pause every `burst` calls lets the writer keep up, as on a real order path.
+// Usage: bench_logger_bench [calls_per_thread] [max_threads] [burst] [path]
+int main(int argc, char* argv[]) {
+    size_t calls = argc > 1 ? std::stoul(argv[1]) : 200000;
+    size_t max_threads = argc > 2 ? std::stoul(argv[2]) : 4;
+    size_t burst = argc > 3 ? std::stoul(argv[3]) : 64;
+    std::string path = argc > 4 ? argv[4] : "/tmp/logger_bench.log";
+    std::string instrument = "BTC-27DEC24-60000-C";
+
+    using Clock = std::chrono::steady_clock;
+    auto run = [&](size_t threads, auto&& call) {
+        std::vector<std::vector<double>> samples(threads);
+        auto start = Clock::now();
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                samples[t].reserve(calls / 16 + 1);
+                for (size_t i = 0; i < calls; ++i) {
+                    if (i % 16 == 0) {
+                        auto before = Clock::now();
+                        call(i);
+                        samples[t].push_back(std::chrono::duration<double, std::nano>(Clock::now() - before).count());
+                    } else {
+                        call(i);
+                    }
+                    if (burst > 0 && i % burst == burst - 1) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    }
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::vector<double> all;
+        for (const auto& thread_samples : samples) {
+            all.insert(all.end(), thread_samples.begin(), thread_samples.end());
+        }
+        std::sort(all.begin(), all.end());
+        return std::make_tuple(ms, all[all.size() / 2], all[all.size() * 99 / 100], all.back());
+    };
+
+    std::cout << "sink,threads,calls,ms,p50_ns,p99_ns,max_ns,dropped\n";
+    if (!logging::openFile(path)) {
+        std::cout << "Cannot open " << path << std::endl;
+        return 1;
+    }
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        uint64_t dropped_before = logging::dropped();
+        auto [ms, p50, p99, max] = run(threads, [&](size_t i) {
+            logging::warn("Instrument not found: {} at {} for {} contracts", instrument, 60000.5 + i, i);
+        });
+        logging::flush();
+        std::cout << "logger," << threads << "," << threads * calls << "," << ms << "," << p50 << "," << p99 << ","
+            << max << "," << logging::dropped() - dropped_before << "\n";
+    }
+
+    std::ofstream file(path, std::ios::app);
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        std::mutex mutex;
+        auto [ms, p50, p99, max] = run(threads, [&](size_t i) {
+            std::lock_guard lock(mutex);
+            file << "Instrument not found: " + instrument << " at " << 60000.5 + i << " for " << i << " contracts" << std::endl;
+        });
+        std::cout << "ofstream_endl," << threads << "," << threads * calls << "," << ms << "," << p50 << "," << p99 << ","
+            << max << ",0\n";
+    }
+    std::remove(path.c_str());
+    return 0;
+}
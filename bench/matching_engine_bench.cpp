@@ -0,0 +1,303 @@
+#include "async_trading.h"
+#include "matching_engine.h"
+#include "trading_system.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// Places and cancels `pairs` orders awaited through AsyncTrading, which calls an in-process
+// transport inline; counts the requests that came back with a result
+Task<void> placeAndCancel(AsyncTrading& async, int pairs, int instruments, std::mt19937& rng, int& completed) {
+    std::uniform_int_distribution<int> pick(0, instruments - 1);
+    for (int n = 0; n < pairs; ++n) {
+        JsonValue placed = co_await async.buy("BTC-FUTURE-" + std::to_string(pick(rng)), 1 + n % 20, 0, "limit", "bench", 59000 + n % 50);
+        if (placed.isNull() || !placed.get<JsonObject>().count("result")) continue;
+        ++completed;
+        JsonValue cancelled = co_await async.cancel(placed.at("result").at("order").at("order_id").get<std::string>());
+        if (!cancelled.isNull() && cancelled.get<JsonObject>().count("result")) ++completed;
+    }
+}
+
+
+using Fill = std::tuple<uint64_t, double, double>;     // maker order id, price, amount
+
+std::vector<Fill> fills(const std::vector<matching::Execution>& executions) {
+    std::vector<Fill> result;
+    for (const matching::Execution& execution : executions) {
+        result.emplace_back(execution.maker_order_id, execution.price, execution.amount);
+    }
+    return result;
+}
+
+matching::OrderSpec limit(uint32_t account, matching::Side side, double amount, double price) {
+    matching::OrderSpec spec;
+    spec.account = account;
+    spec.side = side;
+    spec.amount = amount;
+    spec.price = price;
+    return spec;
+}
+
+// Small books with known outcomes: price-time priority, iceberg refresh, FOK and IOC, post_only
+// joining and rejecting (also when amended), reduce_only caps and a cascade of stop orders.
+// Returns the number of failed checks, each named on stderr.
+int checkScenarios() {
+    using matching::OrderState;
+    using matching::Reject;
+    using matching::Side;
+    using matching::TimeInForce;
+    std::unordered_map<std::string, Instrument> universe;
+    universe["BTC-FUTURE-0"] = Instrument("BTC", "USD", "future", true);
+    int failures = 0;
+    auto check = [&](const char* name, bool ok) {
+        if (!ok) {
+            std::cerr << "scenario failed: " << name << "\n";
+            ++failures;
+        }
+    };
+    std::vector<matching::Execution> executions;
+
+    {
+        MatchingEngine engine(universe);
+        uint64_t far = engine.submit(0, limit(2, Side::Sell, 1, 101)).order_id;
+        uint64_t first = engine.submit(0, limit(3, Side::Sell, 2, 100)).order_id;
+        uint64_t second = engine.submit(0, limit(4, Side::Sell, 2, 100)).order_id;
+        matching::OrderResult taken = engine.submit(0, limit(1, Side::Buy, 5, 101), &executions);
+        check("price-time priority: better price first, then arrival",
+            fills(executions) == std::vector<Fill>{{first, 100, 2}, {second, 100, 2}, {far, 101, 1}});
+        check("price-time priority: average price", taken.state == OrderState::Filled && taken.average_price == 100.2);
+    }
+    {
+        MatchingEngine engine(universe);
+        matching::OrderSpec iceberg = limit(2, Side::Sell, 5, 100);
+        iceberg.max_show = 2;
+        uint64_t hidden = engine.submit(0, iceberg).order_id;
+        uint64_t behind = engine.submit(0, limit(3, Side::Sell, 3, 100)).order_id;
+        executions.clear();
+        engine.submit(0, limit(1, Side::Buy, 3, 100), &executions);
+        check("iceberg: the shown slice, then the order behind it",
+            fills(executions) == std::vector<Fill>{{hidden, 100, 2}, {behind, 100, 1}});
+        matching::OrderSpec sweep = limit(1, Side::Buy, 6, 100);
+        sweep.time_in_force = TimeInForce::ImmediateOrCancel;
+        executions.clear();
+        matching::OrderResult swept = engine.submit(0, sweep, &executions);
+        check("iceberg: a refreshed slice joins the back of the queue",
+            fills(executions) == std::vector<Fill>{{behind, 100, 2}, {hidden, 100, 2}, {hidden, 100, 1}});
+        check("iceberg: IOC remainder cancelled", swept.state == OrderState::Cancelled && swept.filled_amount == 5 &&
+            engine.bestBid(0) == 0 && engine.openOrders() == 0);
+    }
+    {
+        MatchingEngine engine(universe);
+        uint64_t maker = engine.submit(0, limit(2, Side::Sell, 3, 100)).order_id;
+        matching::OrderSpec fok = limit(1, Side::Buy, 5, 100);
+        fok.time_in_force = TimeInForce::FillOrKill;
+        executions.clear();
+        matching::OrderResult killed = engine.submit(0, fok, &executions);
+        check("FOK: killed without trading when short of liquidity",
+            executions.empty() && killed.state == OrderState::Cancelled && engine.bestAsk(0) == 100);
+        fok.amount = 3;
+        matching::OrderResult filled = engine.submit(0, fok, &executions);
+        check("FOK: filled in full", filled.state == OrderState::Filled &&
+            fills(executions) == std::vector<Fill>{{maker, 100, 3}});
+        maker = engine.submit(0, limit(2, Side::Sell, 2, 100)).order_id;
+        matching::OrderSpec ioc = limit(1, Side::Buy, 5, 100);
+        ioc.time_in_force = TimeInForce::ImmediateOrCancel;
+        executions.clear();
+        matching::OrderResult partial = engine.submit(0, ioc, &executions);
+        check("IOC: fills what it can and never rests", partial.state == OrderState::Cancelled &&
+            partial.filled_amount == 2 && fills(executions) == std::vector<Fill>{{maker, 100, 2}} &&
+            engine.openOrders() == 0);
+    }
+    {
+        MatchingEngine engine(universe);
+        engine.submit(0, limit(2, Side::Buy, 1, 99));
+        engine.submit(0, limit(3, Side::Sell, 1, 100));
+        matching::OrderSpec post = limit(1, Side::Buy, 1, 101);
+        post.post_only = true;
+        executions.clear();
+        matching::OrderResult joined = engine.submit(0, post, &executions);
+        check("post_only: a crossing order joins its own side", joined.state == OrderState::Open &&
+            executions.empty() && engine.bestBid(0) == 99 && engine.bestAsk(0) == 100);
+        post.reject_post_only = true;
+        matching::OrderResult rejected = engine.submit(0, post);
+        check("post_only: rejected with reject_post_only", rejected.reject == Reject::PostOnly &&
+            engine.openOrders() == 3);
+
+        MatchingEngine alone(universe);
+        alone.submit(0, limit(3, Side::Sell, 1, 100));
+        matching::OrderSpec bid = limit(1, Side::Buy, 1, 99);
+        bid.post_only = true;
+        uint64_t resting = alone.submit(0, bid).order_id;
+        matching::Amend across;
+        across.price = 101;
+        matching::OrderResult amended = alone.amend(resting, across);
+        check("post_only: an amendment with nothing to join is rejected and the order kept",
+            amended.reject == Reject::PostOnly && amended.state == OrderState::Open && alone.bestBid(0) == 99);
+        across.reject_post_only = 1;
+        across.amount = 2;
+        amended = alone.amend(resting, across);
+        across.price = -1;
+        across.reject_post_only = -1;
+        executions.clear();
+        matching::OrderSpec taker = limit(4, Side::Sell, 2, 99);
+        taker.time_in_force = TimeInForce::ImmediateOrCancel;
+        alone.submit(0, taker, &executions);
+        check("post_only: a rejected amendment changes neither flags nor amount",
+            amended.reject == Reject::PostOnly && fills(executions) == std::vector<Fill>{{resting, 99, 1}});
+    }
+    {
+        MatchingEngine engine(universe);
+        engine.submit(0, limit(2, Side::Sell, 3, 100));
+        engine.submit(0, limit(1, Side::Buy, 3, 100));
+        uint64_t bid = engine.submit(0, limit(4, Side::Buy, 10, 90)).order_id;
+        matching::OrderSpec reduce = limit(1, Side::Sell, 5, 90);
+        reduce.reduce_only = true;
+        executions.clear();
+        matching::OrderResult capped = engine.submit(0, reduce, &executions);
+        check("reduce_only: capped at the position", capped.state == OrderState::Filled && capped.filled_amount == 3 &&
+            fills(executions) == std::vector<Fill>{{bid, 90, 3}} && engine.position(1, 0) == 0);
+        reduce.amount = 1;
+        check("reduce_only: rejected with no position", engine.submit(0, reduce).reject == Reject::ReduceOnly);
+    }
+    {
+        MatchingEngine engine(universe);
+        uint64_t low = engine.submit(0, limit(2, Side::Sell, 1, 100)).order_id;
+        uint64_t mid = engine.submit(0, limit(2, Side::Sell, 1, 101)).order_id;
+        uint64_t high = engine.submit(0, limit(2, Side::Sell, 1, 102)).order_id;
+        matching::OrderSpec stop;
+        stop.account = 3;
+        stop.type = matching::OrderType::StopMarket;
+        stop.amount = 1;
+        stop.trigger_price = 100;
+        matching::OrderResult first = engine.submit(0, stop);
+        stop.account = 4;
+        stop.trigger_price = 101;
+        engine.submit(0, stop);
+        stop.trigger_price = 103;
+        matching::OrderResult unfired = engine.submit(0, stop);
+        executions.clear();
+        engine.submit(0, limit(1, Side::Buy, 1, 100), &executions);
+        check("triggers: each fill fires the next stop",
+            fills(executions) == std::vector<Fill>{{low, 100, 1}, {mid, 101, 1}, {high, 102, 1}} &&
+            executions[1].taker_order_id == first.order_id && engine.position(4, 0) == 1);
+        check("triggers: a stop beyond the last trade stays untriggered",
+            first.state == OrderState::Untriggered && engine.openOrders() == 1 &&
+            engine.cancel(unfired.order_id).reject == Reject::None);
+    }
+    return failures;
+}
+
+} // namespace
+
+// Drives a MatchingEngine with random order flow: limit orders around a drifting mid, cancels of
+// resting orders and marketable IOC orders, first through the native API and then as
+// TradingSystem requests through the Transport interface, blocking and awaited through
+// AsyncTrading. Exits 1 if an awaited request does not come back with a result, or if the
+// open-order table has grown past the orders ever open at once, or if a scenario with a known
+// outcome (see checkScenarios) trades differently.
+// Usage: bench_matching_engine_bench [instruments] [orders] [api_requests]
+int main(int argc, char* argv[]) {
+    int instruments = argc > 1 ? std::stoi(argv[1]) : 10;
+    int count = argc > 2 ? std::stoi(argv[2]) : 5000000;
+    int api_requests = argc > 3 ? std::stoi(argv[3]) : 100000;
+
+    int failures = checkScenarios();
+    std::cout << "scenario_failures\n" << failures << "\n";
+    if (failures != 0) return 1;
+
+    std::unordered_map<std::string, Instrument> universe;
+    for (int i = 0; i < instruments; ++i) {
+        universe["BTC-FUTURE-" + std::to_string(i)] = Instrument("BTC", "USD", "future", true);
+    }
+    auto engine = std::make_shared<MatchingEngine>(universe);
+
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> pick(0, instruments - 1);
+    std::uniform_int_distribution<int> action(0, 99);
+    std::uniform_int_distribution<int> offset(1, 50);
+    std::uniform_int_distribution<int> lots(1, 20);
+    std::uniform_int_distribution<uint32_t> account(1, 100);
+    std::vector<double> mids(instruments, 60000);
+    std::vector<uint64_t> resting;
+    resting.reserve(count);
+    std::vector<matching::Execution> executions;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < count; ++n) {
+        int i = pick(rng);
+        int roll = action(rng);
+        if (roll < 25 && !resting.empty()) {
+            std::uniform_int_distribution<size_t> which(0, resting.size() - 1);
+            size_t k = which(rng);
+            engine->cancel(resting[k]);
+            resting[k] = resting.back();
+            resting.pop_back();
+            continue;
+        }
+        matching::OrderSpec spec;
+        spec.account = account(rng);
+        spec.side = rng() & 1 ? matching::Side::Buy : matching::Side::Sell;
+        spec.amount = lots(rng);
+        bool buy = spec.side == matching::Side::Buy;
+        if (roll < 35) {
+            // Marketable: crosses a few ticks into the other side
+            spec.time_in_force = matching::TimeInForce::ImmediateOrCancel;
+            spec.price = mids[i] + (buy ? 5 : -5);
+        } else {
+            spec.price = mids[i] + (buy ? -offset(rng) : offset(rng)) * 0.5;
+        }
+        if (roll > 97) mids[i] += rng() & 1 ? 0.5 : -0.5;
+        executions.clear();
+        matching::OrderResult result = engine->submit(i, spec, &executions);
+        if (result.state == matching::OrderState::Open) resting.push_back(result.order_id);
+    }
+    double native_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "path,operations,trades,ms,operations_per_second,open_orders,pooled_orders,order_id_slots\n";
+    std::cout << "native," << count << "," << engine->trades() << "," << native_ms << "," << count / (native_ms / 1000) << ","
+        << engine->openOrders() << "," << engine->pooledOrders() << ","
+        << engine->orderIdSlots() << "\n";
+
+    // The same engine behind TradingSystem: place and cancel through URLs and JSON
+    TradingSystem trading(engine);
+    size_t trades_before = engine->trades();
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < api_requests; n += 2) {
+        std::string name = "BTC-FUTURE-" + std::to_string(pick(rng));
+        JsonValue placed = trading.buy(name, lots(rng), 0, "limit", "bench", 59000 + offset(rng));
+        trading.cancel(placed.at("result").at("order").at("order_id").get<std::string>());
+    }
+    double api_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "transport," << api_requests << "," << engine->trades() - trades_before << "," << api_ms << ","
+        << api_requests / (api_ms / 1000) << "," << engine->openOrders() << "," << engine->pooledOrders() << ","
+        << engine->orderIdSlots() << "\n";
+
+    // The same through AsyncTrading: the response of an inline transport must survive the await
+    EventLoop loop;
+    AsyncTrading async(trading, loop);
+    int completed = 0;
+    trades_before = engine->trades();
+    start = std::chrono::steady_clock::now();
+    loop.spawn(placeAndCancel(async, api_requests / 2, instruments, rng, completed));
+    loop.run();
+    double async_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "async_transport," << api_requests << "," << engine->trades() - trades_before << "," << async_ms << ","
+        << api_requests / (async_ms / 1000) << "," << engine->openOrders() << "," << engine->pooledOrders() << ","
+        << engine->orderIdSlots() << "\n";
+    // Orders are looked up in a table sized to the orders open at once, not to every id issued
+    if (engine->orderIdSlots() > 4 * engine->pooledOrders()) {
+        std::cerr << "order id table of " << engine->orderIdSlots() << " slots for " << engine->pooledOrders()
+            << " pooled orders\n";
+        return 1;
+    }
+    if (completed != api_requests / 2 * 2) {
+        std::cerr << "async_transport: " << completed << " of " << api_requests / 2 * 2 << " requests completed\n";
+        return 1;
+    }
+    return 0;
+}
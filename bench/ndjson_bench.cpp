@@ -0,0 +1,70 @@
+#include "json_utils.h"
+#include "json_writer.h"
+
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Writes `records` synthetic trade notifications as NDJSON, then streams the file back through
+// processNdjsonFile on one thread and on `threads` threads, ordered and unordered, and reports
+// throughput and the process's peak resident memory after each pass.
+// Usage: bench_ndjson_bench [records] [threads] [path]
+int main(int argc, char* argv[]) {
+    size_t records = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    size_t threads = argc > 2 ? std::stoul(argv[2]) : std::thread::hardware_concurrency();
+    std::string path = argc > 3 ? argv[3] : "/tmp/ndjson_bench.ndjson";
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cout << "Cannot create " << path << std::endl;
+        return 1;
+    }
+    {
+        std::mt19937 rng(11);
+        JsonWriter out(fd);
+        for (size_t i = 0; i < records; ++i) {
+            out.beginObject().key("channel").value("user.trades.BTC-PERPETUAL.raw");
+            out.key("data").beginArray().beginObject();
+            out.key("trade_id").value("BTC-" + std::to_string(i)).key("instrument_name").value("BTC-PERPETUAL");
+            out.key("price").value(60000 + (rng() % 2000) * 0.5).key("amount").value(double(10 * (1 + rng() % 50)));
+            out.key("direction").value(rng() & 1 ? "buy" : "sell").key("timestamp").value(1700000000000LL + (long long)i);
+            out.endObject().endArray().endObject().newline();
+        }
+    }
+    ::close(fd);
+    size_t bytes = std::filesystem::file_size(path);
+
+    std::cout << "threads,ordered,records,mb,ms,mb_per_second,records_per_second,peak_rss_mb\n";
+    auto pass = [&](size_t thread_count, bool ordered) {
+        json_utils::NdjsonOptions options;
+        options.threads = thread_count;
+        options.ordered = ordered;
+        std::atomic<size_t> seen = 0;
+        std::atomic<double> volume = 0;
+        auto start = std::chrono::steady_clock::now();
+        size_t parsed = json_utils::processNdjsonFile(path, [&](const JsonValue& record) {
+            const JsonValue& trade = record.at("data").get<JsonArray>()[0];
+            volume.fetch_add(trade.at("amount").get<double>(), std::memory_order_relaxed);
+            seen.fetch_add(1, std::memory_order_relaxed);
+        }, options);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        struct rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+        std::cout << thread_count << "," << ordered << "," << parsed << "," << bytes / 1e6 << "," << ms << ","
+            << bytes / 1e3 / ms << "," << parsed / (ms / 1000) << "," << usage.ru_maxrss / 1024.0 << "\n";
+        return parsed == records && seen == records;
+    };
+
+    bool complete = pass(1, true) && pass(threads, true) && pass(threads, false);
+    ::unlink(path.c_str());
+    if (!complete) {
+        std::cout << "Record count mismatch" << std::endl;
+        return 1;
+    }
+    return 0;
+}
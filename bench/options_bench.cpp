@@ -0,0 +1,73 @@
+#include "options_pricer.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// Prices a synthetic full options chain: full reprice, then incremental forward and quote updates.
+// Usage: bench_options_bench [expiries] [strikes_per_expiry] [threads] [rounds]
+int main(int argc, char* argv[]) {
+    int expiry_count = argc > 1 ? std::stoi(argv[1]) : 12;
+    int strike_count = argc > 2 ? std::stoi(argv[2]) : 200;
+    size_t threads = argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+    int rounds = argc > 4 ? std::stoi(argv[4]) : 20;
+
+    const long long day_ms = 86400000LL;
+    const double forward = 60000;
+    std::unordered_map<std::string, Instrument> instruments;
+    for (int e = 1; e <= expiry_count; ++e) {
+        for (int k = 0; k < strike_count; ++k) {
+            double strike = 20000 + k * (100000.0 / strike_count);
+            std::string name = "BTC-" + std::to_string(e) + "-" + std::to_string((int)strike);
+            instruments[name + "-C"] = Instrument("BTC", "USD", "option", true, strike, "call", e * 14 * day_ms);
+            instruments[name + "-P"] = Instrument("BTC", "USD", "option", true, strike, "put", e * 14 * day_ms);
+        }
+    }
+
+    OptionsPricer pricer(instruments, "BTC", 0);
+    pricer.setRate(0.03);
+    for (long long expiry : pricer.expiryTimestamps()) {
+        pricer.setForward(expiry, forward);
+    }
+    for (const std::string& name : pricer.instrumentNames()) {
+        pricer.setVolatility(name, 0.6);
+    }
+    pricer.recompute();
+
+    // Turn the model prices into quotes so every option goes through the IV solver
+    for (size_t option = 0; option < pricer.size(); ++option) {
+        pricer.setQuote(pricer.instrumentNames()[option], pricer.price(option));
+    }
+    ThreadPool pool(threads);
+
+    auto time = [&](auto&& update, ThreadPool* runner) {
+        double total_us = 0;
+        size_t recomputed = 0;
+        for (int round = 0; round < rounds; ++round) {
+            update(round);
+            auto start = std::chrono::steady_clock::now();
+            recomputed = pricer.recompute(runner);
+            total_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        }
+        return std::make_pair(recomputed, total_us / rounds);
+    };
+    auto everything = [&](int round) { pricer.setValuationTime(round); };
+    auto one_expiry = [&](int round) { pricer.setForward(pricer.expiryTimestamps()[0], forward + round + 1); };
+    auto some_quotes = [&](int round) {
+        for (size_t option = round % 100; option < pricer.size(); option += 100) {
+            pricer.setQuote(pricer.instrumentNames()[option], pricer.price(option) * 1.001);
+        }
+    };
+
+    std::cout << "options: " << pricer.size() << ", threads: " << pool.size() << "\n";
+    std::cout << "scenario,options_recomputed,microseconds\n";
+    auto [full_single, full_single_us] = time(everything, nullptr);
+    std::cout << "full_chain_1_thread," << full_single << "," << full_single_us << "\n";
+    auto [full_pool, full_pool_us] = time(everything, &pool);
+    std::cout << "full_chain_pool," << full_pool << "," << full_pool_us << "\n";
+    auto [expiry, expiry_us] = time(one_expiry, &pool);
+    std::cout << "one_expiry_forward," << expiry << "," << expiry_us << "\n";
+    auto [quotes, quotes_us] = time(some_quotes, &pool);
+    std::cout << "one_percent_quotes," << quotes << "," << quotes_us << "\n";
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "logger.h"
+#include "matching_engine.h"
+#include "quote_manager.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Forwards to a MatchingEngine and counts the order messages that reach it
+class CountingTransport : public Transport {
+private:
+    std::shared_ptr<MatchingEngine> engine;
+
+public:
+    std::atomic<int> placed{0};
+    std::atomic<int> edited{0};
+    std::atomic<int> cancelled{0};
+
+    explicit CountingTransport(std::shared_ptr<MatchingEngine> engine) : engine(std::move(engine)) {}
+
+    std::string get(const std::string& url, const std::string& authToken) override {
+        if (url.find("/private/buy?") != std::string::npos || url.find("/private/sell?") != std::string::npos) {
+            placed.fetch_add(1, std::memory_order_relaxed);
+        } else if (url.find("/private/edit?") != std::string::npos) {
+            edited.fetch_add(1, std::memory_order_relaxed);
+        } else if (url.find("/private/cancel?") != std::string::npos) {
+            cancelled.fetch_add(1, std::memory_order_relaxed);
+        }
+        return engine->get(url, authToken);
+    }
+
+    int sent() const { return placed + edited + cancelled; }
+};
+
+struct Expected {
+    int requested;
+    int superseded;
+    int unchanged;
+    int placed;
+    int edited;
+    int cancelled;
+};
+
+// Cycles through a fresh QuoteManager: what is placed, edited, cancelled or left alone, and the
+// messages saved, both as counted by the manager and as seen by the exchange. Returns the number
+// of failed checks, each named on stderr.
+int checkDiffing() {
+    std::unordered_map<std::string, Instrument> universe;
+    universe["BTC-FUTURE-0"] = Instrument("BTC", "USD", "future", true);
+    auto engine = std::make_shared<MatchingEngine>(universe);
+    auto transport = std::make_shared<CountingTransport>(engine);
+    TradingSystem trading(transport);
+    QuoteManager quotes(trading);
+    uint32_t instrument = engine->instrumentId("BTC-FUTURE-0");
+    const std::string name = "BTC-FUTURE-0";
+
+    int failures = 0;
+    auto check = [&](const char* step, bool ok) {
+        if (!ok) {
+            std::cerr << "quote diffing failed: " << step << "\n";
+            ++failures;
+        }
+    };
+    auto expect = [&](const char* step, const Expected& expected) {
+        int placed = transport->placed;
+        int edited = transport->edited;
+        int cancelled = transport->cancelled;
+        QuoteCycleStats stats = quotes.cycle();
+        bool counted = stats.requested == expected.requested && stats.superseded == expected.superseded &&
+            stats.unchanged == expected.unchanged && stats.placed == expected.placed &&
+            stats.edited == expected.edited && stats.cancelled == expected.cancelled && stats.failed == 0 &&
+            stats.saved() == expected.requested - (expected.placed + expected.edited + expected.cancelled);
+        bool seen = transport->placed - placed == expected.placed && transport->edited - edited == expected.edited &&
+            transport->cancelled - cancelled == expected.cancelled;
+        if (!counted || !seen) {
+            std::cerr << step << ": requested " << stats.requested << " superseded " << stats.superseded
+                << " unchanged " << stats.unchanged << " placed " << stats.placed << " edited " << stats.edited
+                << " cancelled " << stats.cancelled << " failed " << stats.failed << " saved " << stats.saved()
+                << "; sent " << transport->placed - placed << " places, " << transport->edited - edited
+                << " edits, " << transport->cancelled - cancelled << " cancels\n";
+        }
+        check(step, counted && seen);
+    };
+
+    quotes.setQuote(name, true, 0, 59000, 10);
+    quotes.setQuote(name, false, 0, 61000, 10);
+    quotes.setQuote(name, true, 1, 58990, 5);
+    expect("new quotes are placed", {3, 0, 0, 3, 0, 0});
+    check("placed quotes rest", engine->bestBid(instrument) == 59000 && engine->bestAsk(instrument) == 61000 &&
+        engine->openOrders() == 3 && quotes.liveQuotes() == 3);
+
+    // The same bid again, the ask moved twice, the second bid level withdrawn
+    quotes.setQuote(name, true, 0, 59000, 10);
+    quotes.setQuote(name, false, 0, 60990, 10);
+    quotes.setQuote(name, false, 0, 60980, 10);
+    quotes.removeQuote(name, true, 1);
+    expect("only the moved quote is edited and the withdrawn one cancelled", {4, 1, 1, 0, 1, 1});
+    check("the edit lands at the latest price", engine->bestAsk(instrument) == 60980 && engine->openOrders() == 2);
+
+    expect("an idle cycle sends nothing", {0, 0, 0, 0, 0, 0});
+
+    // A quote set and withdrawn between cycles costs nothing
+    quotes.setQuote(name, true, 2, 58980, 1);
+    quotes.removeQuote(name, true, 2);
+    expect("a quote withdrawn before the cycle is never sent", {2, 1, 0, 0, 0, 0});
+
+    // Another account takes the whole bid: the edit finds it gone and the next cycle re-places it
+    matching::OrderSpec taker;
+    taker.account = 7;
+    taker.side = matching::Side::Sell;
+    taker.amount = 10;
+    taker.price = 59000;
+    taker.time_in_force = matching::TimeInForce::ImmediateOrCancel;
+    check("the bid is filled", engine->submit(instrument, taker).filled_amount == 10);
+    quotes.setQuote(name, true, 0, 59001, 10);
+    expect("an edit of a filled quote drops it", {1, 0, 0, 0, 1, 0});
+    expect("a dropped quote is placed afresh", {0, 0, 0, 1, 0, 0});
+    check("the bid rests again", engine->bestBid(instrument) == 59001 && quotes.liveQuotes() == 2);
+
+    quotes.removeAll();
+    expect("removeAll cancels every live quote", {2, 0, 0, 0, 0, 2});
+    check("nothing is left resting", engine->openOrders() == 0 && quotes.liveQuotes() == 0);
+    return failures;
+}
+
+} // namespace
+
+// Checks quote diffing on a scripted sequence, then requotes `instruments` x 2 sides x `levels`
+// levels against a MatchingEngine for `rounds` cycles, moving fair value on a tenth of the
+// instruments per round and setting every moved quote twice, and reports the messages requested,
+// sent and saved and the time per cycle. Exits 1 if the scripted sequence sends other messages
+// than expected or if any cycle's accounting disagrees with the messages the exchange received.
+// Usage: bench_quote_bench [instruments] [levels] [rounds]
+int main(int argc, char* argv[]) {
+    int instruments = argc > 1 ? std::stoi(argv[1]) : 50;
+    int levels = argc > 2 ? std::stoi(argv[2]) : 5;
+    int rounds = argc > 3 ? std::stoi(argv[3]) : 200;
+
+    int failures = checkDiffing();
+    std::cout << "diffing_failures\n" << failures << "\n";
+    if (failures != 0) return 1;
+
+    std::unordered_map<std::string, Instrument> universe;
+    for (int i = 0; i < instruments; ++i) {
+        universe["BTC-FUTURE-" + std::to_string(i)] = Instrument("BTC", "USD", "future", true);
+    }
+    auto engine = std::make_shared<MatchingEngine>(universe);
+    auto transport = std::make_shared<CountingTransport>(engine);
+    TradingSystem trading(transport);
+    QuoteManager quotes(trading);
+
+    std::mt19937 rng(5);
+    std::vector<int> fair(instruments, 60000);
+    auto requote = [&](int i) {
+        std::string name = "BTC-FUTURE-" + std::to_string(i);
+        for (int level = 0; level < levels; ++level) {
+            quotes.setQuote(name, true, level, fair[i] - 5 - level, 1 + level);
+            quotes.setQuote(name, false, level, fair[i] + 5 + level, 1 + level);
+        }
+    };
+    for (int i = 0; i < instruments; ++i) requote(i);
+    quotes.cycle();
+
+    long long requested = 0;
+    long long sent = 0;
+    int accounting_errors = 0;
+    double cycle_us = 0;
+    for (int round = 0; round < rounds; ++round) {
+        for (int i = 0; i < instruments; ++i) {
+            if (rng() % 10 != 0) continue;
+            // A first guess superseded by the settled fair value
+            fair[i] += int(rng() % 3) - 1;
+            requote(i);
+            fair[i] += int(rng() % 3) - 1;
+            requote(i);
+        }
+        int before = transport->sent();
+        auto start = std::chrono::steady_clock::now();
+        QuoteCycleStats stats = quotes.cycle();
+        cycle_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        requested += stats.requested;
+        sent += stats.sent();
+        if (stats.sent() != transport->sent() - before || stats.failed != 0 ||
+            quotes.liveQuotes() != size_t(instruments * levels * 2)) {
+            ++accounting_errors;
+        }
+    }
+
+    std::cout << "instruments,levels,rounds,requested,sent,saved,us_per_cycle,accounting_errors\n";
+    std::cout << instruments << "," << levels << "," << rounds << "," << requested << "," << sent << ","
+        << requested - sent << "," << cycle_us / rounds << "," << accounting_errors << "\n";
+    if (accounting_errors != 0) {
+        std::cerr << accounting_errors << " cycles counted other messages than the exchange received\n";
+        return 1;
+    }
+    return 0;
+}
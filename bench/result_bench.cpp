@@ -0,0 +1,79 @@
+#include "logger.h"
+#include "matching_engine.h"
+#include "trading_system.h"
+
+#include <chrono>
+#include <iostream>
+
+// Forwards to a MatchingEngine, or fails every request as a timed-out transfer would
+class FlakyTransport : public Transport {
+public:
+    std::shared_ptr<MatchingEngine> engine;
+    bool failing = false;
+
+    explicit FlakyTransport(std::shared_ptr<MatchingEngine> engine) : engine(std::move(engine)) {}
+
+    std::string get(const std::string& url, const std::string& authToken) override {
+        if (failing) return "Error: Timeout was reached";
+        return engine->get(url, authToken);
+    }
+};
+
+// Times rejected orders through the JsonValue API (null, error response or exception) and the
+// Result API, for each kind of failure: a local validation reject (unknown instrument, price off
+// the tick grid, amount off the lot grid), an exchange reject (cancel of an unknown order) and a
+// transport failure. Logging is raised to errors only so the numbers
+// are the cost of the reject itself.
+// Usage: bench_result_bench [requests]
+int main(int argc, char* argv[]) {
+    int requests = argc > 1 ? std::stoi(argv[1]) : 200000;
+
+    std::unordered_map<std::string, Instrument> universe;
+    universe["BTC-PERPETUAL"] = Instrument("BTC", "USD", "future", true, 0, "", 0, 2.5, 10, 10);
+    auto transport = std::make_shared<FlakyTransport>(std::make_shared<MatchingEngine>(universe));
+    TradingSystem trading(transport);
+    logging::setLevel(logging::Level::Error);
+
+    auto time = [&](auto&& call) {
+        size_t failures = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < requests; ++i) {
+            failures += call();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(ns / requests, failures);
+    };
+    auto report = [&](const char* failure, const char* api, std::pair<double, size_t> result) {
+        std::cout << failure << "," << api << "," << requests << "," << result.first << "," << result.second << "\n";
+    };
+
+    std::cout << "failure,api,requests,ns_per_request,failures_seen\n";
+    report("validation", "json", time([&]() { return trading.buy("UNKNOWN", 10, 0, "limit", "", 60000).isNull(); }));
+    report("validation", "result", time([&]() { return !trading.tryBuy("UNKNOWN", 10, 0, "limit", "", 60000).ok(); }));
+    report("off_tick", "result", time([&]() { return !trading.tryBuy("BTC-PERPETUAL", 10, 0, "limit", "", 60001).ok(); }));
+    report("off_lot", "result", time([&]() { return !trading.tryBuy("BTC-PERPETUAL", 15, 0, "limit", "", 60000).ok(); }));
+
+    auto exchangeError = [](const JsonValue& response) {
+        return std::get<JsonObject>(response.value).count("error") != 0;
+    };
+    report("exchange", "json", time([&]() { return exchangeError(trading.cancel("999999")); }));
+    report("exchange", "result", time([&]() {
+        Result<JsonValue> result = trading.tryCancel("999999");
+        return !result.ok() && result.error().code == ErrorCode::Exchange;
+    }));
+
+    transport->failing = true;
+    report("transport", "json", time([&]() {
+        try {
+            trading.buy("BTC-PERPETUAL", 10, 0, "limit", "", 60000);
+            return false;
+        } catch (const std::exception&) {
+            return true;
+        }
+    }));
+    report("transport", "result", time([&]() {
+        Result<JsonValue> result = trading.tryBuy("BTC-PERPETUAL", 10, 0, "limit", "", 60000);
+        return !result.ok() && result.error().code == ErrorCode::Transport;
+    }));
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "risk_engine.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Measures the cost of a pre-trade check against a synthetic instrument universe, then checks
+// that an instrument listed later is refused until added and fully checked afterwards, and that
+// limits count open orders, edits of them only by the change, and hold USD future amounts and coin
+// option amounts in one currency unit, and that concurrent checks cannot pass more than the limit
+// between them; exits 1 if not.
+// Usage: bench_risk_bench [checks_per_thread] [max_threads]
+int main(int argc, char* argv[]) {
+    int checks_per_thread = argc > 1 ? std::stoi(argv[1]) : 5000000;
+    int max_threads = argc > 2 ? std::stoi(argv[2]) : 4;
+
+    std::unordered_map<std::string, Instrument> instruments;
+    std::vector<std::string> names;
+    for (int i = 0; i < 2000; ++i) {
+        std::string currency = i % 2 == 0 ? "BTC" : "ETH";
+        names.push_back(currency + "-OPTION-" + std::to_string(i));
+        instruments[names.back()] = Instrument(currency, "USD", "option", true);
+    }
+
+    RiskLimits limits;
+    limits.max_order_amount = 1000;
+    limits.max_instrument_position = 1e9;
+    limits.max_currency_position = 1e12;
+    limits.price_band = 0.05;
+    limits.max_orders_per_second = 1 << 30;
+    RiskEngine risk(instruments, limits);
+    for (const std::string& name : names) {
+        risk.setReferencePrice(name, 100.0);
+    }
+
+    std::cout << "threads,checks,rejects,ns_per_check\n";
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::vector<std::thread> workers;
+        std::vector<long> rejects(threads, 0);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                for (int i = 0; i < checks_per_thread; ++i) {
+                    const std::string& name = names[(i * 7 + t) % names.size()];
+                    if (risk.checkOrder(name, i % 2 == 0, 1 + i % 10, 98 + i % 5) != RiskResult::Ok) {
+                        ++rejects[t];
+                    }
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        long total_rejects = 0;
+        for (long r : rejects) total_rejects += r;
+        std::cout << threads << "," << (long)threads * checks_per_thread << "," << total_rejects << ","
+            << ns / checks_per_thread << "\n";
+    }
+
+    const std::string listed = "BTC-OPTION-LISTED";
+    bool refused = risk.checkOrder(listed, true, 1, 100) == RiskResult::UnknownInstrument;
+    auto start = std::chrono::steady_clock::now();
+    risk.addInstrument(listed, Instrument("BTC", "USD", "option", true));
+    double add_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    risk.setReferencePrice(listed, 100.0);
+    bool checked = risk.checkOrder(listed, true, 1, 100) == RiskResult::Ok &&
+        risk.checkOrder(listed, true, 1, 200) == RiskResult::PriceOutsideBand;
+    std::cout << "add_instrument_us," << add_us << "\n";
+    if (!refused || !checked) {
+        std::cerr << "instrument listed later was not refused, then checked\n";
+        return 1;
+    }
+
+    // 80 USD bid on the perpetual is 0.0016 BTC, which leaves room for a 0.9 BTC option but not 1 BTC
+    RiskLimits tight;
+    tight.max_instrument_position = 100;
+    tight.max_currency_position = 1;
+    RiskEngine exposure({{"BTC-PERPETUAL", Instrument("BTC", "USD", "future", true)},
+        {"BTC-OPTION-C", Instrument("BTC", "BTC", "option", true)}}, tight);
+    exposure.onWorking("BTC-PERPETUAL", true, 80, 50000);
+    bool counted = exposure.checkOrder("BTC-PERPETUAL", true, 30, 50000) == RiskResult::InstrumentPositionLimit &&
+        exposure.checkOrder("BTC-PERPETUAL", false, 30, 50000) == RiskResult::Ok &&
+        exposure.checkOrder("BTC-PERPETUAL", true, 30, -1) == RiskResult::InstrumentPositionLimit;
+    bool normalized = exposure.checkOrder("BTC-OPTION-C", true, 0.9, 0.05) == RiskResult::Ok &&
+        exposure.checkOrder("BTC-OPTION-C", true, 1, 0.05) == RiskResult::CurrencyPositionLimit &&
+        exposure.checkOrder("BTC-PERPETUAL", false, 20, -1) == RiskResult::NoConversionPrice;
+    // Editing the open 80 bid counts only the change: down to 70 passes, up to 130 does not
+    bool edited = exposure.checkEdit("BTC-PERPETUAL", true, 70, 80, 50000) == RiskResult::Ok &&
+        exposure.checkEdit("BTC-PERPETUAL", true, 100, 80, 50000) == RiskResult::Ok &&
+        exposure.checkEdit("BTC-PERPETUAL", true, 130, 80, 50000) == RiskResult::InstrumentPositionLimit;
+    exposure.onWorking("BTC-PERPETUAL", true, -80, 50000);
+    bool released = exposure.checkOrder("BTC-PERPETUAL", true, 30, 50000) == RiskResult::Ok &&
+        exposure.checkOrder("BTC-OPTION-C", true, 1, 0.05) == RiskResult::Ok;
+    if (!counted || !normalized || !edited || !released) {
+        std::cerr << "open orders or currency units are not counted as expected\n";
+        return 1;
+    }
+
+    // Orders still on the wire hold their amount: threads racing for the room under the limit get
+    // at most 10 lots of 10 between them, and everything is given back once released
+    RiskEngine racing({{"BTC-PERPETUAL", Instrument("BTC", "USD", "future", true)}}, tight);
+    std::vector<std::vector<RiskEngine::Reservation>> held(8);
+    std::vector<std::thread> racers;
+    for (size_t t = 0; t < held.size(); ++t) {
+        racers.emplace_back([&, t]() {
+            for (int i = 0; i < 100; ++i) {
+                RiskEngine::Reservation reservation;
+                if (racing.checkOrder("BTC-PERPETUAL", true, 10, 50000, &reservation) == RiskResult::Ok) {
+                    held[t].push_back(std::move(reservation));
+                }
+            }
+        });
+    }
+    for (std::thread& racer : racers) {
+        racer.join();
+    }
+    size_t passed = 0;
+    for (const auto& reservations : held) passed += reservations.size();
+    double reserved = racing.workingAmount("BTC-PERPETUAL", true);
+    held.clear();
+    std::cout << "racing_checks_passed," << passed << "\n";
+    if (passed == 0 || passed > 10 || reserved != 10.0 * passed || racing.workingAmount("BTC-PERPETUAL", true) != 0) {
+        std::cerr << "concurrent checks passed " << passed << " orders of 10 under a limit of 100\n";
+        return 1;
+    }
+    return 0;
+}
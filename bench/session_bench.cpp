@@ -0,0 +1,105 @@
+#include "logger.h"
+#include "matching_engine.h"
+#include "session_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+
+// Live bytes allocated through operator new. mallinfo2 would count blocks parked in the thread
+// cache as in use.
+static std::atomic<size_t> allocated{0};
+
+// Not inlined: GCC would otherwise pair the inlined malloc with operator delete and warn
+__attribute__((noinline)) void* operator new(size_t bytes) {
+    void* block = std::malloc(bytes);
+    if (!block) throw std::bad_alloc();
+    allocated += malloc_usable_size(block);
+    return block;
+}
+void operator delete(void* block) noexcept {
+    if (block) allocated -= malloc_usable_size(block);
+    std::free(block);
+}
+void operator delete(void* block, size_t) noexcept {
+    if (block) allocated -= malloc_usable_size(block);
+    std::free(block);
+}
+
+// Forwards to a MatchingEngine and counts the requests made
+class CountingTransport : public Transport {
+public:
+    std::shared_ptr<MatchingEngine> engine;
+    std::atomic<size_t> requests{0};
+
+    explicit CountingTransport(std::shared_ptr<MatchingEngine> engine) : engine(std::move(engine)) {}
+
+    std::string get(const std::string& url, const std::string& authToken) override {
+        ++requests;
+        return engine->get(url, authToken);
+    }
+};
+
+// Opens `accounts` accounts against a MatchingEngine with a synthetic `instruments`-instrument
+// universe, once as standalone TradingSystems (each loading its own universe and starting its own
+// fan-out threads) and once as sessions of a SessionPool, and reports the requests, time and
+// heap per account. Then places orders from every session, with and without a rate limit.
+// Usage: bench_session_bench [accounts] [instruments] [orders_per_account]
+int main(int argc, char* argv[]) {
+    int accounts = argc > 1 ? std::stoi(argv[1]) : 10;
+    int instrument_count = argc > 2 ? std::stoi(argv[2]) : 20000;
+    int orders = argc > 3 ? std::stoi(argv[3]) : 200;
+
+    std::unordered_map<std::string, Instrument> universe;
+    for (int i = 0; i < instrument_count; ++i) {
+        universe["BTC-" + std::to_string(i) + "-C"] = Instrument("BTC", "USD", "option", true, 50000 + i, "call");
+    }
+    universe["BTC-PERPETUAL"] = Instrument("BTC", "USD", "future", true);
+    auto transport = std::make_shared<CountingTransport>(std::make_shared<MatchingEngine>(universe));
+    logging::setLevel(logging::Level::Error);
+
+    auto heap = [] { return allocated.load(); };
+    // Heap per account is what destroying the accounts gives back, so that buffers the parser and
+    // transport keep between requests are not counted
+    auto open = [&](const char* name, auto&& make_account) {
+        size_t requests_before = transport->requests;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::unique_ptr<TradingSystem>> opened;
+        for (int i = 0; i < accounts; ++i) {
+            opened.push_back(make_account(i));
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        size_t heap_with = heap();
+        opened.clear();
+        double kb = double(heap_with - heap()) / 1024 / accounts;
+        std::cout << name << "," << accounts << "," << double(transport->requests - requests_before) / accounts << ","
+            << ms / accounts << "," << kb << "\n";
+    };
+
+    std::cout << "setup,accounts,requests_per_account,ms_per_account,heap_kb_per_account\n";
+    open("standalone", [&](int) { return std::make_unique<TradingSystem>(transport); });
+    size_t requests_before = transport->requests;
+    SessionPool pool(transport);
+    std::cout << "pool_bootstrap,1," << transport->requests - requests_before << ",,\n";
+    open("session", [&](int i) { return pool.open({"client_" + std::to_string(i), "secret"}); });
+
+    std::cout << "\nrate_limit_per_account,accounts,orders,orders_per_second\n";
+    for (double per_second : {0.0, 1000.0}) {
+        std::vector<std::unique_ptr<TradingSystem>> sessions;
+        for (int i = 0; i < accounts; ++i) {
+            sessions.push_back(pool.open({"client_" + std::to_string(i), "secret"}, RateLimit{per_second, 10}));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int n = 0; n < orders; ++n) {
+            for (const std::unique_ptr<TradingSystem>& session : sessions) {
+                session->tryBuy("BTC-PERPETUAL", 10, 0, "limit", "", 50000 - n % 100);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << per_second << "," << accounts << "," << orders * accounts << "," << orders * accounts / seconds << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include "http_client.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Keep-alive HTTP server answering /plain with `body` and /gzip with it gzip-compressed, written
+// in 16KB pieces paced to `bytes_per_second` to stand in for a link of that bandwidth
+class PacedServer {
+private:
+    int listener = -1;
+    std::thread thread;
+    std::string plain;
+    std::string gzip;
+    double bytes_per_second;
+
+    void send(int connection, const std::string& encoding, const std::string& body) {
+        std::string header = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n" + encoding +
+            "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        ::send(connection, header.data(), header.size(), MSG_NOSIGNAL);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t sent = 0; sent < body.size();) {
+            size_t n = std::min<size_t>(16384, body.size() - sent);
+            if (::send(connection, body.data() + sent, n, MSG_NOSIGNAL) < 0) return;
+            sent += n;
+            std::this_thread::sleep_until(start + std::chrono::duration<double>(sent / bytes_per_second));
+        }
+    }
+
+    void serve(int connection) {
+        std::string request;
+        char buffer[4096];
+        while (true) {
+            ssize_t n = ::recv(connection, buffer, sizeof(buffer), 0);
+            if (n <= 0) return;
+            request.append(buffer, n);
+            size_t end;
+            while ((end = request.find("\r\n\r\n")) != std::string::npos) {
+                bool compressed = request.find("GET /gzip") == 0 && request.find("gzip", 9) < end;
+                request.erase(0, end + 4);
+                if (compressed) {
+                    send(connection, "Content-Encoding: gzip\r\n", gzip);
+                } else {
+                    send(connection, "", plain);
+                }
+            }
+        }
+    }
+
+public:
+    PacedServer(std::string body, std::string compressed, double bytes_per_second)
+        : plain(std::move(body)), gzip(std::move(compressed)), bytes_per_second(bytes_per_second) {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        ::listen(listener, 16);
+        thread = std::thread([this] {
+            while (true) {
+                int connection = ::accept(listener, nullptr, nullptr);
+                if (connection < 0) return;
+                int one = 1;
+                ::setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                serve(connection);
+                ::close(connection);
+            }
+        });
+    }
+
+    ~PacedServer() {
+        ::shutdown(listener, SHUT_RDWR);
+        thread.join();
+        ::close(listener);
+    }
+
+    int port() const {
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        return ntohs(address.sin_port);
+    }
+};
+
+// A get_instruments response listing `count` options
+std::string instrumentsResponse(int count) {
+    std::string json = "{\"jsonrpc\":\"2.0\",\"result\":[";
+    for (int i = 0; i < count; ++i) {
+        if (i) json += ',';
+        std::string name = "BTC-27DEC24-" + std::to_string(20000 + i * 500) + (i % 2 ? "-P" : "-C");
+        json += "{\"tick_size\":0.0005,\"taker_commission\":0.0003,\"strike\":" + std::to_string(20000 + i * 500) +
+            ",\"settlement_period\":\"month\",\"settlement_currency\":\"BTC\",\"rfq\":false,\"quote_currency\":\"BTC\"," +
+            "\"price_index\":\"btc_usd\",\"option_type\":\"" + (i % 2 ? "put" : "call") + "\",\"min_trade_amount\":0.1," +
+            "\"maker_commission\":0.0003,\"kind\":\"option\",\"is_active\":true,\"instrument_name\":\"" + name + "\"," +
+            "\"instrument_id\":" + std::to_string(100000 + i) + ",\"expiration_timestamp\":1735286400000," +
+            "\"creation_timestamp\":1719561600000,\"counter_currency\":\"USD\",\"contract_size\":1.0," +
+            "\"block_trade_tick_size\":0.0001,\"block_trade_min_trade_amount\":25,\"block_trade_commission\":0.0003," +
+            "\"base_currency\":\"BTC\"}";
+    }
+    return json + "],\"usIn\":1,\"usOut\":2,\"usDiff\":1,\"testnet\":true}";
+}
+
+// Compressed with the gzip tool, to keep zlib out of the link line
+std::string gzipped(const std::string& body) {
+    std::string path = "/tmp/stream_parse_bench.json";
+    std::ofstream(path, std::ios::binary) << body;
+    std::string compressed;
+    if (FILE* pipe = ::popen(("gzip -c " + path).c_str(), "r")) {
+        char buffer[65536];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0) compressed.append(buffer, n);
+        ::pclose(pipe);
+    }
+    std::remove(path.c_str());
+    return compressed;
+}
+
+} // namespace
+
+// Downloads a synthetic get_instruments response from a local server paced to `mbit_per_second`,
+// plain and gzip-compressed, and reports the time until the parsed document is ready: buffered
+// (RestClient::get, then JsonParser) and streamed (RestClient::getJson parsing each chunk as it
+// arrives). Also times both parsers on the body in memory, the streamed one fed 16KB chunks.
+// Usage: bench_stream_parse_bench [instruments] [mbit_per_second] [rounds]
+int main(int argc, char* argv[]) {
+    int instruments = argc > 1 ? std::stoi(argv[1]) : 4000;
+    double mbit = argc > 2 ? std::stod(argv[2]) : 200;
+    int rounds = argc > 3 ? std::stoi(argv[3]) : 5;
+
+    std::string body = instrumentsResponse(instruments);
+    std::string compressed = gzipped(body);
+    PacedServer server(body, compressed, mbit * 1e6 / 8);
+    std::string base = "http://127.0.0.1:" + std::to_string(server.port());
+
+    using Clock = std::chrono::steady_clock;
+    auto best = [&](auto&& run) {
+        double fastest = 1e300;
+        for (int round = 0; round < rounds; ++round) {
+            auto start = Clock::now();
+            run();
+            fastest = std::min(fastest, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        return fastest;
+    };
+
+    RestClient client;
+    JsonParser parser;
+    JsonStreamParser stream_parser;
+    size_t parsed = 0;
+    auto count = [&parsed](const JsonValue& document) { parsed += document.at("result").get<JsonArray>().size(); };
+
+    std::cout << "mode,encoding,body_bytes,wire_bytes,ms\n";
+    std::cout << "parse_in_memory,,," << body.size() << "," << best([&] { count(parser.parse(body)); }) << "\n";
+    std::cout << "stream_parse_in_memory,,," << body.size() << "," << best([&] {
+        stream_parser.reset();
+        for (size_t offset = 0; offset < body.size(); offset += 16384) {
+            stream_parser.feed(std::string_view(body).substr(offset, 16384));
+        }
+        count(stream_parser.finish());
+    }) << "\n";
+    for (const char* encoding : {"plain", "gzip"}) {
+        std::string url = base + "/" + encoding;
+        size_t wire = std::string(encoding) == "gzip" ? compressed.size() : body.size();
+        std::cout << "buffered," << encoding << "," << body.size() << "," << wire << ","
+            << best([&] { count(parser.parse(client.get(url))); }) << "\n";
+        std::cout << "streamed," << encoding << "," << body.size() << "," << wire << "," << best([&] {
+            Result<JsonValue> document = client.getJson(url, "", stream_parser);
+            if (!document) {
+                std::cerr << "streamed " << encoding << ": " << document.error().message << "\n";
+                return;
+            }
+            count(document.value());
+        }) << "\n";
+    }
+    if (parsed != size_t(instruments) * rounds * 6) std::cerr << "parsed " << parsed << " instruments\n";
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include "tick_query.h"
+#include "tick_store.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <thread>
+
+// Records synthetic random-walk books into a tick store, then scans and queries them.
+// Usage: bench_tick_store_bench [instruments] [snapshots_per_instrument] [levels] [path]
+int main(int argc, char* argv[]) {
+    int instruments = argc > 1 ? std::stoi(argv[1]) : 20;
+    int snapshots = argc > 2 ? std::stoi(argv[2]) : 20000;
+    int levels = argc > 3 ? std::stoi(argv[3]) : 20;
+    std::string path = argc > 4 ? argv[4] : "/tmp/tick_store_bench.ticks";
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> step(-2, 2);
+    std::uniform_int_distribution<int> lots(1, 500);
+    std::bernoulli_distribution touch(0.2);
+
+    std::vector<std::string> names;
+    std::vector<BookSnapshot> books(instruments);
+    std::vector<double> mids(instruments);
+    for (int i = 0; i < instruments; ++i) {
+        names.push_back("BTC-FUTURE-" + std::to_string(i));
+        mids[i] = 60000 + 100 * i;
+        for (int l = 0; l < levels; ++l) {
+            books[i].bids.prices.push_back(mids[i] - 0.5 * (l + 1));
+            books[i].bids.amounts.push_back(lots(rng) * 10);
+            books[i].asks.prices.push_back(mids[i] + 0.5 * (l + 1));
+            books[i].asks.amounts.push_back(lots(rng) * 10);
+        }
+    }
+
+    long long timestamp = 1700000000000;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t bytes = 0;
+    {
+        TickRecorder recorder(path);
+        for (const std::string& name : names) {
+            recorder.setIncrements(name, 0.5, 10);
+        }
+        for (int s = 0; s < snapshots; ++s) {
+            for (int i = 0; i < instruments; ++i) {
+                timestamp += 1 + s % 3;
+                BookSnapshot& book = books[i];
+                int move = step(rng);
+                if (move != 0) {
+                    mids[i] += 0.5 * move;
+                    for (int l = 0; l < levels; ++l) {
+                        book.bids.prices[l] = mids[i] - 0.5 * (l + 1);
+                        book.asks.prices[l] = mids[i] + 0.5 * (l + 1);
+                    }
+                }
+                for (int l = 0; l < levels; ++l) {
+                    if (touch(rng)) book.bids.amounts[l] = lots(rng) * 10;
+                    if (touch(rng)) book.asks.amounts[l] = lots(rng) * 10;
+                }
+                recorder.recordSnapshot(names[i], timestamp, book);
+            }
+        }
+        recorder.flush();
+        bytes = recorder.bytesWritten();
+    }
+    double write_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    long total = (long)instruments * snapshots;
+
+    start = std::chrono::steady_clock::now();
+    TickReader reader(path);
+    size_t events = 0;
+    double checksum = 0;
+    for (const std::string& name : reader.instruments()) {
+        events += reader.scan(name, 0, timestamp, [&](long long, const BookSnapshot& book) {
+            checksum += book.bids.prices[0];
+        });
+    }
+    double scan_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Every book written must come back unchanged
+    bool exact = true;
+    BookSnapshot last;
+    reader.scan(names.back(), 0, timestamp, [&](long long, const BookSnapshot& book) { last = book; });
+    for (int l = 0; l < levels; ++l) {
+        exact &= last.bids.prices[l] == books.back().bids.prices[l] && last.bids.amounts[l] == books.back().bids.amounts[l];
+        exact &= last.asks.prices[l] == books.back().asks.prices[l] && last.asks.amounts[l] == books.back().asks.amounts[l];
+    }
+
+    // A getOrderBook level is roughly ["60000.5", 1230] twice per level in JSON
+    double json_bytes = total * (levels * 2 * 20.0 + 200);
+    std::cout << "snapshots,events,blocks,bytes,bytes_per_snapshot,vs_json,write_ms,scan_ms,events_per_second,exact\n";
+    std::cout << total << "," << events << "," << reader.blockCount() << "," << bytes << "," << (double)bytes / total << ","
+        << json_bytes / bytes << "x," << write_ms << "," << scan_ms << "," << events / (scan_ms / 1000) << ","
+        << (exact ? "yes" : "no") << "\n";
+    (void)checksum;
+
+    // The same data through the parallel query engine
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    TickQuery query(reader, pool);
+    start = std::chrono::steady_clock::now();
+    std::vector<InstrumentStats> stats = query.statistics(0, timestamp);
+    double stats_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    size_t bars = 0;
+    for (const std::string& name : names) {
+        bars += query.bars(name, 0, timestamp, 1000).size();
+    }
+    double bars_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "threads,statistics_ms,one_second_bars,bars_ms\n";
+    std::cout << pool.size() << "," << stats_ms << "," << bars << "," << bars_ms << "\n";
+    return 0;
+}
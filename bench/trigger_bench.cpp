@@ -0,0 +1,253 @@
+#include "logger.h"
+#include "matching_engine.h"
+#include "trading_system.h"
+#include "trigger_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <thread>
+
+namespace {
+
+// Forwards to a MatchingEngine and takes `delay` over every order it places, like a distant exchange
+class SlowTransport : public Transport {
+private:
+    std::shared_ptr<MatchingEngine> engine;
+    std::chrono::milliseconds delay;
+
+public:
+    std::atomic<int> orders{0};
+
+    SlowTransport(std::shared_ptr<MatchingEngine> engine, std::chrono::milliseconds delay)
+        : engine(std::move(engine)), delay(delay) {}
+
+    std::string get(const std::string& url, const std::string& authToken) override {
+        if (url.find("/private/buy?") != std::string::npos || url.find("/private/sell?") != std::string::npos) {
+            std::this_thread::sleep_for(delay);
+            orders.fetch_add(1);
+        }
+        return engine->get(url, authToken);
+    }
+};
+
+// One held order as a brute-force evaluator sees it: every order checked on every tick
+struct ReferenceOrder {
+    TriggerOrder order;
+    bool rising = false;
+    bool has_extreme = false;
+    double extreme = 0;         // highest price seen by a sell trailing stop, lowest by a buy one
+};
+
+// Runs random adds, cancels, amends and ticks on two instruments and two price references through
+// the engine and a brute-force evaluator, and returns the number of ticks on which they fired a
+// different set of orders
+size_t compareWithReference(int operations) {
+    std::mt19937 rng(17);
+    const char* types[] = {"stop_market", "take_market", "stop_limit", "take_limit", "trailing_stop"};
+    const char* instruments[] = {"BTC-PERPETUAL", "ETH-PERPETUAL"};
+    const TriggerReference references[] = {TriggerReference::Last, TriggerReference::Mark};
+    std::map<std::pair<std::string, int>, double> last_price;
+    std::map<std::string, ReferenceOrder> reference;
+    std::vector<std::string> fired;
+    TriggerEngine engine([&](const std::string& trigger_id, const TriggerOrder&) { fired.push_back(trigger_id); });
+    size_t mismatches = 0;
+
+    auto stream = [&](const TriggerOrder& order) {
+        return std::make_pair(order.watch_instrument.empty() ? order.instrument_name : order.watch_instrument, int(order.reference));
+    };
+    // A trailing stop's extreme starts at the stream's last price, also when it is amended
+    auto start = [&](ReferenceOrder& held) {
+        auto last = last_price.find(stream(held.order));
+        held.has_extreme = last != last_price.end();
+        if (held.has_extreme) held.extreme = last->second;
+    };
+    auto pick = [&]() {
+        auto it = reference.begin();
+        std::advance(it, rng() % reference.size());
+        return it;
+    };
+
+    for (int n = 0; n < operations; ++n) {
+        int action = rng() % 100;
+        if (action < 30 || reference.empty()) {
+            TriggerOrder order;
+            order.instrument_name = instruments[rng() % 2];
+            if (rng() % 4 == 0) order.watch_instrument = instruments[rng() % 2];
+            order.isBuy = rng() & 1;
+            order.type = types[rng() % 5];
+            order.reference = references[rng() % 2];
+            order.amount = 10;
+            order.price = 1000;
+            order.trigger_price = 900 + rng() % 201;
+            order.trigger_offset = 1 + rng() % 30;
+            std::string trigger_id = engine.add(order);
+            bool is_stop = order.type == "stop_limit" || order.type == "stop_market";
+            bool is_take = order.type == "take_limit" || order.type == "take_market";
+            ReferenceOrder held{order, (is_stop && order.isBuy) || (is_take && !order.isBuy) ||
+                (order.type == "trailing_stop" && order.isBuy)};
+            start(held);
+            reference.emplace(trigger_id, held);
+        } else if (action < 40) {
+            auto it = pick();
+            engine.cancel(it->first);
+            reference.erase(it);
+        } else if (action < 50) {
+            auto it = pick();
+            bool trailing = it->second.order.type == "trailing_stop";
+            double trigger_price = trailing ? -1 : 900 + rng() % 201;
+            double trigger_offset = trailing ? 1 + rng() % 30 : -1;
+            engine.amend(it->first, trigger_price, trigger_offset);
+            if (trailing) {
+                it->second.order.trigger_offset = trigger_offset;
+            } else {
+                it->second.order.trigger_price = trigger_price;
+            }
+            start(it->second);
+        } else {
+            std::string instrument = instruments[rng() % 2];
+            TriggerReference price_reference = references[rng() % 2];
+            auto key = std::make_pair(instrument, int(price_reference));
+            auto last = last_price.find(key);
+            double price = last == last_price.end() ? 1000 : std::max(1.0, last->second + double(int(rng() % 41) - 20));
+            last_price[key] = price;
+
+            std::vector<std::string> expected;
+            for (auto it = reference.begin(); it != reference.end();) {
+                ReferenceOrder& held = it->second;
+                bool fires = false;
+                if (stream(held.order) == key) {
+                    if (held.order.type == "trailing_stop") {
+                        held.extreme = !held.has_extreme ? price : held.rising ? std::min(held.extreme, price) : std::max(held.extreme, price);
+                        held.has_extreme = true;
+                        double retreat = held.rising ? price - held.extreme : held.extreme - price;
+                        fires = held.order.trigger_offset <= retreat;
+                    } else {
+                        fires = held.rising ? price >= held.order.trigger_price : price <= held.order.trigger_price;
+                    }
+                }
+                if (fires) {
+                    expected.push_back(it->first);
+                    it = reference.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            fired.clear();
+            engine.onPrice(instrument, price_reference, price);
+            std::sort(expected.begin(), expected.end());
+            std::sort(fired.begin(), fired.end());
+            if (fired != expected) ++mismatches;
+        }
+    }
+    if (engine.pendingCount() != reference.size()) ++mismatches;
+    return mismatches;
+}
+
+} // namespace
+
+// Keeps `resting` trigger orders pending on one instrument while its price random-walks, and
+// times each tick, including the orders it fires and their replacements. Checks 200k random
+// adds, cancels, amends and ticks against a brute-force evaluator. Then fires one held
+// order through TradingSystem over a slow transport with a one-order-per-second risk limit, and
+// exits 1 if the tick waits for the order or the order is not sent, if held orders are missing
+// from open-order queries or survive a mass cancel, or on any difference from the evaluator.
+// Usage: bench_trigger_bench [resting] [ticks]
+int main(int argc, char* argv[]) {
+    int resting = argc > 1 ? std::stoi(argv[1]) : 100000;
+    int ticks = argc > 2 ? std::stoi(argv[2]) : 1000000;
+
+    std::mt19937 rng(9);
+    const char* types[] = {"stop_market", "take_market", "stop_limit", "trailing_stop"};
+    double price = 60000;
+    size_t fired = 0;
+
+    auto order = [&]() {
+        TriggerOrder order;
+        order.instrument_name = "BTC-PERPETUAL";
+        order.isBuy = rng() & 1;
+        order.type = types[rng() % 4];
+        order.amount = 10;
+        order.price = 60000;
+        order.trigger_price = price + (int)(rng() % 2001) - 1000;
+        order.trigger_offset = 50 + rng() % 500;
+        return order;
+    };
+    TriggerEngine engine([&](const std::string&, const TriggerOrder&) { ++fired; });
+    for (int i = 0; i < resting; ++i) {
+        engine.add(order());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < ticks; ++t) {
+        price += (int)(rng() % 21) - 10;
+        size_t before = fired;
+        engine.onPrice("BTC-PERPETUAL", TriggerReference::Last, price);
+        // Replace what fired so the number of pending orders stays the same
+        for (size_t i = before; i < fired; ++i) {
+            engine.add(order());
+        }
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "resting,ticks,fired,ms,ns_per_tick\n";
+    std::cout << resting << "," << ticks << "," << fired << "," << ms << "," << ms * 1e6 / ticks << "\n";
+
+    const int operations = 200000;
+    size_t mismatches = compareWithReference(operations);
+    std::cout << "reference_operations,mismatched_ticks\n";
+    std::cout << operations << "," << mismatches << "\n";
+    if (mismatches != 0) {
+        std::cerr << "the trigger engine fired differently from the brute-force evaluator\n";
+        return 1;
+    }
+
+    // Holding the order must not use up the one order the rate allows, and the tick that fires
+    // it must not wait for the exchange
+    const auto delay = std::chrono::milliseconds(50);
+    std::unordered_map<std::string, Instrument> universe;
+    universe["BTC-PERPETUAL"] = Instrument("BTC", "USD", "future", true);
+    auto transport = std::make_shared<SlowTransport>(std::make_shared<MatchingEngine>(universe), delay);
+    TradingSystem trading(transport);
+    RiskLimits limits;
+    limits.max_orders_per_second = 1;
+    trading.enableRiskChecks(limits);
+    trading.enableLocalTriggers();
+    JsonValue held = trading.buy("BTC-PERPETUAL", 10, 0, "stop_market", "", -1, "", -1, -1, -1, -1, 61000);
+    start = std::chrono::steady_clock::now();
+    trading.onPrice("BTC-PERPETUAL", TriggerReference::Last, 61000);
+    double tick_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    trading.awaitTriggeredOrders();
+    std::cout << "fired_tick_ms,send_ms,orders_sent\n";
+    std::cout << tick_ms << "," << delay.count() << "," << transport->orders << "\n";
+    if (held.isNull() || tick_ms >= delay.count() || transport->orders != 1) {
+        logging::flush();
+        std::cerr << "held order was refused, not sent, or sent on the price thread\n";
+        return 1;
+    }
+
+    // Held orders are listed with the open orders and go with the mass cancels that cover them
+    universe["ETH-PERPETUAL"] = Instrument("ETH", "USD", "future", true);
+    auto exchange = std::make_shared<MatchingEngine>(universe);
+    TradingSystem local(exchange);
+    local.enableLocalTriggers();
+    local.sell("BTC-PERPETUAL", 10, 0, "stop_market", "", -1, "", -1, -1, -1, -1, 59000);
+    local.sell("ETH-PERPETUAL", 10, 0, "stop_market", "", -1, "", -1, -1, -1, -1, 2000);
+    auto listed = [&](const JsonValue& response) { return response.at("result").get<JsonArray>().size(); };
+    bool listed_all = listed(local.getOpenOrders()) == 2 && listed(local.getOpenOrdersByCurrency("ETH")) == 1 &&
+        listed(local.getOpenOrdersByInstrument("BTC-PERPETUAL", "stop_all")) == 1;
+    local.cancelAllByCurrency("BTC");
+    bool by_currency = local.triggerEngine()->pendingCount() == 1;
+    local.cancelAll();
+    local.onPrice("ETH-PERPETUAL", TriggerReference::Last, 1000);
+    local.awaitTriggeredOrders();
+    logging::flush();
+    if (!listed_all || !by_currency || local.triggerEngine()->pendingCount() != 0 || listed(local.getOpenOrders()) != 0) {
+        std::cerr << "held orders were not listed with the open orders or survived a mass cancel\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+#include "book_analytics.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Off for the whole file, see simd.h
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace {
+
+using simd::Vec4;
+using simd::horizontalSum;
+using simd::load;
+using simd::store;
+
+constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+
+SIMD_KERNEL double sumKernel(const double* values, size_t n) {
+    Vec4 acc0 = {0, 0, 0, 0};
+    Vec4 acc1 = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 += load(values + i);
+        acc1 += load(values + i + 4);
+    }
+    double total = horizontalSum(acc0 + acc1);
+    for (; i < n; ++i) {
+        total += values[i];
+    }
+    return total;
+}
+
+// Whole 4-level blocks that fit inside the remaining size are consumed with vector
+// multiply-adds; the block that crosses the target size is finished level by level.
+SIMD_KERNEL double vwapKernel(const double* prices, const double* amounts, size_t n, double size) {
+    double filled = 0;
+    double notional = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        Vec4 block_amounts = load(amounts + i);
+        double block = horizontalSum(block_amounts);
+        if (filled + block >= size) break;
+        filled += block;
+        notional += horizontalSum(load(prices + i) * block_amounts);
+    }
+    for (; i < n && filled < size; ++i) {
+        double take = std::min(amounts[i], size - filled);
+        filled += take;
+        notional += take * prices[i];
+    }
+    return filled < size ? NaN : notional / size;
+}
+
+SIMD_KERNEL void micropriceKernel(const double* bid, const double* bid_size, const double* ask,
+    const double* ask_size, size_t n, double* out) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        Vec4 b = load(bid + i);
+        Vec4 bs = load(bid_size + i);
+        Vec4 a = load(ask + i);
+        Vec4 as = load(ask_size + i);
+        store(out + i, (b * as + a * bs) / (bs + as));
+    }
+    for (; i < n; ++i) {
+        out[i] = (bid[i] * ask_size[i] + ask[i] * bid_size[i]) / (bid_size[i] + ask_size[i]);
+    }
+}
+
+// (bid - ask) / (bid + ask) per book; NaN where both sides are empty
+SIMD_KERNEL void imbalanceKernel(const double* bid_depth, const double* ask_depth, size_t n, double* out) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        Vec4 b = load(bid_depth + i);
+        Vec4 a = load(ask_depth + i);
+        Vec4 total = b + a;
+        store(out + i, simd::select(total == 0, simd::broadcast(NaN), (b - a) / total));
+    }
+    for (; i < n; ++i) {
+        double total = bid_depth[i] + ask_depth[i];
+        out[i] = total == 0 ? NaN : (bid_depth[i] - ask_depth[i]) / total;
+    }
+}
+
+// The fill's distance from the mid, signed so that a cost is positive: fill - mid for buys
+SIMD_KERNEL void slippageKernel(const double* fill, const double* mid, size_t n, double sign, double* out) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        store(out + i, (load(fill + i) - load(mid + i)) * sign);
+    }
+    for (; i < n; ++i) {
+        out[i] = (fill[i] - mid[i]) * sign;
+    }
+}
+
+void readSide(const JsonValue& levels, BookSide& side) {
+    const JsonArray& entries = levels.get<JsonArray>();
+    side.prices.resize(entries.size());
+    side.amounts.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const JsonArray& level = entries[i].get<JsonArray>();
+        side.prices[i] = level[0].get<double>();
+        side.amounts[i] = level[1].get<double>();
+    }
+}
+
+} // namespace
+
+BookSnapshot BookSnapshot::fromJson(const JsonValue& book) {
+    const JsonObject& fields = book.get<JsonObject>();
+    auto result = fields.find("result");
+    const JsonValue& body = result == fields.end() ? book : result->second;
+
+    BookSnapshot snapshot;
+    readSide(body.at("bids"), snapshot.bids);
+    readSide(body.at("asks"), snapshot.asks);
+    return snapshot;
+}
+
+namespace book_analytics {
+
+double depth(const BookSide& side, size_t levels) {
+    size_t n = levels == 0 ? side.size() : std::min(levels, side.size());
+    return sumKernel(side.amounts.data(), n);
+}
+
+double vwap(const BookSide& side, double size) {
+    if (size <= 0) return NaN;
+    return vwapKernel(side.prices.data(), side.amounts.data(), side.size(), size);
+}
+
+double midPrice(const BookSnapshot& book) {
+    if (book.bids.size() == 0 || book.asks.size() == 0) return NaN;
+    return (book.bids.prices[0] + book.asks.prices[0]) / 2;
+}
+
+double microprice(const BookSnapshot& book) {
+    if (book.bids.size() == 0 || book.asks.size() == 0) return NaN;
+    double bid_size = book.bids.amounts[0];
+    double ask_size = book.asks.amounts[0];
+    return (book.bids.prices[0] * ask_size + book.asks.prices[0] * bid_size) / (bid_size + ask_size);
+}
+
+double depthImbalance(const BookSnapshot& book, size_t levels) {
+    double bid_depth = depth(book.bids, levels);
+    double ask_depth = depth(book.asks, levels);
+    if (bid_depth + ask_depth == 0) return NaN;
+    return (bid_depth - ask_depth) / (bid_depth + ask_depth);
+}
+
+double slippage(const BookSnapshot& book, bool isBuy, double size) {
+    double fill = vwap(isBuy ? book.asks : book.bids, size);
+    double mid = midPrice(book);
+    return isBuy ? fill - mid : mid - fill;
+}
+
+void batchMicroprice(const std::vector<BookSnapshot>& books, double* out) {
+    // Gather top of book into contiguous columns; empty sides become NaN and propagate
+    thread_local std::vector<double> columns;
+    size_t n = books.size();
+    columns.resize(4 * n);
+    double* bid = columns.data();
+    double* bid_size = bid + n;
+    double* ask = bid_size + n;
+    double* ask_size = ask + n;
+    for (size_t i = 0; i < n; ++i) {
+        const BookSnapshot& book = books[i];
+        bool valid = book.bids.size() != 0 && book.asks.size() != 0;
+        bid[i] = valid ? book.bids.prices[0] : NaN;
+        bid_size[i] = valid ? book.bids.amounts[0] : NaN;
+        ask[i] = valid ? book.asks.prices[0] : NaN;
+        ask_size[i] = valid ? book.asks.amounts[0] : NaN;
+    }
+    micropriceKernel(bid, bid_size, ask, ask_size, n, out);
+}
+
+void batchDepthImbalance(const std::vector<BookSnapshot>& books, size_t levels, double* out) {
+    // Each book's depths are summed in the depth kernel; the ratios are taken across books
+    thread_local std::vector<double> columns;
+    size_t n = books.size();
+    columns.resize(2 * n);
+    double* bid_depth = columns.data();
+    double* ask_depth = bid_depth + n;
+    for (size_t i = 0; i < n; ++i) {
+        bid_depth[i] = depth(books[i].bids, levels);
+        ask_depth[i] = depth(books[i].asks, levels);
+    }
+    imbalanceKernel(bid_depth, ask_depth, n, out);
+}
+
+void batchVwap(const std::vector<BookSnapshot>& books, bool isBuy, const double* sizes, double* out) {
+    // A walk down one book's levels; nothing is left to do across books
+    for (size_t i = 0; i < books.size(); ++i) {
+        out[i] = vwap(isBuy ? books[i].asks : books[i].bids, sizes[i]);
+    }
+}
+
+void batchSlippage(const std::vector<BookSnapshot>& books, bool isBuy, const double* sizes, double* out) {
+    thread_local std::vector<double> columns;
+    size_t n = books.size();
+    columns.resize(2 * n);
+    double* fill = columns.data();
+    double* mid = fill + n;
+    batchVwap(books, isBuy, sizes, fill);
+    for (size_t i = 0; i < n; ++i) {
+        mid[i] = midPrice(books[i]);
+    }
+    slippageKernel(fill, mid, n, isBuy ? 1.0 : -1.0, out);
+}
+
+} // namespace book_analytics
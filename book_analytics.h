@@ -0,0 +1,55 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <cstddef>
+#include <vector>
+
+// One side of an order book as two contiguous arrays, best level first
+struct BookSide {
+    std::vector<double> prices;
+    std::vector<double> amounts;
+
+    size_t size() const { return prices.size(); }
+};
+
+struct BookSnapshot {
+    BookSide bids;
+    BookSide asks;
+
+    // Accepts a getOrderBook response or its "result" object
+    static BookSnapshot fromJson(const JsonValue& book);
+};
+
+// Analytics kernels over BookSnapshot. Depth-wise kernels run over the contiguous level arrays
+// in SIMD blocks, so books up to the 10000 levels getOrderBook returns stay cheap to scan.
+// Kernels return NaN when the book does not have enough liquidity to answer.
+namespace book_analytics {
+
+// Total amount in the first `levels` levels (all levels if levels is 0)
+double depth(const BookSide& side, size_t levels = 0);
+
+// Average fill price for `size` taken from this side
+double vwap(const BookSide& side, double size);
+
+double midPrice(const BookSnapshot& book);
+
+// Top-of-book mid weighted by the opposite side's size
+double microprice(const BookSnapshot& book);
+
+// (bid depth - ask depth) / (bid depth + ask depth) over the first `levels` levels, in [-1, 1]
+double depthImbalance(const BookSnapshot& book, size_t levels = 0);
+
+// Distance between the average fill price for `size` and the mid, positive when it costs us
+double slippage(const BookSnapshot& book, bool isBuy, double size);
+
+// Batch variants: evaluate many books at once, writing one value per book into `out`. Per-book
+// inputs (top of book, depths, fill prices) are gathered into contiguous columns and the
+// metric is computed across books in SIMD; depths and fills themselves come from the depth-wise
+// kernels one book at a time, so batchVwap is the plain per-book loop.
+void batchMicroprice(const std::vector<BookSnapshot>& books, double* out);
+void batchDepthImbalance(const std::vector<BookSnapshot>& books, size_t levels, double* out);
+void batchVwap(const std::vector<BookSnapshot>& books, bool isBuy, const double* sizes, double* out);
+void batchSlippage(const std::vector<BookSnapshot>& books, bool isBuy, const double* sizes, double* out);
+
+} // namespace book_analytics
@@ -0,0 +1,98 @@
+#include "buffer_pool.h"
+
+#include <bit>
+
+PooledBuffer::~PooledBuffer() {
+    if (pool) pool->recycle(std::move(buffer));
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept {
+    if (this != &other) {
+        if (pool) pool->recycle(std::move(buffer));
+        pool = other.pool;
+        buffer = std::move(other.buffer);
+        other.pool = nullptr;
+    }
+    return *this;
+}
+
+void PooledBuffer::expect(size_t bytes) {
+    if (bytes <= buffer.capacity()) return;
+    if (!pool) {
+        buffer.reserve(bytes);
+        return;
+    }
+    PooledBuffer larger = pool->acquire(bytes);
+    larger.buffer.append(buffer);
+    std::swap(buffer, larger.buffer);
+}
+
+std::string PooledBuffer::release() {
+    if (pool) {
+        pool->released.fetch_add(1, std::memory_order_relaxed);
+        pool = nullptr;
+    }
+    return std::move(buffer);
+}
+
+BufferPool& BufferPool::shared() {
+    // Leaked, so that thread-local clients destroyed after static destruction can still return
+    // their buffers
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+PooledBuffer BufferPool::acquire(size_t expected_bytes) {
+    acquired.fetch_add(1, std::memory_order_relaxed);
+    size_t shift = std::max<size_t>(MIN_SHIFT, std::bit_width(std::max<size_t>(expected_bytes, 1) - 1));
+    size_t index = shift - MIN_SHIFT;
+    if (index >= CLASSES) {
+        std::string buffer;
+        buffer.reserve(expected_bytes);
+        return PooledBuffer(this, std::move(buffer));
+    }
+    // Any retained buffer of this class or up to two above will do
+    for (size_t candidate = index; candidate < std::min(index + 3, CLASSES); ++candidate) {
+        SizeClass& size_class = classes[candidate];
+        std::lock_guard lock(size_class.mutex);
+        if (!size_class.free.empty()) {
+            std::string buffer = std::move(size_class.free.back());
+            size_class.free.pop_back();
+            retained_bytes.fetch_sub(buffer.capacity(), std::memory_order_relaxed);
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return PooledBuffer(this, std::move(buffer));
+        }
+    }
+    std::string buffer;
+    buffer.reserve(size_t(1) << shift);
+    return PooledBuffer(this, std::move(buffer));
+}
+
+void BufferPool::recycle(std::string buffer) {
+    size_t capacity = buffer.capacity();
+    // Filed under the largest class it can serve in full
+    size_t shift = std::bit_width(capacity) - 1;
+    if (shift < MIN_SHIFT || shift - MIN_SHIFT >= CLASSES ||
+        retained_bytes.load(std::memory_order_relaxed) + capacity > max_retained_bytes) {
+        discarded.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.clear();
+    SizeClass& size_class = classes[shift - MIN_SHIFT];
+    std::lock_guard lock(size_class.mutex);
+    size_class.free.push_back(std::move(buffer));
+    retained_bytes.fetch_add(capacity, std::memory_order_relaxed);
+    recycled.fetch_add(1, std::memory_order_relaxed);
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    Stats stats;
+    stats.acquired = acquired.load(std::memory_order_relaxed);
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = stats.acquired - stats.hits;
+    stats.recycled = recycled.load(std::memory_order_relaxed);
+    stats.discarded = discarded.load(std::memory_order_relaxed);
+    stats.released = released.load(std::memory_order_relaxed);
+    stats.retained_bytes = retained_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class BufferPool;
+
+// A response body in a buffer borrowed from a BufferPool. Move-only; the buffer goes back to its
+// pool, capacity intact, when the handle is destroyed, so the next response of a similar size is
+// written into memory that is already allocated and faulted in.
+class PooledBuffer {
+private:
+    BufferPool* pool = nullptr;
+    std::string buffer;
+
+public:
+    PooledBuffer() = default;
+    // A buffer of no pool, e.g. a response produced in process; freed normally
+    explicit PooledBuffer(std::string text) : buffer(std::move(text)) {}
+    PooledBuffer(BufferPool* pool, std::string buffer) : pool(pool), buffer(std::move(buffer)) {}
+    ~PooledBuffer();
+
+    PooledBuffer(PooledBuffer&& other) noexcept : pool(other.pool), buffer(std::move(other.buffer)) {
+        other.pool = nullptr;
+    }
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    std::string& str() { return buffer; }
+    const std::string& str() const { return buffer; }
+    std::string_view view() const { return buffer; }
+    size_t size() const { return buffer.size(); }
+    bool empty() const { return buffer.empty(); }
+
+    // Makes room for `bytes` in total. A pooled buffer that is too small is swapped for one of
+    // the right class from its pool, rather than regrown.
+    void expect(size_t bytes);
+    void append(std::string_view bytes) {
+        if (buffer.size() + bytes.size() > buffer.capacity()) expect(std::max(buffer.size() + bytes.size(), 2 * buffer.capacity()));
+        buffer.append(bytes);
+    }
+
+    // Hands the bytes over as a plain string without copying; the buffer leaves the pool
+    std::string release();
+};
+
+// Response buffers in power-of-two size classes from 4KB to 64MB. acquire() hands out a retained
+// buffer of the class that fits the expected size, or allocates one of that class's capacity;
+// released buffers are kept per class up to a byte budget. Safe to share between threads: a
+// buffer may be released on another thread than the one that acquired it.
+class BufferPool {
+public:
+    static constexpr size_t MIN_SHIFT = 12;
+    static constexpr size_t CLASSES = 15;      // 4KB .. 64MB
+
+    struct Stats {
+        uint64_t acquired = 0;
+        uint64_t hits = 0;          // served from a retained buffer
+        uint64_t misses = 0;        // allocated a new buffer
+        uint64_t recycled = 0;      // returned and retained
+        uint64_t discarded = 0;     // returned but freed: over budget or outside the classes
+        uint64_t released = 0;      // handed over as strings; never return
+        size_t retained_bytes = 0;
+
+        double hitRate() const { return acquired ? double(hits) / double(acquired) : 0.0; }
+    };
+
+private:
+    struct SizeClass {
+        std::mutex mutex;
+        std::vector<std::string> free;
+    };
+
+    std::array<SizeClass, CLASSES> classes;
+    size_t max_retained_bytes;
+    std::atomic<size_t> retained_bytes{0};
+    std::atomic<uint64_t> acquired{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> recycled{0};
+    std::atomic<uint64_t> discarded{0};
+    std::atomic<uint64_t> released{0};
+
+    friend class PooledBuffer;
+    void recycle(std::string buffer);
+
+public:
+    explicit BufferPool(size_t max_retained_bytes = 64 << 20) : max_retained_bytes(max_retained_bytes) {}
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // The process-wide pool RestClient and EventLoop draw from
+    static BufferPool& shared();
+
+    // An empty buffer with room for at least `expected_bytes`
+    PooledBuffer acquire(size_t expected_bytes = 0);
+
+    Stats stats() const;
+};
@@ -0,0 +1,141 @@
+#include "event_loop.h"
+#include "http_client.h"
+#include "logger.h"
+#include "runtime.h"
+
+namespace {
+
+// Owns a spawned task until it finishes; the frame frees itself at the end
+struct Detached {
+    struct promise_type : PooledFrame {
+        Detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+Detached runDetached(Task<void> task) {
+    try {
+        co_await task;
+    } catch (const std::exception& e) {
+        logging::error("Task failed: {}", e.what());
+    }
+}
+
+} // namespace
+
+EventLoop::EventLoop(long max_connections)
+    : EventLoop(max_connections, runtime::options().busy_poll ? PollMode::BusyPoll : PollMode::Blocking) {}
+
+EventLoop::EventLoop(long max_connections, PollMode mode) : mode(mode) {
+    curlGlobalInit();
+    multi = curl_multi_init();
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_connections);
+}
+
+EventLoop::~EventLoop() {
+    for (const std::unique_ptr<Transfer>& transfer : transfers) {
+        if (transfer->waiter) {
+            curl_multi_remove_handle(multi, transfer->easy);
+        }
+        curl_slist_free_all(transfer->headers);
+        curl_easy_cleanup(transfer->easy);
+    }
+    curl_multi_cleanup(multi);
+}
+
+EventLoop::Transfer* EventLoop::acquire() {
+    if (!idle.empty()) {
+        Transfer* transfer = idle.back();
+        idle.pop_back();
+        return transfer;
+    }
+    transfers.push_back(std::make_unique<Transfer>());
+    Transfer* transfer = transfers.back().get();
+    transfer->easy = curl_easy_init();
+    transfer->response.curl = transfer->easy;
+    curl_easy_setopt(transfer->easy, CURLOPT_WRITEFUNCTION, PooledWriteCallback);
+    curl_easy_setopt(transfer->easy, CURLOPT_WRITEDATA, &transfer->response);
+    curl_easy_setopt(transfer->easy, CURLOPT_PRIVATE, transfer);
+    curl_easy_setopt(transfer->easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(transfer->easy, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(transfer->easy, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(transfer->easy, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(transfer->easy, CURLOPT_TIMEOUT_MS, 3000L);
+    curl_easy_setopt(transfer->easy, CURLOPT_CONNECTTIMEOUT_MS, 1000L);
+    // Wait for a connection to multiplex on instead of opening one per request
+    curl_easy_setopt(transfer->easy, CURLOPT_PIPEWAIT, 1L);
+    return transfer;
+}
+
+void EventLoop::start(Transfer* transfer, const std::string& url, const std::string& authToken,
+    std::coroutine_handle<> waiter) {
+    transfer->response.buffer = BufferPool::shared().acquire(transfer->expected_size);
+    transfer->waiter = waiter;
+    curl_slist_free_all(transfer->headers);
+    transfer->headers = nullptr;
+    if (!authToken.empty()) {
+        std::string authHeader = "Authorization: Bearer " + authToken;
+        transfer->headers = curl_slist_append(nullptr, authHeader.c_str());
+    }
+    curl_easy_setopt(transfer->easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(transfer->easy, CURLOPT_HTTPHEADER, transfer->headers);
+    curl_multi_add_handle(multi, transfer->easy);
+    ++active;
+}
+
+void EventLoop::GetRequest::await_suspend(std::coroutine_handle<> waiter) {
+    transfer = loop.acquire();
+    loop.start(transfer, url, authToken, waiter);
+}
+
+PooledBuffer EventLoop::GetRequest::await_resume() {
+    PooledBuffer response = transfer->result == CURLE_OK
+        ? std::move(transfer->response.buffer)
+        : PooledBuffer("Error: " + std::string(curl_easy_strerror(transfer->result)));
+    if (transfer->result == CURLE_OK) transfer->expected_size = response.size();
+    transfer->waiter = nullptr;
+    loop.idle.push_back(transfer);
+    return response;
+}
+
+void EventLoop::spawn(Task<void> task) {
+    runDetached(std::move(task));
+}
+
+void EventLoop::run() {
+    while (active > 0) {
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int remaining = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi, &remaining)) {
+            if (message->msg != CURLMSG_DONE) continue;
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+            transfer->result = message->data.result;
+            curl_multi_remove_handle(multi, message->easy_handle);
+            finished.push_back(transfer);
+        }
+
+        if (finished.empty()) {
+            // curl_multi_perform reads whatever has arrived without blocking, so spinning on it
+            // is the busy poll
+            if (mode == PollMode::BusyPoll) {
+                runtime::relax();
+            } else {
+                curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+            }
+            continue;
+        }
+        // Resumed coroutines may start new transfers, so hand them over only after draining
+        active -= finished.size();
+        for (Transfer* transfer : finished) {
+            transfer->waiter.resume();
+        }
+        finished.clear();
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "http_client.h"
+#include "task.h"
+
+#include <coroutine>
+#include <cstdint>
+#include <curl/curl.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Single-threaded event loop over a libcurl multi handle. Coroutines co_await get() and are
+// resumed on the thread calling run() once their response is complete, so thousands of
+// requests can be outstanding without a thread each. Transfers and their easy handles (and
+// with them the connection cache) are reused across requests.
+//
+// In Blocking mode an idle loop sleeps in poll() until a socket is ready. In BusyPoll mode it
+// never sleeps: it keeps driving the sockets, so a response is picked up as soon as it lands
+// instead of after a scheduler wakeup, at the cost of a fully used core. Busy polling belongs
+// on a pinned core (see runtime.h); on a shared one it steals time from the threads it waits on.
+enum class PollMode : uint8_t { Blocking, BusyPoll };
+
+class EventLoop {
+private:
+    struct Transfer {
+        CURL* easy = nullptr;
+        struct curl_slist* headers = nullptr;
+        PooledResponse response;
+        size_t expected_size = 0;   // of the next response without a Content-Length: the last one's
+        CURLcode result = CURLE_OK;
+        std::coroutine_handle<> waiter;
+    };
+
+    CURLM* multi;
+    PollMode mode;
+    std::vector<std::unique_ptr<Transfer>> transfers;
+    std::vector<Transfer*> idle;
+    std::vector<Transfer*> finished;
+    size_t active = 0;
+
+    Transfer* acquire();
+    void start(Transfer* transfer, const std::string& url, const std::string& authToken, std::coroutine_handle<> waiter);
+
+public:
+    class GetRequest {
+    private:
+        EventLoop& loop;
+        std::string url;
+        std::string authToken;
+        Transfer* transfer = nullptr;
+
+    public:
+        GetRequest(EventLoop& loop, std::string url, std::string authToken)
+            : loop(loop), url(std::move(url)), authToken(std::move(authToken)) {}
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> waiter);
+        // Response body, or "Error: ..." like RestClient::get, in a buffer that returns to the
+        // shared BufferPool when dropped
+        PooledBuffer await_resume();
+    };
+
+    // max_connections caps the sockets per host; further requests queue or share an HTTP/2 connection
+    // The mode defaults to the runtime's busy_poll option
+    explicit EventLoop(long max_connections = 8);
+    EventLoop(long max_connections, PollMode mode);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    GetRequest get(std::string url, std::string authToken = "") {
+        return GetRequest(*this, std::move(url), std::move(authToken));
+    }
+
+    // Start a task now; it runs until its first await and is then driven by run()
+    void spawn(Task<void> task);
+
+    // Drive transfers until none are left, at which point every spawned task has finished
+    void run();
+
+    size_t inFlight() const { return active; }
+
+    PollMode pollMode() const { return mode; }
+    void setPollMode(PollMode poll_mode) { mode = poll_mode; }
+};
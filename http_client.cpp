@@ -0,0 +1,49 @@
+#include "http_client.h"
+
+// Where ParseCallback feeds a response; the first parse error is kept and aborts the transfer
+struct ParseSink {
+    JsonStreamParser* parser;
+    std::string error;
+};
+
+static size_t ParseCallback(void* contents, size_t size, size_t nmemb, ParseSink* sink) {
+    try {
+        sink->parser->feed(std::string_view((char*)contents, size * nmemb));
+    } catch (const std::exception& e) {
+        sink->error = e.what();
+        return 0;
+    }
+    return size * nmemb;
+}
+
+Result<JsonValue> RestClient::getJson(const std::string& url, const std::string& authToken, JsonStreamParser& parser) {
+    if (!curl) return Result<JsonValue>::failure(ErrorCode::Transport, "no curl handle");
+    parser.reset();
+    ParseSink sink{&parser, std::string()};
+    const std::string* tokenPtr = authToken.empty() ? nullptr : &authToken;
+    struct curl_slist* headers = setupHeaders(tokenPtr);
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ParseCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+
+    CURLcode res = curl_easy_perform(curl);
+    curl_slist_free_all(headers);
+
+    if (!sink.error.empty()) {
+        return Result<JsonValue>::failure(ErrorCode::Parse, "Invalid response: " + sink.error);
+    }
+    if (res != CURLE_OK) {
+        return Result<JsonValue>::failure(ErrorCode::Transport, curl_easy_strerror(res));
+    }
+    std::string error;
+    try {
+        JsonValue document = parser.finish();
+        return document;
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    return Result<JsonValue>::failure(ErrorCode::Parse, "Invalid response: " + error);
+}
@@ -1,25 +1,60 @@
+#pragma once
+
+#include "buffer_pool.h"
+#include "json_stream_parser.h"
+#include "json_writer.h"
+#include "result.h"
+
 #include <curl/curl.h>
 #include <string>
 #include <iostream>
 
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
-    userp->append((char*)contents, size * nmemb);
+// libcurl's global state must be set up once per process, before any easy handle exists,
+// and torn down only after every (thread-local) handle has been cleaned up
+inline void curlGlobalInit() {
+    struct CurlGlobal {
+        CurlGlobal() { curl_global_init(CURL_GLOBAL_ALL); }
+        ~CurlGlobal() { curl_global_cleanup(); }
+    };
+    static CurlGlobal global;
+}
+
+// Where PooledWriteCallback writes a response. The first chunk sizes the buffer from the
+// announced Content-Length, so bodies of any size land in a pooled buffer that fits them.
+struct PooledResponse {
+    CURL* curl = nullptr;
+    PooledBuffer buffer;
+};
+
+static size_t PooledWriteCallback(void* contents, size_t size, size_t nmemb, PooledResponse* response) {
+    if (response->buffer.empty()) {
+        curl_off_t length = -1;
+        curl_easy_getinfo(response->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+        if (length > 0) response->buffer.expect(size_t(length));
+    }
+    response->buffer.append(std::string_view((char*)contents, size * nmemb));
     return size * nmemb;
 }
 
 class RestClient {
 private:
     CURL* curl;
-    std::string response;
+    PooledResponse response;
+    size_t expected_size = 0;   // of the next response without a Content-Length: the last one's
+    JsonWriter body;            // reused by post(url, JsonValue)
     
     void init() {
+        curlGlobalInit();
         curl = curl_easy_init();
+        response.curl = curl;
         if (curl) {
-            // Set common options
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+            // Set common options; the write callback is set per request
             curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L); // For thread safety
             
+            // Offer every encoding libcurl can decode (gzip, deflate, zstd); bodies reach the
+            // write callback already decoded, chunk by chunk
+            curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+
             // Optimize for low latency
             curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L); // Disable Nagle's algorithm
             curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 3000L); // 3 second timeout
@@ -47,6 +82,10 @@ public:
     RestClient() {
         init();
     }
+
+    // A client owns a curl handle; it must not be shared between threads
+    RestClient(const RestClient&) = delete;
+    RestClient& operator=(const RestClient&) = delete;
     
     ~RestClient() {
         if (curl) {
@@ -54,9 +93,13 @@ public:
         }
     }
 
-    std::string get(const std::string& url, const std::string& authToken = "") {
-        response.clear();
+    // GET into a buffer from the shared BufferPool. The caller owns the buffer; dropping it
+    // returns it to the pool for the next response.
+    PooledBuffer getBuffer(const std::string& url, const std::string& authToken = "") {
+        response.buffer = BufferPool::shared().acquire(expected_size);
         if (curl) {
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PooledWriteCallback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
             const std::string* tokenPtr = authToken.empty() ? nullptr : &authToken;
             struct curl_slist* headers = setupHeaders(tokenPtr);
             
@@ -65,16 +108,31 @@ public:
             curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
             
             CURLcode res = curl_easy_perform(curl);
+            curl_slist_free_all(headers);
+
             if (res != CURLE_OK) {
-                return "Error: " + std::string(curl_easy_strerror(res));
+                return PooledBuffer("Error: " + std::string(curl_easy_strerror(res)));
             }
         }
-        return response;
+        expected_size = response.buffer.size();
+        return std::move(response.buffer);
     }
 
-    std::string post(const std::string& url, const std::string& json_data, const std::string& authToken = "") {
-        response.clear();
+    // The body as a plain string, moved out of its buffer rather than copied
+    std::string get(const std::string& url, const std::string& authToken = "") {
+        return getBuffer(url, authToken).release();
+    }
+
+    // GET and parse the body with `parser` as it arrives, so the document is complete shortly
+    // after the last byte instead of a full parse later. Transfer failures come back as
+    // Transport errors; invalid JSON as a Parse error, aborting the transfer at the first bad byte.
+    Result<JsonValue> getJson(const std::string& url, const std::string& authToken, JsonStreamParser& parser);
+
+    PooledBuffer postBuffer(const std::string& url, const std::string& json_data, const std::string& authToken = "") {
+        response.buffer = BufferPool::shared().acquire(expected_size);
         if (curl) {
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PooledWriteCallback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
             const std::string* tokenPtr = authToken.empty() ? nullptr : &authToken;
             struct curl_slist* headers = setupHeaders(tokenPtr, true);
             
@@ -87,9 +145,21 @@ public:
             curl_slist_free_all(headers);
             
             if (res != CURLE_OK) {
-                return "Error: " + std::string(curl_easy_strerror(res));
+                return PooledBuffer("Error: " + std::string(curl_easy_strerror(res)));
             }
         }
-        return response;
+        expected_size = response.buffer.size();
+        return std::move(response.buffer);
+    }
+
+    std::string post(const std::string& url, const std::string& json_data, const std::string& authToken = "") {
+        return postBuffer(url, json_data, authToken).release();
+    }
+
+    // Serializes the body into the client's reusable buffer instead of a hand-built string
+    std::string post(const std::string& url, const JsonValue& json, const std::string& authToken = "") {
+        body.clear();
+        body.value(json);
+        return post(url, body.str(), authToken);
     }
 };
\ No newline at end of file
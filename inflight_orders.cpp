@@ -0,0 +1,120 @@
+#include "inflight_orders.h"
+#include "logger.h"
+
+#include <optional>
+
+void EditRequest::merge(const EditRequest& newer) {
+    // amount and contracts describe the same size; keep only the latest one given
+    if (newer.amount != -1 || newer.contracts != -1) {
+        amount = newer.amount;
+        contracts = newer.contracts;
+    }
+    if (newer.price != -1) price = newer.price;
+    if (newer.post_only != -1) post_only = newer.post_only;
+    if (newer.reduce_only != -1) reduce_only = newer.reduce_only;
+    if (newer.reject_post_only != -1) reject_post_only = newer.reject_post_only;
+    if (newer.advanced != "") advanced = newer.advanced;
+    if (newer.trigger_price != -1) trigger_price = newer.trigger_price;
+    if (newer.trigger_offset != -1) trigger_offset = newer.trigger_offset;
+    if (newer.mmp != -1) mmp = newer.mmp;
+    if (newer.valid_until != 0) valid_until = newer.valid_until;
+}
+
+InflightOrders::InflightOrders(SendEdit send_edit, SendCancel send_cancel)
+    : send_edit(std::move(send_edit)), send_cancel(std::move(send_cancel)) {}
+
+Result<JsonValue> InflightOrders::edit(const std::string& order_id, const EditRequest& request) {
+    return submit(order_id, false, request);
+}
+
+Result<JsonValue> InflightOrders::cancel(const std::string& order_id) {
+    return submit(order_id, true, EditRequest());
+}
+
+FlightState InflightOrders::state(const std::string& order_id) {
+    std::lock_guard lock(mutex);
+    auto it = flights.find(order_id);
+    if (it == flights.end() || !it->second.in_flight) return FlightState::Live;
+    return it->second.in_flight->is_cancel ? FlightState::PendingCancel : FlightState::PendingEdit;
+}
+
+Result<JsonValue> InflightOrders::submit(const std::string& order_id, bool is_cancel, const EditRequest& edit) {
+    std::unique_lock lock(mutex);
+    Flight& flight = flights[order_id];
+
+    if (!flight.in_flight && !flight.queued) {
+        // Live: send straight away
+        flight.in_flight = std::make_unique<Request>();
+        flight.in_flight->is_cancel = is_cancel;
+        flight.in_flight->edit = edit;
+        Request& request = *flight.in_flight;
+        lock.unlock();
+        return send(order_id, request);
+    }
+
+    bool cancelling = flight.in_flight->is_cancel || (flight.queued && flight.queued->is_cancel);
+    if (!is_cancel && cancelling) {
+        logging::warn("Order is being cancelled: {}", order_id);
+        return Result<JsonValue>::failure(ErrorCode::Validation, "Order is being cancelled: " + order_id);
+    }
+
+    if (flight.queued) {
+        // Fold into the queued request and share its response
+        if (is_cancel) {
+            flight.queued->is_cancel = true;
+        } else {
+            flight.queued->edit.merge(edit);
+        }
+        coalesced.fetch_add(1, std::memory_order_relaxed);
+        std::shared_future<Result<JsonValue>> result = flight.queued->result;
+        lock.unlock();
+        return result.get();
+    }
+    if (is_cancel && flight.in_flight->is_cancel) {
+        coalesced.fetch_add(1, std::memory_order_relaxed);
+        std::shared_future<Result<JsonValue>> result = flight.in_flight->result;
+        lock.unlock();
+        return result.get();
+    }
+
+    // Queue behind the request on the wire; this caller sends whatever the slot holds once it clears.
+    // send() moves the slot to in_flight when the previous request completes, under the lock, so
+    // the order never looks Live while this request is still to be sent.
+    flight.queued = std::make_unique<Request>();
+    flight.queued->is_cancel = is_cancel;
+    flight.queued->edit = edit;
+    Request& request = *flight.queued;
+    std::shared_future<Result<JsonValue>> previous = flight.in_flight->result;
+    lock.unlock();
+    previous.wait();
+    return send(order_id, request);
+}
+
+Result<JsonValue> InflightOrders::send(const std::string& order_id, Request& request) {
+    std::optional<Result<JsonValue>> response;
+    std::exception_ptr error;
+    try {
+        response.emplace(request.is_cancel ? send_cancel(order_id) : send_edit(order_id, request.edit));
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    std::unique_ptr<Request> done;
+    {
+        std::lock_guard lock(mutex);
+        auto it = flights.find(order_id);
+        done = std::move(it->second.in_flight);
+        if (it->second.queued) {
+            // Its caller is woken by the promise below and sends it
+            it->second.in_flight = std::move(it->second.queued);
+        } else {
+            flights.erase(it);
+        }
+    }
+    if (error) {
+        done->promise.set_exception(error);
+        std::rethrow_exception(error);
+    }
+    done->promise.set_value(*response);
+    return std::move(*response);
+}
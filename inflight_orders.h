@@ -0,0 +1,80 @@
+#pragma once
+
+#include "json_parser.h"
+#include "result.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Parameters of one edit request; -1 / "" / 0 mean "leave unchanged" as in TradingSystem::edit
+struct EditRequest {
+    int amount = -1;
+    int contracts = -1;
+    int price = -1;
+    int post_only = -1;
+    int reduce_only = -1;
+    int reject_post_only = -1;
+    std::string advanced = "";
+    int trigger_price = -1;
+    int trigger_offset = -1;
+    int mmp = -1;
+    int valid_until = 0;
+
+    // Fold a later edit of the same order into this one; fields it sets win
+    void merge(const EditRequest& newer);
+};
+
+enum class FlightState { Live, PendingEdit, PendingCancel };
+
+// Per-order state machine for edits and cancels. At most one request per order is on the wire;
+// requests made meanwhile wait in a single queued slot. Queued edits collapse into the latest
+// target and a cancel replaces any queued edit. Every caller whose request was folded into the
+// queued one receives that request's response.
+//
+// Orders without a request in flight are Live and take no memory here. New orders are not
+// tracked: their id is only known once the exchange has acknowledged them.
+class InflightOrders {
+public:
+    using SendEdit = std::function<Result<JsonValue>(const std::string& order_id, const EditRequest& request)>;
+    using SendCancel = std::function<Result<JsonValue>(const std::string& order_id)>;
+
+private:
+    struct Request {
+        bool is_cancel = false;
+        EditRequest edit;
+        std::promise<Result<JsonValue>> promise;
+        std::shared_future<Result<JsonValue>> result;
+
+        Request() : result(promise.get_future().share()) {}
+    };
+
+    struct Flight {
+        std::unique_ptr<Request> in_flight;
+        std::unique_ptr<Request> queued;
+    };
+
+    SendEdit send_edit;
+    SendCancel send_cancel;
+    std::mutex mutex;
+    std::unordered_map<std::string, Flight> flights;
+    std::atomic<uint64_t> coalesced = 0;
+
+    Result<JsonValue> submit(const std::string& order_id, bool is_cancel, const EditRequest& edit);
+    Result<JsonValue> send(const std::string& order_id, Request& request);
+
+public:
+    InflightOrders(SendEdit send_edit, SendCancel send_cancel);
+
+    // Block until the request (or the request it was folded into) has been answered
+    Result<JsonValue> edit(const std::string& order_id, const EditRequest& request);
+    Result<JsonValue> cancel(const std::string& order_id);
+
+    FlightState state(const std::string& order_id);
+    // Requests answered without a message of their own
+    uint64_t coalescedCount() const { return coalesced.load(std::memory_order_relaxed); }
+};
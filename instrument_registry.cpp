@@ -0,0 +1,126 @@
+#include "instrument_registry.h"
+#include "json_parser.h"
+
+const std::vector<std::string> InstrumentRegistry::KINDS = {"future", "option", "spot", "future_combo", "option_combo"};
+
+// Changes are kept on top of the shared table until they reach this fraction of it
+static constexpr size_t COMPACT_DIVISOR = 8;
+
+InstrumentRegistry::InstrumentRegistry(Table instruments)
+    : base(std::make_shared<const Table>(std::move(instruments))) {
+    count = base->size();
+}
+
+InstrumentRegistry::Table InstrumentRegistry::parseInstruments(const std::string& response) {
+    JsonParser parser;
+    return parseInstruments(parser.parse(response));
+}
+
+InstrumentRegistry::Table InstrumentRegistry::parseInstruments(const JsonValue& result) {
+    Table instruments;
+    for (const JsonValue& instrument : result.at("result").get<JsonArray>()) {
+        const JsonObject& fields = instrument.get<JsonObject>();
+        auto number = [&fields](const char* name) {
+            auto field = fields.find(name);
+            return field != fields.end() ? field->second.get<double>() : 0.0;
+        };
+        bool is_option = instrument.at("kind").get<std::string>() == "option";
+        bool expires = fields.count("expiration_timestamp") != 0;
+        Instrument& parsed = instruments[instrument.at("instrument_name").get<std::string>()];
+        parsed = Instrument(
+            instrument.at("base_currency").get<std::string>(),
+            instrument.at("quote_currency").get<std::string>(),
+            instrument.at("kind").get<std::string>(),
+            instrument.at("is_active").get<bool>(),
+            is_option ? instrument.at("strike").get<double>() : 0,
+            is_option ? instrument.at("option_type").get<std::string>() : "",
+            expires ? (long long)instrument.at("expiration_timestamp").get<double>() : 0,
+            number("tick_size"),
+            number("contract_size"),
+            number("min_trade_amount")
+        );
+        auto settlement = fields.find("settlement_currency");
+        if (settlement != fields.end()) parsed.settlement_currency = settlement->second.get<std::string>();
+    }
+    return instruments;
+}
+
+std::shared_ptr<const InstrumentRegistry> InstrumentRegistry::load(const Fetch& fetch) {
+    return load(FetchJson([&fetch](const std::string& url) {
+        JsonParser parser;
+        return parser.parse(fetch(url));
+    }));
+}
+
+std::shared_ptr<const InstrumentRegistry> InstrumentRegistry::load(const FetchJson& fetch) {
+    std::vector<std::string> currencies;
+    std::vector<std::string> index_price_names;
+
+    // Get all currencies
+    {
+        JsonValue result = fetch("https://test.deribit.com/api/v2/public/get_currencies");
+        for (const JsonValue& currency : result.at("result").get<JsonArray>()) {
+            currencies.push_back(currency.at("currency").get<std::string>());
+        }
+    }
+
+    // Get all index price names
+    {
+        JsonValue result = fetch("https://test.deribit.com/api/v2/public/get_index_price_names");
+        for (const JsonValue& index_price_name : result.at("result").get<JsonArray>()) {
+            index_price_names.push_back(index_price_name.get<std::string>());
+        }
+    }
+
+    // Get all instruments
+    Table instruments;
+    for (const std::string& kind : KINDS) {
+        std::string url = "https://test.deribit.com/api/v2/public/get_instruments?currency=any&kind=" + kind;
+        instruments.merge(parseInstruments(fetch(url)));
+    }
+
+    auto registry = std::make_shared<InstrumentRegistry>(std::move(instruments));
+    registry->currencies = std::move(currencies);
+    registry->index_price_names = std::move(index_price_names);
+    return registry;
+}
+
+std::shared_ptr<const InstrumentRegistry> InstrumentRegistry::apply(const Table& changed,
+    const std::vector<std::string>& gone, std::vector<std::string> currencies) const {
+    std::shared_ptr<InstrumentRegistry> next;
+    if ((overlay.size() + removed.size() + changed.size() + gone.size()) * COMPACT_DIVISOR > base->size()) {
+        Table flat = table();
+        for (const std::string& instrument_name : gone) {
+            flat.erase(instrument_name);
+        }
+        for (const auto& [instrument_name, instrument] : changed) {
+            flat[instrument_name] = instrument;
+        }
+        next = std::make_shared<InstrumentRegistry>(std::move(flat));
+    } else {
+        next = std::make_shared<InstrumentRegistry>(*this);
+        for (const std::string& instrument_name : gone) {
+            if (!next->find(instrument_name)) continue;
+            --next->count;
+            next->overlay.erase(instrument_name);
+            if (base->count(instrument_name)) next->removed.insert(instrument_name);
+        }
+        for (const auto& [instrument_name, instrument] : changed) {
+            if (!next->find(instrument_name)) ++next->count;
+            next->removed.erase(instrument_name);
+            next->overlay[instrument_name] = instrument;
+        }
+    }
+    next->currencies = std::move(currencies);
+    next->index_price_names = index_price_names;
+    return next;
+}
+
+InstrumentRegistry::Table InstrumentRegistry::table() const {
+    Table flat;
+    flat.reserve(count);
+    forEach([&flat](const std::string& instrument_name, const Instrument& instrument) {
+        flat.emplace(instrument_name, instrument);
+    });
+    return flat;
+}
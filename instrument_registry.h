@@ -0,0 +1,90 @@
+#pragma once
+
+#include "instruments.h"
+#include "json_parser.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// The exchange's instrument universe: currencies, index price names and instruments. A registry
+// is never modified once built, so every session on the same exchange shares one copy through a
+// shared_ptr and reads it without locks. Refreshes build a new version with apply(): it shares
+// the previous version's table and records only the changes on top, folding them into a new
+// table once they grow past a fraction of it.
+class InstrumentRegistry {
+public:
+    // GET a public API URL and return the response body, or the parsed body
+    using Fetch = std::function<std::string(const std::string& url)>;
+    using FetchJson = std::function<JsonValue(const std::string& url)>;
+    using Table = std::unordered_map<std::string, Instrument>;
+
+    static const std::vector<std::string> KINDS;
+
+    std::vector<std::string> currencies;
+    std::vector<std::string> index_price_names;
+
+    InstrumentRegistry() : base(std::make_shared<const Table>()) {}
+    explicit InstrumentRegistry(Table instruments);
+
+    // Fetches currencies, index price names and the instruments of every kind; throws if a
+    // response is not the JSON expected
+    static std::shared_ptr<const InstrumentRegistry> load(const FetchJson& fetch);
+    static std::shared_ptr<const InstrumentRegistry> load(const Fetch& fetch);
+
+    // The instruments of a get_instruments response
+    static Table parseInstruments(const JsonValue& result);
+    static Table parseInstruments(const std::string& response);
+
+    // A new version with `changed` instruments added or replaced and `removed` ones dropped
+    std::shared_ptr<const InstrumentRegistry> apply(const Table& changed, const std::vector<std::string>& removed,
+        std::vector<std::string> currencies) const;
+
+    const Instrument* find(const std::string& instrument_name) const {
+        if (!overlay.empty()) {
+            auto changed = overlay.find(instrument_name);
+            if (changed != overlay.end()) return &changed->second;
+        }
+        if (!removed.empty() && removed.count(instrument_name)) return nullptr;
+        auto instrument = base->find(instrument_name);
+        return instrument != base->end() ? &instrument->second : nullptr;
+    }
+    bool hasInstrument(const std::string& instrument_name) const {
+        return find(instrument_name) != nullptr;
+    }
+    bool hasCurrency(const std::string& currency) const {
+        return std::find(currencies.begin(), currencies.end(), currency) != currencies.end();
+    }
+    bool hasIndexPriceName(const std::string& index_price_name) const {
+        return std::find(index_price_names.begin(), index_price_names.end(), index_price_name) != index_price_names.end();
+    }
+    static bool isKind(const std::string& kind) {
+        return std::find(KINDS.begin(), KINDS.end(), kind) != KINDS.end();
+    }
+
+    size_t size() const { return count; }
+
+    // Every instrument, in no particular order
+    template<typename F>
+    void forEach(F&& f) const {
+        for (const auto& [instrument_name, instrument] : *base) {
+            if (!removed.count(instrument_name) && !overlay.count(instrument_name)) f(instrument_name, instrument);
+        }
+        for (const auto& [instrument_name, instrument] : overlay) {
+            f(instrument_name, instrument);
+        }
+    }
+
+    // A flat copy of the instrument table
+    Table table() const;
+
+private:
+    std::shared_ptr<const Table> base;
+    Table overlay;                          // added or replaced since base
+    std::unordered_set<std::string> removed; // in base, but no longer listed
+    size_t count = 0;
+};
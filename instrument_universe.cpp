@@ -0,0 +1,215 @@
+#include "instrument_universe.h"
+#include "json_parser.h"
+#include "logger.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+static long long nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// The text of the top-level "result" value. Responses also carry usIn/usOut/usDiff timings that
+// differ on every call, so only the payload says whether a partition changed. The whole response
+// if there is no result, e.g. an error, which then fails to parse below.
+static std::string_view resultPayload(std::string_view response) {
+    size_t key = response.find("\"result\":");
+    if (key == std::string_view::npos) return response;
+    size_t start = key + 9;
+    int depth = 0;
+    bool in_string = false;
+    for (size_t i = start; i < response.size(); ++i) {
+        char c = response[i];
+        if (in_string) {
+            if (c == '\\') ++i;
+            else if (c == '"') in_string = false;
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '[' || c == '{') {
+            ++depth;
+        } else if (c == ']' || c == '}') {
+            if (depth == 0) return response.substr(start, i - start);
+            if (--depth == 0) return response.substr(start, i + 1 - start);
+        } else if (c == ',' && depth == 0) {
+            return response.substr(start, i - start);
+        }
+    }
+    return response;
+}
+
+static bool expired(const Instrument& instrument, long long now_ms) {
+    return instrument.expiration_timestamp != 0 && instrument.expiration_timestamp <= now_ms;
+}
+
+InstrumentUniverse::InstrumentUniverse(std::shared_ptr<const InstrumentRegistry> initial, std::vector<std::string> kinds)
+    : cell(std::move(initial)), kinds(std::move(kinds)) {}
+
+InstrumentUniverse::~InstrumentUniverse() {
+    if (refresh_thread.joinable()) {
+        refresh_thread.request_stop();
+        refresh_thread.join();
+    }
+}
+
+void InstrumentUniverse::markChanged(const std::string& currency, const std::string& kind) {
+    {
+        std::lock_guard lock(dirty_mutex);
+        dirty.insert({currency, kind});
+    }
+    changed.notify_one();
+}
+
+RefreshStats InstrumentUniverse::refresh(const InstrumentRegistry::Fetch& fetch, bool full) {
+    std::lock_guard lock(refreshing);
+    std::shared_ptr<const InstrumentRegistry> current = cell.snapshot();
+    long long now_ms = nowMs();
+    RefreshStats stats;
+
+    std::set<Key> marked;
+    {
+        std::lock_guard dirty_lock(dirty_mutex);
+        marked.swap(dirty);
+    }
+    std::set<Key> wanted = marked;
+    // The first refresh also learns which partition every instrument belongs to
+    bool learning = partitions.empty();
+    full = full || learning;
+
+    std::vector<std::string> currencies = current->currencies;
+    if (full) {
+        JsonParser parser;
+        JsonValue result = parser.parse(fetch("https://test.deribit.com/api/v2/public/get_currencies"));
+        currencies.clear();
+        for (const JsonValue& currency : result.at("result").get<JsonArray>()) {
+            currencies.push_back(currency.at("currency").get<std::string>());
+        }
+        for (const std::string& currency : currencies) {
+            for (const std::string& kind : kinds) {
+                wanted.insert({currency, kind});
+            }
+        }
+    }
+
+    // Nothing below touches the universe's state until the new version is published, so a
+    // failed fetch leaves the partitions to be fetched again
+    InstrumentRegistry::Table changes;
+    std::unordered_set<std::string> gone;
+    std::vector<std::pair<Key, Partition>> fetched;
+    std::unordered_set<std::string> listed_anywhere;
+    try {
+        for (const Key& key : wanted) {
+            const auto& [currency, kind] = key;
+            std::string url = "https://test.deribit.com/api/v2/public/get_instruments?currency=" + currency + "&kind=" + kind;
+            std::string response = fetch(url);
+            ++stats.partitions_fetched;
+
+            Partition next;
+            next.hash = std::hash<std::string_view>{}(resultPayload(response));
+            auto previous = partitions.find(key);
+            if (previous != partitions.end() && previous->second.hash == next.hash) {
+                if (learning) listed_anywhere.insert(previous->second.names.begin(), previous->second.names.end());
+                continue;
+            }
+            ++stats.partitions_changed;
+
+            for (auto& [instrument_name, instrument] : InstrumentRegistry::parseInstruments(response)) {
+                if (expired(instrument, now_ms)) continue;
+                next.names.insert(instrument_name);
+                const Instrument* known = current->find(instrument_name);
+                if (!known) {
+                    ++stats.added;
+                    changes.emplace(instrument_name, std::move(instrument));
+                } else if (!(*known == instrument)) {
+                    ++stats.updated;
+                    changes.emplace(instrument_name, std::move(instrument));
+                }
+            }
+            if (previous != partitions.end()) {
+                for (const std::string& instrument_name : previous->second.names) {
+                    if (!next.names.count(instrument_name)) gone.insert(instrument_name);
+                }
+            }
+            if (learning) listed_anywhere.insert(next.names.begin(), next.names.end());
+            fetched.emplace_back(key, std::move(next));
+        }
+    } catch (...) {
+        std::lock_guard dirty_lock(dirty_mutex);
+        dirty.insert(marked.begin(), marked.end());
+        throw;
+    }
+
+    if (!indexed) {
+        current->forEach([this](const std::string& instrument_name, const Instrument& instrument) {
+            if (instrument.expiration_timestamp != 0) expiries.emplace(instrument.expiration_timestamp, instrument_name);
+        });
+        indexed = true;
+    }
+    if (learning) {
+        // Listed at load time but in none of the partitions: delisted since
+        std::unordered_set<std::string> refreshed_kinds(kinds.begin(), kinds.end());
+        current->forEach([&](const std::string& instrument_name, const Instrument& instrument) {
+            if (refreshed_kinds.count(instrument.kind) && !listed_anywhere.count(instrument_name)) gone.insert(instrument_name);
+        });
+    }
+    for (const auto& [instrument_name, instrument] : changes) {
+        if (instrument.expiration_timestamp != 0) expiries.emplace(instrument.expiration_timestamp, instrument_name);
+    }
+    while (!expiries.empty() && expiries.begin()->first <= now_ms) {
+        gone.insert(expiries.begin()->second);
+        expiries.erase(expiries.begin());
+    }
+    for (const std::string& instrument_name : gone) {
+        if (current->find(instrument_name) && !changes.count(instrument_name)) ++stats.removed;
+    }
+
+    for (auto& [key, partition] : fetched) {
+        partitions[key] = std::move(partition);
+    }
+    if (!changes.empty() || stats.removed != 0 || currencies != current->currencies) {
+        std::vector<std::string> removed(gone.begin(), gone.end());
+        cell.publish(current->apply(changes, removed, std::move(currencies)));
+        ++version;
+    }
+    cell.reclaim();
+    stats.version = version;
+    last = stats;
+    return stats;
+}
+
+void InstrumentUniverse::startRefresh(InstrumentRegistry::Fetch fetch, std::chrono::milliseconds full_interval) {
+    refresh_thread = std::jthread([this, fetch = std::move(fetch), full_interval](std::stop_token stop) {
+        runtime::unpin();
+        auto retry = std::min<std::chrono::milliseconds>(full_interval, std::chrono::seconds(1));
+        auto next_full = std::chrono::steady_clock::now();
+        while (!stop.stop_requested()) {
+            bool full = std::chrono::steady_clock::now() >= next_full;
+            bool failed = false;
+            try {
+                RefreshStats stats = refresh(fetch, full);
+                if (stats.added + stats.updated + stats.removed != 0) {
+                    logging::info("Instruments refreshed to version {}: {} added, {} updated, {} removed",
+                        stats.version, stats.added, stats.updated, stats.removed);
+                }
+            } catch (const std::exception& e) {
+                logging::error("Instrument refresh failed: {}", e.what());
+                failed = true;
+            }
+            if (full && !failed) next_full = std::chrono::steady_clock::now() + full_interval;
+
+            std::unique_lock lock(dirty_mutex);
+            if (failed) {
+                changed.wait_for(lock, stop, retry, [] { return false; });
+            } else {
+                changed.wait_until(lock, stop, next_full, [this] { return !dirty.empty(); });
+            }
+        }
+    });
+}
+
+RefreshStats InstrumentUniverse::lastRefresh() {
+    std::lock_guard lock(refreshing);
+    return last;
+}
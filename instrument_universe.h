@@ -0,0 +1,86 @@
+#pragma once
+
+#include "instrument_registry.h"
+#include "rcu.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// What one refresh() did
+struct RefreshStats {
+    uint64_t version = 0;           // of the registry current afterwards
+    size_t partitions_fetched = 0;
+    size_t partitions_changed = 0;  // responses that differed from the previous fetch
+    size_t added = 0;
+    size_t updated = 0;
+    size_t removed = 0;             // delisted or expired
+};
+
+// The current InstrumentRegistry of one exchange, shared by every session trading on it and kept
+// up to date while they run. Readers go through read(), an RCU read section: they never block
+// and never wait for a refresh, and the version they hold stays valid until the section ends.
+//
+// A refresh works per (currency, kind) partition of get_instruments. It fetches the partitions
+// marked changed (by instrument.state notifications, see markChanged), or all of them on a full
+// refresh, and parses and diffs only those whose response differs from the last one. Expired
+// instruments are dropped locally without a request. When anything changed, a new version
+// holding just the changes on top of the previous one is published with a pointer swap, and the
+// old one is freed once no reader can still see it.
+class InstrumentUniverse {
+private:
+    using Key = std::pair<std::string, std::string>;    // currency, kind
+
+    struct Partition {
+        size_t hash = 0;
+        std::unordered_set<std::string> names;
+    };
+
+    rcu::Cell<InstrumentRegistry> cell;
+
+    std::mutex refreshing;                              // one refresh at a time; guards what follows
+    std::vector<std::string> kinds;
+    std::map<Key, Partition> partitions;
+    std::multimap<long long, std::string> expiries;     // expiring instruments by expiration_timestamp
+    bool indexed = false;
+    uint64_t version = 0;
+    RefreshStats last;
+
+    std::mutex dirty_mutex;                             // guards dirty and wakes the refresh thread
+    std::condition_variable_any changed;
+    std::set<Key> dirty;
+    std::jthread refresh_thread;
+
+public:
+    // Refreshes cover `kinds`; spot pairs are rarely listed, so they are left out by default
+    explicit InstrumentUniverse(std::shared_ptr<const InstrumentRegistry> initial,
+        std::vector<std::string> kinds = {"future", "option", "future_combo", "option_combo"});
+    ~InstrumentUniverse();
+
+    InstrumentUniverse(const InstrumentUniverse&) = delete;
+    InstrumentUniverse& operator=(const InstrumentUniverse&) = delete;
+
+    // The current version, valid while the returned reader lives
+    rcu::Cell<InstrumentRegistry>::Reader read() const { return cell.read(); }
+    // The current version, kept alive for as long as the caller holds it
+    std::shared_ptr<const InstrumentRegistry> snapshot() const { return cell.snapshot(); }
+
+    // A listing of the partition changed; the next refresh fetches it
+    void markChanged(const std::string& currency, const std::string& kind);
+
+    // Bring the registry up to date: the marked partitions, or every partition when `full`.
+    // Throws if a response cannot be fetched or parsed; nothing is published then.
+    RefreshStats refresh(const InstrumentRegistry::Fetch& fetch, bool full);
+
+    // Refresh in the background: marked partitions as soon as they are marked, and every
+    // partition each `full_interval`. Errors are logged and retried at the next interval.
+    void startRefresh(InstrumentRegistry::Fetch fetch, std::chrono::milliseconds full_interval);
+
+    RefreshStats lastRefresh();
+};
@@ -1,23 +1,96 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
 #include <string>
 
+// A price or amount increment (tick size, lot) in integer form: step = units / scale, with scale
+// the smallest power of ten that makes the step whole. Values are counted in steps with integer
+// arithmetic, so checking or rounding an order costs a few nanoseconds and no float compares.
+struct Increment {
+    int64_t units = 0;      // 0: no increment known; every value is accepted
+    int64_t scale = 1;
+
+    Increment() = default;
+    explicit Increment(double step) {
+        if (!(step > 0)) return;
+        while (scale < 1000000000 && std::fabs(step * scale - std::round(step * scale)) > 1e-9 * scale) {
+            scale *= 10;
+        }
+        units = std::llround(step * scale);
+    }
+
+    bool known() const { return units != 0; }
+
+    // Steps in value, rounded down, up or to the nearest. Values are first taken to 1/scale
+    // units, absorbing floating point noise far below the step.
+    int64_t floorSteps(double value) const { return floorDiv(int64_t(std::floor(value * scale + 1e-6)), units); }
+    int64_t ceilSteps(double value) const { return -floorDiv(-int64_t(std::ceil(value * scale - 1e-6)), units); }
+    int64_t nearestSteps(double value) const { return floorDiv(std::llround(value * scale) + units / 2, units); }
+    bool isMultiple(double value) const {
+        return !known() || floorSteps(value) == ceilSteps(value);
+    }
+    double value(int64_t steps) const { return double(steps * units) / double(scale); }
+
+    bool operator==(const Increment&) const = default;
+
+private:
+    static int64_t floorDiv(int64_t a, int64_t b) { return a / b - (a % b != 0 && (a < 0) != (b < 0)); }
+};
+
 class Instrument {
     public:
     std::string base_currency;
     std::string quote_currency;
+    // What the instrument pays out in, and the currency orders are filed under on the exchange:
+    // USDC for linear instruments on BTC, the base currency for inverse ones
+    std::string settlement_currency;
     std::string kind;
     bool is_active;
+    // Options only: strike price and "call"/"put"
+    double strike;
+    std::string option_type;
+    // Milliseconds since epoch; 0 for instruments that do not expire
+    long long expiration_timestamp;
+    // Trading rules; 0 when unknown. Amounts go in steps of min_trade_amount, which is also the
+    // smallest order; contract_size converts contracts to amount.
+    double tick_size;
+    double contract_size;
+    double min_trade_amount;
+    Increment tick;
+    Increment lot;
 
     Instrument() {
         this->base_currency = "";
         this->quote_currency = "";
+        this->settlement_currency = "";
         this->kind = "";
         this->is_active = false;
+        this->strike = 0;
+        this->option_type = "";
+        this->expiration_timestamp = 0;
+        this->tick_size = 0;
+        this->contract_size = 0;
+        this->min_trade_amount = 0;
     }
 
-    Instrument(std::string base_currency, std::string quote_currency, std::string kind, bool is_active) {
+    Instrument(std::string base_currency, std::string quote_currency, std::string kind, bool is_active,
+        double strike = 0, std::string option_type = "", long long expiration_timestamp = 0,
+        double tick_size = 0, double contract_size = 0, double min_trade_amount = 0) {
         this->base_currency = base_currency;
         this->quote_currency = quote_currency;
+        this->settlement_currency = this->base_currency;
         this->kind = kind;
         this->is_active = is_active;
+        this->strike = strike;
+        this->option_type = option_type;
+        this->expiration_timestamp = expiration_timestamp;
+        this->tick_size = tick_size;
+        this->contract_size = contract_size;
+        this->min_trade_amount = min_trade_amount;
+        this->tick = Increment(tick_size);
+        this->lot = Increment(min_trade_amount);
     }
-};
\ No newline at end of file
+
+    bool operator==(const Instrument&) const = default;
+};
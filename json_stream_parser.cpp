@@ -0,0 +1,223 @@
+#include "json_stream_parser.h"
+
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+
+static bool isNumberChar(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+template<typename T>
+static JsonValue makeValue(T&& value) {
+    JsonValue result;
+    result.value.emplace<std::decay_t<T>>(std::forward<T>(value));
+    return result;
+}
+
+void JsonStreamParser::reset() {
+    state = State::Value;
+    stack.clear();
+    root = JsonValue();
+    token.clear();
+    in_key = false;
+    literal = nullptr;
+    matched = 0;
+}
+
+void JsonStreamParser::emit(JsonValue&& value) {
+    if (stack.empty()) {
+        root = std::move(value);
+        state = State::Done;
+        return;
+    }
+    Frame& top = stack.back();
+    if (top.is_object) {
+        std::get<JsonObject>(top.container.value).emplace(std::move(top.key), std::move(value));
+    } else {
+        std::get<JsonArray>(top.container.value).push_back(std::move(value));
+    }
+    state = State::Next;
+}
+
+void JsonStreamParser::close(bool is_object) {
+    if (stack.back().is_object != is_object) {
+        throw std::runtime_error(is_object ? "Expected ',' or ']'" : "Expected ',' or '}'");
+    }
+    JsonValue container = std::move(stack.back().container);
+    stack.pop_back();
+    emit(std::move(container));
+}
+
+void JsonStreamParser::finishNumber(std::string_view text) {
+    double number;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), number);
+    if (ec != std::errc() || ptr != text.data() + text.size()) {
+        throw std::runtime_error("Invalid number format");
+    }
+    emit(makeValue(number));
+}
+
+void JsonStreamParser::finishLiteral() {
+    switch (literal[0]) {
+        case 't': emit(makeValue(true)); break;
+        case 'f': emit(makeValue(false)); break;
+        default: emit(JsonValue(nullptr)); break;
+    }
+}
+
+// Starts the value at *p, finishing it in place if it ends within the chunk
+void JsonStreamParser::beginValue(const char*& p, const char* end) {
+    switch (*p) {
+        case '{':
+            ++p;
+            stack.push_back({makeValue(JsonObject()), std::string(), true});
+            state = State::FirstKey;
+            return;
+        case '[':
+            ++p;
+            stack.push_back({makeValue(JsonArray()), std::string(), false});
+            state = State::FirstValue;
+            return;
+        case '"':
+            ++p;
+            token.clear();
+            in_key = false;
+            state = State::String;
+            return;
+        case 't': literal = "true"; break;
+        case 'f': literal = "false"; break;
+        case 'n': literal = "null"; break;
+        case '-':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9': {
+            const char* q = p;
+            while (q < end && isNumberChar(*q)) ++q;
+            if (q < end) {
+                finishNumber(std::string_view(p, q - p));
+            } else {
+                token.assign(p, q);
+                state = State::Number;
+            }
+            p = q;
+            return;
+        }
+        default:
+            throw std::runtime_error("Unexpected character");
+    }
+    matched = 0;
+    state = State::Literal;
+}
+
+void JsonStreamParser::feed(std::string_view chunk) {
+    const char* p = chunk.data();
+    const char* end = p + chunk.size();
+    while (p < end) {
+        switch (state) {
+            case State::String: {
+                const char* q = p;
+                while (q < end && *q != '"' && *q != '\\') ++q;
+                token.append(p, q);
+                p = q;
+                if (p == end) break;
+                if (*p++ == '\\') {
+                    state = State::Escape;
+                } else if (in_key) {
+                    stack.back().key = std::move(token);
+                    token.clear();
+                    state = State::Colon;
+                } else {
+                    emit(makeValue(std::move(token)));
+                    token.clear();
+                }
+                break;
+            }
+            case State::Escape:
+                switch (*p++) {
+                    case '"': token += '"'; break;
+                    case '\\': token += '\\'; break;
+                    case '/': token += '/'; break;
+                    case 'b': token += '\b'; break;
+                    case 'f': token += '\f'; break;
+                    case 'n': token += '\n'; break;
+                    case 'r': token += '\r'; break;
+                    case 't': token += '\t'; break;
+                    default: throw std::runtime_error("Invalid escape sequence");
+                }
+                state = State::String;
+                break;
+            case State::Number: {
+                const char* q = p;
+                while (q < end && isNumberChar(*q)) ++q;
+                token.append(p, q);
+                p = q;
+                if (p < end) finishNumber(token);
+                break;
+            }
+            case State::Literal:
+                if (*p++ != literal[matched++]) throw std::runtime_error("Invalid literal");
+                if (literal[matched] == '\0') finishLiteral();
+                break;
+            default: {
+                char c = *p;
+                if (std::isspace(static_cast<unsigned char>(c))) {
+                    ++p;
+                    break;
+                }
+                switch (state) {
+                    case State::FirstValue:
+                        if (c == ']') {
+                            ++p;
+                            close(false);
+                            break;
+                        }
+                        [[fallthrough]];
+                    case State::Value:
+                        beginValue(p, end);
+                        break;
+                    case State::FirstKey:
+                        if (c == '}') {
+                            ++p;
+                            close(true);
+                            break;
+                        }
+                        [[fallthrough]];
+                    case State::Key:
+                        if (c != '"') throw std::runtime_error("Expected '\"'");
+                        ++p;
+                        token.clear();
+                        in_key = true;
+                        state = State::String;
+                        break;
+                    case State::Colon:
+                        if (c != ':') throw std::runtime_error("Expected ':'");
+                        ++p;
+                        state = State::Value;
+                        break;
+                    case State::Next:
+                        ++p;
+                        if (c == ',') {
+                            state = stack.back().is_object ? State::Key : State::Value;
+                        } else if (c == ']' || c == '}') {
+                            close(c == '}');
+                        } else {
+                            throw std::runtime_error(stack.back().is_object ? "Expected ',' or '}'" : "Expected ',' or ']'");
+                        }
+                        break;
+                    default:
+                        throw std::runtime_error("Unexpected trailing characters");
+                }
+            }
+        }
+    }
+}
+
+JsonValue JsonStreamParser::finish() {
+    if (state == State::Number && stack.empty()) finishNumber(token);
+    if (state != State::Done) {
+        throw std::runtime_error("Unexpected end of input");
+    }
+    JsonValue document = std::move(root);
+    reset();
+    return document;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Parses one JSON document fed in pieces as they arrive, e.g. from a curl write callback, so
+// parsing overlaps the transfer instead of starting after it. State is kept between feed()
+// calls: containers under construction on an explicit stack, and the partial token (string,
+// number or literal) a chunk ended in. Tokens that lie within one chunk are parsed in place.
+//
+//     parser.reset();
+//     while (more) parser.feed(chunk);
+//     JsonValue document = parser.finish();
+//
+// Builds the same JsonValue as JsonParser, and rejects the same malformed documents.
+class JsonStreamParser {
+private:
+    enum class State : uint8_t {
+        Value,          // a value
+        FirstValue,     // after '[': a value or ']'
+        FirstKey,       // after '{': a key or '}'
+        Key,            // after ',' in an object
+        Colon,
+        Next,           // after a value: ',' or the end of its container
+        String,
+        Escape,         // after '\' in a string
+        Number,
+        Literal,
+        Done,
+    };
+
+    struct Frame {
+        JsonValue container;
+        std::string key;            // objects: key of the value being parsed
+        bool is_object = false;
+    };
+
+    State state = State::Value;
+    std::vector<Frame> stack;
+    JsonValue root;
+    std::string token;              // partial string or number
+    bool in_key = false;            // the string being parsed is a key
+    const char* literal = nullptr;  // "true", "false" or "null" while matching one
+    size_t matched = 0;
+
+    void beginValue(const char*& p, const char* end);
+    void emit(JsonValue&& value);
+    void close(bool is_object);
+    void finishNumber(std::string_view text);
+    void finishLiteral();
+
+public:
+    // Discards any partial document; the stack and token buffer keep their capacity
+    void reset();
+    // Consumes the next piece of the document; throws std::runtime_error at the first invalid byte
+    void feed(std::string_view chunk);
+    // The document, once all of it has been fed; throws if it is incomplete
+    JsonValue finish();
+
+    bool done() const { return state == State::Done; }
+};
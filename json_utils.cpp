@@ -1,24 +1,58 @@
 #include "json_utils.h"
-#include <fstream>
-#include <sstream>
+#include "json_writer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <deque>
+#include <fcntl.h>
 #include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace json_utils {
 
-std::string readFile(const std::string& filepath) {
-    std::ifstream file(filepath, std::ios::in);
-    if (!file.is_open()) {
+MappedFile::MappedFile(const std::string& filepath) {
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
         throw FileError("Could not open file: " + filepath);
     }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw FileError("Could not stat file: " + filepath);
+    }
+    length = info.st_size;
+    if (length > 0) {
+        void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            throw FileError("Could not map file: " + filepath);
+        }
+        ::madvise(mapping, length, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    }
+    ::close(fd);
+}
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    
-    if (file.bad()) {
-        throw FileError("Error occurred while reading file: " + filepath);
+MappedFile::~MappedFile() {
+    if (data) {
+        ::munmap(const_cast<char*>(data), length);
     }
-    
-    return buffer.str();
+}
+
+void MappedFile::release(size_t offset, size_t bytes) const {
+    static const size_t page = ::sysconf(_SC_PAGESIZE);
+    size_t begin = offset / page * page;
+    size_t end = std::min(offset + bytes, length) / page * page;
+    if (data && begin < end) {
+        ::madvise(const_cast<char*>(data) + begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+std::string readFile(const std::string& filepath) {
+    MappedFile file(filepath);
+    return std::string(file.view());
 }
 
 void validateFile(const std::string& filepath) {
@@ -30,10 +64,6 @@ void validateFile(const std::string& filepath) {
     if (fileSize == 0) {
         throw FileError("File is empty: " + filepath);
     }
-
-    if (fileSize > Config::MAX_FILE_SIZE) {
-        throw FileError("File is too large (>100MB): " + filepath);
-    }
 }
 
 void printJson(const JsonValue& value, int indent) {
@@ -41,65 +71,58 @@ void printJson(const JsonValue& value, int indent) {
         throw PrintError("Maximum indent level exceeded");
     }
 
-    const std::string indentation(indent * 2, ' ');
-    
     try {
-        if (std::holds_alternative<nullptr_t>(value.value)) {
-            std::cout << "null";
-        }
-        else if (std::holds_alternative<bool>(value.value)) {
-            std::cout << (value.get<bool>() ? "true" : "false");
-        }
-        else if (std::holds_alternative<double>(value.value)) {
-            std::cout << value.get<double>();
-        }
-        else if (std::holds_alternative<std::string>(value.value)) {
-            std::cout << "\"" << value.get<std::string>() << "\"";
-        }
-        else if (std::holds_alternative<JsonArray>(value.value)) {
-            const auto& array = value.get<JsonArray>();
-            std::cout << "[\n";
-            
-            for (size_t i = 0; i < array.size(); ++i) {
-                std::cout << indentation << "  ";
-                printJson(array[i], indent + 1);
-                if (i < array.size() - 1) {
-                    std::cout << ",";
-                }
-                std::cout << "\n";
-            }
-            
-            std::cout << indentation << "]";
+        // Keys are sorted so the same response always prints the same way
+        JsonWriter writer(JsonWriter::Style::Pretty, true);
+        writer.value(value);
+        const std::string& text = writer.str();
+        if (indent == 0) {
+            std::cout.write(text.data(), text.size());
+            return;
         }
-        else if (std::holds_alternative<JsonObject>(value.value)) {
-            const auto& object = value.get<JsonObject>();
-            std::cout << "{\n";
-            
-            size_t i = 0;
-            for (const auto& [key, val] : object) {
-                std::cout << indentation << "  \"" << key << "\": ";
-                printJson(val, indent + 1);
-                if (i < object.size() - 1) {
-                    std::cout << ",";
-                }
-                std::cout << "\n";
-                ++i;
-            }
-            
-            std::cout << indentation << "}";
+        // Nested printing: continuation lines start at the caller's indentation
+        const std::string indentation(indent * 2, ' ');
+        size_t begin = 0;
+        for (size_t end = text.find('\n'); end != std::string::npos; end = text.find('\n', begin)) {
+            std::cout.write(text.data() + begin, end + 1 - begin);
+            std::cout << indentation;
+            begin = end + 1;
         }
+        std::cout.write(text.data() + begin, text.size() - begin);
     } catch (const std::exception& e) {
         throw PrintError(std::string("Error while printing JSON: ") + e.what());
     }
 }
 
+std::string toJson(const JsonValue& value, bool pretty) {
+    JsonWriter writer(pretty ? JsonWriter::Style::Pretty : JsonWriter::Style::Compact, pretty);
+    writer.value(value);
+    return writer.str();
+}
+
 void processJsonFile(const std::string& filepath) {
     try {
         validateFile(filepath);
-        std::string jsonContent = readFile(filepath);
-        
+        std::string extension = std::filesystem::path(filepath).extension().string();
+
+        if (extension == ".ndjson" || extension == ".jsonl") {
+            // Records stream to stdout as they are parsed, one compact line each
+            std::cout << "Content:\n" << std::flush;
+            size_t records;
+            {
+                JsonWriter out(STDOUT_FILENO);
+                records = processNdjsonFile(filepath, [&](const JsonValue& record) {
+                    out.value(record).newline();
+                });
+            }
+            std::cout << "\nSuccessfully parsed " << records << " records from: " << filepath << "\n";
+            return;
+        }
+
+        // The parser reads the mapping directly, without copying the file
+        MappedFile file(filepath);
         JsonParser parser;
-        JsonValue result = parser.parse(jsonContent);
+        JsonValue result = parser.parse(file.view());
 
         std::cout << "Successfully parsed JSON from: " << filepath << "\n\n";
         std::cout << "Content:\n";
@@ -110,4 +133,117 @@ void processJsonFile(const std::string& filepath) {
     }
 }
 
-} // namespace json_utils
\ No newline at end of file
+namespace {
+
+struct ChunkResult {
+    std::vector<JsonValue> records;     // kept for ordered delivery only
+    size_t parsed = 0;
+    size_t lines = 0;
+    size_t error_line = 0;              // 1-based within the chunk, 0 if every record parsed
+    std::string error;
+};
+
+ChunkResult parseChunk(std::string_view text, bool keep, const RecordCallback& onRecord) {
+    ChunkResult result;
+    JsonParser parser;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t newline = text.find('\n', pos);
+        size_t end = newline == std::string_view::npos ? text.size() : newline;
+        std::string_view line = text.substr(pos, end - pos);
+        pos = end + 1;
+        ++result.lines;
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) continue;
+
+        JsonValue record;
+        try {
+            record = parser.parse(line);
+        } catch (const std::exception& e) {
+            result.error_line = result.lines;
+            result.error = e.what();
+            break;
+        }
+        ++result.parsed;
+        if (keep) {
+            result.records.push_back(std::move(record));
+        } else {
+            onRecord(record);
+        }
+    }
+    return result;
+}
+
+// Splits `text` into chunks ending at line ends and parses them on a pool, with at most two
+// chunks per thread in flight. Chunks are retired in order: `retired` gets the end offset of
+// each one once its records were delivered.
+size_t processChunks(std::string_view text, const RecordCallback& onRecord, const NdjsonOptions& options,
+    const std::function<void(size_t end)>& retired) {
+    size_t chunk_bytes = std::max<size_t>(options.chunk_bytes, 1);
+    auto chunkEnd = [&](size_t begin) {
+        if (text.size() - begin <= chunk_bytes) return text.size();
+        size_t newline = text.find('\n', begin + chunk_bytes - 1);
+        return newline == std::string_view::npos ? text.size() : newline + 1;
+    };
+
+    size_t records = 0;
+    size_t line_base = 0;
+    auto retire = [&](ChunkResult& result, size_t end) {
+        for (const JsonValue& record : result.records) {
+            onRecord(record);
+        }
+        records += result.parsed;
+        if (result.error_line != 0) {
+            throw FileError("Line " + std::to_string(line_base + result.error_line) + ": " + result.error);
+        }
+        line_base += result.lines;
+        if (retired) retired(end);
+    };
+
+    size_t threads = std::max<size_t>(options.threads, 1);
+    if (threads == 1 || text.size() <= chunk_bytes) {
+        for (size_t begin = 0; begin < text.size();) {
+            size_t end = chunkEnd(begin);
+            ChunkResult result = parseChunk(text.substr(begin, end - begin), false, onRecord);
+            retire(result, end);
+            begin = end;
+        }
+        return records;
+    }
+
+    // Declared before the queue so unwinding waits for the chunks still running
+    ThreadPool pool(threads);
+    std::deque<std::pair<std::future<ChunkResult>, size_t>> in_flight;
+    size_t window = threads * 2;
+    size_t next = 0;
+    while (next < text.size() || !in_flight.empty()) {
+        while (next < text.size() && in_flight.size() < window) {
+            size_t end = chunkEnd(next);
+            std::string_view chunk = text.substr(next, end - next);
+            bool keep = options.ordered;
+            in_flight.emplace_back(pool.submit([chunk, keep, &onRecord] { return parseChunk(chunk, keep, onRecord); }), end);
+            next = end;
+        }
+        ChunkResult result = in_flight.front().first.get();
+        size_t end = in_flight.front().second;
+        in_flight.pop_front();
+        retire(result, end);
+    }
+    return records;
+}
+
+} // namespace
+
+size_t processNdjson(std::string_view text, const RecordCallback& onRecord, const NdjsonOptions& options) {
+    return processChunks(text, onRecord, options, nullptr);
+}
+
+size_t processNdjsonFile(const std::string& filepath, const RecordCallback& onRecord, const NdjsonOptions& options) {
+    MappedFile file(filepath);
+    size_t released = 0;
+    return processChunks(file.view(), onRecord, options, [&](size_t end) {
+        file.release(released, end - released);
+        released = end;
+    });
+}
+
+} // namespace json_utils
@@ -1,22 +1,68 @@
 #pragma once
 
 #include "json_parser.h"
+#include <functional>
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <thread>
 
 namespace json_utils {
 
+// Read-only mmap of a whole file. The mapping is only paged in as it is read, so files larger
+// than memory can be walked front to back.
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const std::string& filepath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const { return std::string_view(data, length); }
+    size_t size() const { return length; }
+
+    // Drop the pages of [offset, offset + bytes), but not a partial last page, from this
+    // process's resident memory; they are read back from the page cache if touched again
+    void release(size_t offset, size_t bytes) const;
+};
+
 // File operations
 std::string readFile(const std::string& filepath);
 void validateFile(const std::string& filepath);
 
 // JSON operations
 void printJson(const JsonValue& value, int indent = 0);
+// Compact, or pretty with sorted keys; use a JsonWriter directly to reuse the buffer
+std::string toJson(const JsonValue& value, bool pretty = false);
+// Parses a JSON document, or an NDJSON file (.ndjson, .jsonl) record by record, and prints it
 void processJsonFile(const std::string& filepath);
 
+// Newline-delimited JSON: one document per line, blank lines skipped
+struct NdjsonOptions {
+    size_t chunk_bytes = 1 << 20;   // records are split into chunks of about this size at line ends
+    size_t threads = std::thread::hardware_concurrency();
+    // true: records reach the callback in file order on the calling thread.
+    // false: each worker calls it as soon as a record parses, so it must be thread-safe.
+    bool ordered = true;
+};
+
+using RecordCallback = std::function<void(const JsonValue& record)>;
+
+// Parse every record in `text`, in parallel chunks with at most a few per thread in flight, so
+// memory stays bounded whatever the input size. Returns the number of records; throws FileError
+// naming the line of the first malformed record, after the records before it were delivered
+// (ordered) or after the chunks in flight finished (unordered).
+size_t processNdjson(std::string_view text, const RecordCallback& onRecord, const NdjsonOptions& options = {});
+// The same over a mapped file, releasing each chunk's pages once its records were delivered
+size_t processNdjsonFile(const std::string& filepath, const RecordCallback& onRecord, const NdjsonOptions& options = {});
+
 // Configuration
 struct Config {
-    static constexpr size_t MAX_FILE_SIZE = 100 * 1024 * 1024; // 100MB
     static constexpr int MAX_INDENT = 100; // Maximum indent level
 };
 
@@ -31,4 +77,4 @@ public:
     explicit PrintError(const std::string& msg) : std::runtime_error(msg) {}
 };
 
-} // namespace json_utils
\ No newline at end of file
+} // namespace json_utils
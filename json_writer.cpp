@@ -0,0 +1,228 @@
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <unistd.h>
+
+JsonWriter::JsonWriter(Style style, bool sort_keys) : style(style), sort_keys(sort_keys) {}
+
+JsonWriter::JsonWriter(int fd, Style style, bool sort_keys) : style(style), sort_keys(sort_keys), fd(fd) {
+    buffer.reserve(flush_threshold);
+}
+
+JsonWriter::~JsonWriter() {
+    if (fd >= 0) flush(fd);
+}
+
+void JsonWriter::indent() {
+    buffer.push_back('\n');
+    buffer.append(open.size() * 2, ' ');
+}
+
+// Emits what goes before a value: nothing after a key or at the top level, else a comma for
+// every element but the first and, when pretty, a line break and indentation
+void JsonWriter::separate() {
+    if (after_key) {
+        after_key = false;
+        return;
+    }
+    if (open.empty()) return;
+    if (open.back()) buffer.push_back(',');
+    open.back() = true;
+    if (style == Style::Pretty) indent();
+}
+
+void JsonWriter::writeString(std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    buffer.push_back('"');
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        // Copy the plain run before the character in one append
+        buffer.append(text.data() + run, i - run);
+        run = i + 1;
+        buffer.push_back('\\');
+        switch (c) {
+            case '"': buffer.push_back('"'); break;
+            case '\\': buffer.push_back('\\'); break;
+            case '\n': buffer.push_back('n'); break;
+            case '\r': buffer.push_back('r'); break;
+            case '\t': buffer.push_back('t'); break;
+            case '\b': buffer.push_back('b'); break;
+            case '\f': buffer.push_back('f'); break;
+            default:
+                buffer += "u00";
+                buffer.push_back(hex[c >> 4]);
+                buffer.push_back(hex[c & 0xf]);
+        }
+    }
+    buffer.append(text.data() + run, text.size() - run);
+    buffer.push_back('"');
+}
+
+void JsonWriter::writeNumber(double number) {
+    if (!std::isfinite(number)) {
+        buffer += "null";
+        return;
+    }
+    // Shortest representation that round-trips, e.g. 0.1 rather than 0.10000000000000001
+    char text[32];
+    auto [end, error] = std::to_chars(text, text + sizeof(text), number);
+    buffer.append(text, end - text);
+}
+
+void JsonWriter::writeValue(const JsonValue& value) {
+    if (std::holds_alternative<std::nullptr_t>(value.value)) {
+        null();
+    } else if (std::holds_alternative<bool>(value.value)) {
+        this->value(value.get<bool>());
+    } else if (std::holds_alternative<double>(value.value)) {
+        this->value(value.get<double>());
+    } else if (std::holds_alternative<std::string>(value.value)) {
+        this->value(std::string_view(value.get<std::string>()));
+    } else if (std::holds_alternative<JsonArray>(value.value)) {
+        beginArray();
+        for (const JsonValue& element : value.get<JsonArray>()) {
+            writeValue(element);
+        }
+        endArray();
+    } else {
+        const JsonObject& object = value.get<JsonObject>();
+        beginObject();
+        if (sort_keys) {
+            std::vector<const JsonObject::value_type*> fields;
+            fields.reserve(object.size());
+            for (const auto& field : object) {
+                fields.push_back(&field);
+            }
+            std::sort(fields.begin(), fields.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+            for (const auto* field : fields) {
+                key(field->first);
+                writeValue(field->second);
+            }
+        } else {
+            for (const auto& [name, element] : object) {
+                key(name);
+                writeValue(element);
+            }
+        }
+        endObject();
+    }
+}
+
+JsonWriter& JsonWriter::value(const JsonValue& value) {
+    writeValue(value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(double number) {
+    separate();
+    writeNumber(number);
+    maybeFlush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::integer(int64_t number) {
+    separate();
+    char text[24];
+    auto [end, error] = std::to_chars(text, text + sizeof(text), number);
+    buffer.append(text, end - text);
+    maybeFlush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(std::string_view text) {
+    separate();
+    writeString(text);
+    maybeFlush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+    separate();
+    buffer += flag ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    separate();
+    buffer += "null";
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    separate();
+    if (open.size() >= MAX_DEPTH) {
+        throw std::runtime_error("Maximum nesting depth exceeded");
+    }
+    buffer.push_back('{');
+    open.push_back(false);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    bool empty = !open.back();
+    open.pop_back();
+    if (style == Style::Pretty && !empty) indent();
+    buffer.push_back('}');
+    maybeFlush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    separate();
+    if (open.size() >= MAX_DEPTH) {
+        throw std::runtime_error("Maximum nesting depth exceeded");
+    }
+    buffer.push_back('[');
+    open.push_back(false);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    bool empty = !open.back();
+    open.pop_back();
+    if (style == Style::Pretty && !empty) indent();
+    buffer.push_back(']');
+    maybeFlush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name) {
+    separate();
+    writeString(name);
+    buffer += style == Style::Pretty ? ": " : ":";
+    after_key = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::newline() {
+    buffer.push_back('\n');
+    maybeFlush();
+    return *this;
+}
+
+void JsonWriter::clear() {
+    buffer.clear();
+    open.clear();
+    after_key = false;
+}
+
+bool JsonWriter::flush(int fd) {
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t n = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            failed = true;
+            break;
+        }
+        written += n;
+    }
+    buffer.clear();
+    return !failed;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Serializes JSON into a reusable buffer. Numbers use the shortest text that parses back to the
+// same double, strings are escaped per RFC 8259, and non-finite numbers are written as null.
+//
+// Whole values go through value(const JsonValue&); bodies can also be built directly with
+// beginObject/key/value/endObject without creating a JsonValue first:
+//
+//     writer.clear();
+//     writer.beginObject().key("amount").value(10).key("instrument_name").value(name).endObject();
+//     client.post(url, writer.str());
+//
+// A writer constructed with a file descriptor streams to it: the buffer is written out whenever
+// it passes flushThreshold() bytes and when the writer is destroyed.
+class JsonWriter {
+public:
+    enum class Style { Compact, Pretty };
+
+    static constexpr int MAX_DEPTH = 100;
+
+private:
+    std::string buffer;
+    Style style;
+    bool sort_keys;
+    int fd = -1;
+    size_t flush_threshold = 64 * 1024;
+    bool failed = false;
+
+    // One entry per open container: whether it already holds an element
+    std::vector<bool> open;
+    bool after_key = false;
+
+    void separate();
+    void indent();
+    void writeString(std::string_view text);
+    void writeNumber(double number);
+    void writeValue(const JsonValue& value);
+    void maybeFlush() {
+        if (fd >= 0 && buffer.size() >= flush_threshold) flush(fd);
+    }
+
+public:
+    // Sorting keys makes the output for equal objects identical; unordered_map order is not
+    explicit JsonWriter(Style style = Style::Compact, bool sort_keys = false);
+    explicit JsonWriter(int fd, Style style = Style::Compact, bool sort_keys = false);
+    ~JsonWriter();
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& value(const JsonValue& value);
+    JsonWriter& value(double number);
+    JsonWriter& value(std::string_view text);
+    JsonWriter& value(const char* text) { return value(std::string_view(text)); }
+    JsonWriter& value(const std::string& text) { return value(std::string_view(text)); }
+    JsonWriter& value(bool flag);
+    JsonWriter& null();
+    template<std::integral T>
+        requires (!std::same_as<T, bool>)
+    JsonWriter& value(T number) { return integer(static_cast<int64_t>(number)); }
+    JsonWriter& integer(int64_t number);
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    JsonWriter& key(std::string_view name);
+
+    // Ends a top-level value, as in newline-delimited JSON logs
+    JsonWriter& newline();
+
+    const std::string& str() const { return buffer; }
+    size_t size() const { return buffer.size(); }
+    // Drops the output but keeps the allocated buffer
+    void clear();
+
+    // Writes the buffer to `fd` and empties it; false (and hasFailed() from then on) on a write error
+    bool flush(int fd);
+    bool hasFailed() const { return failed; }
+    size_t flushThreshold() const { return flush_threshold; }
+    void setFlushThreshold(size_t bytes) { flush_threshold = bytes; }
+};
@@ -0,0 +1,350 @@
+#include "logger.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <ctime>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace logging {
+
+std::atomic<Level> detail::min_level{Level::Info};
+
+namespace {
+
+using detail::Record;
+using detail::Tag;
+
+// Single-producer, single-consumer ring owned by one thread and drained by the writer
+struct Ring {
+    static constexpr size_t CAPACITY = 1024;   // records; a power of two
+
+    alignas(64) std::atomic<uint64_t> tail{0};  // next record the owner writes
+    uint64_t cached_head = 0;                   // owner's last view of head
+    uint64_t nudged_at = ~0ull;                 // head when the owner last woke the writer
+    alignas(64) std::atomic<uint64_t> head{0};  // next record the writer reads
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> closed{false};            // owning thread has exited
+    std::unique_ptr<Record[]> records{new Record[CAPACITY]};
+};
+
+void appendArgument(const Record& record, size_t& offset, std::string& out) {
+    Tag tag = Tag(record.payload[offset++]);
+    char text[32];
+    char* end = text;
+    switch (tag) {
+        case Tag::Signed: {
+            int64_t number;
+            std::memcpy(&number, record.payload + offset, 8);
+            end = std::to_chars(text, text + sizeof(text), number).ptr;
+            offset += 8;
+            break;
+        }
+        case Tag::Unsigned: {
+            uint64_t number;
+            std::memcpy(&number, record.payload + offset, 8);
+            end = std::to_chars(text, text + sizeof(text), number).ptr;
+            offset += 8;
+            break;
+        }
+        case Tag::Double: {
+            double number;
+            std::memcpy(&number, record.payload + offset, 8);
+            end = std::to_chars(text, text + sizeof(text), number).ptr;
+            offset += 8;
+            break;
+        }
+        case Tag::Bool:
+            out += record.payload[offset++] ? "true" : "false";
+            return;
+        case Tag::Char:
+            out.push_back(record.payload[offset++]);
+            return;
+        case Tag::Text: {
+            uint16_t length;
+            std::memcpy(&length, record.payload + offset, 2);
+            out.append(record.payload + offset + 2, length);
+            offset += 2 + length;
+            return;
+        }
+    }
+    out.append(text, end - text);
+}
+
+class Writer {
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable written;
+    std::vector<std::shared_ptr<Ring>> rings;
+    uint64_t flush_requested = 0;
+    uint64_t flush_done = 0;
+    int fd = STDOUT_FILENO;
+    bool owns_fd = false;
+    pthread_t thread;
+    uint64_t dropped_by_exited = 0;     // by threads whose rings are gone
+
+    // Writer thread state
+    std::vector<Record> batch;
+    std::string buffer;
+    uint64_t dropped_reported = 0;
+    time_t cached_second = -1;
+    char cached_time[32];
+
+    void appendTime(uint64_t timestamp) {
+        time_t second = timestamp / 1000000000;
+        if (second != cached_second) {
+            struct tm parts;
+            ::localtime_r(&second, &parts);
+            std::strftime(cached_time, sizeof(cached_time), "%Y-%m-%d %H:%M:%S", &parts);
+            cached_second = second;
+        }
+        char micros[8];
+        std::snprintf(micros, sizeof(micros), ".%06u", unsigned(timestamp % 1000000000 / 1000));
+        buffer += cached_time;
+        buffer += micros;
+    }
+
+    void format(const Record& record) {
+        static const char* names[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+        appendTime(record.timestamp);
+        buffer.push_back(' ');
+        buffer += names[size_t(record.level)];
+        buffer.push_back(' ');
+        detail::appendMessage(record, buffer);
+        buffer.push_back('\n');
+    }
+
+    void write(int out) {
+        size_t written_bytes = 0;
+        while (written_bytes < buffer.size()) {
+            ssize_t n = ::write(out, buffer.data() + written_bytes, buffer.size() - written_bytes);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;      // nowhere to report it; the batch is lost
+            written_bytes += n;
+        }
+        buffer.clear();
+    }
+
+    // Moves everything published so far out of the rings and writes it, oldest first
+    void drain() {
+        std::vector<std::shared_ptr<Ring>> current;
+        int out;
+        uint64_t dropped_total;
+        {
+            std::lock_guard lock(mutex);
+            current = rings;
+            out = fd;
+            dropped_total = dropped_by_exited;
+        }
+
+        batch.clear();
+        for (const std::shared_ptr<Ring>& ring : current) {
+            uint64_t head = ring->head.load(std::memory_order_relaxed);
+            uint64_t tail = ring->tail.load(std::memory_order_acquire);
+            for (; head < tail; ++head) {
+                batch.push_back(ring->records[head & (Ring::CAPACITY - 1)]);
+            }
+            ring->head.store(head, std::memory_order_release);
+            dropped_total += ring->dropped.load(std::memory_order_relaxed);
+        }
+        std::stable_sort(batch.begin(), batch.end(), [](const Record& a, const Record& b) {
+            return a.timestamp < b.timestamp;
+        });
+        for (const Record& record : batch) {
+            format(record);
+        }
+        if (dropped_total > dropped_reported) {
+            buffer += "Logger dropped " + std::to_string(dropped_total - dropped_reported) + " messages\n";
+            dropped_reported = dropped_total;
+        }
+        if (!buffer.empty()) write(out);
+
+        // Forget threads that have exited once their last records are out
+        std::lock_guard lock(mutex);
+        std::erase_if(rings, [this](const std::shared_ptr<Ring>& ring) {
+            bool done = ring->closed.load(std::memory_order_acquire) &&
+                ring->head.load(std::memory_order_relaxed) == ring->tail.load(std::memory_order_acquire);
+            if (done) dropped_by_exited += ring->dropped.load(std::memory_order_relaxed);
+            return done;
+        });
+    }
+
+    void run() {
+        std::unique_lock lock(mutex);
+        while (true) {
+            if (flush_requested == flush_done) {
+                wake.wait_for(lock, std::chrono::milliseconds(2));
+            }
+            uint64_t requested = flush_requested;
+            lock.unlock();
+            drain();
+            lock.lock();
+            if (requested > flush_done) {
+                flush_done = requested;
+                written.notify_all();
+            }
+        }
+    }
+
+public:
+    Writer() {
+        batch.reserve(Ring::CAPACITY);
+        // Never joined: the writer lives for the whole process, and flush() runs at exit
+        std::thread worker([this] { run(); });
+        thread = worker.native_handle();
+        worker.detach();
+        std::atexit([] { logging::flush(); });
+    }
+
+    // A ring is half full: drain now rather than at the next tick. Without the lock the wakeup
+    // can be missed, which only delays the drain to the tick.
+    void nudge() {
+        wake.notify_one();
+    }
+
+    bool pin(int cpu) {
+        return runtime::pinThread(thread, cpu);
+    }
+
+    void add(std::shared_ptr<Ring> ring) {
+        std::lock_guard lock(mutex);
+        rings.push_back(std::move(ring));
+    }
+
+    void flush() {
+        std::unique_lock lock(mutex);
+        uint64_t ticket = ++flush_requested;
+        wake.notify_one();
+        written.wait(lock, [&] { return flush_done >= ticket; });
+    }
+
+    void setOutput(int out, bool owned) {
+        int previous;
+        bool previous_owned;
+        {
+            std::lock_guard lock(mutex);
+            previous = fd;
+            previous_owned = owns_fd;
+            fd = out;
+            owns_fd = owned;
+        }
+        // A batch already written to the old descriptor is complete once a drain has passed
+        flush();
+        if (previous_owned) ::close(previous);
+    }
+
+    uint64_t dropped() {
+        std::lock_guard lock(mutex);
+        uint64_t total = dropped_by_exited;
+        for (const std::shared_ptr<Ring>& ring : rings) {
+            total += ring->dropped.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+};
+
+// Intentionally leaked so that logging from static destructors stays safe
+Writer& writer() {
+    static Writer* instance = new Writer();
+    return *instance;
+}
+
+// Registers the thread's ring on its first message and marks it closed when the thread exits
+struct ThreadRing {
+    std::shared_ptr<Ring> ring;
+
+    ThreadRing() : ring(std::make_shared<Ring>()) {
+        writer().add(ring);
+    }
+    ~ThreadRing() {
+        ring->closed.store(true, std::memory_order_release);
+    }
+};
+
+Ring& threadRing() {
+    thread_local ThreadRing local;
+    return *local.ring;
+}
+
+} // namespace
+
+void detail::appendMessage(const Record& record, std::string& out) {
+    size_t offset = 0;
+    uint8_t remaining = record.args;
+    for (const char* c = record.format; *c; ++c) {
+        if (c[0] == '{' && c[1] == '}' && remaining > 0) {
+            appendArgument(record, offset, out);
+            --remaining;
+            ++c;
+        } else {
+            out.push_back(*c);
+        }
+    }
+}
+
+Record* detail::claim() {
+    Ring& ring = threadRing();
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.cached_head == Ring::CAPACITY) {
+        ring.cached_head = ring.head.load(std::memory_order_acquire);
+        if (tail - ring.cached_head == Ring::CAPACITY) {
+            // Only the owner writes the count, so no read-modify-write is needed
+            ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+    }
+    return &ring.records[tail & (Ring::CAPACITY - 1)];
+}
+
+void detail::commit() {
+    Ring& ring = threadRing();
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed) + 1;
+    ring.tail.store(tail, std::memory_order_release);
+    if (tail - ring.cached_head >= Ring::CAPACITY / 2) {
+        // Once per half ring: see how far the writer got, and wake it if it is still behind
+        ring.cached_head = ring.head.load(std::memory_order_acquire);
+        if (tail - ring.cached_head >= Ring::CAPACITY / 2 && ring.nudged_at != ring.cached_head) {
+            ring.nudged_at = ring.cached_head;
+            writer().nudge();
+        }
+    }
+}
+
+void setLevel(Level level) {
+    detail::min_level.store(level, std::memory_order_relaxed);
+}
+
+void setOutput(int fd) {
+    writer().setOutput(fd, false);
+}
+
+bool openFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return false;
+    writer().setOutput(fd, true);
+    return true;
+}
+
+void flush() {
+    writer().flush();
+}
+
+bool pinWriter(int cpu) {
+    return writer().pin(cpu);
+}
+
+uint64_t dropped() {
+    return writer().dropped();
+}
+
+} // namespace logging
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous logging. A log call copies its arguments in binary form into a lock-free ring
+// owned by the calling thread; a background thread drains every ring, formats the messages and
+// writes them out in batches. Callers never format, lock, flush or wait for the disk: when a ring
+// is full the message is dropped and counted.
+//
+//     logging::warn("Instrument not found: {}", instrument_name);
+//
+// The format must be a string literal: only its address is stored. Each `{}` takes the next
+// argument; integers, floating point, bool, characters and strings are supported, and strings
+// are copied, truncated if the message outgrows one record.
+namespace logging {
+
+enum class Level : uint8_t { Debug, Info, Warning, Error };
+
+namespace detail {
+
+enum class Tag : uint8_t { Signed, Unsigned, Double, Bool, Char, Text };
+
+struct Record {
+    static constexpr size_t BYTES = 256;
+
+    uint64_t timestamp;         // ns since the epoch
+    const char* format;
+    Level level;
+    uint8_t args;
+    uint16_t size;              // payload bytes used
+    char payload[BYTES - sizeof(uint64_t) - sizeof(const char*) - 4];
+};
+static_assert(sizeof(Record) == Record::BYTES);
+
+extern std::atomic<Level> min_level;
+
+// A free slot in the calling thread's ring, or nullptr (and one more drop) if it is full
+Record* claim();
+// Publish the slot returned by the last claim()
+void commit();
+// The record's format with its arguments substituted
+void appendMessage(const Record& record, std::string& out);
+
+inline void put(Record& record, Tag tag, const void* value, size_t bytes) {
+    if (record.size + 1 + bytes > sizeof(record.payload)) return;
+    record.payload[record.size] = char(tag);
+    std::memcpy(record.payload + record.size + 1, value, bytes);
+    record.size += 1 + bytes;
+    ++record.args;
+}
+
+inline void putText(Record& record, std::string_view text) {
+    size_t room = sizeof(record.payload) - record.size;
+    if (room < 3) return;
+    uint16_t length = uint16_t(std::min(text.size(), room - 3));
+    record.payload[record.size] = char(Tag::Text);
+    std::memcpy(record.payload + record.size + 1, &length, 2);
+    std::memcpy(record.payload + record.size + 3, text.data(), length);
+    record.size += 3 + length;
+    ++record.args;
+}
+
+template<typename T>
+void encode(Record& record, const T& value) {
+    if constexpr (std::same_as<T, bool>) {
+        put(record, Tag::Bool, &value, 1);
+    } else if constexpr (std::same_as<T, char>) {
+        put(record, Tag::Char, &value, 1);
+    } else if constexpr (std::signed_integral<T>) {
+        int64_t number = value;
+        put(record, Tag::Signed, &number, sizeof(number));
+    } else if constexpr (std::unsigned_integral<T>) {
+        uint64_t number = value;
+        put(record, Tag::Unsigned, &number, sizeof(number));
+    } else if constexpr (std::floating_point<T>) {
+        double number = value;
+        put(record, Tag::Double, &number, sizeof(number));
+    } else if constexpr (std::is_enum_v<T>) {
+        encode(record, static_cast<std::underlying_type_t<T>>(value));
+    } else {
+        putText(record, std::string_view(value));
+    }
+}
+
+} // namespace detail
+
+template<typename... Args>
+void log(Level level, const char* format, const Args&... args) {
+    if (level < detail::min_level.load(std::memory_order_relaxed)) return;
+    detail::Record* record = detail::claim();
+    if (!record) return;
+    record->timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record->format = format;
+    record->level = level;
+    record->args = 0;
+    record->size = 0;
+    (detail::encode(*record, args), ...);
+    detail::commit();
+}
+
+// Formats on the calling thread, for messages that are needed as text (e.g. error results)
+template<typename... Args>
+std::string format(const char* format, const Args&... args) {
+    detail::Record record;
+    record.format = format;
+    record.args = 0;
+    record.size = 0;
+    (detail::encode(record, args), ...);
+    std::string out;
+    detail::appendMessage(record, out);
+    return out;
+}
+
+template<typename... Args>
+void debug(const char* format, const Args&... args) { log(Level::Debug, format, args...); }
+template<typename... Args>
+void info(const char* format, const Args&... args) { log(Level::Info, format, args...); }
+template<typename... Args>
+void warn(const char* format, const Args&... args) { log(Level::Warning, format, args...); }
+template<typename... Args>
+void error(const char* format, const Args&... args) { log(Level::Error, format, args...); }
+
+// Messages below `level` are discarded before anything is copied; Info by default
+void setLevel(Level level);
+// Where the writer goes; stdout by default. openFile appends and returns false if it cannot open.
+void setOutput(int fd);
+bool openFile(const std::string& path);
+// Block until everything logged so far has been written. For interactive use and shutdown only;
+// it also runs at exit.
+void flush();
+// Pin the background writer to a core, so formatting and write() stay off the trading cores
+bool pinWriter(int cpu);
+// Messages dropped because a thread's ring was full
+uint64_t dropped();
+
+} // namespace logging
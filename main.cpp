@@ -1,9 +1,16 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <sstream>
+#include <string_view>
 #include <map>
+#include <unistd.h>
+#include "batch_runner.h"
 #include "trading_system.h"
 #include "json_utils.h"
+#include "logger.h"
+#include "runtime.h"
 
 class TradingCLI {
 private:
@@ -14,6 +21,9 @@ private:
     }
 
     void waitForEnter(bool check = true) {
+        // Show what was logged during the operation before prompting
+        std::cout.flush();
+        logging::flush();
         std::cout << "\nPress Enter to continue...";
         if(check) std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
         std::cin.get();
@@ -50,7 +60,7 @@ private:
                 json_utils::printJson(result);
             }
         } catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
+            logging::error("Order book request failed: {}", e.what());
         }
         waitForEnter();
     }
@@ -117,7 +127,7 @@ private:
                         else if (key == "mmp") params.mmp = int_value;
                         else if (key == "valid_until") params.valid_until = int_value;
                     } catch (const std::exception& e) {
-                        std::cout << "Warning: Invalid value for " << key << std::endl;
+                        logging::warn("Invalid value for {}", key);
                     }
                 }
             }
@@ -202,7 +212,7 @@ private:
                 json_utils::printJson(result);
             }
         } catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
+            logging::error("Order placement failed: {}", e.what());
         }
         waitForEnter(0);
     }
@@ -263,7 +273,7 @@ private:
                 json_utils::printJson(result);
             }
         } catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
+            logging::error("Cancel failed: {}", e.what());
         }
         waitForEnter();
     }
@@ -330,7 +340,7 @@ private:
                 json_utils::printJson(result);
             }
         } catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
+            logging::error("Edit failed: {}", e.what());
         }
         waitForEnter(0);
     }
@@ -385,7 +395,7 @@ private:
                 json_utils::printJson(result);
             }
         } catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
+            logging::error("Open orders request failed: {}", e.what());
         }
         waitForEnter();
     }
@@ -421,12 +431,32 @@ private:
                 json_utils::printJson(result);
             }
         } catch (const std::exception& e) {
-            std::cout << "Error: " << e.what() << std::endl;
+            logging::error("Order state request failed: {}", e.what());
         }
         waitForEnter();
     }
 
 public:
+    // Runs the commands in `path` ("-" for stdin) without prompting and writes the results as
+    // JSON lines to stdout; main() has sent the log to stderr so the output stays parseable.
+    // Exit status 1 if any command failed.
+    int runBatch(const std::string& path, size_t concurrency) {
+        std::ifstream file;
+        if (path != "-") {
+            file.open(path);
+            if (!file) {
+                logging::error("Cannot open batch file {}", path);
+                return 1;
+            }
+        }
+        EventLoop loop;
+        BatchRunner runner(trading, loop, concurrency);
+        BatchRunner::Summary summary = runner.run(path == "-" ? std::cin : file, STDOUT_FILENO);
+        logging::info("Batch: {} operations, {} failed, {} ops/s, p99 {} us", summary.operations,
+            summary.failed, summary.throughput(), summary.p99_us);
+        return summary.failed ? 1 : 0;
+    }
+
     void run() {
         while (true) {
             displayMainMenu();
@@ -464,8 +494,56 @@ public:
     }
 };
 
-int main() {
+struct CliOptions {
+    RuntimeOptions runtime;
+    std::string batch_path;     // empty: interactive
+    size_t concurrency = 8;
+};
+
+// Runtime options: --order-cpu N, --log-cpu N, --busy-poll, --prefault-mb N, --mlock. The CLI
+// has no market data thread of its own, so only order entry and the log writer are pinned.
+// Batch mode: --batch FILE|-, --concurrency N
+CliOptions parseOptions(int argc, char* argv[]) {
+    CliOptions cli;
+    RuntimeOptions& options = cli.runtime;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--order-cpu" && hasValue) {
+            options.order_entry_cpu = std::stoi(argv[++i]);
+        } else if (arg == "--log-cpu" && hasValue) {
+            options.logging_cpu = std::stoi(argv[++i]);
+        } else if (arg == "--prefault-mb" && hasValue) {
+            options.prefault_bytes = std::stoul(argv[++i]) << 20;
+        } else if (arg == "--busy-poll") {
+            options.busy_poll = true;
+        } else if (arg == "--mlock") {
+            options.lock_memory = true;
+        } else if (arg == "--batch" && hasValue) {
+            cli.batch_path = argv[++i];
+        } else if (arg == "--concurrency" && hasValue) {
+            cli.concurrency = std::stoul(argv[++i]);
+        } else {
+            logging::warn("Ignoring unknown option {}", arg);
+        }
+    }
+    return cli;
+}
+
+int main(int argc, char* argv[]) {
+    // In batch mode stdout carries only results: log to stderr before anything, including the
+    // option parsing below, can log
+    if (std::find(argv + 1, argv + argc, std::string_view("--batch")) != argv + argc) {
+        logging::setOutput(STDERR_FILENO);
+    }
+    CliOptions options = parseOptions(argc, argv);
+    // Before the CLI starts any threads; its pools and background threads unpin themselves, so
+    // only this thread (and the EventLoop a batch runs on it) keeps the order entry core
+    runtime::configure(options.runtime);
     TradingCLI cli;
+    if (!options.batch_path.empty()) {
+        return cli.runBatch(options.batch_path, options.concurrency);
+    }
     cli.run();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,969 @@
+#include "matching_engine.h"
+#include "order_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+using namespace matching;
+
+namespace {
+
+constexpr double EPSILON = 1e-9;
+
+long long nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char* typeString(OrderType type) {
+    switch (type) {
+        case OrderType::Limit: return "limit";
+        case OrderType::Market: return "market";
+        case OrderType::MarketLimit: return "market_limit";
+        case OrderType::StopLimit: return "stop_limit";
+        case OrderType::StopMarket: return "stop_market";
+        case OrderType::TakeLimit: return "take_limit";
+        case OrderType::TakeMarket: return "take_market";
+        case OrderType::TrailingStop: return "trailing_stop";
+    }
+    return "limit";
+}
+
+const char* timeInForceString(TimeInForce time_in_force) {
+    switch (time_in_force) {
+        case TimeInForce::GoodTilCancelled: return "good_til_cancelled";
+        case TimeInForce::GoodTilDay: return "good_til_day";
+        case TimeInForce::FillOrKill: return "fill_or_kill";
+        case TimeInForce::ImmediateOrCancel: return "immediate_or_cancel";
+    }
+    return "good_til_cancelled";
+}
+
+const char* stateString(OrderState state) {
+    switch (state) {
+        case OrderState::Open: return "open";
+        case OrderState::Untriggered: return "untriggered";
+        case OrderState::Filled: return "filled";
+        case OrderState::Cancelled: return "cancelled";
+        case OrderState::Rejected: return "rejected";
+    }
+    return "open";
+}
+
+bool parseType(const std::string& text, OrderType& type) {
+    static const std::pair<const char*, OrderType> types[] = {
+        {"limit", OrderType::Limit}, {"market", OrderType::Market}, {"market_limit", OrderType::MarketLimit},
+        {"stop_limit", OrderType::StopLimit}, {"stop_market", OrderType::StopMarket},
+        {"take_limit", OrderType::TakeLimit}, {"take_market", OrderType::TakeMarket},
+        {"trailing_stop", OrderType::TrailingStop},
+    };
+    for (const auto& [name, value] : types) {
+        if (text == name) {
+            type = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseTimeInForce(const std::string& text, TimeInForce& time_in_force) {
+    static const std::pair<const char*, TimeInForce> values[] = {
+        {"good_til_cancelled", TimeInForce::GoodTilCancelled}, {"good_til_day", TimeInForce::GoodTilDay},
+        {"fill_or_kill", TimeInForce::FillOrKill}, {"immediate_or_cancel", TimeInForce::ImmediateOrCancel},
+    };
+    for (const auto& [name, value] : values) {
+        if (text == name) {
+            time_in_force = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+int flagParam(const ApiRequest& request, const std::string& key) {
+    return request.has(key) ? (request.flag(key) ? 1 : 0) : -1;
+}
+
+} // namespace
+
+const char* matching::rejectString(Reject reject) {
+    switch (reject) {
+        case Reject::None: return "none";
+        case Reject::UnknownInstrument: return "unknown_instrument";
+        case Reject::UnknownOrder: return "order_not_found";
+        case Reject::InvalidAmount: return "invalid_amount";
+        case Reject::InvalidPrice: return "invalid_price";
+        case Reject::PostOnly: return "post_only_reject";
+        case Reject::ReduceOnly: return "reduce_only_reject";
+        case Reject::Expired: return "request_expired";
+        case Reject::Unsupported: return "not_supported";
+    }
+    return "unknown";
+}
+
+MatchingEngine::MatchingEngine(std::unordered_map<std::string, Instrument> instruments) : instruments(std::move(instruments)) {
+    std::vector<std::string> names;
+    for (const auto& [instrument_name, instrument] : this->instruments) {
+        names.push_back(instrument_name);
+    }
+    std::sort(names.begin(), names.end());
+    books.resize(names.size());
+    for (uint32_t i = 0; i < names.size(); ++i) {
+        instrument_ids[names[i]] = i;
+        books[i].instrument_name = names[i];
+        books[i].instrument = &this->instruments.at(names[i]);
+    }
+}
+
+bool MatchingEngine::isTrigger(OrderType type) {
+    return type == OrderType::StopLimit || type == OrderType::StopMarket || type == OrderType::TakeLimit ||
+        type == OrderType::TakeMarket || type == OrderType::TrailingStop;
+}
+
+bool MatchingEngine::isMarket(OrderType type) {
+    return type == OrderType::Market || type == OrderType::MarketLimit || type == OrderType::StopMarket ||
+        type == OrderType::TakeMarket || type == OrderType::TrailingStop;
+}
+
+MatchingEngine::OrderNode* MatchingEngine::node(uint64_t order_id) const {
+    return orders.find(order_id);
+}
+
+double MatchingEngine::reducible(uint32_t account, uint32_t instrument, Side side) const {
+    auto it = positions.find(positionKey(account, instrument));
+    double position = it == positions.end() ? 0 : it->second;
+    return side == Side::Buy ? std::max(-position, 0.0) : std::max(position, 0.0);
+}
+
+MatchingEngine::OrderNode* MatchingEngine::place(uint32_t instrument, const OrderSpec& spec, Reject& reject,
+    std::vector<Execution>* executions, bool respond) {
+    reject = Reject::None;
+    if (instrument >= books.size()) {
+        reject = Reject::UnknownInstrument;
+    } else if (spec.linked) {
+        reject = Reject::Unsupported;
+    } else if (spec.amount <= 0 || spec.max_show < 0) {
+        reject = Reject::InvalidAmount;
+    } else if (!isMarket(spec.type) && spec.price <= 0) {
+        reject = Reject::InvalidPrice;
+    } else if (spec.type == OrderType::TrailingStop ? spec.trigger_offset <= 0 : isTrigger(spec.type) && spec.trigger_price <= 0) {
+        reject = Reject::InvalidPrice;
+    } else if (spec.valid_until != 0 && nowMs() > spec.valid_until) {
+        reject = Reject::Expired;
+    }
+    double amount = spec.amount;
+    if (reject == Reject::None && spec.reduce_only) {
+        amount = std::min(amount, reducible(spec.account, instrument, spec.side));
+        if (amount <= EPSILON) reject = Reject::ReduceOnly;
+    }
+    if (reject != Reject::None) return nullptr;
+
+    OrderNode* order = order_pool.acquire();
+    order->prev = nullptr;
+    order->level = nullptr;
+    order->order_id = next_order_id++;
+    order->account = spec.account;
+    order->instrument = instrument;
+    order->side = spec.side;
+    order->type = spec.type;
+    order->time_in_force = spec.time_in_force;
+    order->post_only = spec.post_only;
+    order->reject_post_only = spec.reject_post_only;
+    order->reduce_only = spec.reduce_only;
+    order->mmp = spec.mmp;
+    order->triggered = false;
+    order->amount = amount;
+    order->filled_amount = 0;
+    order->notional = 0;
+    order->price = isMarket(spec.type) ? 0 : spec.price;
+    order->max_show = spec.max_show;
+    order->display = 0;
+    order->trigger_price = spec.trigger_price;
+    order->trigger_offset = spec.trigger_offset;
+    order->creation_timestamp = nowMs();
+    order->last_update_timestamp = order->creation_timestamp;
+    order->label = spec.label;
+    orders.insert(order->order_id, order);
+    if (respond) reporting_taker = order;
+
+    Book& book = books[instrument];
+    if (isTrigger(spec.type)) {
+        order->state = OrderState::Untriggered;
+        order->trail_extreme = book.last_price;
+        book.triggers.push_back(order);
+        if (order->account == API_ACCOUNT) api_orders.insert(order->order_id);
+        return order;
+    }
+    double last_price = book.last_price;
+    reject = arrive(order, executions);
+    if (book.last_price != last_price && !book.triggers.empty()) {
+        fireTriggers(book, executions);
+    }
+    return order;
+}
+
+bool MatchingEngine::crosses(const OrderNode* order) const {
+    const Book& book = books[order->instrument];
+    const std::vector<Level*>& opposite = order->side == Side::Buy ? book.asks : book.bids;
+    if (opposite.empty()) return false;
+    if (order->price <= 0) return true;
+    double best = opposite.back()->price;
+    return order->side == Side::Buy ? order->price >= best : order->price <= best;
+}
+
+bool MatchingEngine::joinOwnSide(OrderNode* order) const {
+    const Book& book = books[order->instrument];
+    const std::vector<Level*>& own = order->side == Side::Buy ? book.bids : book.asks;
+    if (own.empty()) return false;
+    order->price = own.back()->price;
+    return true;
+}
+
+double MatchingEngine::liquidity(const OrderNode* order) const {
+    const Book& book = books[order->instrument];
+    const std::vector<Level*>& opposite = order->side == Side::Buy ? book.asks : book.bids;
+    double available = 0;
+    for (size_t i = opposite.size(); i-- > 0;) {
+        double price = opposite[i]->price;
+        if (order->price > 0 && (order->side == Side::Buy ? price > order->price : price < order->price)) break;
+        available += opposite[i]->quantity;
+    }
+    return available;
+}
+
+Reject MatchingEngine::arrive(OrderNode* order, std::vector<Execution>* executions) {
+    Book& book = books[order->instrument];
+    order->state = OrderState::Open;
+    bool resting_time_in_force = order->time_in_force == TimeInForce::GoodTilCancelled ||
+        order->time_in_force == TimeInForce::GoodTilDay;
+
+    if (order->type == OrderType::MarketLimit) {
+        // Takes the best level only; the remainder rests there as a limit order
+        const std::vector<Level*>& opposite = order->side == Side::Buy ? book.asks : book.bids;
+        if (opposite.empty()) {
+            close(order, OrderState::Cancelled);
+            return Reject::None;
+        }
+        order->price = opposite.back()->price;
+    }
+
+    if (order->post_only && resting_time_in_force && !isMarket(order->type) && crosses(order)) {
+        if (order->reject_post_only || !joinOwnSide(order)) {
+            close(order, OrderState::Rejected);
+            return Reject::PostOnly;
+        }
+    }
+
+    if (order->time_in_force == TimeInForce::FillOrKill && liquidity(order) + EPSILON < order->remaining()) {
+        close(order, OrderState::Cancelled);
+        return Reject::None;
+    }
+
+    match(order, executions);
+    if (order->remaining() <= EPSILON) {
+        close(order, OrderState::Filled);
+    } else if (!resting_time_in_force || order->price <= 0) {
+        close(order, OrderState::Cancelled);
+    } else {
+        rest(order);
+    }
+    return Reject::None;
+}
+
+void MatchingEngine::match(OrderNode* order, std::vector<Execution>* executions) {
+    Book& book = books[order->instrument];
+    std::vector<Level*>& opposite = order->side == Side::Buy ? book.asks : book.bids;
+    while (order->remaining() > EPSILON && !opposite.empty()) {
+        Level* level = opposite.back();
+        if (order->price > 0 && (order->side == Side::Buy ? level->price > order->price : level->price < order->price)) break;
+        OrderNode* maker = level->head;
+        double amount = std::min(order->remaining(), maker->display);
+        trade(book, maker, order, level->price, amount, executions);
+        if (maker->remaining() <= EPSILON) {
+            unlink(maker);
+            close(maker, OrderState::Filled);
+            finish(maker);
+        } else if (maker->display <= EPSILON) {
+            // Iceberg slice used up: show the next one at the back of the queue
+            unlink(maker);
+            rest(maker);
+        }
+    }
+}
+
+void MatchingEngine::trade(Book& book, OrderNode* maker, OrderNode* taker, double price, double amount,
+    std::vector<Execution>* executions) {
+    maker->filled_amount += amount;
+    maker->notional += price * amount;
+    maker->display -= amount;
+    maker->level->visible -= amount;
+    maker->level->quantity -= amount;
+    taker->filled_amount += amount;
+    taker->notional += price * amount;
+    double signed_amount = taker->side == Side::Buy ? amount : -amount;
+    positions[positionKey(taker->account, taker->instrument)] += signed_amount;
+    positions[positionKey(maker->account, maker->instrument)] -= signed_amount;
+    book.last_price = price;
+
+    Execution execution{++trade_count, maker->order_id, taker->order_id, maker->account, taker->account,
+        taker->instrument, taker->side, price, amount};
+    if (executions) executions->push_back(execution);
+    if (maker->account == API_ACCOUNT || (taker->account == API_ACCOUNT && taker != reporting_taker)) {
+        long long now = nowMs();
+        book.last_trade_timestamp = now;
+        maker->last_update_timestamp = now;
+        taker->last_update_timestamp = now;
+        if (maker->account == API_ACCOUNT) report(maker, &execution, true);
+        if (taker->account == API_ACCOUNT && taker != reporting_taker) report(taker, &execution, false);
+    }
+}
+
+void MatchingEngine::rest(OrderNode* order) {
+    Book& book = books[order->instrument];
+    std::vector<Level*>& levels = order->side == Side::Buy ? book.bids : book.asks;
+    // Walk in from the best price; bids ascend and asks descend towards the back
+    size_t position = levels.size();
+    while (position > 0) {
+        double price = levels[position - 1]->price;
+        if (order->side == Side::Buy ? price <= order->price : price >= order->price) break;
+        --position;
+    }
+    Level* level;
+    if (position > 0 && levels[position - 1]->price == order->price) {
+        level = levels[position - 1];
+    } else {
+        level = level_pool.acquire();
+        level->price = order->price;
+        level->visible = 0;
+        level->quantity = 0;
+        level->head = nullptr;
+        level->tail = nullptr;
+        levels.insert(levels.begin() + position, level);
+    }
+
+    order->display = order->max_show > 0 ? std::min(order->max_show, order->remaining()) : order->remaining();
+    order->level = level;
+    order->next = nullptr;
+    order->prev = level->tail;
+    if (level->tail) {
+        level->tail->next = order;
+    } else {
+        level->head = order;
+    }
+    level->tail = order;
+    level->visible += order->display;
+    level->quantity += order->remaining();
+    order->state = OrderState::Open;
+    if (order->account == API_ACCOUNT) api_orders.insert(order->order_id);
+}
+
+void MatchingEngine::unlink(OrderNode* order) {
+    Level* level = order->level;
+    if (!level) return;
+    if (order->prev) {
+        order->prev->next = order->next;
+    } else {
+        level->head = order->next;
+    }
+    if (order->next) {
+        order->next->prev = order->prev;
+    } else {
+        level->tail = order->prev;
+    }
+    level->visible -= order->display;
+    level->quantity -= order->remaining();
+    order->next = nullptr;
+    order->prev = nullptr;
+    order->level = nullptr;
+
+    if (!level->head) {
+        Book& book = books[order->instrument];
+        std::vector<Level*>& levels = order->side == Side::Buy ? book.bids : book.asks;
+        for (size_t i = levels.size(); i-- > 0;) {
+            if (levels[i] == level) {
+                levels.erase(levels.begin() + i);
+                break;
+            }
+        }
+        level_pool.release(level);
+    }
+}
+
+void MatchingEngine::remove(OrderNode* order) {
+    if (order->state == OrderState::Untriggered) {
+        std::vector<OrderNode*>& triggers = books[order->instrument].triggers;
+        triggers.erase(std::remove(triggers.begin(), triggers.end(), order), triggers.end());
+    } else {
+        unlink(order);
+    }
+}
+
+void MatchingEngine::close(OrderNode* order, OrderState state) {
+    order->state = state;
+    order->display = 0;
+    orders.erase(order->order_id);
+    if (order->account == API_ACCOUNT) {
+        order->last_update_timestamp = nowMs();
+        api_orders.erase(order->order_id);
+    }
+}
+
+void MatchingEngine::finish(OrderNode* order) {
+    if (order->state != OrderState::Open && order->state != OrderState::Untriggered) {
+        order_pool.release(order);
+    }
+}
+
+bool MatchingEngine::triggers(OrderNode* order, double reference) const {
+    if (reference <= 0) return false;
+    if (order->type == OrderType::TrailingStop) {
+        // A sell trails the highest price seen, a buy the lowest
+        if (order->trail_extreme <= 0) order->trail_extreme = reference;
+        order->trail_extreme = order->side == Side::Buy ? std::min(order->trail_extreme, reference)
+                                                        : std::max(order->trail_extreme, reference);
+        return order->side == Side::Buy ? reference >= order->trail_extreme + order->trigger_offset
+                                        : reference <= order->trail_extreme - order->trigger_offset;
+    }
+    bool is_stop = order->type == OrderType::StopLimit || order->type == OrderType::StopMarket;
+    bool rising = is_stop == (order->side == Side::Buy);   // buy stops and sell takes fire on a rising price
+    return rising ? reference >= order->trigger_price : reference <= order->trigger_price;
+}
+
+void MatchingEngine::fireTriggers(Book& book, std::vector<Execution>* executions) {
+    // A triggered order can move the price and fire further triggers
+    bool fired = true;
+    while (fired) {
+        fired = false;
+        for (size_t i = 0; i < book.triggers.size();) {
+            OrderNode* order = book.triggers[i];
+            if (!triggers(order, book.last_price)) {
+                ++i;
+                continue;
+            }
+            book.triggers[i] = book.triggers.back();
+            book.triggers.pop_back();
+            order->triggered = true;
+            if (order->reduce_only) {
+                double limit = reducible(order->account, order->instrument, order->side);
+                order->amount = std::min(order->amount, order->filled_amount + limit);
+            }
+            if (order->remaining() <= EPSILON) {
+                close(order, OrderState::Cancelled);
+            } else {
+                arrive(order, executions);
+            }
+            if (order->account == API_ACCOUNT && order != reporting_taker) report(order, nullptr, false);
+            finish(order);
+            fired = true;
+        }
+    }
+}
+
+Reject MatchingEngine::change(OrderNode* order, const Amend& amend, std::vector<Execution>* executions) {
+    double amount = amend.amount >= 0 ? amend.amount : order->amount;
+    if (amount <= order->filled_amount + EPSILON) return Reject::InvalidAmount;
+    if (amend.valid_until != 0 && nowMs() > amend.valid_until) return Reject::Expired;
+    if (amend.price == 0 || (amend.price > 0 && isMarket(order->type) && order->type != OrderType::MarketLimit)) {
+        return Reject::InvalidPrice;
+    }
+
+    // Checked with the amended flags, which are only applied once the edit is accepted: a
+    // rejected edit leaves the order as it was
+    bool post_only = amend.post_only != -1 ? amend.post_only == 1 : order->post_only;
+    bool reject_post_only = amend.reject_post_only != -1 ? amend.reject_post_only == 1 : order->reject_post_only;
+    bool reduce_only = amend.reduce_only != -1 ? amend.reduce_only == 1 : order->reduce_only;
+    bool mmp = amend.mmp != -1 ? amend.mmp == 1 : order->mmp;
+    auto apply = [&] {
+        order->post_only = post_only;
+        order->reject_post_only = reject_post_only;
+        order->reduce_only = reduce_only;
+        order->mmp = mmp;
+        order->last_update_timestamp = nowMs();
+    };
+
+    if (order->state == OrderState::Untriggered) {
+        // reduce_only is capped when the order fires
+        apply();
+        order->amount = amount;
+        if (amend.price > 0) order->price = amend.price;
+        if (amend.trigger_price > 0) order->trigger_price = amend.trigger_price;
+        if (amend.trigger_offset > 0) order->trigger_offset = amend.trigger_offset;
+        return Reject::None;
+    }
+
+    if (reduce_only) {
+        amount = std::min(amount, order->filled_amount + reducible(order->account, order->instrument, order->side));
+        if (amount <= order->filled_amount + EPSILON) return Reject::ReduceOnly;
+    }
+
+    double price = amend.price > 0 ? amend.price : order->price;
+    if (price == order->price && amount <= order->amount) {
+        // A smaller order keeps its place in the queue
+        apply();
+        double cut = order->amount - amount;
+        order->amount = amount;
+        double display = std::min(order->display, order->remaining());
+        order->level->visible -= order->display - display;
+        order->level->quantity -= cut;
+        order->display = display;
+        return Reject::None;
+    }
+
+    Book& book = books[order->instrument];
+    bool resting_time_in_force = order->time_in_force == TimeInForce::GoodTilCancelled ||
+        order->time_in_force == TimeInForce::GoodTilDay;
+    if (post_only && resting_time_in_force && !isMarket(order->type)) {
+        // The re-entry below would reject a crossing post_only order, or join it to the best
+        // price of its own side, and a rejected re-entry closes the order: reject it here instead
+        const std::vector<Level*>& opposite = order->side == Side::Buy ? book.asks : book.bids;
+        const std::vector<Level*>& own = order->side == Side::Buy ? book.bids : book.asks;
+        bool crossing = !opposite.empty() && (order->side == Side::Buy ? price >= opposite.back()->price
+                                                                         : price <= opposite.back()->price);
+        // Unlinked, the order leaves its own side empty if it is that side's only order
+        bool alone = own.empty() || (own.size() == 1 && own.back()->head == order && own.back()->tail == order);
+        if (crossing && (reject_post_only || alone)) return Reject::PostOnly;
+    }
+
+    apply();
+    double last_price = book.last_price;
+    unlink(order);
+    order->amount = amount;
+    order->price = price;
+    Reject reject = arrive(order, executions);
+    if (book.last_price != last_price && !book.triggers.empty()) {
+        fireTriggers(book, executions);
+    }
+    return reject;
+}
+
+OrderResult MatchingEngine::resultOf(const OrderNode* order) const {
+    OrderResult result;
+    result.order_id = order->order_id;
+    result.state = order->state;
+    result.filled_amount = order->filled_amount;
+    result.average_price = order->filled_amount > 0 ? order->notional / order->filled_amount : 0;
+    return result;
+}
+
+OrderResult MatchingEngine::submit(uint32_t instrument, const OrderSpec& spec, std::vector<Execution>* executions) {
+    std::unique_lock lock(mutex);
+    Reject reject;
+    OrderNode* order = place(instrument, spec, reject, executions);
+    OrderResult result;
+    if (order) {
+        result = resultOf(order);
+        finish(order);
+    }
+    result.reject = reject;
+    notify(lock);
+    return result;
+}
+
+OrderResult MatchingEngine::amend(uint64_t order_id, const Amend& amend, std::vector<Execution>* executions) {
+    std::unique_lock lock(mutex);
+    OrderNode* order = node(order_id);
+    OrderResult result;
+    if (!order) {
+        result.reject = Reject::UnknownOrder;
+        return result;
+    }
+    Reject reject = change(order, amend, executions);
+    result = resultOf(order);
+    result.reject = reject;
+    finish(order);
+    notify(lock);
+    return result;
+}
+
+OrderResult MatchingEngine::cancel(uint64_t order_id) {
+    std::lock_guard lock(mutex);
+    OrderNode* order = node(order_id);
+    OrderResult result;
+    if (!order) {
+        result.reject = Reject::UnknownOrder;
+        return result;
+    }
+    remove(order);
+    close(order, OrderState::Cancelled);
+    result = resultOf(order);
+    finish(order);
+    return result;
+}
+
+size_t MatchingEngine::cancelAll(uint32_t account, uint32_t instrument) {
+    std::lock_guard lock(mutex);
+    if (instrument >= books.size()) return 0;
+    Book& book = books[instrument];
+    std::vector<OrderNode*> matches;
+    for (const std::vector<Level*>* levels : {&book.bids, &book.asks}) {
+        for (Level* level : *levels) {
+            for (OrderNode* order = level->head; order; order = order->next) {
+                if (order->account == account) matches.push_back(order);
+            }
+        }
+    }
+    for (OrderNode* order : book.triggers) {
+        if (order->account == account) matches.push_back(order);
+    }
+    for (OrderNode* order : matches) {
+        remove(order);
+        close(order, OrderState::Cancelled);
+        finish(order);
+    }
+    return matches.size();
+}
+
+double MatchingEngine::bestBid(uint32_t instrument) const {
+    std::lock_guard lock(mutex);
+    return instrument < books.size() && !books[instrument].bids.empty() ? books[instrument].bids.back()->price : 0;
+}
+
+double MatchingEngine::bestAsk(uint32_t instrument) const {
+    std::lock_guard lock(mutex);
+    return instrument < books.size() && !books[instrument].asks.empty() ? books[instrument].asks.back()->price : 0;
+}
+
+double MatchingEngine::position(uint32_t account, uint32_t instrument) const {
+    std::lock_guard lock(mutex);
+    auto it = positions.find(positionKey(account, instrument));
+    return it == positions.end() ? 0 : it->second;
+}
+
+size_t MatchingEngine::openOrders() const {
+    std::lock_guard lock(mutex);
+    return order_pool.size();
+}
+
+size_t MatchingEngine::trades() const {
+    std::lock_guard lock(mutex);
+    return trade_count;
+}
+
+size_t MatchingEngine::pooledOrders() const {
+    std::lock_guard lock(mutex);
+    return order_pool.capacity();
+}
+
+size_t MatchingEngine::orderIdSlots() const {
+    std::lock_guard lock(mutex);
+    return orders.capacity();
+}
+
+void MatchingEngine::report(const OrderNode* order, const Execution* execution, bool maker) {
+    if (!listener) return;
+    if (execution) pending_trades.push_back(tradeJson(*execution, maker));
+    pending_orders.push_back(orderJson(order));
+}
+
+void MatchingEngine::notify(std::unique_lock<std::mutex>& lock) {
+    if (pending_orders.empty()) return;
+    JsonObject data;
+    data.emplace("trades", JsonValue(std::move(pending_trades)));
+    data.emplace("orders", JsonValue(std::move(pending_orders)));
+    pending_trades = JsonArray();
+    pending_orders = JsonArray();
+    JsonObject params;
+    params.emplace("channel", JsonValue(std::string("user.changes.any.any.raw")));
+    params.emplace("data", JsonValue(std::move(data)));
+    EventListener deliver = listener;
+    lock.unlock();
+    deliver(JsonValue(std::move(params)));
+}
+
+// Transport
+
+std::string MatchingEngine::get(const std::string& url, const std::string&) {
+    ApiRequest request = ApiRequest::parse(url);
+    std::unique_lock lock(mutex);
+    std::string response = handle(request);
+    reporting_taker = nullptr;
+    notify(lock);
+    return response;
+}
+
+JsonValue MatchingEngine::orderJson(const OrderNode* order) const {
+    JsonObject fields;
+    fields.emplace("order_id", JsonValue(std::to_string(order->order_id)));
+    fields.emplace("instrument_name", JsonValue(books[order->instrument].instrument_name));
+    fields.emplace("direction", JsonValue(std::string(order->side == Side::Buy ? "buy" : "sell")));
+    fields.emplace("order_type", JsonValue(std::string(typeString(order->type))));
+    fields.emplace("time_in_force", JsonValue(std::string(timeInForceString(order->time_in_force))));
+    fields.emplace("order_state", JsonValue(std::string(stateString(order->state))));
+    fields.emplace("label", JsonValue(order->label));
+    fields.emplace("amount", JsonValue(order->amount));
+    fields.emplace("filled_amount", JsonValue(order->filled_amount));
+    fields.emplace("price", JsonValue(order->price));
+    fields.emplace("average_price", JsonValue(order->filled_amount > 0 ? order->notional / order->filled_amount : 0.0));
+    fields.emplace("post_only", JsonValue(order->post_only));
+    fields.emplace("reject_post_only", JsonValue(order->reject_post_only));
+    fields.emplace("reduce_only", JsonValue(order->reduce_only));
+    fields.emplace("mmp", JsonValue(order->mmp));
+    if (order->max_show > 0) fields.emplace("max_show", JsonValue(order->max_show));
+    if (isTrigger(order->type)) {
+        fields.emplace("trigger", JsonValue(std::string("last_price")));
+        fields.emplace("triggered", JsonValue(order->triggered));
+        if (order->trigger_price > 0) fields.emplace("trigger_price", JsonValue(order->trigger_price));
+        if (order->trigger_offset > 0) fields.emplace("trigger_offset", JsonValue(order->trigger_offset));
+    }
+    fields.emplace("creation_timestamp", JsonValue(double(order->creation_timestamp)));
+    fields.emplace("last_update_timestamp", JsonValue(double(order->last_update_timestamp)));
+    fields.emplace("api", JsonValue(true));
+    return JsonValue(std::move(fields));
+}
+
+JsonValue MatchingEngine::tradeJson(const Execution& execution, bool maker) const {
+    bool isBuy = (execution.taker_side == Side::Buy) != maker;
+    JsonObject trade;
+    trade.emplace("trade_id", JsonValue(std::to_string(execution.trade_id)));
+    trade.emplace("order_id", JsonValue(std::to_string(maker ? execution.maker_order_id : execution.taker_order_id)));
+    trade.emplace("instrument_name", JsonValue(books[execution.instrument].instrument_name));
+    trade.emplace("direction", JsonValue(std::string(isBuy ? "buy" : "sell")));
+    trade.emplace("amount", JsonValue(execution.amount));
+    trade.emplace("price", JsonValue(execution.price));
+    trade.emplace("timestamp", JsonValue(double(nowMs())));
+    trade.emplace("liquidity", JsonValue(std::string(maker ? "M" : "T")));
+    trade.emplace("fee", JsonValue(0.0));
+    return JsonValue(std::move(trade));
+}
+
+JsonValue MatchingEngine::orderBookJson(uint32_t instrument, size_t depth) const {
+    const Book& book = books[instrument];
+    auto levels = [depth](const std::vector<Level*>& side) {
+        JsonArray result;
+        for (size_t i = side.size(); i-- > 0 && result.size() < depth;) {
+            result.push_back(JsonValue(JsonArray{JsonValue(side[i]->price), JsonValue(side[i]->visible)}));
+        }
+        return result;
+    };
+    double best_bid = book.bids.empty() ? 0 : book.bids.back()->price;
+    double best_ask = book.asks.empty() ? 0 : book.asks.back()->price;
+    double mark = best_bid > 0 && best_ask > 0 ? (best_bid + best_ask) / 2 : book.last_price;
+    JsonObject result;
+    result.emplace("instrument_name", JsonValue(book.instrument_name));
+    result.emplace("timestamp", JsonValue(double(nowMs())));
+    result.emplace("bids", JsonValue(levels(book.bids)));
+    result.emplace("asks", JsonValue(levels(book.asks)));
+    result.emplace("best_bid_price", JsonValue(best_bid));
+    result.emplace("best_ask_price", JsonValue(best_ask));
+    result.emplace("best_bid_amount", JsonValue(book.bids.empty() ? 0.0 : book.bids.back()->visible));
+    result.emplace("best_ask_amount", JsonValue(book.asks.empty() ? 0.0 : book.asks.back()->visible));
+    result.emplace("mark_price", JsonValue(mark));
+    result.emplace("last_price", JsonValue(book.last_price));
+    result.emplace("state", JsonValue(std::string("open")));
+    return JsonValue(std::move(result));
+}
+
+std::string MatchingEngine::orderResponse(OrderNode* order, const std::vector<Execution>& executions) {
+    JsonArray trades;
+    for (const Execution& execution : executions) {
+        if (execution.taker_order_id == order->order_id) trades.push_back(tradeJson(execution, false));
+    }
+    JsonObject result;
+    result.emplace("order", orderJson(order));
+    result.emplace("trades", JsonValue(std::move(trades)));
+    finish(order);
+    return api_response::result(JsonValue(std::move(result)));
+}
+
+size_t MatchingEngine::cancelApiOrders(const std::function<bool(const OrderNode*)>& matches) {
+    std::vector<OrderNode*> cancelled;
+    for (uint64_t order_id : api_orders) {
+        OrderNode* order = orders.find(order_id);
+        if (matches(order)) cancelled.push_back(order);
+    }
+    for (OrderNode* order : cancelled) {
+        remove(order);
+        close(order, OrderState::Cancelled);
+        finish(order);
+    }
+    return cancelled.size();
+}
+
+JsonArray MatchingEngine::apiOrdersWhere(const std::function<bool(const OrderNode*)>& matches) const {
+    JsonArray result;
+    for (uint64_t order_id : api_orders) {
+        const OrderNode* order = orders.find(order_id);
+        if (matches(order)) result.push_back(orderJson(order));
+    }
+    return result;
+}
+
+std::string MatchingEngine::handle(const ApiRequest& request) {
+    std::string response;
+    if (api_response::referenceData(request, instruments, response)) {
+        return response;
+    }
+    const std::string& method = request.method;
+
+    if (method == "public/get_order_book") {
+        auto instrument = instrument_ids.find(request.text("instrument_name"));
+        if (instrument == instrument_ids.end()) {
+            return api_response::error(api_response::INVALID_PARAMS, "Instrument not found: " + request.text("instrument_name"));
+        }
+        return api_response::result(orderBookJson(instrument->second, (size_t)request.number("depth", 5)));
+    }
+
+    if (method == "private/buy" || method == "private/sell") {
+        auto instrument = instrument_ids.find(request.text("instrument_name"));
+        if (instrument == instrument_ids.end()) {
+            return api_response::error(api_response::INVALID_PARAMS, "Instrument not found: " + request.text("instrument_name"));
+        }
+        OrderSpec spec;
+        spec.account = API_ACCOUNT;
+        spec.side = method == "private/buy" ? Side::Buy : Side::Sell;
+        if (!parseType(request.text("type", "limit"), spec.type)) {
+            return api_response::error(api_response::INVALID_PARAMS, "Invalid order type: " + request.text("type"));
+        }
+        if (!parseTimeInForce(request.text("time_in_force", "good_til_cancelled"), spec.time_in_force)) {
+            return api_response::error(api_response::INVALID_PARAMS, "Invalid time in force: " + request.text("time_in_force"));
+        }
+        spec.amount = request.has("amount") ? request.number("amount") : request.number("contracts");
+        spec.price = request.number("price");
+        spec.max_show = request.number("max_show");
+        spec.trigger_price = request.number("trigger_price");
+        spec.trigger_offset = request.number("trigger_offset");
+        std::string advanced = request.text("advanced");
+        spec.post_only = request.flag("post_only") || advanced == "post_only";
+        spec.reject_post_only = request.flag("reject_post_only") || advanced == "reject_post_only";
+        spec.reduce_only = request.flag("reduce_only") || advanced == "reduce_only";
+        spec.mmp = request.flag("mmp");
+        spec.linked = request.has("linked_order_type");
+        spec.valid_until = (long long)request.number("valid_until");
+        spec.label = request.text("label");
+
+        std::vector<Execution> executions;
+        Reject reject;
+        // The taker's own fills go into the response rather than a notification
+        OrderNode* order = place(instrument->second, spec, reject, &executions, true);
+        if (reject != Reject::None) {
+            if (order) finish(order);
+            int code = reject == Reject::PostOnly ? api_response::POST_ONLY_REJECT
+                : reject == Reject::ReduceOnly ? api_response::REDUCE_ONLY_REJECT : api_response::INVALID_PARAMS;
+            return api_response::error(code, rejectString(reject));
+        }
+        return orderResponse(order, executions);
+    }
+
+    if (method == "private/edit" || method == "private/edit_by_label") {
+        OrderNode* order = nullptr;
+        if (method == "private/edit") {
+            order = node(std::strtoull(request.text("order_id").c_str(), nullptr, 10));
+        } else {
+            std::string label = request.text("label");
+            std::string instrument_name = request.text("instrument_name");
+            for (uint64_t order_id : api_orders) {
+                OrderNode* candidate = orders.find(order_id);
+                if (candidate->label == label && books[candidate->instrument].instrument_name == instrument_name) {
+                    order = candidate;
+                    break;
+                }
+            }
+        }
+        if (!order || order->account != API_ACCOUNT) {
+            return api_response::error(api_response::NOT_OPEN_ORDER, "not_open_order");
+        }
+        Amend amend;
+        if (request.has("amount")) amend.amount = request.number("amount");
+        else if (request.has("contracts")) amend.amount = request.number("contracts");
+        if (request.has("price")) amend.price = request.number("price");
+        if (request.has("trigger_price")) amend.trigger_price = request.number("trigger_price");
+        if (request.has("trigger_offset")) amend.trigger_offset = request.number("trigger_offset");
+        amend.post_only = flagParam(request, "post_only");
+        amend.reject_post_only = flagParam(request, "reject_post_only");
+        amend.reduce_only = flagParam(request, "reduce_only");
+        amend.mmp = flagParam(request, "mmp");
+        amend.valid_until = (long long)request.number("valid_until");
+
+        std::vector<Execution> executions;
+        reporting_taker = order;
+        Reject reject = change(order, amend, &executions);
+        if (reject != Reject::None) {
+            finish(order);
+            return api_response::error(reject == Reject::PostOnly ? api_response::POST_ONLY_REJECT
+                : api_response::INVALID_PARAMS, rejectString(reject));
+        }
+        return orderResponse(order, executions);
+    }
+
+    if (method == "private/cancel" || method == "private/get_order_state") {
+        OrderNode* order = node(std::strtoull(request.text("order_id").c_str(), nullptr, 10));
+        if (!order || order->account != API_ACCOUNT) {
+            return api_response::error(api_response::NOT_OPEN_ORDER, "not_open_order");
+        }
+        if (method == "private/get_order_state") {
+            return api_response::result(orderJson(order));
+        }
+        remove(order);
+        close(order, OrderState::Cancelled);
+        JsonValue result = orderJson(order);
+        finish(order);
+        return api_response::result(std::move(result));
+    }
+
+    // Mass cancels and queries over API_ACCOUNT's open orders
+    std::string type = request.text("type", "all");
+    std::string kind = request.text("kind", "any");
+    auto matchesFilters = [&](const OrderNode* order, const std::string& currency) {
+        const Instrument& instrument = *books[order->instrument].instrument;
+        return (currency == "any" || currency.empty() || instrument.settlement_currency == currency) &&
+            (kind == "any" || kind.empty() || instrument.kind == kind) && OrderCache::matchesType(typeString(order->type), type);
+    };
+    auto count = [](size_t cancelled) { return api_response::result(JsonValue(double(cancelled))); };
+
+    if (method == "private/cancel_all") {
+        return count(cancelApiOrders([](const OrderNode*) { return true; }));
+    }
+    if (method == "private/cancel_all_by_currency" || method == "private/cancel_all_by_kind_or_type") {
+        std::string currency = request.text("currency", "any");
+        return count(cancelApiOrders([&](const OrderNode* order) { return matchesFilters(order, currency); }));
+    }
+    if (method == "private/cancel_all_by_currency_pair") {
+        std::string pair = request.text("currency_pair");
+        std::transform(pair.begin(), pair.end(), pair.begin(), ::tolower);
+        return count(cancelApiOrders([&](const OrderNode* order) {
+            const Instrument& instrument = *books[order->instrument].instrument;
+            std::string order_pair = instrument.base_currency + "_" + instrument.quote_currency;
+            std::transform(order_pair.begin(), order_pair.end(), order_pair.begin(), ::tolower);
+            return order_pair == pair && matchesFilters(order, "any");
+        }));
+    }
+    if (method == "private/cancel_all_by_instrument") {
+        std::string instrument_name = request.text("instrument_name");
+        return count(cancelApiOrders([&](const OrderNode* order) {
+            return books[order->instrument].instrument_name == instrument_name && matchesFilters(order, "any");
+        }));
+    }
+    if (method == "private/cancel_by_label") {
+        std::string label = request.text("label");
+        std::string currency = request.text("currency", "any");
+        return count(cancelApiOrders([&](const OrderNode* order) {
+            return order->label == label && matchesFilters(order, currency);
+        }));
+    }
+    if (method == "private/get_open_orders") {
+        return api_response::result(JsonValue(apiOrdersWhere([&](const OrderNode* order) {
+            return matchesFilters(order, "any");
+        })));
+    }
+    if (method == "private/get_open_orders_by_currency") {
+        std::string currency = request.text("currency");
+        return api_response::result(JsonValue(apiOrdersWhere([&](const OrderNode* order) {
+            return matchesFilters(order, currency);
+        })));
+    }
+    if (method == "private/get_open_orders_by_instrument") {
+        std::string instrument_name = request.text("instrument_name");
+        return api_response::result(JsonValue(apiOrdersWhere([&](const OrderNode* order) {
+            return books[order->instrument].instrument_name == instrument_name && matchesFilters(order, "any");
+        })));
+    }
+    if (method == "private/get_open_orders_by_label" || method == "private/get_order_state_by_label") {
+        std::string label = request.text("label");
+        std::string currency = request.text("currency");
+        return api_response::result(JsonValue(apiOrdersWhere([&](const OrderNode* order) {
+            return order->label == label && matchesFilters(order, currency);
+        })));
+    }
+    return api_response::error(api_response::METHOD_NOT_FOUND, "Method not found: " + method);
+}
@@ -0,0 +1,374 @@
+#pragma once
+
+#include "api_request.h"
+#include "instruments.h"
+#include "json_parser.h"
+#include "transport.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace matching {
+
+enum class Side : uint8_t { Buy, Sell };
+enum class OrderType : uint8_t { Limit, Market, MarketLimit, StopLimit, StopMarket, TakeLimit, TakeMarket, TrailingStop };
+enum class TimeInForce : uint8_t { GoodTilCancelled, GoodTilDay, FillOrKill, ImmediateOrCancel };
+enum class OrderState : uint8_t { Open, Untriggered, Filled, Cancelled, Rejected };
+
+enum class Reject : uint8_t {
+    None,
+    UnknownInstrument,
+    UnknownOrder,
+    InvalidAmount,
+    InvalidPrice,
+    PostOnly,           // would have taken liquidity with reject_post_only
+    ReduceOnly,         // would have increased the position
+    Expired,            // valid_until has passed
+    Unsupported,        // linked orders
+};
+
+const char* rejectString(Reject reject);
+
+// An order as accepted by placeOrder; prices of market orders are ignored
+struct OrderSpec {
+    uint32_t account = 0;
+    Side side = Side::Buy;
+    OrderType type = OrderType::Limit;
+    TimeInForce time_in_force = TimeInForce::GoodTilCancelled;
+    double amount = 0;
+    double price = 0;
+    double max_show = 0;            // iceberg display size; 0 shows everything
+    double trigger_price = 0;
+    double trigger_offset = 0;      // trailing_stop distance
+    bool post_only = false;
+    bool reject_post_only = false;
+    bool reduce_only = false;
+    bool mmp = false;
+    bool linked = false;            // linked_order_type was set
+    long long valid_until = 0;      // ms since epoch; 0 for no limit
+    std::string label;
+};
+
+// The fields edit accepts; unset fields keep their value
+struct Amend {
+    double amount = -1;
+    double price = -1;
+    double trigger_price = -1;
+    double trigger_offset = -1;
+    int post_only = -1;
+    int reject_post_only = -1;
+    int reduce_only = -1;
+    int mmp = -1;
+    long long valid_until = 0;
+};
+
+struct Execution {
+    uint64_t trade_id;
+    uint64_t maker_order_id;
+    uint64_t taker_order_id;
+    uint32_t maker_account;
+    uint32_t taker_account;
+    uint32_t instrument;
+    Side taker_side;
+    double price;
+    double amount;
+};
+
+struct OrderResult {
+    uint64_t order_id = 0;
+    Reject reject = Reject::None;
+    OrderState state = OrderState::Rejected;
+    double filled_amount = 0;
+    double average_price = 0;
+};
+
+// Fixed-size objects handed out from chunks and recycled through an intrusive free list
+// threaded through T::next; nothing is returned to the heap until the pool is destroyed
+template<typename T>
+class ObjectPool {
+private:
+    std::vector<std::unique_ptr<T[]>> chunks;
+    T* free_list = nullptr;
+    size_t chunk_size;
+    size_t in_use = 0;
+
+public:
+    explicit ObjectPool(size_t chunk_size = 4096) : chunk_size(chunk_size) {}
+
+    T* acquire() {
+        if (!free_list) {
+            chunks.push_back(std::make_unique<T[]>(chunk_size));
+            T* chunk = chunks.back().get();
+            for (size_t i = 0; i < chunk_size; ++i) {
+                chunk[i].next = free_list;
+                free_list = &chunk[i];
+            }
+        }
+        T* object = free_list;
+        free_list = object->next;
+        object->next = nullptr;
+        ++in_use;
+        return object;
+    }
+
+    void release(T* object) {
+        object->next = free_list;
+        free_list = object;
+        --in_use;
+    }
+
+    size_t size() const { return in_use; }
+    size_t capacity() const { return chunks.size() * chunk_size; }
+};
+
+// Pointers keyed by nonzero id in one open-addressing array with linear probing. Sequential ids
+// are spread with Fibonacci hashing, erased slots are refilled by shifting the rest of their
+// run back, and the array doubles at half full, so it stays sized to the most ids held at once.
+template<typename T>
+class IdTable {
+private:
+    struct Slot {
+        uint64_t id = 0;            // 0: empty
+        T* value = nullptr;
+    };
+
+    static constexpr int INITIAL_BITS = 10;
+
+    std::vector<Slot> slots = std::vector<Slot>(size_t(1) << INITIAL_BITS);
+    size_t count = 0;
+    int shift = 64 - INITIAL_BITS;     // hashes keep the top log2(slots) bits
+
+    size_t home(uint64_t id) const { return size_t((id * 0x9E3779B97F4A7C15ULL) >> shift); }
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        --shift;
+        for (const Slot& slot : old) {
+            if (slot.id == 0) continue;
+            size_t i = home(slot.id);
+            while (slots[i].id != 0) i = (i + 1) & (slots.size() - 1);
+            slots[i] = slot;
+        }
+    }
+
+public:
+    T* find(uint64_t id) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = home(id); slots[i].id != 0; i = (i + 1) & mask) {
+            if (slots[i].id == id) return slots[i].value;
+        }
+        return nullptr;
+    }
+
+    // id must not be present
+    void insert(uint64_t id, T* value) {
+        if ((count + 1) * 2 > slots.size()) grow();
+        size_t i = home(id);
+        while (slots[i].id != 0) i = (i + 1) & (slots.size() - 1);
+        slots[i] = Slot{id, value};
+        ++count;
+    }
+
+    void erase(uint64_t id) {
+        size_t mask = slots.size() - 1;
+        size_t i = home(id);
+        while (slots[i].id != id) {
+            if (slots[i].id == 0) return;
+            i = (i + 1) & mask;
+        }
+        // Pull back every later entry of the run that may sit at the hole
+        for (size_t j = (i + 1) & mask; slots[j].id != 0; j = (j + 1) & mask) {
+            size_t k = home(slots[j].id);
+            bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+            if (!stays) {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i] = Slot{};
+        --count;
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+};
+
+} // namespace matching
+
+// Embedded price-time priority exchange. Every instrument has a book of price levels per side,
+// each level a FIFO of resting orders linked through the orders themselves; orders and levels
+// come from pools, so steady-state order flow does not allocate. Levels are kept in a vector
+// sorted with the best price at the back, where almost all inserts and removals happen.
+//
+// Orders enter through submit()/amend()/cancel() with any account id, or through the Transport
+// interface, which speaks the API TradingSystem uses and trades as account 0:
+//
+//     auto engine = std::make_shared<MatchingEngine>(instruments);
+//     TradingSystem trading(engine);       // no network involved
+//
+// Semantics follow placeOrder and edit: limit, market, market_limit (the remainder rests at
+// the first price it traded at), stop/take limit and market, and trailing_stop; good_til_cancelled,
+// good_til_day (never expires here), fill_or_kill and immediate_or_cancel; post_only and
+// reject_post_only (a crossing post_only order joins the best price on its own side),
+// reduce_only against the account's position, max_show icebergs, and valid_until. Triggers
+// fire on the last trade price whatever `trigger` says. mmp is accepted but not enforced.
+// Amending the price or raising the amount loses time priority; lowering the amount keeps it.
+// A rejected amendment leaves the order as it was.
+// Closed orders are recycled immediately, so only open orders can be queried.
+class MatchingEngine : public Transport {
+public:
+    static constexpr uint32_t API_ACCOUNT = 0;
+
+    using EventListener = std::function<void(const JsonValue& params)>;
+
+private:
+    struct Level;
+
+    struct OrderNode {
+        OrderNode* next = nullptr;      // level queue, or the pool's free list
+        OrderNode* prev = nullptr;
+        Level* level = nullptr;
+        uint64_t order_id = 0;
+        uint32_t account = 0;
+        uint32_t instrument = 0;
+        matching::Side side = matching::Side::Buy;
+        matching::OrderType type = matching::OrderType::Limit;
+        matching::TimeInForce time_in_force = matching::TimeInForce::GoodTilCancelled;
+        matching::OrderState state = matching::OrderState::Open;
+        bool post_only = false;
+        bool reject_post_only = false;
+        bool reduce_only = false;
+        bool mmp = false;
+        bool triggered = false;
+        double amount = 0;
+        double filled_amount = 0;
+        double notional = 0;            // sum of fill price * amount
+        double price = 0;               // 0 for market orders
+        double max_show = 0;
+        double display = 0;             // visible part of the remaining amount
+        double trigger_price = 0;
+        double trigger_offset = 0;
+        double trail_extreme = 0;
+        long long creation_timestamp = 0;
+        long long last_update_timestamp = 0;
+        std::string label;
+
+        double remaining() const { return amount - filled_amount; }
+    };
+
+    struct Level {
+        Level* next = nullptr;          // pool free list
+        double price = 0;
+        double visible = 0;             // sum of the orders' display amounts
+        double quantity = 0;            // sum of the orders' remaining amounts, icebergs included
+        OrderNode* head = nullptr;
+        OrderNode* tail = nullptr;
+    };
+
+    struct Book {
+        std::string instrument_name;
+        const Instrument* instrument = nullptr;
+        std::vector<Level*> bids;       // ascending, best at the back
+        std::vector<Level*> asks;       // descending, best at the back
+        std::vector<OrderNode*> triggers;
+        double last_price = 0;
+        long long last_trade_timestamp = 0;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Instrument> instruments;
+    std::unordered_map<std::string, uint32_t> instrument_ids;
+    std::vector<Book> books;
+    matching::ObjectPool<OrderNode> order_pool;
+    matching::ObjectPool<Level> level_pool;
+    matching::IdTable<OrderNode> orders;                // open orders by id
+    uint64_t next_order_id = 1;
+    std::unordered_map<uint64_t, double> positions;     // (account << 32 | instrument) -> signed amount
+    std::set<uint64_t> api_orders;                      // open orders of API_ACCOUNT
+    EventListener listener;
+    JsonArray pending_trades;                           // API_ACCOUNT fills outside its own requests
+    JsonArray pending_orders;
+    size_t trade_count = 0;
+
+    static uint64_t positionKey(uint32_t account, uint32_t instrument) { return (uint64_t(account) << 32) | instrument; }
+    static bool isTrigger(matching::OrderType type);
+    // Market-type orders never rest and carry no price
+    static bool isMarket(matching::OrderType type);
+
+    OrderNode* node(uint64_t order_id) const;
+    // Validate and enter an order; the node stays valid until finish() even if it closed.
+    // `respond` marks it as the reporting_taker of an API request.
+    OrderNode* place(uint32_t instrument, const matching::OrderSpec& spec, matching::Reject& reject,
+        std::vector<matching::Execution>* executions, bool respond = false);
+    matching::Reject change(OrderNode* order, const matching::Amend& amend, std::vector<matching::Execution>* executions);
+    void remove(OrderNode* order);
+    void finish(OrderNode* order);
+    matching::Reject arrive(OrderNode* order, std::vector<matching::Execution>* executions);
+    void match(OrderNode* order, std::vector<matching::Execution>* executions);
+    void trade(Book& book, OrderNode* maker, OrderNode* taker, double price, double amount,
+        std::vector<matching::Execution>* executions);
+    void fireTriggers(Book& book, std::vector<matching::Execution>* executions);
+    bool triggers(OrderNode* order, double reference) const;
+    void rest(OrderNode* order);
+    void unlink(OrderNode* order);
+    void close(OrderNode* order, matching::OrderState state);
+    double reducible(uint32_t account, uint32_t instrument, matching::Side side) const;
+    double liquidity(const OrderNode* order) const;
+    bool crosses(const OrderNode* order) const;
+    bool joinOwnSide(OrderNode* order) const;
+    matching::OrderResult resultOf(const OrderNode* order) const;
+
+    // Transport side
+    const OrderNode* reporting_taker = nullptr;       // the order whose fills go into the response
+    std::string handle(const ApiRequest& request);
+    std::string orderResponse(OrderNode* order, const std::vector<matching::Execution>& executions);
+    JsonValue orderJson(const OrderNode* order) const;
+    JsonValue tradeJson(const matching::Execution& execution, bool maker) const;
+    JsonValue orderBookJson(uint32_t instrument, size_t depth) const;
+    size_t cancelApiOrders(const std::function<bool(const OrderNode*)>& matches);
+    JsonArray apiOrdersWhere(const std::function<bool(const OrderNode*)>& matches) const;
+    void report(const OrderNode* order, const matching::Execution* execution, bool maker);
+    // Deliver what report() queued, outside the lock
+    void notify(std::unique_lock<std::mutex>& lock);
+
+public:
+    explicit MatchingEngine(std::unordered_map<std::string, Instrument> instruments);
+
+    MatchingEngine(const MatchingEngine&) = delete;
+    MatchingEngine& operator=(const MatchingEngine&) = delete;
+
+    // Index of an instrument for the order methods below; throws std::out_of_range if unknown
+    uint32_t instrumentId(const std::string& instrument_name) const { return instrument_ids.at(instrument_name); }
+
+    // Order entry for any account. Fills, including those of triggered orders, are appended to
+    // `executions` when it is given.
+    matching::OrderResult submit(uint32_t instrument, const matching::OrderSpec& spec,
+        std::vector<matching::Execution>* executions = nullptr);
+    matching::OrderResult amend(uint64_t order_id, const matching::Amend& amend,
+        std::vector<matching::Execution>* executions = nullptr);
+    matching::OrderResult cancel(uint64_t order_id);
+    // Cancels the account's open and untriggered orders on an instrument
+    size_t cancelAll(uint32_t account, uint32_t instrument);
+
+    double bestBid(uint32_t instrument) const;
+    double bestAsk(uint32_t instrument) const;
+    double position(uint32_t account, uint32_t instrument) const;
+
+    // Receives user.changes notifications when API_ACCOUNT's resting orders fill or trigger
+    // because of other accounts' orders; pass them to TradingSystem::onOrderEvent
+    void setEventListener(EventListener listener) { this->listener = std::move(listener); }
+
+    std::string get(const std::string& url, const std::string& authToken) override;
+
+    size_t openOrders() const;
+    size_t trades() const;
+    size_t pooledOrders() const;     // order nodes allocated so far
+    size_t orderIdSlots() const;     // of the open-order table; grows with open orders, not order ids
+};
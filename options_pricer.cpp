@@ -0,0 +1,300 @@
+#include "options_pricer.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <tuple>
+
+// Off for the whole file, see simd.h
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace {
+
+using simd::Mask4;
+using simd::Vec4;
+using simd::broadcast;
+using simd::load;
+using simd::select;
+using simd::store;
+
+constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+constexpr double MS_PER_YEAR = 365.0 * 24 * 3600 * 1000;
+constexpr double MIN_VOL = 1e-4;
+constexpr double MAX_VOL = 5.0;
+constexpr int SOLVER_ITERATIONS = 40;
+constexpr double SOLVER_TOLERANCE = 1e-10;
+constexpr size_t PARALLEL_CHUNK = 256;
+
+// Contiguous per-lane scratch; count is a multiple of simd::WIDTH
+struct Lanes {
+    size_t count;
+    const double* forward;
+    const double* strike;
+    const double* time;
+    const double* sign;
+    const double* quote;
+    const double* input_vol;
+    double* vol;
+    double* price;
+    double* delta;
+    double* gamma;
+    double* vega;
+    double* theta;
+};
+
+inline Vec4 normPdf(const Vec4& x) {
+    return simd::exp(-0.5 * x * x) * 0.3989422804014327;
+}
+
+// Standard normal CDF from the Chebyshev erfc fit in Numerical Recipes (relative error < 1.2e-7)
+inline Vec4 normCdf(const Vec4& x) {
+    Vec4 z = simd::abs(x) * 0.7071067811865476;
+    Vec4 t = 1.0 / (1.0 + 0.5 * z);
+    Vec4 poly = broadcast(0.17087277);
+    poly = poly * t - 0.82215223;
+    poly = poly * t + 1.48851587;
+    poly = poly * t - 1.13520398;
+    poly = poly * t + 0.27886807;
+    poly = poly * t - 0.18628806;
+    poly = poly * t + 0.09678418;
+    poly = poly * t + 0.37409196;
+    poly = poly * t + 1.00002368;
+    Vec4 erfc = t * simd::exp(-z * z - 1.26551223 + t * poly);
+    return select(x < 0, 0.5 * erfc, 1.0 - 0.5 * erfc);
+}
+
+inline bool allSet(const Mask4& mask) {
+    return mask[0] && mask[1] && mask[2] && mask[3];
+}
+
+SIMD_KERNEL void black76Kernel(const Lanes& lanes, double rate) {
+    for (size_t i = 0; i < lanes.count; i += simd::WIDTH) {
+        Vec4 F = load(lanes.forward + i);
+        Vec4 K = load(lanes.strike + i);
+        Vec4 T = load(lanes.time + i);
+        Vec4 w = load(lanes.sign + i);
+        Vec4 q = load(lanes.quote + i);
+
+        Vec4 sqrtT = simd::sqrt(simd::max(T, broadcast(0.0)));
+        Vec4 D = simd::exp(-rate * T);
+        Vec4 logFK = simd::log(F / K);
+
+        auto d1At = [&](const Vec4& sigma) {
+            return (logFK + 0.5 * sigma * sigma * T) / (sigma * sqrtT);
+        };
+        auto priceAt = [&](const Vec4& sign, const Vec4& sigma, const Vec4& d1) {
+            return D * sign * (F * normCdf(sign * d1) - K * normCdf(sign * (d1 - sigma * sqrtT)));
+        };
+
+        // In-the-money options are solved on their out-of-the-money twin through put-call
+        // parity, where the premium is all time value and the CDF terms do not cancel
+        Vec4 intrinsic = D * simd::max(w * (F - K), broadcast(0.0));
+        Vec4 otm_sign = select(intrinsic > 0, -w, w);
+        Vec4 time_value = q - intrinsic;
+        Vec4 upper = D * select(otm_sign > 0, F, K);
+        Mask4 solvable = (time_value > 0) & (time_value < upper) & (T > 0);
+
+        // Safeguarded Newton: keep a bracket around the root and bisect whenever a Newton step
+        // leaves it, so every lane converges even far out of the money
+        Vec4 lo = broadcast(MIN_VOL);
+        Vec4 hi = broadcast(MAX_VOL);
+        Vec4 guess = simd::sqrt(6.283185307179586 / simd::max(T, broadcast(1e-12))) * time_value / (D * F);
+        Vec4 sigma = select(solvable, simd::min(simd::max(guess, lo), hi), broadcast(0.2));
+        for (int iteration = 0; iteration < SOLVER_ITERATIONS; ++iteration) {
+            Vec4 d1 = d1At(sigma);
+            Vec4 diff = priceAt(otm_sign, sigma, d1) - time_value;
+            Vec4 vega = D * F * normPdf(d1) * sqrtT;
+
+            // Converged lanes are frozen while the rest of the group keeps iterating
+            Mask4 converged = simd::abs(diff) <= SOLVER_TOLERANCE * time_value;
+            if (allSet(converged | ~solvable)) break;
+
+            Mask4 too_high = diff > 0;
+            hi = select(too_high, sigma, hi);
+            lo = select(too_high, lo, sigma);
+            Vec4 newton = sigma - diff / vega;
+            Mask4 inside = (newton > lo) & (newton < hi);
+            sigma = select(converged, sigma, select(inside, newton, 0.5 * (lo + hi)));
+        }
+
+        Vec4 vol_in = load(lanes.input_vol + i);
+        Vec4 vol = select(q == q, select(solvable, sigma, broadcast(NaN)), vol_in);
+        vol = select(T > 0, vol, broadcast(NaN));
+
+        Vec4 d1 = d1At(vol);
+        Vec4 price = priceAt(w, vol, d1);
+        Vec4 pdf = normPdf(d1);
+        store(lanes.vol + i, vol);
+        store(lanes.price + i, price);
+        store(lanes.delta + i, D * w * normCdf(w * d1));
+        store(lanes.gamma + i, D * pdf / (F * vol * sqrtT));
+        store(lanes.vega + i, D * F * pdf * sqrtT);
+        store(lanes.theta + i, rate * price - D * F * pdf * vol / (2.0 * sqrtT));
+    }
+}
+
+} // namespace
+
+OptionsPricer::OptionsPricer(const std::unordered_map<std::string, Instrument>& instruments, const std::string& currency,
+    long long valuation_ms) : valuation_ms(valuation_ms) {
+    std::vector<std::tuple<long long, double, double, std::string>> chain;
+    for (const auto& [instrument_name, instrument] : instruments) {
+        if (instrument.kind == "option" && instrument.base_currency == currency) {
+            chain.emplace_back(instrument.expiration_timestamp, instrument.strike,
+                instrument.option_type == "call" ? 1.0 : -1.0, instrument_name);
+        }
+    }
+    // Expiry-major order keeps each expiry's options adjacent for forward updates
+    std::sort(chain.begin(), chain.end());
+
+    for (const auto& [expiry, strike, sign, instrument_name] : chain) {
+        size_t option = names.size();
+        names.push_back(instrument_name);
+        index[instrument_name] = option;
+        by_expiry[expiry].push_back(option);
+        strikes.push_back(strike);
+        signs.push_back(sign);
+        expiries.push_back(expiry);
+    }
+
+    size_t count = names.size();
+    forwards.assign(count, NaN);
+    quotes.assign(count, NaN);
+    input_vols.assign(count, NaN);
+    vols.assign(count, NaN);
+    prices.assign(count, NaN);
+    deltas.assign(count, NaN);
+    gammas.assign(count, NaN);
+    vegas.assign(count, NaN);
+    thetas.assign(count, NaN);
+    is_dirty.assign(count, 0);
+}
+
+std::vector<long long> OptionsPricer::expiryTimestamps() const {
+    std::vector<long long> result;
+    for (const auto& [expiry, options] : by_expiry) {
+        result.push_back(expiry);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void OptionsPricer::markDirty(size_t option) {
+    if (!is_dirty[option]) {
+        is_dirty[option] = 1;
+        dirty.push_back(option);
+    }
+}
+
+void OptionsPricer::markAllDirty() {
+    for (size_t option = 0; option < names.size(); ++option) {
+        markDirty(option);
+    }
+}
+
+void OptionsPricer::setForward(long long expiration_timestamp, double forward) {
+    auto it = by_expiry.find(expiration_timestamp);
+    if (it == by_expiry.end()) return;
+    for (size_t option : it->second) {
+        if (forwards[option] != forward) {
+            forwards[option] = forward;
+            markDirty(option);
+        }
+    }
+}
+
+bool OptionsPricer::setQuote(const std::string& instrument_name, double premium) {
+    auto it = index.find(instrument_name);
+    if (it == index.end()) return false;
+    if (quotes[it->second] != premium) {
+        quotes[it->second] = premium;
+        markDirty(it->second);
+    }
+    return true;
+}
+
+bool OptionsPricer::setVolatility(const std::string& instrument_name, double volatility) {
+    auto it = index.find(instrument_name);
+    if (it == index.end()) return false;
+    input_vols[it->second] = volatility;
+    markDirty(it->second);
+    return true;
+}
+
+void OptionsPricer::setRate(double rate) {
+    this->rate = rate;
+    markAllDirty();
+}
+
+void OptionsPricer::setValuationTime(long long valuation_ms) {
+    this->valuation_ms = valuation_ms;
+    markAllDirty();
+}
+
+size_t OptionsPricer::indexOf(const std::string& instrument_name) const {
+    auto it = index.find(instrument_name);
+    return it == index.end() ? names.size() : it->second;
+}
+
+void OptionsPricer::computeRange(const size_t* options, size_t count) {
+    size_t padded = (count + simd::WIDTH - 1) / simd::WIDTH * simd::WIDTH;
+    thread_local std::vector<double> scratch;
+    scratch.resize(12 * padded);
+    double* columns[12];
+    for (size_t c = 0; c < 12; ++c) {
+        columns[c] = scratch.data() + c * padded;
+    }
+
+    // Gather the changed options into contiguous lanes; padding repeats the last option
+    for (size_t lane = 0; lane < padded; ++lane) {
+        size_t option = options[std::min(lane, count - 1)];
+        columns[0][lane] = forwards[option];
+        columns[1][lane] = strikes[option];
+        columns[2][lane] = (expiries[option] - valuation_ms) / MS_PER_YEAR;
+        columns[3][lane] = signs[option];
+        columns[4][lane] = quotes[option];
+        columns[5][lane] = input_vols[option];
+    }
+
+    Lanes lanes{padded, columns[0], columns[1], columns[2], columns[3], columns[4], columns[5],
+        columns[6], columns[7], columns[8], columns[9], columns[10], columns[11]};
+    black76Kernel(lanes, rate);
+
+    for (size_t lane = 0; lane < count; ++lane) {
+        size_t option = options[lane];
+        vols[option] = lanes.vol[lane];
+        prices[option] = lanes.price[lane];
+        deltas[option] = lanes.delta[lane];
+        gammas[option] = lanes.gamma[lane];
+        vegas[option] = lanes.vega[lane];
+        thetas[option] = lanes.theta[lane];
+    }
+}
+
+size_t OptionsPricer::recompute(ThreadPool* pool) {
+    size_t count = dirty.size();
+    if (count == 0) return 0;
+
+    if (pool == nullptr || count < 2 * PARALLEL_CHUNK) {
+        computeRange(dirty.data(), count);
+    } else {
+        size_t chunks = std::min(pool->size() * 4, (count + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK);
+        size_t per_chunk = (count + chunks - 1) / chunks;
+        std::vector<std::future<void>> pending;
+        for (size_t begin = 0; begin < count; begin += per_chunk) {
+            size_t length = std::min(per_chunk, count - begin);
+            pending.push_back(pool->submit([this, begin, length] { computeRange(dirty.data() + begin, length); }));
+        }
+        for (std::future<void>& chunk : pending) {
+            chunk.get();
+        }
+    }
+
+    for (size_t option : dirty) {
+        is_dirty[option] = 0;
+    }
+    dirty.clear();
+    return count;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "instruments.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Batch Black-76 engine for every option of one currency. Strikes, call/put and expiries come
+// from the instrument table; forwards per expiry and option quotes are fed in as they change.
+// Only options whose inputs changed since the last recompute() are repriced, in SIMD lanes and
+// optionally split across a ThreadPool.
+//
+// Prices, forwards and strikes must be in the same currency. Deribit quotes options in the
+// base currency, so multiply those quotes by the forward before passing them to setQuote().
+class OptionsPricer {
+private:
+    std::vector<std::string> names;
+    std::unordered_map<std::string, size_t> index;
+    std::unordered_map<long long, std::vector<size_t>> by_expiry;
+
+    // Inputs, one entry per option
+    std::vector<double> strikes;
+    std::vector<double> signs;          // +1 call, -1 put
+    std::vector<long long> expiries;
+    std::vector<double> forwards;
+    std::vector<double> quotes;         // market premium, NaN if unknown
+    std::vector<double> input_vols;     // volatility used when there is no quote, NaN if unknown
+
+    // Outputs, NaN where the inputs are missing or admit no solution
+    std::vector<double> vols;
+    std::vector<double> prices;
+    std::vector<double> deltas;
+    std::vector<double> gammas;
+    std::vector<double> vegas;
+    std::vector<double> thetas;
+
+    std::vector<size_t> dirty;
+    std::vector<uint8_t> is_dirty;
+
+    double rate = 0;
+    long long valuation_ms = 0;
+
+    void markDirty(size_t option);
+    void markAllDirty();
+    void computeRange(const size_t* options, size_t count);
+
+public:
+    OptionsPricer(const std::unordered_map<std::string, Instrument>& instruments, const std::string& currency,
+        long long valuation_ms);
+
+    size_t size() const { return names.size(); }
+    const std::vector<std::string>& instrumentNames() const { return names; }
+    std::vector<long long> expiryTimestamps() const;
+
+    // Input updates; each marks only the affected options for repricing
+    void setForward(long long expiration_timestamp, double forward);
+    bool setQuote(const std::string& instrument_name, double premium);
+    bool setVolatility(const std::string& instrument_name, double volatility);
+    void setRate(double rate);
+    void setValuationTime(long long valuation_ms);
+
+    size_t pendingUpdates() const { return dirty.size(); }
+    // Reprice every option whose inputs changed; returns the number of options recomputed
+    size_t recompute(ThreadPool* pool = nullptr);
+
+    // Results by option index (see instrumentNames()) or by instrument name
+    size_t indexOf(const std::string& instrument_name) const;
+    double impliedVol(size_t option) const { return vols[option]; }
+    double price(size_t option) const { return prices[option]; }
+    double delta(size_t option) const { return deltas[option]; }
+    double gamma(size_t option) const { return gammas[option]; }
+    double vega(size_t option) const { return vegas[option]; }
+    double theta(size_t option) const { return thetas[option]; }
+};
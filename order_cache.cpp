@@ -0,0 +1,303 @@
+#include "order_cache.h"
+
+#include <mutex>
+
+namespace {
+
+const std::string& stringField(const JsonValue& object, const std::string& key) {
+    static const std::string empty;
+    const JsonObject& fields = object.get<JsonObject>();
+    auto it = fields.find(key);
+    if (it == fields.end() || !std::holds_alternative<std::string>(it->second.value)) {
+        return empty;
+    }
+    return it->second.get<std::string>();
+}
+
+double numberField(const JsonValue& object, const std::string& key) {
+    const JsonObject& fields = object.get<JsonObject>();
+    auto it = fields.find(key);
+    if (it == fields.end() || !std::holds_alternative<double>(it->second.value)) {
+        return 0.0;
+    }
+    return it->second.get<double>();
+}
+
+bool sameOrder(const JsonValue& a, const JsonValue& b) {
+    return stringField(a, "order_state") == stringField(b, "order_state") &&
+        numberField(a, "amount") == numberField(b, "amount") &&
+        numberField(a, "filled_amount") == numberField(b, "filled_amount") &&
+        numberField(a, "price") == numberField(b, "price");
+}
+
+double remaining(const JsonValue& order) {
+    return numberField(order, "amount") - numberField(order, "filled_amount");
+}
+
+JsonValue wrapResult(JsonValue result) {
+    JsonObject response;
+    response.emplace("result", std::move(result));
+    return JsonValue(std::move(response));
+}
+
+} // namespace
+
+bool OrderCache::isOpenState(const std::string& order_state) {
+    return order_state == "open" || order_state == "untriggered";
+}
+
+bool OrderCache::matchesType(const std::string& order_type, const std::string& type) {
+    if (type == "all") return true;
+    if (type == "trigger_all") {
+        return order_type == "stop_limit" || order_type == "stop_market" || order_type == "take_limit" ||
+            order_type == "take_market" || order_type == "trailing_stop";
+    }
+    // cancel_all_* spell the stop/take groups without the _all suffix
+    if (type == "stop_all" || type == "stop") return order_type == "stop_limit" || order_type == "stop_market";
+    if (type == "take_all" || type == "take") return order_type == "take_limit" || order_type == "take_market";
+    if (type == "trailing_all") return order_type == "trailing_stop";
+    return order_type == type;
+}
+
+void OrderCache::reportWorking(const CachedOrder& entry, double amount) {
+    if (on_working && amount != 0) {
+        on_working(entry.instrument_name, stringField(entry.order, "direction") == "buy", amount, numberField(entry.order, "price"));
+    }
+}
+
+void OrderCache::setWorkingListener(WorkingListener listener) {
+    std::unique_lock lock(mutex);
+    on_working = std::move(listener);
+    for (const auto& [order_id, entry] : orders) reportWorking(entry, remaining(entry.order));
+}
+
+void OrderCache::insert(const std::string& order_id, CachedOrder entry) {
+    erase(order_id);
+    tombstones.erase(order_id);
+    reportWorking(entry, remaining(entry.order));
+    by_instrument[entry.instrument_name].insert(order_id);
+    by_currency[entry.currency].insert(order_id);
+    if (!entry.label.empty()) by_label[entry.label].insert(order_id);
+    orders.emplace(order_id, std::move(entry));
+}
+
+void OrderCache::erase(const std::string& order_id) {
+    auto it = orders.find(order_id);
+    if (it == orders.end()) return;
+    reportWorking(it->second, -remaining(it->second.order));
+    by_instrument[it->second.instrument_name].erase(order_id);
+    by_currency[it->second.currency].erase(order_id);
+    if (!it->second.label.empty()) {
+        auto index = by_label.find(it->second.label);
+        index->second.erase(order_id);
+        if (index->second.empty()) by_label.erase(index);
+    }
+    orders.erase(it);
+    if (pending_reconciles != 0) tombstones[order_id] = seq;
+}
+
+void OrderCache::applyOrder(const JsonValue& order, const Instrument& instrument) {
+    const std::string& order_id = stringField(order, "order_id");
+    if (order_id.empty()) return;
+
+    std::unique_lock lock(mutex);
+    ++seq;
+    if (!isOpenState(stringField(order, "order_state"))) {
+        erase(order_id);
+        return;
+    }
+    insert(order_id, CachedOrder{order, stringField(order, "instrument_name"), instrument.settlement_currency, instrument.kind,
+        stringField(order, "label"), seq});
+}
+
+void OrderCache::applyTrade(const JsonValue& trade) {
+    const std::string& order_id = stringField(trade, "order_id");
+
+    std::unique_lock lock(mutex);
+    ++seq;
+    auto it = orders.find(order_id);
+    if (it == orders.end()) return;
+
+    if (stringField(trade, "state") == "filled") {
+        erase(order_id);
+        return;
+    }
+    reportWorking(it->second, -numberField(trade, "amount"));
+    JsonObject& fields = std::get<JsonObject>(it->second.order.value);
+    fields["filled_amount"] = JsonValue(numberField(it->second.order, "filled_amount") + numberField(trade, "amount"));
+    it->second.seq = seq;
+}
+
+void OrderCache::eraseAll() {
+    std::unique_lock lock(mutex);
+    ++seq;
+    for (const auto& [order_id, entry] : orders) {
+        reportWorking(entry, -remaining(entry.order));
+        if (pending_reconciles != 0) tombstones[order_id] = seq;
+    }
+    orders.clear();
+    by_instrument.clear();
+    by_currency.clear();
+    by_label.clear();
+}
+
+void OrderCache::eraseByCurrency(const std::string& currency, const std::string& kind, const std::string& type) {
+    std::unique_lock lock(mutex);
+    ++seq;
+    auto index = by_currency.find(currency);
+    if (index == by_currency.end()) return;
+
+    std::unordered_set<std::string> ids = index->second;
+    for (const std::string& order_id : ids) {
+        const CachedOrder& entry = orders.at(order_id);
+        if ((kind == "any" || kind == entry.kind) && matchesType(stringField(entry.order, "order_type"), type)) {
+            erase(order_id);
+        }
+    }
+}
+
+void OrderCache::eraseByInstrument(const std::string& instrument_name, const std::string& type) {
+    std::unique_lock lock(mutex);
+    ++seq;
+    auto index = by_instrument.find(instrument_name);
+    if (index == by_instrument.end()) return;
+
+    std::unordered_set<std::string> ids = index->second;
+    for (const std::string& order_id : ids) {
+        if (matchesType(stringField(orders.at(order_id).order, "order_type"), type)) {
+            erase(order_id);
+        }
+    }
+}
+
+uint64_t OrderCache::beginReconcile() {
+    std::unique_lock lock(mutex);
+    ++pending_reconciles;
+    return seq;
+}
+
+void OrderCache::abandonReconcile() {
+    std::unique_lock lock(mutex);
+    if (--pending_reconciles == 0) tombstones.clear();
+}
+
+size_t OrderCache::reconcile(const JsonArray& open_orders, uint64_t since_seq, const InstrumentRegistry& instruments) {
+    std::unique_lock lock(mutex);
+    size_t differences = 0;
+
+    std::unordered_set<std::string> seen;
+    for (const JsonValue& order : open_orders) {
+        const std::string& order_id = stringField(order, "order_id");
+        seen.insert(order_id);
+
+        auto it = orders.find(order_id);
+        if (it != orders.end() && it->second.seq > since_seq) continue;
+        // Cancelled or filled since the snapshot was taken
+        auto tombstone = tombstones.find(order_id);
+        if (it == orders.end() && tombstone != tombstones.end() && tombstone->second > since_seq) continue;
+        if (it == orders.end() || !sameOrder(it->second.order, order)) ++differences;
+
+        const std::string& instrument_name = stringField(order, "instrument_name");
+        const Instrument* instrument = instruments.find(instrument_name);
+        if (!instrument) continue;
+        insert(order_id, CachedOrder{order, instrument_name, instrument->settlement_currency, instrument->kind,
+            stringField(order, "label"), since_seq});
+    }
+
+    // Orders we think are open but the exchange no longer reports
+    std::vector<std::string> stale;
+    for (const auto& [order_id, entry] : orders) {
+        if (entry.seq <= since_seq && seen.find(order_id) == seen.end()) stale.push_back(order_id);
+    }
+    for (const std::string& order_id : stale) {
+        erase(order_id);
+        ++differences;
+    }
+
+    // Kept while another reconcile, possibly begun earlier, is still fetching
+    if (--pending_reconciles == 0) tombstones.clear();
+    synced = true;
+    drift.fetch_add(differences, std::memory_order_relaxed);
+    return differences;
+}
+
+bool OrderCache::isSynced() const {
+    std::shared_lock lock(mutex);
+    return synced;
+}
+
+size_t OrderCache::size() const {
+    std::shared_lock lock(mutex);
+    return orders.size();
+}
+
+JsonValue OrderCache::collect(const std::unordered_set<std::string>* ids, const std::string& kind, const std::string& type) const {
+    JsonArray result;
+    auto accept = [&](const CachedOrder& entry) {
+        if ((kind.empty() || kind == "any" || kind == entry.kind) && matchesType(stringField(entry.order, "order_type"), type)) {
+            result.push_back(entry.order);
+        }
+    };
+    if (ids == nullptr) {
+        for (const auto& [order_id, entry] : orders) accept(entry);
+    } else {
+        for (const std::string& order_id : *ids) accept(orders.at(order_id));
+    }
+    return wrapResult(JsonValue(std::move(result)));
+}
+
+JsonValue OrderCache::getOpenOrders(const std::string& kind, const std::string& type) const {
+    std::shared_lock lock(mutex);
+    return collect(nullptr, kind, type);
+}
+
+JsonValue OrderCache::getOpenOrdersByCurrency(const std::string& currency, const std::string& kind, const std::string& type) const {
+    static const std::unordered_set<std::string> none;
+    std::shared_lock lock(mutex);
+    auto index = by_currency.find(currency);
+    return collect(index == by_currency.end() ? &none : &index->second, kind, type);
+}
+
+JsonValue OrderCache::getOpenOrdersByInstrument(const std::string& instrument_name, const std::string& type) const {
+    static const std::unordered_set<std::string> none;
+    std::shared_lock lock(mutex);
+    auto index = by_instrument.find(instrument_name);
+    return collect(index == by_instrument.end() ? &none : &index->second, "", type);
+}
+
+JsonValue OrderCache::getOrderState(const std::string& order_id) const {
+    std::shared_lock lock(mutex);
+    auto it = orders.find(order_id);
+    if (it == orders.end()) return JsonValue();
+    return wrapResult(it->second.order);
+}
+
+JsonValue OrderCache::getOpenOrdersByLabel(const std::string& currency, const std::string& label) const {
+    std::shared_lock lock(mutex);
+    JsonArray result;
+    auto index = by_label.find(label);
+    if (index != by_label.end()) {
+        for (const std::string& order_id : index->second) {
+            const CachedOrder& entry = orders.at(order_id);
+            if (entry.currency == currency) result.push_back(entry.order);
+        }
+    }
+    return wrapResult(JsonValue(std::move(result)));
+}
+
+std::vector<std::string> OrderCache::orderIdsByLabel(const std::string& label, const std::string& currency,
+    const std::string& instrument_name) const {
+    std::shared_lock lock(mutex);
+    std::vector<std::string> ids;
+    auto index = by_label.find(label);
+    if (index == by_label.end()) return ids;
+
+    for (const std::string& order_id : index->second) {
+        const CachedOrder& entry = orders.at(order_id);
+        if ((currency.empty() || entry.currency == currency) &&
+            (instrument_name.empty() || entry.instrument_name == instrument_name)) {
+            ids.push_back(order_id);
+        }
+    }
+    return ids;
+}
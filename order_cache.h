@@ -0,0 +1,93 @@
+#pragma once
+
+#include "json_parser.h"
+#include "instrument_registry.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// In-process mirror of our open orders. It is fed with the order objects returned by
+// buy/sell/edit/cancel and pushed on the user.orders/user.trades channels, and indexed by
+// order_id, instrument, currency and label so open-order queries never leave the process.
+// Query results have the same {"result": ...} shape as the REST responses.
+class OrderCache {
+public:
+    // Hears how much an order's remaining amount adds to (or, negative, takes from) the working
+    // amount on its instrument and side, with the order's price: 0 for market orders
+    using WorkingListener = std::function<void(const std::string& instrument_name, bool isBuy, double amount, double price)>;
+
+private:
+    struct CachedOrder {
+        JsonValue order;
+        std::string instrument_name;
+        std::string currency;           // settlement currency, as the by-currency requests filter
+        std::string kind;
+        std::string label;
+        uint64_t seq = 0;
+    };
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, CachedOrder> orders;
+    std::unordered_map<std::string, std::unordered_set<std::string>> by_instrument;
+    std::unordered_map<std::string, std::unordered_set<std::string>> by_currency;
+    std::unordered_map<std::string, std::unordered_set<std::string>> by_label;
+    uint64_t seq = 0;
+    // Ids erased while a reconcile is pending, with the seq of their erase: a snapshot taken
+    // before that still lists them
+    std::unordered_map<std::string, uint64_t> tombstones;
+    size_t pending_reconciles = 0;
+    bool synced = false;
+    std::atomic<uint64_t> drift = 0;
+    WorkingListener on_working;
+
+    void reportWorking(const CachedOrder& entry, double amount);
+    void insert(const std::string& order_id, CachedOrder entry);
+    void erase(const std::string& order_id);
+    JsonValue collect(const std::unordered_set<std::string>* ids, const std::string& kind, const std::string& type) const;
+
+public:
+    static bool isOpenState(const std::string& order_state);
+    static bool matchesType(const std::string& order_type, const std::string& type);
+
+    // Set before sharing the cache; the listener first hears about the orders already open.
+    // It runs under the cache's lock.
+    void setWorkingListener(WorkingListener listener);
+
+    // Apply an order object; orders that are no longer open are dropped from the cache
+    void applyOrder(const JsonValue& order, const Instrument& instrument);
+    // Apply a trade from user.trades; fills update filled_amount and close filled orders
+    void applyTrade(const JsonValue& trade);
+
+    // Drop cached orders after a successful mass cancel
+    void eraseAll();
+    void eraseByCurrency(const std::string& currency, const std::string& kind = "any", const std::string& type = "all");
+    void eraseByInstrument(const std::string& instrument_name, const std::string& type = "all");
+
+    // Reconciliation: take a sequence number, fetch the REST snapshot, then hand it to
+    // reconcile(), or to abandonReconcile() if the fetch failed. Orders applied or erased after
+    // beginReconcile() are newer than the snapshot and kept as they are.
+    // Returns the number of orders that differed between the cache and the exchange.
+    uint64_t beginReconcile();
+    size_t reconcile(const JsonArray& open_orders, uint64_t since_seq, const InstrumentRegistry& instruments);
+    void abandonReconcile();
+
+    bool isSynced() const;
+    uint64_t driftCount() const { return drift.load(std::memory_order_relaxed); }
+    size_t size() const;
+
+    JsonValue getOpenOrders(const std::string& kind = "", const std::string& type = "all") const;
+    JsonValue getOpenOrdersByCurrency(const std::string& currency, const std::string& kind = "", const std::string& type = "all") const;
+    JsonValue getOpenOrdersByInstrument(const std::string& instrument_name, const std::string& type = "all") const;
+    JsonValue getOpenOrdersByLabel(const std::string& currency, const std::string& label) const;
+    // Null JsonValue if the order is not open in the cache
+    JsonValue getOrderState(const std::string& order_id) const;
+
+    // Open order ids carrying a label, optionally narrowed to a currency or instrument
+    std::vector<std::string> orderIdsByLabel(const std::string& label, const std::string& currency = "",
+        const std::string& instrument_name = "") const;
+};
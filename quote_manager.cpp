@@ -0,0 +1,205 @@
+#include "quote_manager.h"
+#include "logger.h"
+
+#include <future>
+#include <optional>
+#include <vector>
+
+namespace {
+
+// Exchange error codes for an order that is no longer on the book
+constexpr int ORDER_NOT_FOUND = 10004;
+constexpr int NOT_OPEN_ORDER = 11044;
+
+// The order object of a buy/sell/edit response, or nullptr if it has none
+const JsonValue* responseOrder(const JsonValue& response) {
+    if (!std::holds_alternative<JsonObject>(response.value)) return nullptr;
+    const JsonObject& fields = response.get<JsonObject>();
+    auto result = fields.find("result");
+    if (result == fields.end()) return nullptr;
+    const JsonValue& payload = result->second;
+    // Cancels answer with the order itself, the others with {"order": ..., "trades": ...}
+    if (std::holds_alternative<JsonObject>(payload.value) && payload.get<JsonObject>().count("order")) {
+        return &payload.at("order");
+    }
+    return &payload;
+}
+
+// The request failed because the order is already gone: filled, cancelled or never known
+bool orderGone(const TradingError& error) {
+    return error.code == ErrorCode::Exchange &&
+        (error.exchange_code == NOT_OPEN_ORDER || error.exchange_code == ORDER_NOT_FOUND);
+}
+
+} // namespace
+
+QuoteManager::QuoteManager(TradingSystem& trading, QuoteOptions options)
+    : trading(trading), options(options), senders(options.max_in_flight) {}
+
+void QuoteManager::markTouched(const Slot& slot) {
+    ++requested;
+    if (!touched.insert(slot).second) {
+        ++superseded;
+    }
+}
+
+void QuoteManager::setQuote(const std::string& instrument_name, bool isBuy, int level, int price, int amount) {
+    if (amount <= 0) {
+        removeQuote(instrument_name, isBuy, level);
+        return;
+    }
+    std::lock_guard lock(mutex);
+    Slot slot{instrument_name, isBuy, level};
+    markTouched(slot);
+    desired[slot] = DesiredQuote{price, amount};
+}
+
+void QuoteManager::removeQuote(const std::string& instrument_name, bool isBuy, int level) {
+    std::lock_guard lock(mutex);
+    Slot slot{instrument_name, isBuy, level};
+    markTouched(slot);
+    desired.erase(slot);
+}
+
+void QuoteManager::removeAll() {
+    std::lock_guard lock(mutex);
+    for (const auto& [slot, quote] : desired) {
+        markTouched(slot);
+    }
+    desired.clear();
+}
+
+size_t QuoteManager::liveQuotes() {
+    std::lock_guard lock(mutex);
+    return live.size();
+}
+
+void QuoteManager::dropFilledQuotes() {
+    // With a synced order cache, quotes that were filled or cancelled elsewhere are re-placed
+    const OrderCache& cache = trading.orderCache();
+    if (!cache.isSynced()) return;
+    for (auto it = live.begin(); it != live.end();) {
+        if (cache.getOrderState(it->second.order_id).isNull()) {
+            it = live.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QuoteCycleStats QuoteManager::cycle() {
+    enum class Action { Place, Edit, Cancel };
+    struct Message {
+        Action action;
+        Slot slot;
+        DesiredQuote target;
+        std::string order_id;
+    };
+
+    std::lock_guard cycle_lock(cycling);
+    QuoteCycleStats stats;
+    std::vector<Message> messages;
+    {
+        std::lock_guard lock(mutex);
+        dropFilledQuotes();
+
+        stats.requested = requested;
+        stats.superseded = superseded;
+        requested = 0;
+        superseded = 0;
+
+        for (const auto& [slot, target] : desired) {
+            auto current = live.find(slot);
+            if (current == live.end()) {
+                messages.push_back(Message{Action::Place, slot, target, ""});
+            } else if (current->second.price != target.price || current->second.amount != target.amount) {
+                messages.push_back(Message{Action::Edit, slot, target, current->second.order_id});
+            } else if (touched.count(slot) != 0) {
+                ++stats.unchanged;
+            }
+        }
+        for (const auto& [slot, current] : live) {
+            if (desired.find(slot) == desired.end()) {
+                messages.push_back(Message{Action::Cancel, slot, DesiredQuote{0, 0}, current.order_id});
+            }
+        }
+        touched.clear();
+    }
+
+    int post_only = options.post_only ? 1 : -1;
+    int mmp = options.mmp ? 1 : -1;
+    std::vector<std::future<Result<JsonValue>>> responses;
+    for (const Message& message : messages) {
+        responses.push_back(senders.submit([this, &message, post_only, mmp]() {
+            const std::string& instrument_name = std::get<0>(message.slot);
+            bool isBuy = std::get<1>(message.slot);
+            switch (message.action) {
+                case Action::Place:
+                    if (isBuy) {
+                        return trading.tryBuy(instrument_name, message.target.amount, 0, "limit", options.label,
+                            message.target.price, "", -1, post_only, -1, -1, -1, -1, "", "", mmp);
+                    }
+                    return trading.trySell(instrument_name, message.target.amount, 0, "limit", options.label,
+                        message.target.price, "", -1, post_only, -1, -1, -1, -1, "", "", mmp);
+                case Action::Edit:
+                    return trading.tryEdit(message.order_id, message.target.amount, -1, message.target.price, post_only);
+                case Action::Cancel:
+                    return trading.tryCancel(message.order_id);
+            }
+            return Result<JsonValue>::failure(ErrorCode::Validation, "Unknown quote action");
+        }));
+    }
+
+    for (size_t i = 0; i < messages.size(); ++i) {
+        const Message& message = messages[i];
+        std::optional<Result<JsonValue>> response;
+        std::string failure;
+        try {
+            response.emplace(responses[i].get());
+        } catch (const std::exception& e) {
+            failure = e.what();
+        }
+        if (!response) response.emplace(Result<JsonValue>::failure(ErrorCode::Transport, failure));
+
+        std::lock_guard lock(mutex);
+        if (!*response) {
+            const TradingError& error = response->error();
+            if (message.action != Action::Place && orderGone(error)) {
+                // Nothing left to edit or cancel; a desired quote is placed afresh next cycle
+                live.erase(message.slot);
+                if (message.action == Action::Cancel) ++stats.cancelled;
+                else ++stats.edited;
+                continue;
+            }
+            // The order may still be resting: keep tracking it, so the next cycle retries the edit
+            // or cancel instead of placing a second quote beside it
+            logging::error("Quote update failed: {}", error.message);
+            ++stats.failed;
+            continue;
+        }
+
+        const JsonValue* order = responseOrder(response->value());
+        bool open = order != nullptr && OrderCache::isOpenState(order->at("order_state").get<std::string>());
+        if (message.action == Action::Cancel) {
+            if (open) {
+                ++stats.failed;
+            } else {
+                live.erase(message.slot);
+                ++stats.cancelled;
+            }
+            continue;
+        }
+        if (message.action == Action::Place) {
+            ++stats.placed;
+        } else {
+            ++stats.edited;
+        }
+        if (!open) {
+            // Rejected (e.g. post_only would have crossed) or filled: re-evaluate next cycle
+            live.erase(message.slot);
+            continue;
+        }
+        live[message.slot] = LiveQuote{order->at("order_id").get<std::string>(), message.target.price, message.target.amount};
+    }
+    return stats;
+}
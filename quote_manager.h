@@ -0,0 +1,80 @@
+#pragma once
+
+#include "trading_system.h"
+#include "thread_pool.h"
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
+
+struct QuoteOptions {
+    bool post_only = true;
+    bool mmp = false;
+    std::string label = "";
+    size_t max_in_flight = 4;   // messages sent concurrently per cycle
+};
+
+// Message accounting for one cycle(). `requested` is what sending every setQuote/removeQuote
+// call straight to the exchange would have cost; `saved` is the difference to what we sent.
+struct QuoteCycleStats {
+    int requested = 0;
+    int superseded = 0;
+    int unchanged = 0;
+    int placed = 0;
+    int edited = 0;
+    int cancelled = 0;
+    int failed = 0;         // sent but not applied; the quote is retried next cycle
+
+    int sent() const { return placed + edited + cancelled + failed; }
+    int saved() const { return requested - sent(); }
+};
+
+// Market-making quote manager. Strategies set the desired quote per (instrument, side, level)
+// whenever fair value moves; cycle() compares the desired set with our live quotes and sends
+// only the new orders, edits and cancels needed to converge. Updates to a level made between
+// cycles collapse into the latest one.
+class QuoteManager {
+private:
+    using Slot = std::tuple<std::string, bool, int>;  // instrument, isBuy, level
+
+    struct DesiredQuote {
+        int price;
+        int amount;
+    };
+
+    struct LiveQuote {
+        std::string order_id;
+        int price;
+        int amount;
+    };
+
+    TradingSystem& trading;
+    QuoteOptions options;
+    ThreadPool senders;
+
+    std::mutex cycling;     // one cycle at a time
+    std::mutex mutex;       // guards the maps below
+    std::map<Slot, DesiredQuote> desired;
+    std::map<Slot, LiveQuote> live;
+    std::set<Slot> touched; // slots updated since the last cycle
+    int requested = 0;
+    int superseded = 0;
+
+    void markTouched(const Slot& slot);
+    void dropFilledQuotes();
+
+public:
+    QuoteManager(TradingSystem& trading, QuoteOptions options = QuoteOptions());
+
+    // A zero amount is the same as removeQuote
+    void setQuote(const std::string& instrument_name, bool isBuy, int level, int price, int amount);
+    void removeQuote(const std::string& instrument_name, bool isBuy, int level);
+    void removeAll();
+
+    // Send the minimal set of messages that makes the live quotes match the desired ones
+    QuoteCycleStats cycle();
+
+    size_t liveQuotes();
+};
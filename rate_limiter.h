@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+struct RateLimit {
+    double per_second = 0;      // sustained requests per second; 0 means unlimited
+    double burst = 1;           // requests that may go back to back after an idle period
+};
+
+// Per-account request budget as a token bucket, kept as a single atomic "theoretical arrival
+// time" (GCRA): a request is allowed if it arrives no earlier than burst intervals before the
+// time the previous ones have used up. Safe to share between threads without locks.
+class RateLimiter {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<int64_t> next_free{0};      // ns on Clock; budget is used up until here
+    int64_t interval = 0;                   // ns per request
+    int64_t tolerance = 0;                  // ns of budget that may be taken ahead
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    // Reserves the next request and returns how long the caller must wait for it, or the wait
+    // without reserving when `wait` is false and it would be positive
+    int64_t reserve(bool wait) {
+        int64_t current = now();
+        int64_t free = next_free.load(std::memory_order_relaxed);
+        while (true) {
+            int64_t start = std::max(free, current);
+            int64_t delay = start - tolerance - current;
+            if (delay > 0 && !wait) return delay;
+            if (next_free.compare_exchange_weak(free, start + interval, std::memory_order_relaxed)) {
+                return std::max<int64_t>(delay, 0);
+            }
+        }
+    }
+
+public:
+    explicit RateLimiter(RateLimit limit = RateLimit()) {
+        if (limit.per_second > 0) {
+            interval = int64_t(1e9 / limit.per_second);
+            tolerance = int64_t(interval * std::max(limit.burst - 1, 0.0));
+        }
+    }
+
+    bool limited() const { return interval != 0; }
+
+    // Take one request's budget if it is available now
+    bool tryAcquire() {
+        return interval == 0 || reserve(false) == 0;
+    }
+
+    // Take one request's budget, sleeping until it is available
+    void acquire() {
+        if (interval == 0) return;
+        int64_t delay = reserve(true);
+        if (delay > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(delay));
+    }
+};
@@ -0,0 +1,58 @@
+#include "rcu.h"
+
+namespace rcu {
+
+std::atomic<uint64_t> detail::global_epoch{1};
+
+namespace {
+
+// Slots of every thread that has read, kept until the thread has exited
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<detail::Slot>> slots;
+};
+
+Registry& registry() {
+    // Leaked, so that threads exiting after static destruction can still close their slot
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+struct ThreadSlot {
+    std::shared_ptr<detail::Slot> slot = std::make_shared<detail::Slot>();
+
+    ThreadSlot() {
+        std::lock_guard lock(registry().mutex);
+        registry().slots.push_back(slot);
+    }
+    ~ThreadSlot() {
+        slot->closed.store(true, std::memory_order_release);
+    }
+};
+
+} // namespace
+
+detail::Slot& detail::threadSlot() {
+    thread_local ThreadSlot local;
+    return *local.slot;
+}
+
+uint64_t advance() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return detail::global_epoch.fetch_add(1, std::memory_order_seq_cst);
+}
+
+bool quiescent(uint64_t epoch) {
+    std::lock_guard lock(registry().mutex);
+    std::erase_if(registry().slots, [](const std::shared_ptr<detail::Slot>& slot) {
+        return slot->closed.load(std::memory_order_acquire);
+    });
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (const std::shared_ptr<detail::Slot>& slot : registry().slots) {
+        uint64_t entered = slot->epoch.load(std::memory_order_acquire);
+        if (entered != 0 && entered <= epoch) return false;
+    }
+    return true;
+}
+
+} // namespace rcu
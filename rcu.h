@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Epoch-based read-copy-update. Readers mark the epoch they entered in a slot of their own and
+// read the current pointer without locks, counters on shared cache lines or waiting. Writers
+// publish a new version with a pointer swap and retire the old one; it is freed once every
+// reader that could have seen it has left its read section.
+namespace rcu {
+
+namespace detail {
+
+struct Slot {
+    std::atomic<uint64_t> epoch{0};     // epoch of the current read section, 0 outside
+    uint32_t depth = 0;                 // nested read sections, owner thread only
+    std::atomic<bool> closed{false};    // owning thread has exited
+};
+
+Slot& threadSlot();
+extern std::atomic<uint64_t> global_epoch;
+
+} // namespace detail
+
+// Scoped read section. Pointers loaded from a Cell inside it stay valid until it ends; sections
+// nest, and only the outermost one is visible to writers.
+class ReadSection {
+private:
+    detail::Slot& slot;
+
+public:
+    ReadSection() : slot(detail::threadSlot()) {
+        if (slot.depth++ == 0) {
+            slot.epoch.store(detail::global_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+            // The epoch must be visible to writers before the pointer is read
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+    ~ReadSection() {
+        if (--slot.depth == 0) slot.epoch.store(0, std::memory_order_release);
+    }
+
+    ReadSection(const ReadSection&) = delete;
+    ReadSection& operator=(const ReadSection&) = delete;
+};
+
+// Start a new epoch and return the last one in which a reader could have seen what was just
+// unpublished
+uint64_t advance();
+// True once no reader is still in a section entered at or before `epoch`
+bool quiescent(uint64_t epoch);
+
+// One RCU-protected value. Versions are owned through shared_ptr, so a reader that needs one
+// beyond its read section takes a snapshot() instead.
+template<typename T>
+class Cell {
+private:
+    std::atomic<const T*> current{nullptr};
+    mutable std::mutex mutex;               // writers and snapshot()
+    std::shared_ptr<const T> owner;
+    struct Retired {
+        std::shared_ptr<const T> version;
+        uint64_t epoch;
+    };
+    std::vector<Retired> retired;
+
+public:
+    explicit Cell(std::shared_ptr<const T> initial = nullptr) : current(initial.get()), owner(std::move(initial)) {}
+
+    // A read lock guard and the current version in one
+    class Reader {
+    private:
+        ReadSection section;
+        const T* value;
+
+    public:
+        explicit Reader(const Cell& cell) : value(cell.current.load(std::memory_order_acquire)) {}
+        const T* operator->() const { return value; }
+        const T& operator*() const { return *value; }
+        const T* get() const { return value; }
+    };
+
+    Reader read() const { return Reader(*this); }
+
+    std::shared_ptr<const T> snapshot() const {
+        std::lock_guard lock(mutex);
+        return owner;
+    }
+
+    // Make `next` current; the previous version is freed by a later reclaim()
+    void publish(std::shared_ptr<const T> next) {
+        std::lock_guard lock(mutex);
+        current.store(next.get(), std::memory_order_seq_cst);
+        retired.push_back({std::move(owner), advance()});
+        owner = std::move(next);
+    }
+
+    // Free retired versions no reader can still see; returns how many are left
+    size_t reclaim() {
+        std::lock_guard lock(mutex);
+        std::erase_if(retired, [](const Retired& old) { return quiescent(old.epoch); });
+        return retired.size();
+    }
+};
+
+} // namespace rcu
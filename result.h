@@ -0,0 +1,90 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <variant>
+
+// Why a request produced no result
+enum class ErrorCode : uint8_t {
+    Validation,     // rejected locally (parameters, risk limits) before anything was sent
+    Transport,      // the request did not complete: connection failure, timeout
+    Exchange,       // the exchange answered with an error
+    Parse,          // the response was not the JSON expected
+};
+
+inline const char* errorCodeString(ErrorCode code) {
+    switch (code) {
+        case ErrorCode::Validation: return "validation";
+        case ErrorCode::Transport: return "transport";
+        case ErrorCode::Exchange: return "exchange";
+        case ErrorCode::Parse: return "parse";
+    }
+    return "unknown";
+}
+
+struct TradingError {
+    ErrorCode code = ErrorCode::Validation;
+    int exchange_code = 0;      // the exchange's own error code, for Exchange
+    std::string message;
+    JsonValue response;         // the whole error response, for Exchange
+};
+
+// A value or the error that prevented it. Errors are returned, not thrown, so a rejected or
+// timed-out request costs the same as a successful one and callers branch on ok().
+template<typename T>
+class Result {
+private:
+    std::variant<T, TradingError> state;
+
+public:
+    Result(T value) : state(std::in_place_index<0>, std::move(value)) {}
+    Result(TradingError error) : state(std::in_place_index<1>, std::move(error)) {}
+
+    static Result failure(ErrorCode code, std::string message) {
+        TradingError error;
+        error.code = code;
+        error.message = std::move(message);
+        return Result(std::move(error));
+    }
+
+    bool ok() const { return state.index() == 0; }
+    explicit operator bool() const { return ok(); }
+
+    // Only valid when ok()
+    const T& value() const { return *std::get_if<0>(&state); }
+    T& value() { return *std::get_if<0>(&state); }
+    // Only valid when !ok()
+    const TradingError& error() const { return *std::get_if<1>(&state); }
+
+    T valueOr(T fallback) const { return ok() ? value() : std::move(fallback); }
+};
+
+// A decoded response: the exchange's {"error": {"code", "message"}} as an Exchange failure that
+// keeps the whole response, anything else as the value
+inline Result<JsonValue> exchangeResult(JsonValue response) {
+    if (std::holds_alternative<JsonObject>(response.value)) {
+        const JsonObject& fields = response.get<JsonObject>();
+        auto error = fields.find("error");
+        if (error != fields.end()) {
+            TradingError failure;
+            failure.code = ErrorCode::Exchange;
+            if (std::holds_alternative<JsonObject>(error->second.value)) {
+                const JsonObject& details = error->second.get<JsonObject>();
+                auto code = details.find("code");
+                auto message = details.find("message");
+                if (code != details.end() && std::holds_alternative<double>(code->second.value)) {
+                    failure.exchange_code = int(code->second.get<double>());
+                }
+                if (message != details.end() && std::holds_alternative<std::string>(message->second.value)) {
+                    failure.message = message->second.get<std::string>();
+                }
+            }
+            failure.response = std::move(response);
+            return failure;
+        }
+    }
+    return response;
+}
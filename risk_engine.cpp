@@ -0,0 +1,237 @@
+#include "risk_engine.h"
+
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+constexpr size_t MAX_SEEN_TRADES = 4096;
+constexpr int64_t RATE_WINDOW_NS = 1000000000;
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Reject only when the order takes the position past the limit and further away from flat
+bool breachesLimit(double current, double delta, double limit) {
+    double projected = current + delta;
+    return limit > 0 && std::abs(projected) > limit && std::abs(projected) > std::abs(current);
+}
+
+} // namespace
+
+const char* riskResultString(RiskResult result) {
+    switch (result) {
+        case RiskResult::Ok: return "ok";
+        case RiskResult::OrderTooLarge: return "order amount exceeds the maximum order size";
+        case RiskResult::InstrumentPositionLimit: return "instrument position limit exceeded";
+        case RiskResult::CurrencyPositionLimit: return "currency position limit exceeded";
+        case RiskResult::PriceOutsideBand: return "price is outside the allowed band around the reference price";
+        case RiskResult::RateLimited: return "order rate limit exceeded";
+        case RiskResult::UnknownInstrument: return "instrument is unknown to the risk engine";
+        case RiskResult::NoConversionPrice: return "no price to convert the USD amount for the currency limit";
+    }
+    return "unknown";
+}
+
+RiskEngine::RiskEngine(const std::unordered_map<std::string, Instrument>& instrument_table, RiskLimits limits)
+    : limits(limits) {
+    auto initial = std::make_shared<Tables>();
+    for (const auto& [instrument_name, instrument] : instrument_table) {
+        insert(*initial, instrument_name, instrument);
+    }
+    tables.publish(std::move(initial));
+}
+
+void RiskEngine::insert(Tables& tables, const std::string& instrument_name, const Instrument& instrument) {
+    std::shared_ptr<CurrencyState>& currency = tables.currencies[instrument.base_currency];
+    if (!currency) currency = std::make_shared<CurrencyState>();
+    auto state = std::make_shared<InstrumentState>();
+    state->usd_amounts = (instrument.kind == "future" || instrument.kind == "future_combo") && instrument.quote_currency == "USD";
+    state->currency = currency.get();
+    tables.instruments.emplace(instrument_name, std::move(state));
+}
+
+void RiskEngine::addInstrument(const std::string& instrument_name, const Instrument& instrument) {
+    std::lock_guard lock(adding);
+    std::shared_ptr<const Tables> current = tables.snapshot();
+    if (current->instruments.count(instrument_name)) return;
+    auto next = std::make_shared<Tables>(*current);
+    insert(*next, instrument_name, instrument);
+    tables.publish(std::move(next));
+    tables.reclaim();
+}
+
+RiskEngine::Reservation::Reservation(Reservation&& other) noexcept {
+    *this = std::move(other);
+}
+
+RiskEngine::Reservation& RiskEngine::Reservation::operator=(Reservation&& other) noexcept {
+    if (this != &other) {
+        release();
+        working = std::exchange(other.working, nullptr);
+        currency_working = std::exchange(other.currency_working, nullptr);
+        amount = other.amount;
+        currency_amount = other.currency_amount;
+    }
+    return *this;
+}
+
+void RiskEngine::Reservation::release() {
+    if (working) working->fetch_sub(amount, std::memory_order_relaxed);
+    if (currency_working) currency_working->fetch_sub(currency_amount, std::memory_order_relaxed);
+    working = nullptr;
+    currency_working = nullptr;
+}
+
+RiskResult RiskEngine::checkRate() {
+    if (limits.max_orders_per_second <= 0) return RiskResult::Ok;
+
+    int64_t now = nowNs();
+    int64_t start = window_start_ns.load(std::memory_order_relaxed);
+    if (now - start >= RATE_WINDOW_NS && window_start_ns.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+        window_orders.store(0, std::memory_order_relaxed);
+    }
+    if (window_orders.fetch_add(1, std::memory_order_relaxed) >= limits.max_orders_per_second) {
+        return RiskResult::RateLimited;
+    }
+    return RiskResult::Ok;
+}
+
+RiskResult RiskEngine::checkPosition(const std::string& instrument_name, bool isBuy, double amount, double added, double price,
+    Reservation* reservation) {
+    if (limits.max_order_amount > 0 && amount > limits.max_order_amount) {
+        return RiskResult::OrderTooLarge;
+    }
+
+    auto current = tables.read();
+    auto it = current->instruments.find(instrument_name);
+    if (it == current->instruments.end()) {
+        return RiskResult::UnknownInstrument;
+    }
+    InstrumentState& state = *it->second;
+    CurrencyState& currency = *state.currency;
+    double reference = state.reference_price.load(std::memory_order_relaxed);
+    // Released on every failed check below
+    Reservation held;
+    if (added > 0) {
+        double sign = isBuy ? 1 : -1;
+        // Measured from the position with every open order on this side filled. A reserving check
+        // adds its amount before comparing, so concurrent checks each count the others' orders.
+        std::atomic<double>& working = isBuy ? state.working_buy : state.working_sell;
+        double before = reservation ? working.fetch_add(added, std::memory_order_relaxed) : working.load(std::memory_order_relaxed);
+        if (reservation) {
+            held.working = &working;
+            held.amount = added;
+        }
+        if (breachesLimit(state.position.load(std::memory_order_relaxed) + sign * before, sign * added, limits.max_instrument_position)) {
+            return RiskResult::InstrumentPositionLimit;
+        }
+        double conversion = price > 0 ? price : reference;
+        if (limits.max_currency_position > 0 && state.usd_amounts && !(conversion > 0)) {
+            return RiskResult::NoConversionPrice;
+        }
+        double currency_added = state.inCurrency(added, conversion);
+        std::atomic<double>& currency_working = isBuy ? currency.working_buy : currency.working_sell;
+        double currency_before = reservation ? currency_working.fetch_add(currency_added, std::memory_order_relaxed)
+                                             : currency_working.load(std::memory_order_relaxed);
+        if (reservation) {
+            held.currency_working = &currency_working;
+            held.currency_amount = currency_added;
+        }
+        if (breachesLimit(currency.position.load(std::memory_order_relaxed) + sign * currency_before, sign * currency_added,
+                limits.max_currency_position)) {
+            return RiskResult::CurrencyPositionLimit;
+        }
+    }
+    if (limits.price_band > 0 && price != -1 && reference > 0 && std::abs(price - reference) > limits.price_band * reference) {
+        return RiskResult::PriceOutsideBand;
+    }
+    if (reservation) *reservation = std::move(held);
+    return RiskResult::Ok;
+}
+
+RiskResult RiskEngine::checkRate(RiskResult limits_result, Reservation* reservation) {
+    if (limits_result != RiskResult::Ok) return limits_result;
+    RiskResult result = checkRate();
+    if (result != RiskResult::Ok && reservation) reservation->release();
+    return result;
+}
+
+RiskResult RiskEngine::checkLimits(const std::string& instrument_name, bool isBuy, double amount, double price, Reservation* reservation) {
+    return checkPosition(instrument_name, isBuy, amount, amount, price, reservation);
+}
+
+RiskResult RiskEngine::checkOrder(const std::string& instrument_name, bool isBuy, double amount, double price, Reservation* reservation) {
+    return checkRate(checkLimits(instrument_name, isBuy, amount, price, reservation), reservation);
+}
+
+RiskResult RiskEngine::checkEdit(const std::string& instrument_name, bool isBuy, double amount, double replaced, double price,
+    Reservation* reservation) {
+    if (instrument_name.empty()) {
+        if (limits.max_order_amount > 0 && amount > limits.max_order_amount) {
+            return RiskResult::OrderTooLarge;
+        }
+        return checkRate();
+    }
+    return checkRate(checkPosition(instrument_name, isBuy, amount, amount > 0 ? amount - replaced : 0, price, reservation), reservation);
+}
+
+bool RiskEngine::onTrade(const JsonValue& trade) {
+    auto current = tables.read();
+    auto it = current->instruments.find(trade.at("instrument_name").get<std::string>());
+    if (it == current->instruments.end()) return false;
+
+    {
+        std::lock_guard lock(trades_mutex);
+        const std::string& trade_id = trade.at("trade_id").get<std::string>();
+        if (!seen_trades.insert(trade_id).second) return true;
+        seen_order.push_back(trade_id);
+        if (seen_order.size() > MAX_SEEN_TRADES) {
+            seen_trades.erase(seen_order.front());
+            seen_order.pop_front();
+        }
+    }
+
+    InstrumentState& state = *it->second;
+    double amount = trade.at("amount").get<double>();
+    double delta = trade.at("direction").get<std::string>() == "buy" ? amount : -amount;
+    state.position.fetch_add(delta, std::memory_order_relaxed);
+    state.currency->position.fetch_add(state.inCurrency(delta, trade.at("price").get<double>()), std::memory_order_relaxed);
+    return true;
+}
+
+bool RiskEngine::onWorking(const std::string& instrument_name, bool isBuy, double amount, double price) {
+    auto current = tables.read();
+    auto it = current->instruments.find(instrument_name);
+    if (it == current->instruments.end()) return false;
+
+    // The cache reports an order with the same price when it goes, so the converted amounts cancel out
+    InstrumentState& state = *it->second;
+    (isBuy ? state.working_buy : state.working_sell).fetch_add(amount, std::memory_order_relaxed);
+    (isBuy ? state.currency->working_buy : state.currency->working_sell)
+        .fetch_add(state.inCurrency(amount, price), std::memory_order_relaxed);
+    return true;
+}
+
+void RiskEngine::setReferencePrice(const std::string& instrument_name, double price) {
+    auto current = tables.read();
+    auto it = current->instruments.find(instrument_name);
+    if (it != current->instruments.end()) {
+        it->second->reference_price.store(price, std::memory_order_relaxed);
+    }
+}
+
+double RiskEngine::position(const std::string& instrument_name) const {
+    auto current = tables.read();
+    auto it = current->instruments.find(instrument_name);
+    return it == current->instruments.end() ? 0.0 : it->second->position.load(std::memory_order_relaxed);
+}
+
+double RiskEngine::workingAmount(const std::string& instrument_name, bool isBuy) const {
+    auto current = tables.read();
+    auto it = current->instruments.find(instrument_name);
+    if (it == current->instruments.end()) return 0.0;
+    return (isBuy ? it->second->working_buy : it->second->working_sell).load(std::memory_order_relaxed);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "json_parser.h"
+#include "instruments.h"
+#include "rcu.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// A zero limit disables that check. Order and instrument limits are in the instrument's amount
+// units: USD for inverse futures, the base currency otherwise. Positions count open orders as if
+// every one on the order's side filled.
+struct RiskLimits {
+    double max_order_amount = 0;
+    double max_instrument_position = 0;
+    double max_currency_position = 0;   // in the base currency; USD amounts converted at the order or trade price
+    double price_band = 0;          // max relative distance from the reference price, e.g. 0.05
+    int max_orders_per_second = 0;
+};
+
+enum class RiskResult {
+    Ok,
+    OrderTooLarge,
+    InstrumentPositionLimit,
+    CurrencyPositionLimit,
+    PriceOutsideBand,
+    RateLimited,
+    UnknownInstrument,
+    NoConversionPrice
+};
+
+const char* riskResultString(RiskResult result);
+
+// Pre-trade checks run on every buy/sell/edit before the request leaves the process.
+// The per-instrument and per-currency tables are read through RCU and only their atomic counters
+// change, so a check is a hash lookup plus a few relaxed atomics. Instruments listed later are
+// added with a copy of the tables; orders for instruments the tables lack are refused.
+class RiskEngine {
+private:
+    // Filled positions, and the remaining amount of open orders per side
+    struct CurrencyState {
+        std::atomic<double> position = 0;
+        std::atomic<double> working_buy = 0;
+        std::atomic<double> working_sell = 0;
+    };
+
+    struct InstrumentState {
+        std::atomic<double> position = 0;
+        std::atomic<double> working_buy = 0;
+        std::atomic<double> working_sell = 0;
+        std::atomic<double> reference_price = 0;
+        bool usd_amounts = false;       // inverse futures
+        CurrencyState* currency = nullptr;
+
+        // An amount of the instrument in its base currency, 0 without a price for USD amounts
+        double inCurrency(double amount, double price) const {
+            return !usd_amounts ? amount : price > 0 ? amount / price : 0;
+        }
+    };
+
+    // Versions share the states, so counters carry over when an instrument is added
+    struct Tables {
+        std::unordered_map<std::string, std::shared_ptr<CurrencyState>> currencies;
+        std::unordered_map<std::string, std::shared_ptr<InstrumentState>> instruments;
+    };
+
+    RiskLimits limits;
+    rcu::Cell<Tables> tables;
+    std::mutex adding;
+
+    std::atomic<int64_t> window_start_ns = 0;
+    std::atomic<int> window_orders = 0;
+
+    // Fills can arrive both in order responses and on user.trades; count each trade once
+    std::mutex trades_mutex;
+    std::unordered_set<std::string> seen_trades;
+    std::deque<std::string> seen_order;
+
+    RiskResult checkRate();
+    static void insert(Tables& tables, const std::string& instrument_name, const Instrument& instrument);
+
+public:
+    // What a passed check added to the working amounts of its side, held until the order cache has
+    // the exchange's answer so that checks running meanwhile count it. Released when destroyed;
+    // the engine must outlive it.
+    class Reservation {
+    private:
+        friend class RiskEngine;
+        std::atomic<double>* working = nullptr;
+        std::atomic<double>* currency_working = nullptr;
+        double amount = 0;
+        double currency_amount = 0;
+
+    public:
+        Reservation() = default;
+        Reservation(Reservation&& other) noexcept;
+        Reservation& operator=(Reservation&& other) noexcept;
+        ~Reservation() { release(); }
+        void release();
+    };
+
+private:
+    // `added` is what the order adds to the working amount on its side
+    RiskResult checkPosition(const std::string& instrument_name, bool isBuy, double amount, double added, double price,
+        Reservation* reservation);
+    // The rate check after passed limits, releasing the reservation if it fails
+    RiskResult checkRate(RiskResult limits_result, Reservation* reservation);
+
+public:
+    RiskEngine(const std::unordered_map<std::string, Instrument>& instruments, RiskLimits limits);
+
+    // price is -1 for orders without a limit price, which skips the price band. A passed check
+    // moves what the order adds to its side into `reservation`; without one nothing is held.
+    RiskResult checkOrder(const std::string& instrument_name, bool isBuy, double amount, double price,
+        Reservation* reservation = nullptr);
+    // checkOrder without the order rate, for orders held locally that count against it when sent
+    RiskResult checkLimits(const std::string& instrument_name, bool isBuy, double amount, double price,
+        Reservation* reservation = nullptr);
+    // An edit of an open order of `replaced` amount to `amount` (-1 when unchanged). The order is
+    // already counted as working, so position limits see only the difference. instrument_name may
+    // be empty when the order is unknown locally; only size and rate are checked then.
+    RiskResult checkEdit(const std::string& instrument_name, bool isBuy, double amount, double replaced, double price,
+        Reservation* reservation = nullptr);
+
+    // An instrument listed since construction; known ones are left as they are
+    void addInstrument(const std::string& instrument_name, const Instrument& instrument);
+
+    // False when the instrument is unknown and the trade was not counted
+    bool onTrade(const JsonValue& trade);
+    // What an open order's remaining amount adds to or takes from its side; fed by the order cache
+    bool onWorking(const std::string& instrument_name, bool isBuy, double amount, double price);
+    void setReferencePrice(const std::string& instrument_name, double price);
+    double position(const std::string& instrument_name) const;
+    double workingAmount(const std::string& instrument_name, bool isBuy) const;
+    const RiskLimits& getLimits() const { return limits; }
+};
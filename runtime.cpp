@@ -0,0 +1,137 @@
+#include "runtime.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <alloca.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace runtime {
+
+namespace {
+
+RuntimeOptions current;
+// The affinity configure() found, restored by unpin(); published by `pinned`
+cpu_set_t startup_cpus;
+std::atomic<bool> pinned = false;
+
+constexpr size_t PAGE = 4096;
+// Below glibc's default mmap threshold, so blocks come from the arena and stay there when freed
+constexpr size_t PREFAULT_BLOCK = 64 << 10;
+
+} // namespace
+
+const RuntimeOptions& options() {
+    return current;
+}
+
+int cpuFor(ThreadRole role) {
+    switch (role) {
+        case ThreadRole::MarketData: return current.market_data_cpu;
+        case ThreadRole::OrderEntry: return current.order_entry_cpu;
+        case ThreadRole::Logging: return current.logging_cpu;
+    }
+    return -1;
+}
+
+bool pinThread(pthread_t thread, int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+bool pinCurrentThread(int cpu) {
+    return pinThread(pthread_self(), cpu);
+}
+
+bool pin(ThreadRole role) {
+    int cpu = cpuFor(role);
+    if (cpu < 0) return true;
+    if (pinCurrentThread(cpu)) return true;
+    logging::warn("Cannot pin thread to CPU {}", cpu);
+    return false;
+}
+
+bool unpin() {
+    if (!pinned.load(std::memory_order_acquire)) return true;
+    return pthread_setaffinity_np(pthread_self(), sizeof(startup_cpus), &startup_cpus) == 0;
+}
+
+size_t prefaultHeap(size_t bytes) {
+    if (bytes == 0) return 0;
+    // Keep the freed blocks resident instead of returning the top of the heap to the kernel
+    mallopt(M_TRIM_THRESHOLD, int(std::min<size_t>(bytes + PREFAULT_BLOCK, 1ul << 30)));
+    mallopt(M_MMAP_THRESHOLD, int(PREFAULT_BLOCK * 2));
+
+    std::vector<void*> blocks;
+    blocks.reserve(bytes / PREFAULT_BLOCK + 1);
+    size_t touched = 0;
+    while (touched < bytes) {
+        char* block = static_cast<char*>(std::malloc(PREFAULT_BLOCK));
+        if (!block) break;
+        for (size_t offset = 0; offset < PREFAULT_BLOCK; offset += PAGE) {
+            block[offset] = 0;
+        }
+        blocks.push_back(block);
+        touched += PREFAULT_BLOCK;
+    }
+    for (void* block : blocks) {
+        std::free(block);
+    }
+    return touched;
+}
+
+void prefaultStack(size_t bytes) {
+    if (bytes == 0) return;
+    volatile char* stack = static_cast<volatile char*>(alloca(bytes));
+    for (size_t offset = 0; offset < bytes; offset += PAGE) {
+        stack[offset] = 0;
+    }
+}
+
+bool lockMemory() {
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+}
+
+bool configure(const RuntimeOptions& options) {
+    current = options;
+    bool ok = true;
+    // Threads inherit their creator's affinity: start the log writer before this thread is
+    // pinned, so that it does not share the order entry core
+    if (options.logging_cpu >= 0) {
+        if (!logging::pinWriter(options.logging_cpu)) {
+            logging::warn("Cannot pin the log writer to CPU {}", options.logging_cpu);
+            ok = false;
+        }
+    } else {
+        logging::flush();
+    }
+    if (options.order_entry_cpu >= 0 && !pinned.load(std::memory_order_relaxed) &&
+        pthread_getaffinity_np(pthread_self(), sizeof(startup_cpus), &startup_cpus) == 0) {
+        pinned.store(true, std::memory_order_release);
+    }
+    ok = pin(ThreadRole::OrderEntry) && ok;
+    // Lock first, so that MCL_FUTURE also keeps the prefaulted pages resident
+    if (options.lock_memory && !lockMemory()) {
+        logging::warn("Cannot lock memory: {}", std::strerror(errno));
+        ok = false;
+    }
+    prefaultStack(options.stack_bytes);
+    size_t touched = prefaultHeap(options.prefault_bytes);
+    if (touched < options.prefault_bytes) {
+        logging::warn("Prefaulted {} of {} bytes", touched, options.prefault_bytes);
+        ok = false;
+    }
+    return ok;
+}
+
+} // namespace runtime
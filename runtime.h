@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <pthread.h>
+#include <thread>
+#include <utility>
+
+// The threads a latency-sensitive deployment gives a core of its own
+enum class ThreadRole : uint8_t { MarketData, OrderEntry, Logging };
+
+struct RuntimeOptions {
+    int market_data_cpu = -1;       // -1 leaves the thread to the scheduler; see spawn()
+    int order_entry_cpu = -1;
+    int logging_cpu = -1;
+    bool busy_poll = false;         // EventLoops spin on their sockets instead of sleeping in poll()
+    size_t prefault_bytes = 0;      // heap touched at startup and kept by malloc afterwards
+    size_t stack_bytes = 256 << 10; // of the configuring thread's stack, touched at startup
+    bool lock_memory = false;       // mlockall, so touched pages are never paged out
+};
+
+// Process-wide threading and memory setup. By default nothing is changed: threads run wherever
+// the scheduler puts them and pages fault in on first use. configure() is meant to be called
+// once at startup, from the order entry thread, before the latency-sensitive threads start:
+//
+//     RuntimeOptions options;
+//     options.order_entry_cpu = 2;
+//     options.market_data_cpu = 3;
+//     options.busy_poll = true;
+//     options.prefault_bytes = 64 << 20;
+//     runtime::configure(options);
+//     std::thread feed = runtime::spawn(ThreadRole::MarketData, [&] { loop.run(); });
+namespace runtime {
+
+// Applies the options: pins the calling thread as the order entry thread and the log writer,
+// prefaults the heap and stack and locks memory. Threads started afterwards by the calling
+// thread inherit its core unless they pin or unpin() themselves; ThreadPool workers and the
+// background refresh and reconcile threads unpin. Failures (a missing core, no permission to
+// lock) are logged and the rest still applied; returns false if anything failed.
+bool configure(const RuntimeOptions& options);
+const RuntimeOptions& options();
+
+// The core configured for a role, or -1
+int cpuFor(ThreadRole role);
+
+// Pin the calling thread to the role's core; true if the role has none
+bool pin(ThreadRole role);
+bool pinCurrentThread(int cpu);
+bool pinThread(pthread_t thread, int cpu);
+// Give the calling thread back the cores the process had before configure() pinned it, so
+// helper threads started from the order entry thread do not compete with it for its core
+bool unpin();
+
+// A thread that pins itself to the role's core before running f. The market data core is only
+// used this way: configure() has no such thread to pin, and the CLI runs none.
+template<typename F>
+std::thread spawn(ThreadRole role, F&& f) {
+    return std::thread([role, f = std::forward<F>(f)]() mutable {
+        pin(role);
+        f();
+    });
+}
+
+// Touch `bytes` of heap in malloc-sized blocks and free them with trimming disabled, so later
+// allocations of the calling thread's arena reuse resident pages instead of faulting
+size_t prefaultHeap(size_t bytes);
+// Touch the next `bytes` of the calling thread's stack
+void prefaultStack(size_t bytes);
+// mlockall(MCL_CURRENT | MCL_FUTURE); needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK
+bool lockMemory();
+
+// Spin-wait hint for busy loops
+inline void relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+} // namespace runtime
@@ -0,0 +1,4 @@
+namespace secrets {
+const std::string client_id = "x";
+const std::string client_secret = "y";
+}
@@ -0,0 +1,17 @@
+#include "session_pool.h"
+
+SessionPool::SessionPool(std::shared_ptr<Transport> transport, size_t fanout_threads)
+    : transport(std::move(transport)), fanout_pool(std::make_shared<ThreadPool>(fanout_threads)) {
+    universe = std::make_shared<InstrumentUniverse>(InstrumentRegistry::load(InstrumentRegistry::FetchJson(
+        [this](const std::string& url) { return TradingSystem::requestJson(this->transport.get(), url); })));
+}
+
+void SessionPool::startInstrumentRefresh(std::chrono::milliseconds full_interval) {
+    universe->startRefresh([transport = transport](const std::string& url) {
+        return transport ? transport->get(url, "") : TradingSystem::client().get(url);
+    }, full_interval);
+}
+
+std::unique_ptr<TradingSystem> SessionPool::open(const Credentials& credentials, RateLimit limit) const {
+    return std::make_unique<TradingSystem>(*this, credentials, limit);
+}
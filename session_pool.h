@@ -0,0 +1,40 @@
+#pragma once
+
+#include "trading_system.h"
+
+#include <memory>
+#include <string>
+
+struct Credentials {
+    std::string client_id;
+    std::string client_secret;
+};
+
+// Several accounts trading through one process. The pool loads the instrument universe once and
+// owns what its sessions share: the InstrumentUniverse, the transport (or the calling
+// threads' HTTP connections) and the fan-out threads. A session is a TradingSystem with its own
+// token, order cache and rate-limit budget, so opening one costs a single auth request and a
+// few kilobytes. Sessions hold their own references and may outlive the pool.
+//
+//     SessionPool pool;
+//     std::unique_ptr<TradingSystem> maker = pool.open({"maker_id", "maker_secret"}, RateLimit{20, 50});
+//     std::unique_ptr<TradingSystem> hedger = pool.open({"hedger_id", "hedger_secret"});
+class SessionPool {
+private:
+    std::shared_ptr<Transport> transport;   // null: the exchange over HTTP
+    std::shared_ptr<ThreadPool> fanout_pool;
+    std::shared_ptr<InstrumentUniverse> universe;
+
+    friend class TradingSystem;
+
+public:
+    explicit SessionPool(std::shared_ptr<Transport> transport = nullptr, size_t fanout_threads = 4);
+
+    // Authenticate an account; throws like the TradingSystem constructor if auth fails
+    std::unique_ptr<TradingSystem> open(const Credentials& credentials, RateLimit limit = RateLimit()) const;
+
+    std::shared_ptr<const InstrumentRegistry> instrumentRegistry() const { return universe->snapshot(); }
+    InstrumentUniverse& instrumentUniverse() { return *universe; }
+    // Keep the shared universe current; see TradingSystem::startInstrumentRefresh
+    void startInstrumentRefresh(std::chrono::milliseconds full_interval);
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Portable 4-wide double vectors built on GCC/Clang vector extensions. Kernels written with
+// them compile to SIMD on any target; SIMD_KERNEL additionally clones a function for AVX2 on
+// x86-64 Linux and picks the clone at load time, so the build needs no -march flags.
+#if defined(__x86_64__) && defined(__linux__)
+#define SIMD_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define SIMD_KERNEL
+#endif
+
+// Vec4 helpers are always inlined into their kernels, so the 32-byte vector argument ABI never
+// crosses a call boundary. GCC warns about it anyway; the warning is silenced for the helpers
+// below only, and files defining SIMD_KERNEL functions silence it themselves: GCC reports it
+// for the cloned kernels at the end of the file, so there it has to stay off to the end.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace simd {
+
+using Vec4 = double __attribute__((vector_size(32)));
+using Mask4 = int64_t __attribute__((vector_size(32)));
+
+constexpr size_t WIDTH = 4;
+
+inline Vec4 load(const double* values) {
+    Vec4 v;
+    std::memcpy(&v, values, sizeof(v));
+    return v;
+}
+
+inline void store(double* out, const Vec4& v) {
+    std::memcpy(out, &v, sizeof(v));
+}
+
+inline Vec4 broadcast(double value) {
+    return Vec4{value, value, value, value};
+}
+
+inline double horizontalSum(const Vec4& v) {
+    return (v[0] + v[1]) + (v[2] + v[3]);
+}
+
+inline Vec4 select(const Mask4& mask, const Vec4& a, const Vec4& b) {
+    return mask ? a : b;
+}
+
+inline Vec4 min(const Vec4& a, const Vec4& b) {
+    return a < b ? a : b;
+}
+
+inline Vec4 max(const Vec4& a, const Vec4& b) {
+    return a > b ? a : b;
+}
+
+inline Vec4 abs(const Vec4& v) {
+    return v < 0 ? -v : v;
+}
+
+// e^x with a relative error around 1e-15 over the clamped range [-700, 700]
+inline Vec4 exp(const Vec4& value) {
+    const Vec4 round_magic = broadcast(6755399441055744.0); // 1.5 * 2^52
+    Vec4 x = min(max(value, broadcast(-700.0)), broadcast(700.0));
+
+    Vec4 shifted = x * 1.4426950408889634 + round_magic;
+    Vec4 n = shifted - round_magic;
+    Vec4 r = x - n * 0.6931471803691238 - n * 1.9082149292705877e-10;
+
+    Vec4 p = broadcast(1.0 / 479001600.0);
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+
+    Mask4 exponent = ((Mask4)shifted - (Mask4)round_magic + 1023) << 52;
+    return p * (Vec4)exponent;
+}
+
+// Natural log for positive finite x
+inline Vec4 log(const Vec4& x) {
+    Mask4 bits = (Mask4)x;
+    Mask4 exponent = ((bits >> 52) & 0x7ff) - 1023;
+    Vec4 m = (Vec4)((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+
+    Mask4 high = m > 1.4142135623730951;
+    m = select(high, m * 0.5, m);
+    Vec4 e = __builtin_convertvector(exponent - high, Vec4);
+
+    Vec4 s = (m - 1.0) / (m + 1.0);
+    Vec4 s2 = s * s;
+    Vec4 p = broadcast(2.0 / 21.0);
+    p = p * s2 + 2.0 / 19.0;
+    p = p * s2 + 2.0 / 17.0;
+    p = p * s2 + 2.0 / 15.0;
+    p = p * s2 + 2.0 / 13.0;
+    p = p * s2 + 2.0 / 11.0;
+    p = p * s2 + 2.0 / 9.0;
+    p = p * s2 + 2.0 / 7.0;
+    p = p * s2 + 2.0 / 5.0;
+    p = p * s2 + 2.0 / 3.0;
+    p = p * s2 + 2.0;
+    return s * p + e * 0.6931471805599453;
+}
+
+inline Vec4 sqrt(const Vec4& x) {
+    Vec4 result;
+    for (size_t i = 0; i < WIDTH; ++i) {
+        result[i] = __builtin_sqrt(x[i]);
+    }
+    return result;
+}
+
+} // namespace simd
+
+#pragma GCC diagnostic pop
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+
+// Free lists of coroutine frames in 64-byte size classes. Frames are recycled on the thread
+// that frees them, so an event loop thread stops allocating once it has seen its peak number
+// of concurrent operations. Frames above the largest class go to the global heap.
+class FramePool {
+private:
+    static constexpr size_t GRANULE = 64;
+    static constexpr size_t CLASSES = 32;
+
+    struct Node {
+        Node* next;
+    };
+
+    Node* free_lists[CLASSES] = {};
+
+public:
+    static FramePool& local() {
+        thread_local FramePool pool;
+        return pool;
+    }
+
+    FramePool() = default;
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    ~FramePool() {
+        for (Node*& head : free_lists) {
+            while (head) {
+                Node* next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+        }
+    }
+
+    void* allocate(size_t size) {
+        size_t size_class = (size + GRANULE - 1) / GRANULE;
+        if (size_class >= CLASSES) return ::operator new(size);
+        if (Node* frame = free_lists[size_class]) {
+            free_lists[size_class] = frame->next;
+            return frame;
+        }
+        return ::operator new(size_class * GRANULE);
+    }
+
+    void release(void* frame, size_t size) {
+        size_t size_class = (size + GRANULE - 1) / GRANULE;
+        if (size_class >= CLASSES) {
+            ::operator delete(frame);
+            return;
+        }
+        Node* node = static_cast<Node*>(frame);
+        node->next = free_lists[size_class];
+        free_lists[size_class] = node;
+    }
+};
+
+// Promise types deriving from this allocate their coroutine frame from the FramePool
+struct PooledFrame {
+    static void* operator new(size_t size) { return FramePool::local().allocate(size); }
+    static void operator delete(void* frame, size_t size) { FramePool::local().release(frame, size); }
+};
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase : PooledFrame {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    // Resume whoever awaited the task; symmetric transfer keeps long await chains off the stack
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept {
+            std::coroutine_handle<> next = finished.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    template <typename U>
+    void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+    T result() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void result() {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+} // namespace detail
+
+// Lazily started coroutine returning T. The body runs when the task is first awaited, and the
+// awaiting coroutine resumes when it finishes; exceptions propagate to the awaiter.
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume() { return handle.promise().result(); }
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+} // namespace detail
@@ -0,0 +1,335 @@
+#include "tick_query.h"
+#include "logger.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <future>
+#include <limits>
+#include <map>
+
+// Off for the whole file, see simd.h
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+using tick_store::TopOfBookColumns;
+
+namespace {
+
+using simd::Mask4;
+using simd::Vec4;
+using simd::broadcast;
+using simd::load;
+using simd::select;
+using simd::store;
+
+constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+constexpr double INF = std::numeric_limits<double>::infinity();
+
+// Count, sum, min and max of the non-NaN values in a range
+struct Summary {
+    size_t count = 0;
+    double sum = 0;
+    double min = INF;
+    double max = -INF;
+
+    void merge(const Summary& other) {
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+// Columns derived from the top of book of one block
+struct Derived {
+    std::vector<double> mid;
+    std::vector<double> spread;
+    std::vector<double> imbalance;
+};
+
+SIMD_KERNEL void deriveKernel(const double* bid, const double* bid_size, const double* ask, const double* ask_size,
+    size_t n, double* mid, double* spread, double* imbalance) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        Vec4 b = load(bid + i);
+        Vec4 a = load(ask + i);
+        Vec4 bs = load(bid_size + i);
+        Vec4 as = load(ask_size + i);
+        store(mid + i, 0.5 * (b + a));
+        store(spread + i, a - b);
+        store(imbalance + i, (bs - as) / (bs + as));
+    }
+    for (; i < n; ++i) {
+        mid[i] = 0.5 * (bid[i] + ask[i]);
+        spread[i] = ask[i] - bid[i];
+        imbalance[i] = (bid_size[i] - ask_size[i]) / (bid_size[i] + ask_size[i]);
+    }
+}
+
+SIMD_KERNEL Summary summaryKernel(const double* values, size_t n) {
+    Vec4 sum = broadcast(0.0);
+    Vec4 count = broadcast(0.0);
+    Vec4 low = broadcast(INF);
+    Vec4 high = broadcast(-INF);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        Vec4 v = load(values + i);
+        Mask4 valid = v == v;
+        sum += select(valid, v, broadcast(0.0));
+        count += select(valid, broadcast(1.0), broadcast(0.0));
+        low = simd::min(low, select(valid, v, broadcast(INF)));
+        high = simd::max(high, select(valid, v, broadcast(-INF)));
+    }
+    Summary summary;
+    summary.sum = simd::horizontalSum(sum);
+    summary.count = (size_t)simd::horizontalSum(count);
+    summary.min = std::min(std::min(low[0], low[1]), std::min(low[2], low[3]));
+    summary.max = std::max(std::max(high[0], high[1]), std::max(high[2], high[3]));
+    for (; i < n; ++i) {
+        if (values[i] != values[i]) continue;
+        ++summary.count;
+        summary.sum += values[i];
+        summary.min = std::min(summary.min, values[i]);
+        summary.max = std::max(summary.max, values[i]);
+    }
+    return summary;
+}
+
+// Sum and sum of squares of log(mid[i+1] / mid[i]) over consecutive valid pairs. A pair with
+// a NaN in between is skipped rather than bridged; the bridging return is small enough to not
+// matter for volatility and keeps the kernel branch-free.
+SIMD_KERNEL void logReturnKernel(const double* mid, size_t n, double& sum, double& sum_squares, size_t& count) {
+    Vec4 s = broadcast(0.0);
+    Vec4 ss = broadcast(0.0);
+    Vec4 c = broadcast(0.0);
+    size_t i = 0;
+    for (; i + 5 <= n; i += 4) {
+        Vec4 previous = load(mid + i);
+        Vec4 next = load(mid + i + 1);
+        Mask4 valid = (previous == previous) & (next == next) & (previous > 0) & (next > 0);
+        Vec4 r = simd::log(select(valid, next / previous, broadcast(1.0)));
+        s += r;
+        ss += r * r;
+        c += select(valid, broadcast(1.0), broadcast(0.0));
+    }
+    sum += simd::horizontalSum(s);
+    sum_squares += simd::horizontalSum(ss);
+    count += (size_t)simd::horizontalSum(c);
+    for (; i + 1 < n; ++i) {
+        if (!(mid[i] > 0) || !(mid[i + 1] > 0)) continue;
+        double r = std::log(mid[i + 1] / mid[i]);
+        sum += r;
+        sum_squares += r * r;
+        ++count;
+    }
+}
+
+void derive(const TopOfBookColumns& top, Derived& derived) {
+    size_t n = top.size();
+    derived.mid.resize(n);
+    derived.spread.resize(n);
+    derived.imbalance.resize(n);
+    deriveKernel(top.bid_prices.data(), top.bid_amounts.data(), top.ask_prices.data(), top.ask_amounts.data(), n,
+        derived.mid.data(), derived.spread.data(), derived.imbalance.data());
+}
+
+long long barStart(long long timestamp, long long interval) {
+    long long bucket = timestamp / interval;
+    if (timestamp % interval < 0) --bucket;
+    return bucket * interval;
+}
+
+// Per-block partial statistics
+struct StatsPartial {
+    long long first_timestamp = 0;
+    long long last_timestamp = 0;
+    double first_mid = NaN;
+    double last_mid = NaN;
+    Summary mid;
+    Summary spread;
+    Summary imbalance;
+    double return_sum = 0;
+    double return_sum_squares = 0;
+    size_t returns = 0;
+};
+
+// Runs `work` for every item on the pool, at most a few per worker in flight, and hands the
+// results to `consume` on the calling thread in item order
+template <typename Item, typename Work, typename Consume>
+void orderedMap(ThreadPool& pool, const std::vector<Item>& items, Work work, Consume consume) {
+    using Result = decltype(work(items[0]));
+    size_t window = std::max<size_t>(pool.size() * 4, 1);
+    std::deque<std::future<Result>> in_flight;
+    size_t next = 0;
+    while (next < items.size() || !in_flight.empty()) {
+        while (next < items.size() && in_flight.size() < window) {
+            const Item& item = items[next++];
+            in_flight.push_back(pool.submit([&work, &item] { return work(item); }));
+        }
+        Result result = in_flight.front().get();
+        in_flight.pop_front();
+        consume(result);
+    }
+}
+
+} // namespace
+
+size_t TickQuery::scan(const std::string& instrument_name, long long from, long long to, const ChunkVisitor& visit) const {
+    std::vector<TickReader::Block> blocks = reader.blocks(instrument_name, from, to);
+    size_t events = 0;
+    orderedMap(pool, blocks, [&](const TickReader::Block& block) {
+        TopOfBookColumns chunk;
+        reader.topOfBook(block, from, to, chunk);
+        return chunk;
+    }, [&](const TopOfBookColumns& chunk) {
+        events += chunk.size();
+        if (chunk.size() > 0) visit(chunk);
+    });
+    return events;
+}
+
+std::vector<Bar> TickQuery::bars(const std::string& instrument_name, long long from, long long to, long long interval_ms,
+    BarField field) const {
+    std::vector<Bar> result;
+    if (interval_ms <= 0) {
+        logging::warn("Invalid bar interval: {}", interval_ms);
+        return result;
+    }
+
+    std::vector<TickReader::Block> blocks = reader.blocks(instrument_name, from, to);
+    orderedMap(pool, blocks, [&](const TickReader::Block& block) {
+        thread_local TopOfBookColumns top;
+        thread_local Derived derived;
+        top.clear();
+        reader.topOfBook(block, from, to, top);
+        derive(top, derived);
+        const std::vector<double>& values = field == BarField::Mid ? derived.mid : derived.spread;
+
+        // Events are in time order, so each bar is a contiguous range
+        std::vector<Bar> partial;
+        size_t begin = 0;
+        while (begin < top.size()) {
+            long long start = barStart(top.timestamps[begin], interval_ms);
+            size_t end = begin;
+            while (end < top.size() && top.timestamps[end] < start + interval_ms) ++end;
+
+            Summary summary = summaryKernel(values.data() + begin, end - begin);
+            if (summary.count > 0) {
+                size_t first = begin;
+                while (values[first] != values[first]) ++first;
+                size_t last = end - 1;
+                while (values[last] != values[last]) --last;
+                partial.push_back(Bar{start, values[first], summary.max, summary.min, values[last], summary.count});
+            }
+            begin = end;
+        }
+        return partial;
+    }, [&](const std::vector<Bar>& partial) {
+        for (const Bar& bar : partial) {
+            if (!result.empty() && result.back().start == bar.start) {
+                // A bar split across two blocks
+                Bar& merged = result.back();
+                merged.high = std::max(merged.high, bar.high);
+                merged.low = std::min(merged.low, bar.low);
+                merged.close = bar.close;
+                merged.count += bar.count;
+            } else {
+                result.push_back(bar);
+            }
+        }
+    });
+    return result;
+}
+
+std::vector<InstrumentStats> TickQuery::statistics(long long from, long long to,
+    const std::vector<std::string>& instrument_names) const {
+    std::vector<std::string> names = instrument_names.empty() ? reader.instruments() : instrument_names;
+
+    // One task per (instrument, block); instruments stay contiguous so merging is in time order
+    std::vector<std::pair<size_t, TickReader::Block>> work;
+    for (size_t i = 0; i < names.size(); ++i) {
+        for (const TickReader::Block& block : reader.blocks(names[i], from, to)) {
+            work.emplace_back(i, block);
+        }
+    }
+
+    std::vector<StatsPartial> totals(names.size());
+    orderedMap(pool, work, [&](const std::pair<size_t, TickReader::Block>& item) {
+        thread_local TopOfBookColumns top;
+        thread_local Derived derived;
+        top.clear();
+        reader.topOfBook(item.second, from, to, top);
+        derive(top, derived);
+
+        StatsPartial partial;
+        partial.mid = summaryKernel(derived.mid.data(), derived.mid.size());
+        partial.spread = summaryKernel(derived.spread.data(), derived.spread.size());
+        partial.imbalance = summaryKernel(derived.imbalance.data(), derived.imbalance.size());
+        logReturnKernel(derived.mid.data(), derived.mid.size(), partial.return_sum, partial.return_sum_squares,
+            partial.returns);
+        for (size_t i = 0; i < top.size(); ++i) {
+            if (derived.mid[i] == derived.mid[i]) {
+                partial.first_timestamp = top.timestamps[i];
+                partial.first_mid = derived.mid[i];
+                break;
+            }
+        }
+        for (size_t i = top.size(); i-- > 0;) {
+            if (derived.mid[i] == derived.mid[i]) {
+                partial.last_timestamp = top.timestamps[i];
+                partial.last_mid = derived.mid[i];
+                break;
+            }
+        }
+        return std::make_pair(item.first, partial);
+    }, [&](const std::pair<size_t, StatsPartial>& result) {
+        const StatsPartial& partial = result.second;
+        if (partial.mid.count == 0) return;
+        StatsPartial& total = totals[result.first];
+        if (total.mid.count == 0) {
+            total.first_timestamp = partial.first_timestamp;
+            total.first_mid = partial.first_mid;
+        } else if (total.last_mid > 0 && partial.first_mid > 0) {
+            // The return across the block boundary
+            double r = std::log(partial.first_mid / total.last_mid);
+            total.return_sum += r;
+            total.return_sum_squares += r * r;
+            ++total.returns;
+        }
+        total.last_timestamp = partial.last_timestamp;
+        total.last_mid = partial.last_mid;
+        total.mid.merge(partial.mid);
+        total.spread.merge(partial.spread);
+        total.imbalance.merge(partial.imbalance);
+        total.return_sum += partial.return_sum;
+        total.return_sum_squares += partial.return_sum_squares;
+        total.returns += partial.returns;
+    });
+
+    std::vector<InstrumentStats> result;
+    for (size_t i = 0; i < names.size(); ++i) {
+        const StatsPartial& total = totals[i];
+        InstrumentStats stats;
+        stats.instrument_name = names[i];
+        stats.events = total.mid.count;
+        if (total.mid.count > 0) {
+            stats.first_timestamp = total.first_timestamp;
+            stats.last_timestamp = total.last_timestamp;
+            stats.mean_mid = total.mid.sum / total.mid.count;
+            stats.min_mid = total.mid.min;
+            stats.max_mid = total.mid.max;
+            stats.mean_spread = total.spread.sum / std::max<size_t>(total.spread.count, 1);
+            stats.min_spread = total.spread.min;
+            stats.max_spread = total.spread.max;
+            stats.mean_top_imbalance = total.imbalance.sum / std::max<size_t>(total.imbalance.count, 1);
+        }
+        if (total.returns > 1) {
+            double mean = total.return_sum / total.returns;
+            double variance = (total.return_sum_squares - total.returns * mean * mean) / (total.returns - 1);
+            stats.mid_volatility = std::sqrt(std::max(variance, 0.0));
+        }
+        result.push_back(stats);
+    }
+    return result;
+}
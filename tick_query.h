@@ -0,0 +1,63 @@
+#pragma once
+
+#include "thread_pool.h"
+#include "tick_store.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct Bar {
+    long long start;        // bar open time, a multiple of the interval
+    double open;
+    double high;
+    double low;
+    double close;
+    size_t count;           // events in the bar
+};
+
+struct InstrumentStats {
+    std::string instrument_name;
+    size_t events = 0;
+    long long first_timestamp = 0;
+    long long last_timestamp = 0;
+    double mean_mid = 0;
+    double min_mid = 0;
+    double max_mid = 0;
+    double mid_volatility = 0;      // standard deviation of event-to-event log returns of the mid
+    double mean_spread = 0;
+    double min_spread = 0;
+    double max_spread = 0;
+    double mean_top_imbalance = 0;  // (bid size - ask size) / (bid size + ask size) at the top
+};
+
+// Queries over a recorded tick store. Work is split into (instrument, block) tasks on a
+// ThreadPool; each task decodes one block's top of book into column arrays and aggregates them
+// with SIMD kernels, and the partial results are merged in time order. Only the blocks being
+// worked on are decoded at any time, so memory stays flat however large the store is.
+// Events where either side of the book is empty are skipped by the aggregations.
+class TickQuery {
+public:
+    enum class BarField { Mid, Spread };
+
+    using ChunkVisitor = std::function<void(const tick_store::TopOfBookColumns& chunk)>;
+
+private:
+    const TickReader& reader;
+    ThreadPool& pool;
+
+public:
+    TickQuery(const TickReader& reader, ThreadPool& pool) : reader(reader), pool(pool) {}
+
+    // Stream the top of book in [from, to] one block at a time, in time order. Blocks are
+    // decoded ahead in parallel; `visit` runs on the calling thread.
+    size_t scan(const std::string& instrument_name, long long from, long long to, const ChunkVisitor& visit) const;
+
+    // OHLC bars of the mid price or the spread; bars without events are omitted
+    std::vector<Bar> bars(const std::string& instrument_name, long long from, long long to, long long interval_ms,
+        BarField field = BarField::Mid) const;
+
+    // Statistics per instrument over [from, to]; all recorded instruments if the list is empty
+    std::vector<InstrumentStats> statistics(long long from, long long to,
+        const std::vector<std::string>& instrument_names = {}) const;
+};
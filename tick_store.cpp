@@ -0,0 +1,540 @@
+#include "tick_store.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace tick_store;
+
+namespace {
+
+constexpr char FILE_MAGIC[8] = {'T', 'I', 'C', 'K', 'S', 'T', 'O', 'R'};
+constexpr uint32_t FILE_VERSION = 1;
+constexpr uint32_t BLOCK_MAGIC = 0x314b4c42; // "BLK1"
+
+enum Column { TIMESTAMPS, LEVEL_COUNTS, SIDES, PRICES, AMOUNTS };
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(char(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(char(value));
+}
+
+void putSigned(std::string& out, int64_t value) {
+    putVarint(out, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+}
+
+uint64_t getVarint(const uint8_t*& in) {
+    uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *in++;
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (byte < 0x80) return value;
+    }
+}
+
+int64_t getSigned(const uint8_t*& in) {
+    uint64_t value = getVarint(in);
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+void writeAll(int fd, const void* bytes, size_t size) {
+    const char* cursor = static_cast<const char*>(bytes);
+    while (size > 0) {
+        ssize_t written = ::write(fd, cursor, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw StoreError("Tick store write failed: " + std::string(std::strerror(errno)));
+        }
+        cursor += written;
+        size -= written;
+    }
+}
+
+int64_t toTicks(double value, double increment) {
+    return std::llround(value / increment);
+}
+
+uint64_t blockBytes(const BlockHeader& header) {
+    uint64_t bytes = sizeof(BlockHeader);
+    for (uint32_t column_bytes : header.column_bytes) {
+        bytes += column_bytes;
+    }
+    return bytes;
+}
+
+// Read-only mapping of a whole file; nullptr for an empty file
+const uint8_t* mapFile(const std::string& path, size_t& size) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        size = 0;
+        return nullptr;
+    }
+    struct stat info;
+    ::fstat(fd, &info);
+    size = info.st_size;
+    void* mapping = size == 0 ? MAP_FAILED : ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        return nullptr;
+    }
+    return static_cast<const uint8_t*>(mapping);
+}
+
+} // namespace
+
+void TopOfBookColumns::clear() {
+    timestamps.clear();
+    bid_prices.clear();
+    bid_amounts.clear();
+    ask_prices.clear();
+    ask_amounts.clear();
+}
+
+TickRecorder::TickRecorder(const std::string& path, size_t block_events, double price_increment, double amount_increment)
+    : path(path), block_events(std::max<size_t>(block_events, 1)), default_increments{price_increment, amount_increment} {
+    data_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    index_fd = ::open((path + ".idx").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (data_fd < 0 || index_fd < 0) {
+        throw StoreError("Cannot open tick store: " + path);
+    }
+
+    data_bytes = ::lseek(data_fd, 0, SEEK_END);
+    if (data_bytes == 0) {
+        FileHeader header{};
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+        header.version = FILE_VERSION;
+        header.header_bytes = sizeof(FileHeader);
+        writeAll(data_fd, &header, sizeof(header));
+        data_bytes = sizeof(header);
+    } else {
+        FileHeader header{};
+        int fd = ::open(path.c_str(), O_RDONLY);
+        bool valid = fd >= 0 && ::read(fd, &header, sizeof(header)) == sizeof(header) &&
+            std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0;
+        if (fd >= 0) ::close(fd);
+        if (!valid) {
+            throw StoreError("Not a tick store: " + path);
+        }
+    }
+}
+
+TickRecorder::~TickRecorder() {
+    try {
+        flush();
+    } catch (const std::exception& e) {
+        logging::error("Tick store flush failed: {}", e.what());
+    }
+    if (data_fd >= 0) ::close(data_fd);
+    if (index_fd >= 0) ::close(index_fd);
+}
+
+void TickRecorder::setIncrements(const std::string& instrument_name, double price_increment, double amount_increment) {
+    increments[instrument_name] = Increments{price_increment, amount_increment};
+}
+
+TickRecorder::OpenBlock& TickRecorder::openBlock(const std::string& instrument_name) {
+    OpenBlock& block = open_blocks[instrument_name];
+    if (block.event_count == 0) {
+        // New block: pick up the instrument's current increments, rescaling the carried-over book
+        auto it = increments.find(instrument_name);
+        Increments next = it == increments.end() ? default_increments : it->second;
+        if (block.increments.price != 0 && (block.increments.price != next.price || block.increments.amount != next.amount)) {
+            for (Levels* side : {&block.bids, &block.asks}) {
+                Levels rescaled;
+                for (const auto& [price, amount] : *side) {
+                    rescaled[toTicks(price * block.increments.price, next.price)] =
+                        toTicks(amount * block.increments.amount, next.amount);
+                }
+                *side = std::move(rescaled);
+            }
+        }
+        block.increments = next;
+    }
+    return block;
+}
+
+void TickRecorder::appendEvent(OpenBlock& block, int64_t timestamp, bool is_snapshot,
+    const std::vector<std::tuple<bool, int64_t, int64_t>>& levels) {
+    if (block.event_count == 0) {
+        block.first_timestamp = timestamp;
+        block.last_timestamp = timestamp;
+        block.last_price = 0;
+    }
+    putSigned(block.columns[TIMESTAMPS], timestamp - block.last_timestamp);
+    putVarint(block.columns[LEVEL_COUNTS], (uint64_t(levels.size()) << 1) | (is_snapshot ? 1 : 0));
+    for (const auto& [isBid, price, amount] : levels) {
+        if (isBid) block.side_bits |= uint8_t(1u << (block.level_count % 8));
+        if (++block.level_count % 8 == 0) {
+            block.columns[SIDES].push_back(char(block.side_bits));
+            block.side_bits = 0;
+        }
+        putSigned(block.columns[PRICES], price - block.last_price);
+        putVarint(block.columns[AMOUNTS], uint64_t(amount));
+        block.last_price = price;
+    }
+    block.last_timestamp = timestamp;
+    ++block.event_count;
+}
+
+void TickRecorder::recordSnapshot(const std::string& instrument_name, long long timestamp, const BookSnapshot& book) {
+    OpenBlock& block = openBlock(instrument_name);
+
+    std::vector<std::tuple<bool, int64_t, int64_t>> changes;
+    auto diffSide = [&](bool isBid, const BookSide& side, Levels& levels) {
+        Levels next;
+        for (size_t i = 0; i < side.size(); ++i) {
+            int64_t amount = toTicks(side.amounts[i], block.increments.amount);
+            if (amount > 0) next[toTicks(side.prices[i], block.increments.price)] = amount;
+        }
+        for (const auto& [price, amount] : levels) {
+            if (next.find(price) == next.end()) changes.emplace_back(isBid, price, 0);
+        }
+        for (const auto& [price, amount] : next) {
+            auto it = levels.find(price);
+            if (it == levels.end() || it->second != amount) changes.emplace_back(isBid, price, amount);
+        }
+        levels = std::move(next);
+    };
+    diffSide(true, book.bids, block.bids);
+    diffSide(false, book.asks, block.asks);
+
+    if (block.event_count == 0) {
+        std::vector<std::tuple<bool, int64_t, int64_t>> levels;
+        for (const auto& [price, amount] : block.bids) levels.emplace_back(true, price, amount);
+        for (const auto& [price, amount] : block.asks) levels.emplace_back(false, price, amount);
+        appendEvent(block, timestamp, true, levels);
+    } else if (!changes.empty()) {
+        appendEvent(block, timestamp, false, changes);
+    } else {
+        return;
+    }
+    if (block.event_count >= block_events) {
+        writeBlock(instrument_name, block);
+    }
+}
+
+void TickRecorder::recordOrderBook(const JsonValue& response) {
+    const JsonObject& fields = response.get<JsonObject>();
+    auto result = fields.find("result");
+    const JsonValue& body = result == fields.end() ? response : result->second;
+    recordSnapshot(body.at("instrument_name").get<std::string>(), (long long)body.at("timestamp").get<double>(),
+        BookSnapshot::fromJson(body));
+}
+
+void TickRecorder::recordChanges(const std::string& instrument_name, long long timestamp,
+    const std::vector<BookChange>& changes) {
+    OpenBlock& block = openBlock(instrument_name);
+
+    std::vector<std::tuple<bool, int64_t, int64_t>> applied;
+    for (const BookChange& change : changes) {
+        Levels& levels = change.isBid ? block.bids : block.asks;
+        int64_t price = toTicks(change.price, block.increments.price);
+        int64_t amount = toTicks(change.amount, block.increments.amount);
+        auto it = levels.find(price);
+        if (amount <= 0) {
+            if (it == levels.end()) continue;
+            levels.erase(it);
+            amount = 0;
+        } else if (it != levels.end() && it->second == amount) {
+            continue;
+        } else {
+            levels[price] = amount;
+        }
+        applied.emplace_back(change.isBid, price, amount);
+    }
+
+    if (block.event_count == 0) {
+        std::vector<std::tuple<bool, int64_t, int64_t>> levels;
+        for (const auto& [price, amount] : block.bids) levels.emplace_back(true, price, amount);
+        for (const auto& [price, amount] : block.asks) levels.emplace_back(false, price, amount);
+        appendEvent(block, timestamp, true, levels);
+    } else if (!applied.empty()) {
+        appendEvent(block, timestamp, false, applied);
+    } else {
+        return;
+    }
+    if (block.event_count >= block_events) {
+        writeBlock(instrument_name, block);
+    }
+}
+
+void TickRecorder::writeBlock(const std::string& instrument_name, OpenBlock& block) {
+    if (block.event_count == 0) return;
+    if (block.level_count % 8 != 0) {
+        block.columns[SIDES].push_back(char(block.side_bits));
+    }
+
+    BlockHeader header{};
+    header.magic = BLOCK_MAGIC;
+    header.event_count = block.event_count;
+    header.level_count = block.level_count;
+    for (uint32_t c = 0; c < COLUMNS; ++c) {
+        header.column_bytes[c] = block.columns[c].size();
+    }
+    header.first_timestamp = block.first_timestamp;
+    header.last_timestamp = block.last_timestamp;
+    header.price_increment = block.increments.price;
+    header.amount_increment = block.increments.amount;
+    std::strncpy(header.instrument_name, instrument_name.c_str(), sizeof(header.instrument_name) - 1);
+
+    std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const std::string& column : block.columns) {
+        bytes += column;
+    }
+    writeAll(data_fd, bytes.data(), bytes.size());
+
+    IndexEntry entry{};
+    std::memcpy(entry.instrument_name, header.instrument_name, sizeof(entry.instrument_name));
+    entry.first_timestamp = header.first_timestamp;
+    entry.last_timestamp = header.last_timestamp;
+    entry.offset = data_bytes;
+    entry.bytes = bytes.size();
+    writeAll(index_fd, &entry, sizeof(entry));
+    data_bytes += bytes.size();
+
+    // The book carries over: the next block starts with a snapshot of it
+    for (std::string& column : block.columns) {
+        column.clear();
+    }
+    block.event_count = 0;
+    block.level_count = 0;
+    block.side_bits = 0;
+}
+
+void TickRecorder::flush() {
+    for (auto& [instrument_name, block] : open_blocks) {
+        writeBlock(instrument_name, block);
+    }
+}
+
+TickReader::TickReader(const std::string& path) {
+    data = mapFile(path, data_size);
+    FileHeader header{};
+    if (data == nullptr || data_size < sizeof(header)) {
+        throw StoreError("Cannot open tick store: " + path);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION) {
+        throw StoreError("Not a tick store: " + path);
+    }
+
+    loadIndex(path + ".idx");
+    uint64_t indexed = index.empty() ? header.header_bytes : index.back().offset + index.back().bytes;
+    if (indexed < data_size) {
+        rebuildIndex(indexed);
+    }
+
+    for (const IndexEntry& entry : index) {
+        by_instrument[entry.instrument_name].push_back(Block{&entry, entry.first_timestamp, entry.last_timestamp});
+    }
+    for (auto& [instrument_name, blocks] : by_instrument) {
+        std::stable_sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+            return a.first_timestamp < b.first_timestamp;
+        });
+    }
+}
+
+TickReader::~TickReader() {
+    if (data != nullptr) {
+        ::munmap(const_cast<uint8_t*>(data), data_size);
+    }
+}
+
+void TickReader::loadIndex(const std::string& index_path) {
+    size_t size = 0;
+    const uint8_t* mapping = mapFile(index_path, size);
+    size_t count = size / sizeof(IndexEntry);
+    index.resize(count);
+    if (count > 0) {
+        std::memcpy(index.data(), mapping, count * sizeof(IndexEntry));
+    }
+    if (mapping != nullptr) {
+        ::munmap(const_cast<uint8_t*>(mapping), size);
+    }
+    // Keep only the prefix that points at complete blocks
+    size_t valid = 0;
+    while (valid < index.size() && index[valid].offset + index[valid].bytes <= data_size) {
+        ++valid;
+    }
+    index.resize(valid);
+}
+
+void TickReader::rebuildIndex(uint64_t from_offset) {
+    uint64_t offset = from_offset;
+    while (offset + sizeof(BlockHeader) <= data_size) {
+        BlockHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        uint64_t bytes = blockBytes(header);
+        if (header.magic != BLOCK_MAGIC || offset + bytes > data_size) break;   // torn final block
+
+        IndexEntry entry{};
+        std::memcpy(entry.instrument_name, header.instrument_name, sizeof(entry.instrument_name));
+        entry.first_timestamp = header.first_timestamp;
+        entry.last_timestamp = header.last_timestamp;
+        entry.offset = offset;
+        entry.bytes = bytes;
+        index.push_back(entry);
+        offset += bytes;
+    }
+}
+
+std::vector<std::string> TickReader::instruments() const {
+    std::vector<std::string> names;
+    for (const auto& [instrument_name, blocks] : by_instrument) {
+        names.push_back(instrument_name);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+std::vector<TickReader::Block> TickReader::blocks(const std::string& instrument_name, long long from, long long to) const {
+    std::vector<Block> result;
+    auto it = by_instrument.find(instrument_name);
+    if (it == by_instrument.end()) return result;
+    for (const Block& block : it->second) {
+        if (block.first_timestamp > to) break;
+        if (block.last_timestamp >= from) result.push_back(block);
+    }
+    return result;
+}
+
+// One side of a book being replayed, ascending by price. Replayed books are a few dozen
+// levels deep, where a sorted vector beats a node-based map on every operation.
+class FlatLevels {
+private:
+    std::vector<std::pair<int64_t, int64_t>> levels;
+
+public:
+    using const_iterator = std::vector<std::pair<int64_t, int64_t>>::const_iterator;
+    using const_reverse_iterator = std::vector<std::pair<int64_t, int64_t>>::const_reverse_iterator;
+
+    void clear() { levels.clear(); }
+    bool empty() const { return levels.empty(); }
+    const std::pair<int64_t, int64_t>& lowest() const { return levels.front(); }
+    const std::pair<int64_t, int64_t>& highest() const { return levels.back(); }
+    const_iterator begin() const { return levels.begin(); }
+    const_iterator end() const { return levels.end(); }
+    const_reverse_iterator rbegin() const { return levels.rbegin(); }
+    const_reverse_iterator rend() const { return levels.rend(); }
+
+    // An amount of 0 removes the level
+    void set(int64_t price, int64_t amount) {
+        auto it = std::lower_bound(levels.begin(), levels.end(), price,
+            [](const std::pair<int64_t, int64_t>& level, int64_t value) { return level.first < value; });
+        if (it != levels.end() && it->first == price) {
+            if (amount == 0) {
+                levels.erase(it);
+            } else {
+                it->second = amount;
+            }
+        } else if (amount != 0) {
+            levels.insert(it, {price, amount});
+        }
+    }
+};
+
+// Decode a block in place, calling on_event(timestamp, bids, asks) with the book after every
+// event until it returns false
+template <typename OnEvent>
+static void decodeBlock(const uint8_t* block, OnEvent&& on_event) {
+    BlockHeader header;
+    std::memcpy(&header, block, sizeof(header));
+
+    const uint8_t* columns[COLUMNS];
+    columns[0] = block + sizeof(header);
+    for (uint32_t c = 1; c < COLUMNS; ++c) {
+        columns[c] = columns[c - 1] + header.column_bytes[c - 1];
+    }
+    const uint8_t* timestamps = columns[TIMESTAMPS];
+    const uint8_t* level_counts = columns[LEVEL_COUNTS];
+    const uint8_t* sides = columns[SIDES];
+    const uint8_t* prices = columns[PRICES];
+    const uint8_t* amounts = columns[AMOUNTS];
+
+    FlatLevels bids;
+    FlatLevels asks;
+    int64_t timestamp = header.first_timestamp;
+    int64_t price = 0;
+    uint32_t level = 0;
+
+    for (uint32_t event = 0; event < header.event_count; ++event) {
+        timestamp += getSigned(timestamps);
+        uint64_t count = getVarint(level_counts);
+        if (count & 1) {
+            bids.clear();
+            asks.clear();
+        }
+        for (uint64_t i = 0; i < (count >> 1); ++i, ++level) {
+            bool isBid = (sides[level / 8] >> (level % 8)) & 1;
+            price += getSigned(prices);
+            int64_t amount = int64_t(getVarint(amounts));
+            (isBid ? bids : asks).set(price, amount);
+        }
+        if (!on_event(timestamp, header, bids, asks)) break;
+    }
+}
+
+size_t TickReader::replay(const Block& block, long long from, long long to, const Visitor& visit) const {
+    BookSnapshot book;
+    size_t visited = 0;
+    decodeBlock(data + block.entry->offset, [&](int64_t timestamp, const BlockHeader& header,
+        const FlatLevels& bids, const FlatLevels& asks) {
+        if (timestamp < from) return true;
+        if (timestamp > to) return false;
+
+        book.bids.prices.clear();
+        book.bids.amounts.clear();
+        book.asks.prices.clear();
+        book.asks.amounts.clear();
+        for (auto it = bids.rbegin(); it != bids.rend(); ++it) {
+            book.bids.prices.push_back(it->first * header.price_increment);
+            book.bids.amounts.push_back(it->second * header.amount_increment);
+        }
+        for (const auto& [level_price, level_amount] : asks) {
+            book.asks.prices.push_back(level_price * header.price_increment);
+            book.asks.amounts.push_back(level_amount * header.amount_increment);
+        }
+        visit(timestamp, book);
+        ++visited;
+        return true;
+    });
+    return visited;
+}
+
+size_t TickReader::topOfBook(const Block& block, long long from, long long to, TopOfBookColumns& out) const {
+    constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+    size_t visited = 0;
+    decodeBlock(data + block.entry->offset, [&](int64_t timestamp, const BlockHeader& header,
+        const FlatLevels& bids, const FlatLevels& asks) {
+        if (timestamp < from) return true;
+        if (timestamp > to) return false;
+
+        out.timestamps.push_back(timestamp);
+        out.bid_prices.push_back(bids.empty() ? NaN : bids.highest().first * header.price_increment);
+        out.bid_amounts.push_back(bids.empty() ? NaN : bids.highest().second * header.amount_increment);
+        out.ask_prices.push_back(asks.empty() ? NaN : asks.lowest().first * header.price_increment);
+        out.ask_amounts.push_back(asks.empty() ? NaN : asks.lowest().second * header.amount_increment);
+        ++visited;
+        return true;
+    });
+    return visited;
+}
+
+size_t TickReader::scan(const std::string& instrument_name, long long from, long long to, const Visitor& visit) const {
+    size_t visited = 0;
+    for (const Block& block : blocks(instrument_name, from, to)) {
+        visited += replay(block, from, to, visit);
+    }
+    return visited;
+}
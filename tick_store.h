@@ -0,0 +1,191 @@
+#pragma once
+
+#include "book_analytics.h"
+#include "json_parser.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// On-disk tick store for order books.
+//
+// A store is a data file plus an index file (path + ".idx"), both append-only. The data file is
+// a sequence of blocks, one instrument per block. A block starts with a full snapshot of the
+// book followed by deltas, so every block decodes on its own. Inside a block the events and
+// their levels are stored column by column: timestamps and prices are delta encoded in integer
+// ticks, and every column is zigzag/varint packed. The index has one fixed-size record per block
+// (instrument, time range, offset). Readers mmap the data file and decode blocks straight from
+// the mapping; if the index is missing or behind the data file (e.g. after a crash) it is
+// rebuilt from the block headers.
+namespace tick_store {
+
+constexpr uint32_t COLUMNS = 5;  // timestamps, level counts, sides, prices, amounts
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;
+};
+
+struct BlockHeader {
+    uint32_t magic;
+    uint32_t event_count;
+    uint32_t level_count;
+    uint32_t column_bytes[COLUMNS];
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    double price_increment;
+    double amount_increment;
+    char instrument_name[64];
+};
+
+struct IndexEntry {
+    char instrument_name[64];
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+// One level update inside a delta; an amount of 0 removes the level
+struct BookChange {
+    bool isBid;
+    double price;
+    double amount;
+};
+
+// Best bid/ask after every event, one array per field; NaN where a side is empty
+struct TopOfBookColumns {
+    std::vector<long long> timestamps;
+    std::vector<double> bid_prices;
+    std::vector<double> bid_amounts;
+    std::vector<double> ask_prices;
+    std::vector<double> ask_amounts;
+
+    size_t size() const { return timestamps.size(); }
+    void clear();
+};
+
+class StoreError : public std::runtime_error {
+public:
+    explicit StoreError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+} // namespace tick_store
+
+// Appends order book snapshots and deltas to a tick store. Books are buffered per instrument
+// and written as a block once `block_events` events have accumulated, on flush(), and on
+// destruction. Updates that leave the book unchanged are not stored. Not thread-safe; use one
+// recorder per file.
+class TickRecorder {
+private:
+    struct Increments {
+        double price;
+        double amount;
+    };
+
+    // Levels of one side in integer ticks
+    using Levels = std::map<int64_t, int64_t>;
+
+    struct OpenBlock {
+        Increments increments;
+        Levels bids;                // book as of the last event
+        Levels asks;
+        uint32_t event_count = 0;
+        uint32_t level_count = 0;
+        int64_t first_timestamp = 0;
+        int64_t last_timestamp = 0;
+        int64_t last_price = 0;
+        std::string columns[tick_store::COLUMNS];
+        uint8_t side_bits = 0;
+    };
+
+    std::string path;
+    int data_fd = -1;
+    int index_fd = -1;
+    uint64_t data_bytes = 0;
+    size_t block_events;
+    Increments default_increments;
+    std::unordered_map<std::string, Increments> increments;
+    std::unordered_map<std::string, OpenBlock> open_blocks;
+
+    OpenBlock& openBlock(const std::string& instrument_name);
+    void appendEvent(OpenBlock& block, int64_t timestamp, bool is_snapshot,
+        const std::vector<std::tuple<bool, int64_t, int64_t>>& levels);
+    void writeBlock(const std::string& instrument_name, OpenBlock& block);
+
+public:
+    // Creates the store or appends to an existing one. Prices and amounts are stored as
+    // multiples of the increments; set them per instrument to the tick and lot size.
+    explicit TickRecorder(const std::string& path, size_t block_events = 4096,
+        double price_increment = 0.0001, double amount_increment = 0.0001);
+    ~TickRecorder();
+
+    TickRecorder(const TickRecorder&) = delete;
+    TickRecorder& operator=(const TickRecorder&) = delete;
+
+    // Takes effect from the instrument's next block
+    void setIncrements(const std::string& instrument_name, double price_increment, double amount_increment);
+
+    // Full book; stored as the delta to the previous book of the instrument
+    void recordSnapshot(const std::string& instrument_name, long long timestamp, const BookSnapshot& book);
+    // A getOrderBook response (instrument_name and timestamp are taken from it)
+    void recordOrderBook(const JsonValue& response);
+    // Level changes as pushed on the book.* channels
+    void recordChanges(const std::string& instrument_name, long long timestamp,
+        const std::vector<tick_store::BookChange>& changes);
+
+    // Write every open block to disk
+    void flush();
+    uint64_t bytesWritten() const { return data_bytes; }
+};
+
+// Read-only view of a tick store through mmap.
+class TickReader {
+public:
+    struct Block {
+        const tick_store::IndexEntry* entry;
+        long long first_timestamp;
+        long long last_timestamp;
+    };
+
+    using Visitor = std::function<void(long long timestamp, const BookSnapshot& book)>;
+
+private:
+    const uint8_t* data = nullptr;
+    size_t data_size = 0;
+    std::vector<tick_store::IndexEntry> index;
+    std::unordered_map<std::string, std::vector<Block>> by_instrument;   // sorted by first_timestamp
+
+    void loadIndex(const std::string& index_path);
+    void rebuildIndex(uint64_t from_offset);
+
+public:
+    explicit TickReader(const std::string& path);
+    ~TickReader();
+
+    TickReader(const TickReader&) = delete;
+    TickReader& operator=(const TickReader&) = delete;
+
+    std::vector<std::string> instruments() const;
+    size_t blockCount() const { return index.size(); }
+
+    // Blocks of an instrument overlapping [from, to], in time order
+    std::vector<Block> blocks(const std::string& instrument_name, long long from, long long to) const;
+
+    // Replay one block and call `visit` with the reconstructed book after every event in
+    // [from, to]; returns the number of events visited. Blocks are independent, so different
+    // blocks may be replayed on different threads.
+    size_t replay(const Block& block, long long from, long long to, const Visitor& visit) const;
+
+    // Like replay(), but only appends the top of book to `out`, without building the books
+    size_t topOfBook(const Block& block, long long from, long long to, tick_store::TopOfBookColumns& out) const;
+
+    // Replay every event of an instrument in [from, to]
+    size_t scan(const std::string& instrument_name, long long from, long long to, const Visitor& visit) const;
+};
@@ -1,127 +1,588 @@
 #include "trading_system.h"
+#include "session_pool.h"
+#include "logger.h"
 #include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <mutex>
 
 std::string boolString(bool b) {
     return b ? "true" : "false";
 }
 
-TradingSystem::TradingSystem() {
-    // Initialize global curl environment
-    curl_global_init(CURL_GLOBAL_ALL);
+// Number for a query string: the shortest decimal that reads back exactly
+static std::string numberString(double value) {
+    char text[32];
+    return std::string(text, std::to_chars(text, text + sizeof(text), value).ptr);
+}
 
-    // Get all currencies
-    {
-        std::string url = "https://test.deribit.com/api/v2/public/get_currencies";
-        JsonValue result = parser.parse(client.get(url));
-        for (const JsonValue& currency : result.at("result").get<JsonArray>()) {
-            currencies.push_back(currency.at("currency").get<std::string>());
+enum class RoundTo { Down, Up, Nearest };
+
+// True if the value is a whole number of steps. Off the grid it is rounded to one in `direction`
+// if `round` is set, and refused otherwise.
+static bool snapToGrid(double& value, const Increment& step, RoundTo direction, bool round) {
+    if (step.isMultiple(value)) return true;
+    if (!round) return false;
+    int64_t steps = direction == RoundTo::Down ? step.floorSteps(value)
+        : direction == RoundTo::Up ? step.ceilSteps(value) : step.nearestSteps(value);
+    value = step.value(steps);
+    return true;
+}
+
+// Contracts in the instrument's amount units, which risk limits are set in
+static double contractAmount(const Instrument& instrument, int contracts) {
+    return instrument.contract_size > 0 ? contracts * instrument.contract_size : contracts;
+}
+
+static bool hasResult(const JsonValue& response) {
+    return std::holds_alternative<JsonObject>(response.value) &&
+        response.get<JsonObject>().find("result") != response.get<JsonObject>().end();
+}
+
+template<typename... Args>
+TradingSystem::Prepared TradingSystem::reject(const char* format, const Args&... args) {
+    logging::warn(format, args...);
+    return Prepared::rejected(logging::format(format, args...));
+}
+
+// Each thread gets its own transport and parser: a RestClient owns a single response buffer
+// and a JsonParser keeps its cursor between calls, so neither can be shared across threads
+RestClient& TradingSystem::client() {
+    thread_local RestClient client;
+    return client;
+}
+
+JsonParser& TradingSystem::parser() {
+    thread_local JsonParser parser;
+    return parser;
+}
+
+JsonStreamParser& TradingSystem::streamParser() {
+    thread_local JsonStreamParser parser;
+    return parser;
+}
+
+std::string TradingSystem::request(const std::string& url, const std::string& authToken) {
+    if (!authToken.empty()) rate_limiter.acquire();
+    return transport ? transport->get(url, authToken) : client().get(url, authToken);
+}
+
+Result<JsonValue> TradingSystem::fetchJson(Transport* transport, const std::string& url, const std::string& authToken) {
+    if (!transport) return client().getJson(url, authToken, streamParser());
+    std::string response = transport->get(url, authToken);
+    // Transports report failed transfers as "Error: <message>", like RestClient::get
+    if (response.rfind("Error: ", 0) == 0) {
+        return Result<JsonValue>::failure(ErrorCode::Transport, response.substr(7));
+    }
+    try {
+        return parser().parse(response);
+    } catch (const std::exception& e) {
+        return Result<JsonValue>::failure(ErrorCode::Parse, std::string("Invalid response: ") + e.what());
+    }
+}
+
+Result<JsonValue> TradingSystem::fetchJson(const std::string& url, const std::string& authToken) {
+    if (!authToken.empty()) rate_limiter.acquire();
+    return fetchJson(transport.get(), url, authToken);
+}
+
+JsonValue TradingSystem::requestJson(Transport* transport, const std::string& url, const std::string& authToken) {
+    Result<JsonValue> response = fetchJson(transport, url, authToken);
+    if (!response) throw std::runtime_error(response.error().message);
+    return std::move(response.value());
+}
+
+JsonValue TradingSystem::requestJson(const std::string& url, const std::string& authToken) {
+    if (!authToken.empty()) rate_limiter.acquire();
+    return requestJson(transport.get(), url, authToken);
+}
+
+TradingSystem::TradingSystem() : TradingSystem(nullptr) {}
+
+TradingSystem::TradingSystem(std::shared_ptr<Transport> transport)
+    : transport(std::move(transport)), fanout_pool(std::make_shared<ThreadPool>(4)) {
+    universe = std::make_shared<InstrumentUniverse>(InstrumentRegistry::load(
+        InstrumentRegistry::FetchJson([this](const std::string& url) { return requestJson(url); })));
+    authenticate({secrets::client_id, secrets::client_secret});
+}
+
+TradingSystem::TradingSystem(const SessionPool& pool, const Credentials& credentials, RateLimit limit)
+    : transport(pool.transport), fanout_pool(pool.fanout_pool), universe(pool.universe), rate_limiter(limit) {
+    authenticate(credentials);
+}
+
+void TradingSystem::authenticate(const Credentials& credentials) {
+    std::string url = "https://test.deribit.com/api/v2/public/auth?client_id=" + credentials.client_id + "&client_secret=" + credentials.client_secret + "&grant_type=client_credentials";
+    JsonValue result = requestJson(url);
+    this->auth_token = result.at("result").at("access_token").get<std::string>();
+}
+
+TradingSystem::~TradingSystem() {
+    awaitTriggeredOrders();
+    if (reconcile_thread.joinable()) {
+        reconcile_thread.request_stop();
+        reconcile_thread.join();
+    }
+    this->auth_token.clear();
+}
+
+void TradingSystem::trackOrder(const JsonValue& order) {
+    auto registry = universe->read();
+    const Instrument* instrument = registry->find(order.at("instrument_name").get<std::string>());
+    if (instrument) {
+        order_cache.applyOrder(order, *instrument);
+    }
+}
+
+void TradingSystem::trackOrderResponse(const JsonValue& response) {
+    if (!hasResult(response)) return;
+    const JsonValue& result = response.at("result");
+    trackOrder(result.at("order"));
+    if (risk_engine) {
+        for (const JsonValue& trade : result.at("trades").get<JsonArray>()) {
+            riskTrade(trade);
+        }
+    }
+}
+
+void TradingSystem::enableRiskChecks(const RiskLimits& limits) {
+    risk_engine = std::make_unique<RiskEngine>(universe->read()->table(), limits);
+    order_cache.setWorkingListener([this](const std::string& instrument_name, bool isBuy, double amount, double price) {
+        if (!risk_engine->onWorking(instrument_name, isBuy, amount, price) && addRiskInstrument(instrument_name)) {
+            risk_engine->onWorking(instrument_name, isBuy, amount, price);
+        }
+    });
+}
+
+bool TradingSystem::addRiskInstrument(const std::string& instrument_name) {
+    auto registry = universe->read();
+    const Instrument* instrument = registry->find(instrument_name);
+    if (!instrument) return false;
+    risk_engine->addInstrument(instrument_name, *instrument);
+    return true;
+}
+
+RiskResult TradingSystem::checkRisk(const std::string& instrument_name, bool isBuy, double amount, double price,
+    RiskEngine::Reservation* reservation, double replaced) {
+    auto check = [&] {
+        return reservation ? risk_engine->checkEdit(instrument_name, isBuy, amount, replaced, price, reservation)
+                           : risk_engine->checkLimits(instrument_name, isBuy, amount, price);
+    };
+    RiskResult risk = check();
+    if (risk == RiskResult::UnknownInstrument && addRiskInstrument(instrument_name)) {
+        risk = check();
+    }
+    return risk;
+}
+
+void TradingSystem::riskTrade(const JsonValue& trade) {
+    if (!risk_engine->onTrade(trade) && addRiskInstrument(trade.at("instrument_name").get<std::string>())) {
+        risk_engine->onTrade(trade);
+    }
+}
+
+bool TradingSystem::passesRiskCheck(RiskResult result) const {
+    if (result != RiskResult::Ok) {
+        logging::warn("Risk check failed: {}", riskResultString(result));
+        return false;
+    }
+    return true;
+}
+
+void TradingSystem::enableLocalTriggers() {
+    trigger_engine = std::make_unique<TriggerEngine>([this](const std::string& trigger_id, const TriggerOrder& order) {
+        fireTrigger(trigger_id, order);
+    });
+}
+
+void TradingSystem::onPrice(const std::string& instrument_name, TriggerReference reference, double price) {
+    if (trigger_engine) trigger_engine->onPrice(instrument_name, reference, price);
+}
+
+TradingSystem::Prepared TradingSystem::prepareLocalTrigger(const TriggerOrder& order) {
+    std::string trigger_id = trigger_engine->add(order);
+    if (trigger_id.empty()) {
+        return reject("Invalid trigger order: {} needs a trigger price (or offset) and, for limits, a price", order.type);
+    }
+    JsonObject result;
+    result.emplace("order", trigger_engine->orderJson(trigger_id));
+    result.emplace("trades", JsonValue(JsonArray()));
+    JsonObject response;
+    response.emplace("result", JsonValue(std::move(result)));
+    return Prepared::answered(JsonValue(std::move(response)));
+}
+
+JsonValue TradingSystem::addLocalTrigger(const TriggerOrder& order) {
+    if (!trigger_engine) {
+        logging::warn("Local triggers are not enabled");
+        return JsonValue();
+    }
+    if (!universe->read()->hasInstrument(order.instrument_name)) {
+        logging::warn("Instrument not found: {}", order.instrument_name);
+        return JsonValue();
+    }
+    if (!order.watch_instrument.empty() && !universe->read()->hasInstrument(order.watch_instrument)) {
+        logging::warn("Instrument not found: {}", order.watch_instrument);
+        return JsonValue();
+    }
+    return execute(prepareLocalTrigger(order));
+}
+
+struct TradingSystem::HeldSelection {
+    std::string currency = "";          // settlement currency; empty or "any" for all
+    std::string currency_pair = "";     // index price name, e.g. btc_usd
+    std::string instrument_name = "";
+    std::string kind = "";              // empty or "any" for all
+    std::string type = "all";
+    std::string label = "";
+
+    bool matches(const TriggerOrder& order, const InstrumentRegistry& registry) const {
+        if (!instrument_name.empty() && order.instrument_name != instrument_name) return false;
+        if (!label.empty() && order.label != label) return false;
+        if (!OrderCache::matchesType(order.type, type)) return false;
+        bool any_currency = currency.empty() || currency == "any";
+        bool any_kind = kind.empty() || kind == "any";
+        if (any_currency && any_kind && currency_pair.empty()) return true;
+        const Instrument* instrument = registry.find(order.instrument_name);
+        if (!instrument) return false;
+        if (!any_currency && instrument->settlement_currency != currency) return false;
+        if (!any_kind && instrument->kind != kind) return false;
+        if (!currency_pair.empty()) {
+            std::string pair = instrument->base_currency + "_" + instrument->quote_currency;
+            std::transform(pair.begin(), pair.end(), pair.begin(), [](unsigned char c) { return std::tolower(c); });
+            if (pair != currency_pair) return false;
         }
+        return true;
     }
+};
 
-    // Get all index price names
+size_t TradingSystem::cancelHeld(const HeldSelection& selection) {
+    if (!trigger_engine) return 0;
+    auto registry = universe->read();
+    return trigger_engine->cancelIf([&](const TriggerOrder& order) { return selection.matches(order, *registry); });
+}
+
+TradingSystem::Prepared TradingSystem::withHeld(Prepared request, const HeldSelection& selection) {
+    if (!trigger_engine || !request.rejection.empty()) return request;
+    JsonArray held;
     {
-        std::string url = "https://test.deribit.com/api/v2/public/get_index_price_names";
-        JsonValue result = parser.parse(client.get(url));
-        for (const JsonValue& index_price_name : result.at("result").get<JsonArray>()) {
-            index_price_names.push_back(index_price_name.get<std::string>());
+        auto registry = universe->read();
+        held = trigger_engine->ordersJson([&](const TriggerOrder& order) { return selection.matches(order, *registry); });
+    }
+    if (!request.url.empty()) {
+        request.held = std::move(held);
+    } else if (hasResult(request.local)) {
+        JsonArray& orders = std::get<JsonArray>(std::get<JsonObject>(request.local.value)["result"].value);
+        std::move(held.begin(), held.end(), std::back_inserter(orders));
+    }
+    return request;
+}
+
+// Adds the orders cancelled locally to a mass cancel's count; detailed responses are left as they are
+static void countCancelled(JsonValue& response, size_t held) {
+    if (held == 0 || !hasResult(response)) return;
+    JsonValue& count = std::get<JsonObject>(response.value)["result"];
+    if (std::holds_alternative<double>(count.value)) count = JsonValue(count.get<double>() + double(held));
+}
+
+void TradingSystem::fireTrigger(const std::string& trigger_id, const TriggerOrder& order) {
+    // Runs on the thread that delivered the price; the order goes out from the pool
+    std::lock_guard lock(firing_mutex);
+    std::erase_if(firing, [](const std::future<void>& sent) {
+        return sent.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+    firing.push_back(fanout_pool->submit([this, trigger_id, order] { sendTrigger(trigger_id, order); }));
+}
+
+void TradingSystem::sendTrigger(const std::string& trigger_id, const TriggerOrder& order) {
+    bool is_limit = order.type == "stop_limit" || order.type == "take_limit";
+    Result<JsonValue> result = attempt(prepareOrder(order.isBuy, order.instrument_name, order.amount, order.contracts,
+        is_limit ? "limit" : "market", order.label, is_limit ? order.price : -1, order.time_in_force, -1,
+        order.post_only, order.reject_post_only, order.reduce_only, -1, -1, "", "", -1, 0, "", ""));
+    if (!result) {
+        logging::warn("Triggered order {} was not accepted: {}", trigger_id, result.error().message);
+    }
+}
+
+void TradingSystem::awaitTriggeredOrders() {
+    std::vector<std::future<void>> pending;
+    {
+        std::lock_guard lock(firing_mutex);
+        pending.swap(firing);
+    }
+    for (std::future<void>& sent : pending) {
+        sent.wait();
+    }
+}
+
+void TradingSystem::onOrderEvent(const JsonValue& params) {
+    const std::string& channel = params.at("channel").get<std::string>();
+    const JsonValue& data = params.at("data");
+
+    if (channel.rfind("user.orders", 0) == 0) {
+        if (std::holds_alternative<JsonArray>(data.value)) {
+            for (const JsonValue& order : data.get<JsonArray>()) {
+                trackOrder(order);
+            }
+        } else {
+            trackOrder(data);
+        }
+    } else if (channel.rfind("user.trades", 0) == 0) {
+        for (const JsonValue& trade : data.get<JsonArray>()) {
+            order_cache.applyTrade(trade);
+            if (risk_engine) riskTrade(trade);
+        }
+    } else if (channel.rfind("user.changes", 0) == 0) {
+        for (const JsonValue& trade : data.at("trades").get<JsonArray>()) {
+            order_cache.applyTrade(trade);
+            if (risk_engine) riskTrade(trade);
+        }
+        for (const JsonValue& order : data.at("orders").get<JsonArray>()) {
+            trackOrder(order);
+        }
+    } else if (channel.rfind("instrument.state.", 0) == 0) {
+        // instrument.state.<kind>.<currency>: a listing was created, started, settled or closed
+        std::string_view rest = std::string_view(channel).substr(17);
+        size_t dot = rest.find('.');
+        if (dot != std::string_view::npos) {
+            universe->markChanged(std::string(rest.substr(dot + 1)), std::string(rest.substr(0, dot)));
+        }
+    } else if (channel.rfind("ticker.", 0) == 0 && trigger_engine) {
+        const JsonObject& ticker = data.get<JsonObject>();
+        const std::string& instrument_name = data.at("instrument_name").get<std::string>();
+        static const std::pair<const char*, TriggerReference> references[] = {
+            {"index_price", TriggerReference::Index}, {"mark_price", TriggerReference::Mark}, {"last_price", TriggerReference::Last}};
+        for (const auto& [field, reference] : references) {
+            auto price = ticker.find(field);
+            if (price != ticker.end() && std::holds_alternative<double>(price->second.value)) {
+                trigger_engine->onPrice(instrument_name, reference, price->second.get<double>());
+            }
         }
     }
-    
-    // Get all instruments
-    for (const std::string& kind : kinds) {
-        std::string url = "https://test.deribit.com/api/v2/public/get_instruments?currency=any&kind=" + kind;
-        std::string response = client.get(url);
-        JsonValue result = parser.parse(response);
-        for (const JsonValue& instrument : result.at("result").get<JsonArray>()) {
-            instruments[instrument.at("instrument_name").get<std::string>()] = Instrument(
-                instrument.at("base_currency").get<std::string>(),
-                instrument.at("quote_currency").get<std::string>(),
-                instrument.at("kind").get<std::string>(),
-                instrument.at("is_active").get<bool>()
-            );
+}
+
+std::vector<JsonValue> TradingSystem::fanOut(const std::vector<std::string>& order_ids,
+    const std::function<JsonValue(const std::string&)>& request) {
+    std::vector<std::future<JsonValue>> pending;
+    for (const std::string& order_id : order_ids) {
+        pending.push_back(fanout_pool->submit([&request, order_id] { return request(order_id); }));
+    }
+    std::vector<JsonValue> results;
+    for (std::future<JsonValue>& result : pending) {
+        try {
+            results.push_back(result.get());
+        } catch (const std::exception& e) {
+            logging::error("Request failed: {}", e.what());
+            results.push_back(JsonValue());
         }
     }
+    return results;
+}
 
-    // Get Auth Token
-    std::string url = "https://test.deribit.com/api/v2/public/auth?client_id=" + secrets::client_id + "&client_secret=" + secrets::client_secret + "&grant_type=client_credentials";
-    std::string response = client.get(url);
-    JsonValue result = parser.parse(response);
-    this->auth_token = result.at("result").at("access_token").get<std::string>();
+size_t TradingSystem::reconcileOrders() {
+    uint64_t since_seq = order_cache.beginReconcile();
+    std::string url = "https://test.deribit.com/api/v2/private/get_open_orders?type=all";
+    JsonValue result;
+    const JsonArray* open_orders = nullptr;
+    try {
+        result = requestJson(url, this->auth_token);
+        open_orders = &result.at("result").get<JsonArray>();
+    } catch (...) {
+        order_cache.abandonReconcile();
+        throw;
+    }
+    size_t drift = order_cache.reconcile(*open_orders, since_seq, *universe->read());
+    if (drift != 0) {
+        logging::warn("Order cache drift: {} orders differed from the exchange", drift);
+    }
+    return drift;
 }
 
-TradingSystem::~TradingSystem() {
-    // Cleanup global curl environment
-    this->auth_token.clear();
-    curl_global_cleanup();
+void TradingSystem::startInstrumentRefresh(std::chrono::milliseconds full_interval) {
+    // The refresh thread belongs to the universe, which may outlive this TradingSystem
+    universe->startRefresh([transport = transport](const std::string& url) {
+        return transport ? transport->get(url, "") : client().get(url);
+    }, full_interval);
+}
+
+void TradingSystem::startOrderReconciliation(std::chrono::milliseconds interval) {
+    reconcileOrders();
+    reconcile_thread = std::jthread([this, interval](std::stop_token stop) {
+        runtime::unpin();
+        std::mutex mutex;
+        std::condition_variable_any wakeup;
+        std::unique_lock lock(mutex);
+        while (!wakeup.wait_for(lock, stop, interval, [&stop] { return stop.stop_requested(); })) {
+            try {
+                reconcileOrders();
+            } catch (const std::exception& e) {
+                logging::error("Order reconciliation failed: {}", e.what());
+            }
+        }
+    });
+}
+
+Result<JsonValue> TradingSystem::attempt(const Prepared& request) {
+    if (request.url.empty()) {
+        if (!request.rejection.empty()) {
+            return Result<JsonValue>::failure(ErrorCode::Validation, request.rejection);
+        }
+        return request.local;
+    }
+    return complete(request, fetchJson(request.url, request.authenticated ? this->auth_token : ""));
+}
+
+Result<JsonValue> TradingSystem::complete(const Prepared& request, const std::string& response) {
+    // HTTP clients report failed transfers as "Error: <curl message>"
+    if (response.rfind("Error: ", 0) == 0) {
+        return Result<JsonValue>::failure(ErrorCode::Transport, response.substr(7));
+    }
+    try {
+        return complete(request, parser().parse(response));
+    } catch (const std::exception& e) {
+        return Result<JsonValue>::failure(ErrorCode::Parse, std::string("Invalid response: ") + e.what());
+    }
+}
+
+Result<JsonValue> TradingSystem::complete(const Prepared& request, Result<JsonValue> response) {
+    if (!response) return response;
+    response = exchangeResult(std::move(response.value()));
+    if (!response) return response;
+    JsonValue result = std::move(response.value());
+    try {
+        onResult(request, result);
+    } catch (const std::exception& e) {
+        return Result<JsonValue>::failure(ErrorCode::Parse, std::string("Unexpected response: ") + e.what());
+    }
+    if (!request.held.empty() && hasResult(result) && std::holds_alternative<JsonArray>(result.at("result").value)) {
+        JsonArray& orders = std::get<JsonArray>(std::get<JsonObject>(result.value)["result"].value);
+        orders.insert(orders.end(), request.held.begin(), request.held.end());
+    }
+    return result;
+}
+
+JsonValue TradingSystem::unwrap(Result<JsonValue> result) {
+    if (result) {
+        return std::move(result.value());
+    }
+    const TradingError& error = result.error();
+    switch (error.code) {
+        case ErrorCode::Validation:
+            return JsonValue();
+        case ErrorCode::Exchange:
+            return error.response;
+        case ErrorCode::Transport:
+        case ErrorCode::Parse:
+            break;
+    }
+    throw std::runtime_error(std::string(errorCodeString(error.code)) + " error: " + error.message);
+}
+
+JsonValue TradingSystem::execute(const Prepared& request) {
+    return unwrap(attempt(request));
+}
+
+void TradingSystem::onResult(const Prepared& request, const JsonValue& result) {
+    switch (request.on_result) {
+        case Prepared::OnResult::ReferencePrice:
+            if (risk_engine && hasResult(result)) {
+                risk_engine->setReferencePrice(request.instrument_name, result.at("result").at("mark_price").get<double>());
+            }
+            break;
+        case Prepared::OnResult::TrackOrder:
+            trackOrderResponse(result);
+            break;
+        case Prepared::OnResult::TrackCancel:
+            if (hasResult(result)) trackOrder(result.at("result"));
+            break;
+        case Prepared::OnResult::None:
+            break;
+    }
 }
 
 JsonValue TradingSystem::getOrderBook(const std::string& instrument_name, int depth) {
-    if (instruments.find(instrument_name) == instruments.end()) {
-        std::cout << "Instrument not found: " + instrument_name << std::endl;
-        return JsonValue();
+    return execute(prepareOrderBook(instrument_name, depth));
+}
+
+TradingSystem::Prepared TradingSystem::prepareOrderBook(const std::string& instrument_name, int depth) {
+    if (!universe->read()->hasInstrument(instrument_name)) {
+        return reject("Instrument not found: {}", instrument_name);
     }
     if (depth != 1 && depth != 5 && depth != 10 && depth != 20 && depth != 50 && depth != 100 && depth != 1000 && depth != 10000) {
-        std::cout << "Invalid depth: " + std::to_string(depth) << std::endl;
-        return JsonValue();
+        return reject("Invalid depth: {}", depth);
     }
     std::string url = "https://test.deribit.com/api/v2/public/get_order_book?instrument_name=" + instrument_name + "&depth=" + std::to_string(depth);
-    std::string response = client.get(url);
-    JsonValue result = parser.parse(response);
-    return result;
+    Prepared request = Prepared::fetch(url, Prepared::OnResult::ReferencePrice, false);
+    request.instrument_name = instrument_name;
+    return request;
 }
 
-JsonValue TradingSystem::placeOrder(bool isBuy, const std::string instrument_name, int amount, int contracts,
-        const std::string type, const std::string label, int price,
+TradingSystem::Prepared TradingSystem::prepareOrder(bool isBuy, const std::string instrument_name, double amount, int contracts,
+        const std::string type, const std::string label, double price,
         const std::string time_in_force, int max_show, int post_only,
-        int reject_post_only, int reduce_only, int trigger_price,
+        int reject_post_only, int reduce_only, double trigger_price,
         int trigger_offset, const std::string trigger, const std::string advanced,
         int mmp, int valid_until, const std::string linked_order_type,
         const std::string trigger_fill_condition) {
     
     std::string params = "";
-    if (instruments.find(instrument_name) == instruments.end()) {
-        std::cout << "Instrument not found: " + instrument_name << std::endl;
-        return JsonValue();
+    auto registry = universe->read();
+    const Instrument* instrument = registry->find(instrument_name);
+    if (!instrument) {
+        return reject("Instrument not found: {}", instrument_name);
     } else {
         params += "instrument_name=" + instrument_name;
     }
+    bool round = order_rounding == OrderRounding::Round;
 
     if (amount == 0 && contracts == 0) {
-        std::cout << "Amount and contracts cannot both be zero" << std::endl;
-        return JsonValue();
+        return reject("Amount and contracts cannot both be zero");
     } else if (amount != 0 && contracts != 0) {
-        std::cout << "Amount and contracts cannot both be non-zero" << std::endl;
-        return JsonValue();
+        return reject("Amount and contracts cannot both be non-zero");
     } else if (amount != 0) {
-        params += "&amount=" + std::to_string(amount);
+        if (instrument->lot.known() && instrument->lot.floorSteps(amount) < 1) {
+            return reject("Amount {} is below the minimum of {} for {}", amount, instrument->min_trade_amount, instrument_name);
+        }
+        // Rounded down: never more than asked for
+        if (!snapToGrid(amount, instrument->lot, RoundTo::Down, round)) {
+            return reject("Amount {} is not a multiple of {} for {}", amount, instrument->min_trade_amount, instrument_name);
+        }
+        params += "&amount=" + numberString(amount);
     } else {
+        if (instrument->contract_size > 0 && contracts * instrument->contract_size < instrument->min_trade_amount) {
+            return reject("{} contracts are below the minimum of {} for {}", contracts, instrument->min_trade_amount, instrument_name);
+        }
         params += "&contracts=" + std::to_string(contracts);
     }
 
     if (type != "" && type != "limit" && type != "stop_limit" && type != "take_limit" && type != "market" && type != "stop_market" && type != "take_market" && type != "market_limit" && type != "trailing_stop") {
-        std::cout << "Invalid order type: " + type << std::endl;
-        return JsonValue();
+        return reject("Invalid order type: {}", type);
     } else if (!type.empty()) {
         params += "&type=" + type;
     }
 
     if (label.length() > 64) {
-        std::cout << "Label is too long: " + label << std::endl;
-        return JsonValue();
+        return reject("Label is too long: {}", label);
     } else if (!label.empty()) {
         params += "&label=" + label;
     }
 
     if (price == -1 && (type == "" || type == "limit" || type == "stop_limit")) {
-        std::cout << "Price cannot be zero for order type: " + type << std::endl;
-        return JsonValue();
+        return reject("Price cannot be zero for order type: {}", type);
     } else if (price != -1) {
-        params += "&price=" + std::to_string(price);
+        // Rounded away from the touch, so rounding never makes an order more aggressive
+        double asked = price;
+        if (!snapToGrid(price, instrument->tick, isBuy ? RoundTo::Down : RoundTo::Up, round)) {
+            return reject("Price {} is not a multiple of the tick size {} for {}", asked, instrument->tick_size, instrument_name);
+        }
+        if (price <= 0 && asked > 0) {
+            return reject("Price {} rounds to zero at the tick size {} for {}", asked, instrument->tick_size, instrument_name);
+        }
+        params += "&price=" + numberString(price);
     }
 
     if (time_in_force != "" && time_in_force != "good_til_cancelled" && time_in_force != "good_til_day" && time_in_force != "fill_or_kill" && time_in_force != "immediate_or_cancel") {
-        std::cout << "Invalid time in force: " + time_in_force << std::endl;
-        return JsonValue();
+        return reject("Invalid time in force: {}", time_in_force);
     } else if (!time_in_force.empty()) {
         params += "&time_in_force=" + time_in_force;
     }
@@ -130,11 +591,12 @@ JsonValue TradingSystem::placeOrder(bool isBuy, const std::string instrument_nam
         params += "&max_show=" + std::to_string(max_show);
     }
 
-    if (post_only == 1 && type == "good_til_cancelled") {
+    // post_only only applies to resting orders
+    if (post_only == 1 && (time_in_force == "" || time_in_force == "good_til_cancelled" || time_in_force == "good_til_day")) {
         params += "&post_only=true";
     }
 
-    if (reject_post_only == 1 && post_only == 1 && type == "good_til_cancelled") {
+    if (reject_post_only == 1 && post_only == 1 && (time_in_force == "" || time_in_force == "good_til_cancelled" || time_in_force == "good_til_day")) {
         params += "&reject_post_only=true";
     }
 
@@ -142,30 +604,34 @@ JsonValue TradingSystem::placeOrder(bool isBuy, const std::string instrument_nam
         params += "&reduce_only=true";
     }
 
-    if (trigger_price != -1 && (type == "stop_limit" || type == "take_limit" || type == "trailing_stop")) {
-        params += "&trigger_price=" + std::to_string(trigger_price);
+    bool is_trigger_type = type == "stop_limit" || type == "stop_market" || type == "take_limit" || type == "take_market" || type == "trailing_stop";
+    if (trigger_price != -1 && is_trigger_type) {
+        double asked = trigger_price;
+        if (!snapToGrid(trigger_price, instrument->tick, RoundTo::Nearest, round)) {
+            return reject("Trigger price {} is not a multiple of the tick size {} for {}", asked, instrument->tick_size, instrument_name);
+        }
+        if (trigger_price <= 0 && asked > 0) {
+            return reject("Trigger price {} rounds to zero at the tick size {} for {}", asked, instrument->tick_size, instrument_name);
+        }
+        params += "&trigger_price=" + numberString(trigger_price);
     } else if (trigger_price != -1) {
-        std::cout << "Trigger price can only be set for order types: stop_limit, take_limit, trailing_stop" << std::endl;
-        return JsonValue();
+        return reject("Trigger price can only be set for order types: stop_limit, stop_market, take_limit, take_market, trailing_stop");
     }
 
     if (trigger_offset != -1 && type == "trailing_stop") {
         params += "&trigger_offset=" + std::to_string(trigger_offset);
     } else if (trigger_offset != -1) {
-        std::cout << "Trigger offset can only be set for order type: trailing_stop" << std::endl;
-        return JsonValue();
+        return reject("Trigger offset can only be set for order type: trailing_stop");
     }
 
     if (trigger != "" && trigger != "index_price" && trigger != "mark_price" && trigger != "last_price") {
-        std::cout << "Invalid trigger: " + trigger << std::endl;
-        return JsonValue();
+        return reject("Invalid trigger: {}", trigger);
     } else if (!trigger.empty()) {
         params += "&trigger=" + trigger;
     }
 
     if (advanced != "" && advanced != "post_only" && advanced != "reduce_only" && advanced != "reject_post_only" && advanced != "trailing_stop" && advanced != "close_on_trigger") {
-        std::cout << "Invalid advanced option: " + advanced << std::endl;
-        return JsonValue();
+        return reject("Invalid advanced option: {}", advanced);
     } else if (!advanced.empty()) {
         params += "&advanced=" + advanced;
     }
@@ -173,10 +639,9 @@ JsonValue TradingSystem::placeOrder(bool isBuy, const std::string instrument_nam
     if (mmp == 1 && (type == "limit" || type == "")) {
         params += "&mmp=true";
     } else if (mmp == 0 && (type == "limit" || type == "")) {
-        params += "&mmp=flase";
+        params += "&mmp=false";
     } else if (mmp != -1) {
-        std::cout << "MMP can only be set for order type: limit" << std::endl;
-        return JsonValue();
+        return reject("MMP can only be set for order type: limit");
     }
 
     if (valid_until != 0) {
@@ -184,30 +649,49 @@ JsonValue TradingSystem::placeOrder(bool isBuy, const std::string instrument_nam
     }
 
     if (linked_order_type != "" && linked_order_type != "one_triggers_other" && linked_order_type != "one_cancels_other" && linked_order_type != "one_triggers_one_cancels_other") {
-        std::cout << "Invalid linked order type: " + linked_order_type << std::endl;
-        return JsonValue();
+        return reject("Invalid linked order type: {}", linked_order_type);
     } else if (!linked_order_type.empty()) {
         params += "&linked_order_type=" + linked_order_type;
     }
 
     if (trigger_fill_condition != "" && trigger_fill_condition != "first_hit" && trigger_fill_condition != "complete_hit" && trigger_fill_condition != "incremental") {
-        std::cout << "Invalid trigger fill condition: " + trigger_fill_condition << std::endl;
-        return JsonValue();
+        return reject("Invalid trigger fill condition: {}", trigger_fill_condition);
     } else if (!trigger_fill_condition.empty()) {
         params += "&trigger_fill_condition=" + trigger_fill_condition;
     }
 
-    if (isBuy) {
-        std::string url = "https://test.deribit.com/api/v2/private/buy?" + params;
-        std::string response = client.get(url, this->auth_token);
-        JsonValue result = parser.parse(response);
-        return result;
-    } else {
-        std::string url = "https://test.deribit.com/api/v2/private/sell?" + params;
-        std::string response = client.get(url, this->auth_token);
-        JsonValue result = parser.parse(response);
-        return result;
+    bool held = trigger_engine && is_trigger_type;
+    RiskEngine::Reservation reservation;
+    if (risk_engine) {
+        // A held trigger order takes its slot of the order rate and holds its amount when it fires
+        RiskResult risk = checkRisk(instrument_name, isBuy, amount != 0 ? amount : contractAmount(*instrument, contracts), price,
+            held ? nullptr : &reservation);
+        if (risk != RiskResult::Ok) return reject("Risk check failed: {}", riskResultString(risk));
+    }
+
+    if (held) {
+        TriggerOrder order;
+        order.instrument_name = instrument_name;
+        order.isBuy = isBuy;
+        order.type = type;
+        order.amount = amount;
+        order.contracts = contracts;
+        order.price = price;
+        order.label = label;
+        order.time_in_force = time_in_force;
+        order.post_only = post_only;
+        order.reject_post_only = reject_post_only;
+        order.reduce_only = reduce_only;
+        parseTriggerReference(trigger, order.reference);
+        order.trigger_price = trigger_price;
+        order.trigger_offset = trigger_offset;
+        return prepareLocalTrigger(order);
     }
+
+    std::string url = "https://test.deribit.com/api/v2/private/" + std::string(isBuy ? "buy" : "sell") + "?" + params;
+    Prepared request = Prepared::fetch(url, Prepared::OnResult::TrackOrder);
+    request.risk_reservation = std::move(reservation);
+    return request;
 }
 
 JsonValue TradingSystem::buy(const std::string instrument_name, int amount, int contracts,
@@ -217,7 +701,17 @@ JsonValue TradingSystem::buy(const std::string instrument_name, int amount, int
         int trigger_offset, const std::string trigger, const std::string advanced,
         int mmp, int valid_until, const std::string linked_order_type,
         const std::string trigger_fill_condition) {
-    return placeOrder(true, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition);
+    return execute(prepareOrder(true, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition));
+}
+
+Result<JsonValue> TradingSystem::tryBuy(const std::string instrument_name, int amount, int contracts,
+        const std::string type, const std::string label, int price,
+        const std::string time_in_force, int max_show, int post_only,
+        int reject_post_only, int reduce_only, int trigger_price,
+        int trigger_offset, const std::string trigger, const std::string advanced,
+        int mmp, int valid_until, const std::string linked_order_type,
+        const std::string trigger_fill_condition) {
+    return attempt(prepareOrder(true, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition));
 }
 
 JsonValue TradingSystem::sell(const std::string instrument_name, int amount, int contracts,
@@ -227,354 +721,494 @@ JsonValue TradingSystem::sell(const std::string instrument_name, int amount, int
         int trigger_offset, const std::string trigger, const std::string advanced,
         int mmp, int valid_until, const std::string linked_order_type,
         const std::string trigger_fill_condition) {
-    return placeOrder(false, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition);
+    return execute(prepareOrder(false, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition));
+}
+
+Result<JsonValue> TradingSystem::trySell(const std::string instrument_name, int amount, int contracts,
+        const std::string type, const std::string label, int price,
+        const std::string time_in_force, int max_show, int post_only,
+        int reject_post_only, int reduce_only, int trigger_price,
+        int trigger_offset, const std::string trigger, const std::string advanced,
+        int mmp, int valid_until, const std::string linked_order_type,
+        const std::string trigger_fill_condition) {
+    return attempt(prepareOrder(false, instrument_name, amount, contracts, type, label, price, time_in_force, max_show, post_only, reject_post_only, reduce_only, trigger_price, trigger_offset, trigger, advanced, mmp, valid_until, linked_order_type, trigger_fill_condition));
 }
 
 JsonValue TradingSystem::cancel(const std::string order_id) {
+    return unwrap(tryCancel(order_id));
+}
+
+Result<JsonValue> TradingSystem::tryCancel(const std::string order_id) {
+    return order_flights.cancel(order_id);
+}
+
+TradingSystem::Prepared TradingSystem::prepareCancel(const std::string& order_id) {
+    if (trigger_engine && TriggerEngine::isLocalId(order_id)) {
+        JsonValue order = trigger_engine->orderJson(order_id);
+        if (order.isNull() || !trigger_engine->cancel(order_id)) {
+            return reject("Local trigger order not found: {}", order_id);
+        }
+        std::get<JsonObject>(order.value)["order_state"] = JsonValue(std::string("cancelled"));
+        JsonObject response;
+        response.emplace("result", std::move(order));
+        return Prepared::answered(JsonValue(std::move(response)));
+    }
     std::string url = "https://test.deribit.com/api/v2/private/cancel?order_id=" + order_id;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
-    return result;
+    return Prepared::fetch(url, Prepared::OnResult::TrackCancel);
+}
+
+Result<JsonValue> TradingSystem::sendCancel(const std::string& order_id) {
+    return attempt(prepareCancel(order_id));
 }
 
 JsonValue TradingSystem::cancelAll(bool detailed, bool freeze_quotes) {
+    size_t held = cancelHeld(HeldSelection{});
     std::string url = "https://test.deribit.com/api/v2/private/cancel_all?detailed=" + boolString(detailed) + "&freeze_quotes=" + boolString(freeze_quotes);
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
+    JsonValue result = requestJson(url, this->auth_token);
+    if (hasResult(result)) order_cache.eraseAll();
+    countCancelled(result, held);
     return result;
 }
 
 JsonValue TradingSystem::cancelAllByCurrency(const std::string currency, const std::string kind,
     const std::string type, bool detailed, bool freeze_quotes) {
-    if (std::find(currencies.begin(), currencies.end(), currency) == currencies.end()) {
-        std::cout << "Invalid currency: " + currency << std::endl;
+    if (!universe->read()->hasCurrency(currency)) {
+        logging::warn("Invalid currency: {}", currency);
         return JsonValue();
     }
-    if ((kind != "any" || kind != "combo") && std::find(kinds.begin(), kinds.end(), kind) == kinds.end()) {
-        std::cout << "Invalid kind: " + kind << std::endl;
+    if (kind != "any" && kind != "combo" && !InstrumentRegistry::isKind(kind)) {
+        logging::warn("Invalid kind: {}", kind);
         return JsonValue();
     }
     if (type != "all" && type != "limit" && type != "trigger_all" && type != "stop" && type != "take" && type != "trailing_stop") {
-        std::cout << "Invalid order type: " + type << std::endl;
+        logging::warn("Invalid order type: {}", type);
         return JsonValue();
     }
+    size_t held = cancelHeld(HeldSelection{.currency = currency, .kind = kind, .type = type});
     std::string url = "https://test.deribit.com/api/v2/private/cancel_all_by_currency?currency=" + currency + "&kind=" + kind + "&type=" + type + "&detailed=" + boolString(detailed) + "&freeze_quotes=" + boolString(freeze_quotes);
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
+    JsonValue result = requestJson(url, this->auth_token);
+    if (hasResult(result)) order_cache.eraseByCurrency(currency, kind, type);
+    countCancelled(result, held);
     return result;
 }
 
 JsonValue TradingSystem::cancelAllByCurrencyPair(const std::string currency_pair, const std::string kind,
     const std::string type, bool detailed, bool freeze_quotes) {
-    if (std::find(index_price_names.begin(), index_price_names.end(), currency_pair) == index_price_names.end()) {
-        std::cout << "Invalid currency pair: " + currency_pair << std::endl;
+    if (!universe->read()->hasIndexPriceName(currency_pair)) {
+        logging::warn("Invalid currency pair: {}", currency_pair);
         return JsonValue();
     }
-    if ((kind != "any" || kind != "combo") && std::find(kinds.begin(), kinds.end(), kind) == kinds.end()) {
-        std::cout << "Invalid kind: " + kind << std::endl;
+    if (kind != "any" && kind != "combo" && !InstrumentRegistry::isKind(kind)) {
+        logging::warn("Invalid kind: {}", kind);
         return JsonValue();
     }
     if (type != "all" && type != "limit" && type != "trigger_all" && type != "stop" && type != "take" && type != "trailing_stop") {
-        std::cout << "Invalid order type: " + type << std::endl;
+        logging::warn("Invalid order type: {}", type);
         return JsonValue();
     }
+    size_t held = cancelHeld(HeldSelection{.currency_pair = currency_pair, .kind = kind, .type = type});
     std::string url = "https://test.deribit.com/api/v2/private/cancel_all_by_currency_pair?currency_pair=" + currency_pair + "&kind=" + kind + "&type=" + type + "&detailed=" + boolString(detailed) + "&freeze_quotes=" + boolString(freeze_quotes);
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
+    JsonValue result = requestJson(url, this->auth_token);
+    if (hasResult(result) && order_cache.isSynced()) reconcileOrders();
+    countCancelled(result, held);
     return result;
 }
 
 JsonValue TradingSystem::cancelAllByInstrument(const std::string instrument_name, const std::string kind,
     const std::string type, bool detailed, bool freeze_quotes) {
-    if (instruments.find(instrument_name) == instruments.end()) {
-        std::cout << "Instrument not found: " + instrument_name << std::endl;
+    if (!universe->read()->hasInstrument(instrument_name)) {
+        logging::warn("Instrument not found: {}", instrument_name);
         return JsonValue();
     }
     if (type != "all" && type != "limit" && type != "trigger_all" && type != "stop" && type != "take" && type != "trailing_stop") {
-        std::cout << "Invalid order type: " + type << std::endl;
+        logging::warn("Invalid order type: {}", type);
         return JsonValue();
     }
+    size_t held = cancelHeld(HeldSelection{.instrument_name = instrument_name, .type = type});
     std::string url = "https://test.deribit.com/api/v2/private/cancel_all_by_instrument?instrument_name=" + instrument_name + "&kind=" + kind + "&type=" + type + "&detailed=" + boolString(detailed) + "&freeze_quotes=" + boolString(freeze_quotes);
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
+    JsonValue result = requestJson(url, this->auth_token);
+    if (hasResult(result)) order_cache.eraseByInstrument(instrument_name, type);
+    countCancelled(result, held);
     return result;
 }
 
 JsonValue TradingSystem::cancelAllByKindOrType(const std::string currency, const std::string kind,
     const std::string type, bool detailed, bool freeze_quotes) {
-    if (currency != "any" && std::find(currencies.begin(), currencies.end(), currency) == currencies.end()) {
-        std::cout << "Invalid currency: " + currency << std::endl;
+    if (currency != "any" && !universe->read()->hasCurrency(currency)) {
+        logging::warn("Invalid currency: {}", currency);
         return JsonValue();
     }
-    if ((kind != "any" || kind != "combo") && std::find(kinds.begin(), kinds.end(), kind) == kinds.end()) {
-        std::cout << "Invalid kind: " + kind << std::endl;
+    if (kind != "any" && kind != "combo" && !InstrumentRegistry::isKind(kind)) {
+        logging::warn("Invalid kind: {}", kind);
         return JsonValue();
     }
     if (type != "all" && type != "limit" && type != "trigger_all" && type != "stop" && type != "take" && type != "trailing_stop") {
-        std::cout << "Invalid order type: " + type << std::endl;
+        logging::warn("Invalid order type: {}", type);
         return JsonValue();
     }
+    size_t held = cancelHeld(HeldSelection{.currency = currency, .kind = kind, .type = type});
     std::string url = "https://test.deribit.com/api/v2/private/cancel_all_by_kind_or_type?currency=" + currency + "&kind=" + kind + "&type=" + type + "&detailed=" + boolString(detailed) + "&freeze_quotes=" + boolString(freeze_quotes);
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
+    JsonValue result = requestJson(url, this->auth_token);
+    if (hasResult(result)) {
+        auto registry = universe->read();
+        for (const std::string& cancelled : registry->currencies) {
+            if (currency == "any" || currency == cancelled) order_cache.eraseByCurrency(cancelled, kind, type);
+        }
+    }
+    countCancelled(result, held);
     return result;
 }
 
 JsonValue TradingSystem::cancelByLabel(const std::string label, const std::string currency) {
-    if (currency == "") {
-        std::string url = "https://test.deribit.com/api/v2/private/cancel_by_label?label=" + label;
-        std::string response = client.get(url, this->auth_token);
-        JsonValue result = parser.parse(response);
-        return result;
-    }
-    else if (std::find(currencies.begin(), currencies.end(), currency) == currencies.end()) {
-        std::cout << "Invalid currency: " + currency << std::endl;
+    if (currency != "" && !universe->read()->hasCurrency(currency)) {
+        logging::warn("Invalid currency: {}", currency);
         return JsonValue();
     }
-    std::string url = "https://test.deribit.com/api/v2/private/cancel_by_label?label=" + label + "&currency=" + currency;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
+    size_t held = cancelHeld(HeldSelection{.currency = currency, .label = label});
+    if (order_cache.isSynced()) {
+        std::vector<std::string> order_ids = order_cache.orderIdsByLabel(label, currency);
+        if (!order_ids.empty()) {
+            double cancelled = double(held);
+            for (const JsonValue& result : fanOut(order_ids, [this](const std::string& order_id) { return cancel(order_id); })) {
+                if (hasResult(result)) ++cancelled;
+            }
+            JsonObject response;
+            response.emplace("result", JsonValue(cancelled));
+            return JsonValue(std::move(response));
+        }
+    }
+    std::string url = "https://test.deribit.com/api/v2/private/cancel_by_label?label=" + label;
+    if (currency != "") {
+        url += "&currency=" + currency;
+    }
+    JsonValue result = requestJson(url, this->auth_token);
+    if (hasResult(result) && order_cache.isSynced()) reconcileOrders();
+    countCancelled(result, held);
     return result;
 }
 
 JsonValue TradingSystem::edit(const std::string order_id, int amount, int contracts, int price,
     int post_only, int reduce_only, int reject_post_only, std::string advanced,
     int trigger_price, int trigger_offset, int mmp, int valid_until) {
-    if (amount == -1 && contracts == -1 && price == -1 && post_only == -1 && reduce_only == -1 && reject_post_only == -1 && advanced == "" && trigger_price == -1 && trigger_offset == -1 && mmp == -1 && valid_until == 0) {
-        std::cout << "No parameters to edit" << std::endl;
-        return JsonValue();
+    return unwrap(tryEdit(order_id, amount, contracts, price, post_only, reduce_only, reject_post_only, advanced,
+        trigger_price, trigger_offset, mmp, valid_until));
+}
+
+Result<JsonValue> TradingSystem::tryEdit(const std::string order_id, int amount, int contracts, int price,
+    int post_only, int reduce_only, int reject_post_only, std::string advanced,
+    int trigger_price, int trigger_offset, int mmp, int valid_until) {
+    EditRequest request{amount, contracts, price, post_only, reduce_only, reject_post_only, advanced,
+        trigger_price, trigger_offset, mmp, valid_until};
+    Prepared prepared = prepareEdit(order_id, request);
+    if (prepared.url.empty()) {
+        return attempt(prepared);
     }
-    std::string params = "order_id=" + order_id;
-    if (amount != -1) {
-        params += "&amount=" + std::to_string(amount);
+    return order_flights.edit(order_id, request);
+}
+
+TradingSystem::Prepared TradingSystem::prepareEdit(const std::string& order_id, const EditRequest& request) {
+    int amount = request.amount, contracts = request.contracts, price = request.price;
+    if (amount == -1 && contracts == -1 && price == -1 && request.post_only == -1 && request.reduce_only == -1 && request.reject_post_only == -1 && request.advanced == "" && request.trigger_price == -1 && request.trigger_offset == -1 && request.mmp == -1 && request.valid_until == 0) {
+        return reject("No parameters to edit");
+    }
+    if (trigger_engine && TriggerEngine::isLocalId(order_id)) {
+        if (!trigger_engine->amend(order_id, request.trigger_price, request.trigger_offset)) {
+            return reject("Cannot edit local trigger order: {}", order_id);
+        }
+        JsonObject result;
+        result.emplace("order", trigger_engine->orderJson(order_id));
+        result.emplace("trades", JsonValue(JsonArray()));
+        JsonObject response;
+        response.emplace("result", JsonValue(std::move(result)));
+        return Prepared::answered(JsonValue(std::move(response)));
+    }
+    // Direction and instrument are only known for orders in the local cache
+    bool changes_size = amount != -1 || price != -1 || request.trigger_price != -1;
+    JsonValue cached = risk_engine || changes_size ? order_cache.getOrderState(order_id) : JsonValue();
+    std::string instrument_name = cached.isNull() ? "" : cached.at("result").at("instrument_name").get<std::string>();
+    auto registry = universe->read();
+    const Instrument* instrument = registry->find(instrument_name);
+    if (instrument && changes_size) {
+        // Edits keep integer parameters to coalesce them, so off-grid values are refused, not rounded
+        if (amount != -1 && (!instrument->lot.isMultiple(amount) || (instrument->lot.known() && amount < instrument->min_trade_amount))) {
+            return reject("Amount {} is not a multiple of {} for {}", amount, instrument->min_trade_amount, instrument_name);
+        }
+        if (price != -1 && !instrument->tick.isMultiple(price)) {
+            return reject("Price {} is not a multiple of the tick size {} for {}", price, instrument->tick_size, instrument_name);
+        }
+        if (request.trigger_price != -1 && !instrument->tick.isMultiple(request.trigger_price)) {
+            return reject("Trigger price {} is not a multiple of the tick size {} for {}", request.trigger_price, instrument->tick_size, instrument_name);
+        }
     }
-    if (contracts != -1) {
-        params += "&contracts=" + std::to_string(contracts);
+    RiskEngine::Reservation reservation;
+    if (risk_engine) {
+        bool isBuy = cached.isNull() || cached.at("result").at("direction").get<std::string>() == "buy";
+        double risk_amount = amount;
+        if (amount == -1 && contracts != -1) risk_amount = instrument ? contractAmount(*instrument, contracts) : contracts;
+        // The order's current amount is already counted as working; only the change is new
+        double replaced = cached.isNull() ? 0 : cached.at("result").at("amount").get<double>();
+        RiskResult risk = checkRisk(instrument_name, isBuy, risk_amount, price, &reservation, replaced);
+        if (risk != RiskResult::Ok) return reject("Risk check failed: {}", riskResultString(risk));
+    }
+    Prepared prepared = editRequest(order_id, request);
+    prepared.risk_reservation = std::move(reservation);
+    return prepared;
+}
+
+// Query string for the fields an edit sets, shared by edit and edit_by_label
+static std::string editParams(const EditRequest& request) {
+    std::string params;
+    if (request.amount != -1) {
+        params += "&amount=" + std::to_string(request.amount);
+    }
+    if (request.contracts != -1) {
+        params += "&contracts=" + std::to_string(request.contracts);
     }
-    if (price != -1) {
-        params += "&price=" + std::to_string(price);
+    if (request.price != -1) {
+        params += "&price=" + std::to_string(request.price);
     }
-    if (post_only == 0) {
+    if (request.post_only == 0) {
         params += "&post_only=false";
-    } else if (post_only == 1) {
+    } else if (request.post_only == 1) {
         params += "&post_only=true";
     }
-    if (reduce_only == 0) {
+    if (request.reduce_only == 0) {
         params += "&reduce_only=false";
-    } else if (reduce_only == 1) {
+    } else if (request.reduce_only == 1) {
         params += "&reduce_only=true";
     }
-    if (reject_post_only == 0) {
+    if (request.reject_post_only == 0) {
         params += "&reject_post_only=false";
-    } else if (reject_post_only == 1) {
+    } else if (request.reject_post_only == 1) {
         params += "&reject_post_only=true";
     }
-    if (advanced != "") {
-        params += "&advanced=" + advanced;
+    if (request.advanced != "") {
+        params += "&advanced=" + request.advanced;
     }
-    if (trigger_price != -1) {
-        params += "&trigger_price=" + std::to_string(trigger_price);
+    if (request.trigger_price != -1) {
+        params += "&trigger_price=" + std::to_string(request.trigger_price);
     }
-    if (trigger_offset != -1) {
-        params += "&trigger_offset=" + std::to_string(trigger_offset);
+    if (request.trigger_offset != -1) {
+        params += "&trigger_offset=" + std::to_string(request.trigger_offset);
     }
-    if (mmp == 0) {
+    if (request.mmp == 0) {
         params += "&mmp=false";
-    } else if (mmp == 1) {
+    } else if (request.mmp == 1) {
         params += "&mmp=true";
     }
-    if (valid_until != 0) {
-        params += "&valid_until=" + std::to_string(valid_until);
+    if (request.valid_until != 0) {
+        params += "&valid_until=" + std::to_string(request.valid_until);
     }
-    std::string url = "https://test.deribit.com/api/v2/private/edit?" + params;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
-    return result;
+    return params;
+}
+
+TradingSystem::Prepared TradingSystem::editRequest(const std::string& order_id, const EditRequest& request) {
+    std::string url = "https://test.deribit.com/api/v2/private/edit?order_id=" + order_id + editParams(request);
+    return Prepared::fetch(url, Prepared::OnResult::TrackOrder);
+}
+
+Result<JsonValue> TradingSystem::sendEdit(const std::string& order_id, const EditRequest& request) {
+    return attempt(editRequest(order_id, request));
 }
 
 JsonValue TradingSystem::editByLabel(const std::string label, const std::string instrument_name, int amount,
     int contracts, int price, int post_only, int reduce_only, int reject_post_only,
     std::string advanced, int trigger_price, int trigger_offset, int mmp, int valid_until) {
     if (label == "") {
-        std::cout << "Label cannot be empty" << std::endl;
+        logging::warn("Label cannot be empty");
         return JsonValue();
     }
     if (label.length() > 64) {
-        std::cout << "Label is too long: " + label << std::endl;
+        logging::warn("Label is too long: {}", label);
         return JsonValue();
     }
-    if (instruments.find(instrument_name) == instruments.end()) {
-        std::cout << "Instrument not found: " + instrument_name << std::endl;
-        return JsonValue();
+    double risk_amount = amount;
+    {
+        auto registry = universe->read();
+        const Instrument* instrument = registry->find(instrument_name);
+        if (!instrument) {
+            logging::warn("Instrument not found: {}", instrument_name);
+            return JsonValue();
+        }
+        if (amount == -1 && contracts != -1) risk_amount = contractAmount(*instrument, contracts);
     }
     if (amount == -1 && contracts == -1 && price == -1 && post_only == -1 && reduce_only == -1 && reject_post_only == -1 && advanced == "" && trigger_price == -1 && trigger_offset == -1 && mmp == -1 && valid_until == 0) {
-        std::cout << "No parameters to edit" << std::endl;
+        logging::warn("No parameters to edit");
         return JsonValue();
     }
-    std::string params = "label=" + label + "&instrument_name=" + instrument_name;
-    if (amount != -1) {
-        params += "&amount=" + std::to_string(amount);
-    }
-    if (contracts != -1) {
-        params += "&contracts=" + std::to_string(contracts);
-    }
-    if (price != -1) {
-        params += "&price=" + std::to_string(price);
-    }
-    if (post_only == 0) {
-        params += "&post_only=false";
-    } else if (post_only == 1) {
-        params += "&post_only=true";
-    }
-    if (reduce_only == 0) {
-        params += "&reduce_only=false";
-    } else if (reduce_only == 1) {
-        params += "&reduce_only=true";
-    }
-    if (reject_post_only == 0) {
-        params += "&reject_post_only=false";
-    } else if (reject_post_only == 1) {
-        params += "&reject_post_only=true";
-    }
-    if (advanced != "") {
-        params += "&advanced=" + advanced;
-    }
-    if (trigger_price != -1) {
-        params += "&trigger_price=" + std::to_string(trigger_price);
-    }
-    if (trigger_offset != -1) {
-        params += "&trigger_offset=" + std::to_string(trigger_offset);
-    }
-    if (mmp == 0) {
-        params += "&mmp=false";
-    } else if (mmp == 1) {
-        params += "&mmp=true";
+    if (order_cache.isSynced()) {
+        std::vector<std::string> order_ids = order_cache.orderIdsByLabel(label, "", instrument_name);
+        if (order_ids.size() == 1) {
+            return edit(order_ids[0], amount, contracts, price, post_only, reduce_only, reject_post_only,
+                advanced, trigger_price, trigger_offset, mmp, valid_until);
+        } else if (!order_ids.empty()) {
+            JsonArray edited;
+            for (const JsonValue& result : fanOut(order_ids, [=, this](const std::string& order_id) {
+                    return edit(order_id, amount, contracts, price, post_only, reduce_only, reject_post_only,
+                        advanced, trigger_price, trigger_offset, mmp, valid_until);
+                })) {
+                if (hasResult(result)) edited.push_back(result.at("result"));
+            }
+            JsonObject response;
+            response.emplace("result", JsonValue(std::move(edited)));
+            return JsonValue(std::move(response));
+        }
     }
-    if (valid_until != 0) {
-        params += "&valid_until=" + std::to_string(valid_until);
+    if (risk_engine && !passesRiskCheck(risk_engine->checkEdit("", true, risk_amount, 0, price))) {
+        return JsonValue();
     }
-    std::string url = "https://test.deribit.com/api/v2/private/edit_by_label?" + params;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
-    return result;   
+    // Edits of one label on one instrument coalesce like edits of a single order
+    return unwrap(label_flights.edit(label + '\n' + instrument_name, EditRequest{amount, contracts, price, post_only,
+        reduce_only, reject_post_only, advanced, trigger_price, trigger_offset, mmp, valid_until}));
 }
 
-JsonValue TradingSystem::getOpenOrders(const std::string kind, const std::string type) {
+Result<JsonValue> TradingSystem::sendEditByLabel(const std::string& key, const EditRequest& request) {
+    size_t split = key.find('\n');
+    std::string url = "https://test.deribit.com/api/v2/private/edit_by_label?label=" + key.substr(0, split) +
+        "&instrument_name=" + key.substr(split + 1) + editParams(request);
+    return attempt(Prepared::fetch(url, Prepared::OnResult::TrackOrder));
+}
+
+TradingSystem::Prepared TradingSystem::prepareOpenOrders(const std::string kind, const std::string type) {
     std::string params = "";
     if (kind != "") {
         if (kind != "future" && kind != "option" && kind != "spot" && kind != "future_combo" && kind != "option_combo") {
-            std::cout << "Invalid kind: " + kind << std::endl;
-            return JsonValue();
+            return reject("Invalid kind: {}", kind);
         }
         params += "kind=" + kind;
     }
     if (type != "all" && type != "limit" && type != "trigger_all" && type != "stop_all" && type != "stop_limit" && type != "stop_market" && type != "take_all" && type != "take_limit" && type != "take_market" && type != "trailing_all" && type != "trailing_stop") {
-        std::cout << "Invalid order type: " + type << std::endl;
-        return JsonValue();
+        return reject("Invalid order type: {}", type);
     } else {
         params += "&type=" + type;
     }
+    if (order_cache.isSynced()) {
+        return withHeld(Prepared::answered(order_cache.getOpenOrders(kind, type)), HeldSelection{.kind = kind, .type = type});
+    }
     std::string url = "https://test.deribit.com/api/v2/private/get_open_orders?" + params;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
-    return result;
+    return withHeld(Prepared::fetch(url), HeldSelection{.kind = kind, .type = type});
 }
 
-JsonValue TradingSystem::getOpenOrdersByCurrency(const std::string currency, const std::string kind, const std::string type) {
+TradingSystem::Prepared TradingSystem::prepareOpenOrdersByCurrency(const std::string currency, const std::string kind, const std::string type) {
     std::string params = "";
-    if (std::find(currencies.begin(), currencies.end(), currency) == currencies.end()) {
-        std::cout << "Invalid currency: " + currency << std::endl;
-        return JsonValue();
+    if (!universe->read()->hasCurrency(currency)) {
+        return reject("Invalid currency: {}", currency);
     } else {
         params += "currency=" + currency;
     }
     if (kind != "") {
         if (kind != "future" && kind != "option" && kind != "spot" && kind != "future_combo" && kind != "option_combo") {
-            std::cout << "Invalid kind: " + kind << std::endl;
-            return JsonValue();
+            return reject("Invalid kind: {}", kind);
         }
-        params += "kind=" + kind;
+        params += "&kind=" + kind;
     }
     if (type != "all" && type != "limit" && type != "trigger_all" && type != "stop_all" && type != "stop_limit" && type != "stop_market" && type != "take_all" && type != "take_limit" && type != "take_market" && type != "trailing_all" && type != "trailing_stop") {
-        std::cout << "Invalid order type: " + type << std::endl;
-        return JsonValue();
+        return reject("Invalid order type: {}", type);
     } else {
         params += "&type=" + type;
     }
+    if (order_cache.isSynced()) {
+        return withHeld(Prepared::answered(order_cache.getOpenOrdersByCurrency(currency, kind, type)), HeldSelection{.currency = currency, .kind = kind, .type = type});
+    }
     std::string url = "https://test.deribit.com/api/v2/private/get_open_orders_by_currency?" + params;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
-    return result;
+    return withHeld(Prepared::fetch(url), HeldSelection{.currency = currency, .kind = kind, .type = type});
 }
 
-JsonValue TradingSystem::getOpenOrdersByInstrument(const std::string instrument_name, const std::string type) {
+TradingSystem::Prepared TradingSystem::prepareOpenOrdersByInstrument(const std::string instrument_name, const std::string type) {
     std::string params = "";
-    if (instruments.find(instrument_name) == instruments.end()) {
-        std::cout << "Instrument not found: " + instrument_name << std::endl;
-        return JsonValue();
+    if (!universe->read()->hasInstrument(instrument_name)) {
+        return reject("Instrument not found: {}", instrument_name);
     } else {
         params += "instrument_name=" + instrument_name;
     }
     if (type != "all" && type != "limit" && type != "trigger_all" && type != "stop_all" && type != "stop_limit" && type != "stop_market" && type != "take_all" && type != "take_limit" && type != "take_market" && type != "trailing_all" && type != "trailing_stop") {
-        std::cout << "Invalid order type: " + type << std::endl;
-        return JsonValue();
+        return reject("Invalid order type: {}", type);
     } else {
         params += "&type=" + type;
     }
+    if (order_cache.isSynced()) {
+        return withHeld(Prepared::answered(order_cache.getOpenOrdersByInstrument(instrument_name, type)), HeldSelection{.instrument_name = instrument_name, .type = type});
+    }
     std::string url = "https://test.deribit.com/api/v2/private/get_open_orders_by_instrument?" + params;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
-    return result;
+    return withHeld(Prepared::fetch(url), HeldSelection{.instrument_name = instrument_name, .type = type});
 }
 
-JsonValue TradingSystem::getOpenOrdersByLabel(const std::string currency, const std::string label) {
+TradingSystem::Prepared TradingSystem::prepareOpenOrdersByLabel(const std::string currency, const std::string label) {
     if (label == "") {
-        std::cout << "Label cannot be empty" << std::endl;
-        return JsonValue();
+        return reject("Label cannot be empty");
     }
     if (label.length() > 64) {
-        std::cout << "Label is too long: " + label << std::endl;
-        return JsonValue();
+        return reject("Label is too long: {}", label);
     }
     std::string params = "label=" + label;
-    if (std::find(currencies.begin(), currencies.end(), currency) == currencies.end()) {
-        std::cout << "Invalid currency: " + currency << std::endl;
-        return JsonValue();
+    if (!universe->read()->hasCurrency(currency)) {
+        return reject("Invalid currency: {}", currency);
     } else {
-        params += "currency=" + currency;
+        params += "&currency=" + currency;
+    }
+    if (order_cache.isSynced()) {
+        return withHeld(Prepared::answered(order_cache.getOpenOrdersByLabel(currency, label)), HeldSelection{.currency = currency, .label = label});
     }
     std::string url = "https://test.deribit.com/api/v2/private/get_open_orders_by_label?" + params;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
-    return result;
+    return withHeld(Prepared::fetch(url), HeldSelection{.currency = currency, .label = label});
 }
 
-JsonValue TradingSystem::getOrderState(const std::string order_id) {
+TradingSystem::Prepared TradingSystem::prepareOrderState(const std::string order_id) {
+    if (trigger_engine && TriggerEngine::isLocalId(order_id)) {
+        JsonValue order = trigger_engine->orderJson(order_id);
+        if (order.isNull()) return reject("Local trigger order not found: {}", order_id);
+        JsonObject response;
+        response.emplace("result", std::move(order));
+        return Prepared::answered(JsonValue(std::move(response)));
+    }
+    if (order_cache.isSynced()) {
+        JsonValue cached = order_cache.getOrderState(order_id);
+        if (!cached.isNull()) {
+            return Prepared::answered(cached);
+        }
+    }
     std::string url = "https://test.deribit.com/api/v2/private/get_order_state?order_id=" + order_id;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
-    return result;
+    return Prepared::fetch(url);
 }
 
-JsonValue TradingSystem::getOrderStateByLabel(const std::string currency, const std::string label) {
+TradingSystem::Prepared TradingSystem::prepareOrderStateByLabel(const std::string currency, const std::string label) {
     if (label == "") {
-        std::cout << "Label cannot be empty" << std::endl;
-        return JsonValue();
+        return reject("Label cannot be empty");
     }
     if (label.length() > 64) {
-        std::cout << "Label is too long: " + label << std::endl;
-        return JsonValue();
+        return reject("Label is too long: {}", label);
     }
     std::string params = "label=" + label;
-    if (std::find(currencies.begin(), currencies.end(), currency) == currencies.end()) {
-        std::cout << "Invalid currency: " + currency << std::endl;
-        return JsonValue();
+    if (!universe->read()->hasCurrency(currency)) {
+        return reject("Invalid currency: {}", currency);
     } else {
-        params += "currency=" + currency;
+        params += "&currency=" + currency;
     }
+    // Always fetched: the state covers filled and cancelled orders, which the cache drops
     std::string url = "https://test.deribit.com/api/v2/private/get_order_state_by_label?" + params;
-    std::string response = client.get(url, this->auth_token);
-    JsonValue result = parser.parse(response);
-    return result;
+    return withHeld(Prepared::fetch(url), HeldSelection{.currency = currency, .label = label});
+}
+
+JsonValue TradingSystem::getOpenOrders(const std::string kind, const std::string type) {
+    return execute(prepareOpenOrders(kind, type));
+}
+
+JsonValue TradingSystem::getOpenOrdersByCurrency(const std::string currency, const std::string kind, const std::string type) {
+    return execute(prepareOpenOrdersByCurrency(currency, kind, type));
+}
+
+JsonValue TradingSystem::getOpenOrdersByInstrument(const std::string instrument_name, const std::string type) {
+    return execute(prepareOpenOrdersByInstrument(instrument_name, type));
 }
 
+JsonValue TradingSystem::getOpenOrdersByLabel(const std::string currency, const std::string label) {
+    return execute(prepareOpenOrdersByLabel(currency, label));
+}
+
+JsonValue TradingSystem::getOrderState(const std::string order_id) {
+    return execute(prepareOrderState(order_id));
+}
+
+JsonValue TradingSystem::getOrderStateByLabel(const std::string currency, const std::string label) {
+    return execute(prepareOrderStateByLabel(currency, label));
+}
@@ -3,32 +3,183 @@
 #include "http_client.h"
 #include "json_parser.h"
 #include "secrets.h"
-#include "instruments.h"
+#include "instrument_universe.h"
+#include "inflight_orders.h"
+#include "order_cache.h"
+#include "rate_limiter.h"
+#include "result.h"
+#include "risk_engine.h"
+#include "thread_pool.h"
+#include "transport.h"
+#include "trigger_engine.h"
 
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 
+class SessionPool;
+struct Credentials;
+
+// What to do with an order whose price or amount is off the instrument's tick or lot grid
+enum class OrderRounding : uint8_t {
+    Reject,     // refuse it locally, as the exchange would
+    Round,      // round the price away from the touch and the amount down, and send it
+};
+
+// TradingSystem is safe to share between threads. The auth token is written once in the
+// constructor and only read afterwards, and the instrument universe is read through RCU, so the
+// read path takes no locks; every request runs on the calling thread's own RestClient and
+// parsers.
+// Several accounts can share one instrument universe as sessions of a SessionPool.
 class TradingSystem
 {
 private:
-    RestClient client;
-    JsonParser parser;
-    std::vector<std::string> kinds = {"future", "option", "spot", "future_combo", "option_combo"};
-    std::vector<std::string> currencies;
-    std::vector<std::string> index_price_names;
-    std::unordered_map<std::string, Instrument> instruments;
+    static RestClient& client();
+    static JsonParser& parser();
+    static JsonStreamParser& streamParser();
+    std::string request(const std::string& url, const std::string& authToken = "");
+    // The response to `url`, parsed while it downloads when it comes over HTTP
+    static Result<JsonValue> fetchJson(Transport* transport, const std::string& url, const std::string& authToken = "");
+    Result<JsonValue> fetchJson(const std::string& url, const std::string& authToken = "");
+    // The same, throwing std::runtime_error for transport and parse failures
+    static JsonValue requestJson(Transport* transport, const std::string& url, const std::string& authToken = "");
+    JsonValue requestJson(const std::string& url, const std::string& authToken = "");
+
+    std::shared_ptr<Transport> transport;   // null: the exchange over HTTP
+    std::shared_ptr<ThreadPool> fanout_pool;
+    std::shared_ptr<InstrumentUniverse> universe;
     std::string auth_token;
+    RateLimiter rate_limiter;               // authenticated requests only
+    OrderRounding order_rounding = OrderRounding::Reject;
+    OrderCache order_cache;
+    std::unique_ptr<RiskEngine> risk_engine;
+    std::unique_ptr<TriggerEngine> trigger_engine;
+    std::jthread reconcile_thread;
+    std::mutex firing_mutex;
+    std::vector<std::future<void>> firing;  // fired trigger orders being sent on the fan-out pool
+    // Edits and cancels go through these so requests for an order already on the wire coalesce
+    InflightOrders order_flights{
+        [this](const std::string& order_id, const EditRequest& request) { return sendEdit(order_id, request); },
+        [this](const std::string& order_id) { return sendCancel(order_id); }};
+    // Keyed by label and instrument; only edits go through it
+    InflightOrders label_flights{
+        [this](const std::string& key, const EditRequest& request) { return sendEditByLabel(key, request); },
+        nullptr};
 
-    JsonValue placeOrder(bool isBuy, const std::string instrument_name = "", int amount = 0, int contracts = 0,
-        const std::string type = "", const std::string label = "", int price = -1,
+    void authenticate(const Credentials& credentials);
+    void trackOrder(const JsonValue& order);
+    void trackOrderResponse(const JsonValue& response);
+    bool passesRiskCheck(RiskResult result) const;
+    // Risk checks, fills and open orders on instruments listed since enableRiskChecks add them to the risk engine first
+    bool addRiskInstrument(const std::string& instrument_name);
+    // `replaced` is the amount of the open order an edit changes. Orders held locally pass no
+    // reservation: they count against the order rate and hold their amount only once sent.
+    RiskResult checkRisk(const std::string& instrument_name, bool isBuy, double amount, double price,
+        RiskEngine::Reservation* reservation, double replaced = 0);
+    void riskTrade(const JsonValue& trade);
+    // Held trigger orders a mass cancel or an open-order query covers, selected the way the
+    // exchange selects its own
+    struct HeldSelection;
+    size_t cancelHeld(const HeldSelection& selection);
+    void fireTrigger(const std::string& trigger_id, const TriggerOrder& order);
+    void sendTrigger(const std::string& trigger_id, const TriggerOrder& order);
+    Result<JsonValue> sendEdit(const std::string& order_id, const EditRequest& request);
+    Result<JsonValue> sendEditByLabel(const std::string& key, const EditRequest& request);
+    Result<JsonValue> sendCancel(const std::string& order_id);
+    // Run one request per order id on the fan-out pool and wait for all of them
+    std::vector<JsonValue> fanOut(const std::vector<std::string>& order_ids,
+        const std::function<JsonValue(const std::string&)>& request);
+
+    // A validated call: either answered locally, rejected (with the reason in `rejection`) or a
+    // URL still to be fetched. Blocking methods execute() it on the calling thread; AsyncTrading
+    // awaits the same request on an EventLoop, so both paths share validation and bookkeeping.
+    struct Prepared {
+        enum class OnResult { None, ReferencePrice, TrackOrder, TrackCancel };
+
+        std::string url;
+        JsonValue local;
+        std::string rejection;
+        bool authenticated = true;
+        OnResult on_result = OnResult::None;
+        std::string instrument_name;    // for ReferencePrice
+        // What a new or edited order adds to the risk engine's working amounts, held until the
+        // response is in the order cache (which then counts the order) or the request has failed
+        RiskEngine::Reservation risk_reservation;
+        JsonArray held;                 // held trigger orders to add to a fetched open-order list
+
+        static Prepared rejected(std::string rejection) {
+            Prepared request;
+            request.rejection = std::move(rejection);
+            return request;
+        }
+        static Prepared answered(JsonValue local) {
+            Prepared request;
+            request.local = std::move(local);
+            return request;
+        }
+        static Prepared fetch(std::string url, OnResult on_result = OnResult::None, bool authenticated = true) {
+            Prepared request;
+            request.url = std::move(url);
+            request.on_result = on_result;
+            request.authenticated = authenticated;
+            return request;
+        }
+    };
+
+    // Logs a validation failure and returns it as a rejected request
+    template<typename... Args>
+    static Prepared reject(const char* format, const Args&... args);
+
+    // Runs the request without throwing: rejections, transport failures, exchange errors and
+    // malformed responses all come back as a TradingError
+    Result<JsonValue> attempt(const Prepared& request);
+    // Classifies a response to the request and applies it to the local state, e.g. one fetched
+    // on AsyncTrading's event loop
+    Result<JsonValue> complete(const Prepared& request, const std::string& response);
+    Result<JsonValue> complete(const Prepared& request, Result<JsonValue> response);
+    // The JsonValue API on top of attempt(): null for a rejection, the error response from the
+    // exchange, and an exception for transport and parse failures
+    static JsonValue unwrap(Result<JsonValue> result);
+    JsonValue execute(const Prepared& request);
+    void onResult(const Prepared& request, const JsonValue& result);
+
+    Prepared prepareOrderBook(const std::string& instrument_name, int depth);
+    // Amount and prices are doubles so a held trigger order sends the values it was rounded to
+    Prepared prepareOrder(bool isBuy, const std::string instrument_name = "", double amount = 0, int contracts = 0,
+        const std::string type = "", const std::string label = "", double price = -1,
         const std::string time_in_force = "", int max_show = -1, int post_only = -1,
-        int reject_post_only = -1, int reduce_only = -1, int trigger_price = -1,
+        int reject_post_only = -1, int reduce_only = -1, double trigger_price = -1,
         int trigger_offset = -1, const std::string trigger = "", const std::string advanced = "",
         int mmp = -1, int valid_until = 0, const std::string linked_order_type = "",
         const std::string trigger_fill_condition = "");
+    Prepared prepareEdit(const std::string& order_id, const EditRequest& request);
+    Prepared editRequest(const std::string& order_id, const EditRequest& request);
+    Prepared prepareCancel(const std::string& order_id);
+    Prepared prepareOpenOrders(const std::string kind, const std::string type);
+    Prepared prepareOpenOrdersByCurrency(const std::string currency, const std::string kind, const std::string type);
+    Prepared prepareOpenOrdersByInstrument(const std::string instrument_name, const std::string type);
+    Prepared prepareOpenOrdersByLabel(const std::string currency, const std::string label);
+    Prepared prepareOrderState(const std::string order_id);
+    Prepared prepareOrderStateByLabel(const std::string currency, const std::string label);
+    Prepared prepareLocalTrigger(const TriggerOrder& order);
+    // Adds the held trigger orders to an open-order query, answered or fetched
+    Prepared withHeld(Prepared request, const HeldSelection& selection);
+
+    friend class AsyncTrading;
+    friend class SessionPool;
 
 public:
     TradingSystem();
+    // Run against another transport, e.g. a Backtester, instead of the exchange
+    explicit TradingSystem(std::shared_ptr<Transport> transport);
+    // A session of the pool: shares its instrument universe, transport and threads, and only
+    // authenticates. Authenticated requests wait for the account's rate-limit budget.
+    TradingSystem(const SessionPool& pool, const Credentials& credentials, RateLimit limit = RateLimit());
     ~TradingSystem();
 
     // Get Order Book
@@ -50,6 +201,27 @@ public:
         int mmp = -1, int valid_until = 0, const std::string linked_order_type = "",
         const std::string trigger_fill_condition = "");
     
+    // Exception-free order entry: same parameters and checks as buy, sell, edit and cancel, with
+    // every failure returned as a typed TradingError instead of a null, an error response or a throw
+    Result<JsonValue> tryBuy(const std::string instrument_name = "", int amount = 0, int contracts = 0,
+        const std::string type = "", const std::string label = "", int price = -1,
+        const std::string time_in_force = "", int max_show = -1, int post_only = -1,
+        int reject_post_only = -1, int reduce_only = -1, int trigger_price = -1,
+        int trigger_offset = -1, const std::string trigger = "", const std::string advanced = "",
+        int mmp = -1, int valid_until = 0, const std::string linked_order_type = "",
+        const std::string trigger_fill_condition = "");
+    Result<JsonValue> trySell(const std::string instrument_name = "", int amount = 0, int contracts = 0,
+        const std::string type = "", const std::string label = "", int price = -1,
+        const std::string time_in_force = "", int max_show = -1, int post_only = -1,
+        int reject_post_only = -1, int reduce_only = -1, int trigger_price = -1,
+        int trigger_offset = -1, const std::string trigger = "", const std::string advanced = "",
+        int mmp = -1, int valid_until = 0, const std::string linked_order_type = "",
+        const std::string trigger_fill_condition = "");
+    Result<JsonValue> tryEdit(const std::string order_id, int amount = -1, int contracts = -1, int price = -1,
+        int post_only = -1, int reduce_only = -1, int reject_post_only = -1, std::string advanced = "",
+        int trigger_price = -1, int trigger_offset = -1, int mmp = -1, int valid_until = 0);
+    Result<JsonValue> tryCancel(const std::string order_id);
+
     // Cancel Order
     JsonValue cancel(const std::string order_id);
     JsonValue cancelAll(bool detailed = false, bool freeze_quotes = false);
@@ -81,4 +253,57 @@ public:
     // View Order States
     JsonValue getOrderState(const std::string order_id);
     JsonValue getOrderStateByLabel(const std::string currency, const std::string label);
+
+    // Instrument Universe
+    // Loaded at construction. A copy of the current table, or the current version itself, which
+    // stays valid while held but is not updated by later refreshes.
+    InstrumentRegistry::Table getInstruments() const { return universe->snapshot()->table(); }
+    std::shared_ptr<const InstrumentRegistry> instrumentRegistry() const { return universe->snapshot(); }
+    InstrumentUniverse& instrumentUniverse() { return *universe; }
+    // Keep the universe current from a background thread: partitions named by instrument.state
+    // notifications passed to onOrderEvent as they arrive, and everything each `full_interval`.
+    void startInstrumentRefresh(std::chrono::milliseconds full_interval);
+
+    // Trading Rules
+    // New orders are checked against the instrument's tick size, lot and minimum amount before
+    // they are sent; edits of cached orders too, though edits are never rounded. Set before
+    // sharing the TradingSystem between threads.
+    void setOrderRounding(OrderRounding rounding) { order_rounding = rounding; }
+
+    // Local Order Cache
+    // Once synced, open-order queries and getOrderState for open orders are answered locally,
+    // and label operations resolve the label locally and fan out over the known order ids
+    void onOrderEvent(const JsonValue& params);
+    size_t reconcileOrders();
+    void startOrderReconciliation(std::chrono::milliseconds interval);
+    const OrderCache& orderCache() const { return order_cache; }
+
+    // Pre-trade Risk
+    // Enable before sharing the TradingSystem between threads; checks then run on every buy/sell/edit,
+    // counting the open orders in the local order cache and the orders still awaiting an answer
+    void enableRiskChecks(const RiskLimits& limits);
+    RiskEngine* riskEngine() { return risk_engine.get(); }
+
+    // Local Trigger Orders
+    // Once enabled, stop, take and trailing orders are held locally instead of being sent, and go
+    // out as limit or market orders when the prices fed to onPrice (or ticker notifications passed
+    // to onOrderEvent) cross their trigger. Their ids start with "local-"; cancel and edit (of the
+    // trigger price and offset) work on them. Enable before sharing the TradingSystem.
+    // Fired orders are sent from the fan-out pool, so a price update never waits on the exchange;
+    // they count against the risk engine's order rate when sent, not when held. Open-order and
+    // order-state queries list held orders as untriggered, and every mass cancel (cancelAll*,
+    // cancelByLabel) also cancels the held orders it covers, even when the exchange's request fails.
+    void enableLocalTriggers();
+    TriggerEngine* triggerEngine() { return trigger_engine.get(); }
+    void onPrice(const std::string& instrument_name, TriggerReference reference, double price);
+    // A local trigger order, which may watch another instrument's price
+    JsonValue addLocalTrigger(const TriggerOrder& order);
+    // Wait until the orders fired so far have been sent and answered
+    void awaitTriggeredOrders();
+
+    // In-flight Orders
+    // Edits of an order that already has a request on the wire wait and collapse into the latest
+    // target; a cancel replaces queued edits. Callers sharing a message share its response.
+    FlightState orderFlightState(const std::string& order_id) { return order_flights.state(order_id); }
+    uint64_t coalescedRequests() const { return order_flights.coalescedCount() + label_flights.coalescedCount(); }
 };
\ No newline at end of file
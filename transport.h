@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+// Where TradingSystem sends its API requests. By default requests go to the exchange over
+// HTTP through each thread's RestClient; an in-process simulator implements the same calls
+// behind this interface so strategies run against it unchanged. Implementations must accept
+// calls from several threads.
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    // GET an API URL (https://.../api/v2/<scope>/<method>?<params>) and return the response body
+    virtual std::string get(const std::string& url, const std::string& authToken) = 0;
+};
@@ -0,0 +1,241 @@
+#include "trigger_engine.h"
+
+#include <cmath>
+#include <limits>
+
+bool parseTriggerReference(const std::string& trigger, TriggerReference& reference) {
+    if (trigger == "" || trigger == "last_price") {
+        reference = TriggerReference::Last;
+    } else if (trigger == "mark_price") {
+        reference = TriggerReference::Mark;
+    } else if (trigger == "index_price") {
+        reference = TriggerReference::Index;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static const char* referenceString(TriggerReference reference) {
+    switch (reference) {
+        case TriggerReference::Index: return "index_price";
+        case TriggerReference::Mark: return "mark_price";
+        case TriggerReference::Last: return "last_price";
+    }
+    return "last_price";
+}
+
+bool TriggerEngine::firesOnRise(const TriggerOrder& order) {
+    bool is_stop = order.type == "stop_limit" || order.type == "stop_market";
+    bool is_take = order.type == "take_limit" || order.type == "take_market";
+    // Buy stops and sell takes fire on a rising price; a buy trailing stop follows the low up
+    return (is_stop && order.isBuy) || (is_take && !order.isBuy) || (order.type == "trailing_stop" && order.isBuy);
+}
+
+void TriggerEngine::insert(uint64_t id, Pending& entry) {
+    const TriggerOrder& order = entry.order;
+    const std::string& watch = order.watch_instrument.empty() ? order.instrument_name : order.watch_instrument;
+    Stream& stream = streams[watch][(size_t)order.reference];
+    bool rising = firesOnRise(order);
+    Direction& direction = rising ? stream.rising : stream.falling;
+    double sign = rising ? -1 : 1;
+
+    if (order.type == "trailing_stop") {
+        // The extreme starts at the current price; before the first tick it is set by that tick
+        double extreme = stream.last_price > 0 ? sign * stream.last_price : -std::numeric_limits<double>::infinity();
+        Offsets& group = direction.trailing[extreme];
+        entry.group = &group;
+        entry.offset = group.emplace(order.trigger_offset, id);
+        entry.levels = nullptr;
+    } else {
+        entry.levels = &direction.levels;
+        entry.level = direction.levels.emplace(sign * order.trigger_price, id);
+        entry.group = nullptr;
+    }
+}
+
+void TriggerEngine::erase(Pending& entry) {
+    if (entry.group) {
+        // An emptied group is dropped on its stream's next tick
+        entry.group->erase(entry.offset);
+    } else {
+        entry.levels->erase(entry.level);
+    }
+}
+
+void TriggerEngine::collect(Direction& direction, double price, std::vector<uint64_t>& fired) {
+    Levels& levels = direction.levels;
+    while (!levels.empty() && levels.begin()->first >= price) {
+        fired.push_back(levels.begin()->second);
+        levels.erase(levels.begin());
+    }
+
+    auto& trailing = direction.trailing;
+    if (trailing.empty()) return;
+    auto behind = trailing.lower_bound(price);
+    if (behind != trailing.begin()) {
+        // A new extreme: every group that saw less joins one group at this price. The largest
+        // group is re-keyed in place and the others are spliced into it.
+        auto target = behind;
+        if (target == trailing.end() || target->first != price) {
+            auto largest = trailing.begin();
+            for (auto it = trailing.begin(); it != behind; ++it) {
+                if (it->second.size() > largest->second.size()) largest = it;
+            }
+            auto node = trailing.extract(largest);
+            node.key() = price;
+            target = trailing.insert(std::move(node)).position;
+        }
+        for (auto it = trailing.begin(); it != trailing.end() && it->first < price;) {
+            for (const auto& [offset, id] : it->second) {
+                pending.at(id).group = &target->second;
+            }
+            target->second.merge(it->second);
+            it = trailing.erase(it);
+        }
+    }
+
+    for (auto it = trailing.begin(); it != trailing.end();) {
+        Offsets& group = it->second;
+        double retreat = it->first - price;
+        while (!group.empty() && group.begin()->first <= retreat) {
+            fired.push_back(group.begin()->second);
+            group.erase(group.begin());
+        }
+        it = group.empty() ? trailing.erase(it) : std::next(it);
+    }
+}
+
+std::string TriggerEngine::add(const TriggerOrder& order) {
+    bool is_limit = order.type == "stop_limit" || order.type == "take_limit";
+    bool is_market = order.type == "stop_market" || order.type == "take_market";
+    if (order.type == "trailing_stop") {
+        if (!(order.trigger_offset > 0)) return "";
+    } else if (!is_limit && !is_market) {
+        return "";
+    } else if (!(order.trigger_price > 0)) {
+        return "";
+    }
+    if (is_limit && order.price <= 0) return "";
+
+    std::lock_guard lock(mutex);
+    uint64_t id = next_id++;
+    Pending& entry = pending[id];
+    entry.order = order;
+    insert(id, entry);
+    return "local-" + std::to_string(id);
+}
+
+bool TriggerEngine::cancel(const std::string& trigger_id) {
+    if (!isLocalId(trigger_id)) return false;
+    std::lock_guard lock(mutex);
+    auto it = pending.find(std::strtoull(trigger_id.c_str() + 6, nullptr, 10));
+    if (it == pending.end()) return false;
+    erase(it->second);
+    pending.erase(it);
+    return true;
+}
+
+size_t TriggerEngine::cancelIf(const std::function<bool(const TriggerOrder&)>& matches) {
+    std::lock_guard lock(mutex);
+    size_t cancelled = 0;
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (matches(it->second.order)) {
+            erase(it->second);
+            it = pending.erase(it);
+            ++cancelled;
+        } else {
+            ++it;
+        }
+    }
+    return cancelled;
+}
+
+bool TriggerEngine::amend(const std::string& trigger_id, double trigger_price, double trigger_offset) {
+    if (!isLocalId(trigger_id)) return false;
+    std::lock_guard lock(mutex);
+    uint64_t id = std::strtoull(trigger_id.c_str() + 6, nullptr, 10);
+    auto it = pending.find(id);
+    if (it == pending.end()) return false;
+    Pending& entry = it->second;
+    if (entry.order.type == "trailing_stop" ? trigger_offset == 0 : trigger_price == 0) return false;
+    erase(entry);
+    if (trigger_price > 0) entry.order.trigger_price = trigger_price;
+    if (trigger_offset > 0) entry.order.trigger_offset = trigger_offset;
+    insert(id, entry);
+    return true;
+}
+
+size_t TriggerEngine::onPrice(const std::string& instrument_name, TriggerReference reference, double price) {
+    if (!(price > 0)) return 0;
+    std::vector<std::pair<std::string, TriggerOrder>> ready;
+    {
+        std::lock_guard lock(mutex);
+        auto it = streams.find(instrument_name);
+        if (it == streams.end()) return 0;
+        Stream& stream = it->second[(size_t)reference];
+        stream.last_price = price;
+
+        std::vector<uint64_t> fired;
+        collect(stream.falling, price, fired);
+        collect(stream.rising, -price, fired);
+        for (uint64_t id : fired) {
+            auto entry = pending.find(id);
+            ready.emplace_back("local-" + std::to_string(id), std::move(entry->second.order));
+            pending.erase(entry);
+        }
+        fired_count += fired.size();
+    }
+    for (const auto& [trigger_id, order] : ready) {
+        fire(trigger_id, order);
+    }
+    return ready.size();
+}
+
+JsonValue TriggerEngine::toJson(uint64_t id, const TriggerOrder& order) {
+    JsonObject fields;
+    fields.emplace("order_id", JsonValue("local-" + std::to_string(id)));
+    fields.emplace("instrument_name", JsonValue(order.instrument_name));
+    fields.emplace("direction", JsonValue(std::string(order.isBuy ? "buy" : "sell")));
+    fields.emplace("amount", JsonValue(double(order.amount != 0 ? order.amount : order.contracts)));
+    fields.emplace("filled_amount", JsonValue(0.0));
+    fields.emplace("order_type", JsonValue(order.type));
+    fields.emplace("order_state", JsonValue(std::string("untriggered")));
+    fields.emplace("trigger", JsonValue(std::string(referenceString(order.reference))));
+    if (order.trigger_price > 0) fields.emplace("trigger_price", JsonValue(order.trigger_price));
+    if (order.trigger_offset > 0) fields.emplace("trigger_offset", JsonValue(order.trigger_offset));
+    if (order.price > 0) fields.emplace("price", JsonValue(double(order.price)));
+    fields.emplace("label", JsonValue(order.label));
+    fields.emplace("reduce_only", JsonValue(order.reduce_only == 1));
+    fields.emplace("post_only", JsonValue(order.post_only == 1));
+    if (!order.watch_instrument.empty()) fields.emplace("watch_instrument", JsonValue(order.watch_instrument));
+    return JsonValue(std::move(fields));
+}
+
+JsonValue TriggerEngine::orderJson(const std::string& trigger_id) const {
+    if (!isLocalId(trigger_id)) return JsonValue();
+    std::lock_guard lock(mutex);
+    uint64_t id = std::strtoull(trigger_id.c_str() + 6, nullptr, 10);
+    auto it = pending.find(id);
+    if (it == pending.end()) return JsonValue();
+    return toJson(id, it->second.order);
+}
+
+JsonArray TriggerEngine::ordersJson(const std::function<bool(const TriggerOrder&)>& matches) const {
+    std::lock_guard lock(mutex);
+    JsonArray orders;
+    for (const auto& [id, entry] : pending) {
+        if (matches(entry.order)) orders.push_back(toJson(id, entry.order));
+    }
+    return orders;
+}
+
+size_t TriggerEngine::pendingCount() const {
+    std::lock_guard lock(mutex);
+    return pending.size();
+}
+
+size_t TriggerEngine::firedCount() const {
+    std::lock_guard lock(mutex);
+    return fired_count;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "json_parser.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class TriggerReference { Index, Mark, Last };
+
+// Maps the `trigger` values placeOrder accepts ("index_price", "mark_price", "last_price");
+// false for anything else. An empty string means last_price.
+bool parseTriggerReference(const std::string& trigger, TriggerReference& reference);
+
+// A stop, take or trailing order held locally until its condition is met. When it fires it is
+// sent as a limit order at `price` (stop_limit, take_limit) or as a market order otherwise.
+struct TriggerOrder {
+    std::string instrument_name;
+    bool isBuy = true;
+    std::string type;               // stop_limit, stop_market, take_limit, take_market, trailing_stop
+    double amount = 0;
+    int contracts = 0;
+    double price = -1;
+    std::string label;
+    std::string time_in_force;
+    int post_only = -1;
+    int reject_post_only = -1;
+    int reduce_only = -1;
+    TriggerReference reference = TriggerReference::Last;
+    double trigger_price = 0;
+    double trigger_offset = 0;      // trailing_stop distance from the best price seen
+    std::string watch_instrument;   // whose price triggers the order; instrument_name if empty
+};
+
+// Evaluates stop, take and trailing conditions against streamed index, mark and last prices.
+//
+// Orders are held per (instrument, reference) price stream in two directions: orders that fire
+// when the price falls to their level (sell stops, buy takes, sell trailing stops) and orders
+// that fire when it rises to it (the rest), the latter stored on negated prices so both use the
+// same code. Stops and takes sit in a multimap sorted by trigger price, so a tick pops exactly
+// the orders it crossed. Trailing stops are grouped by the extreme price they have seen, each
+// group sorted by offset; a new extreme merges every group behind it into one, so a tick only
+// touches the groups above the price and the orders that fire.
+//
+// An order added while its condition already holds fires on the next tick. Fired orders are
+// handed to the callback on the thread that delivered the price, after the lock is released.
+class TriggerEngine {
+public:
+    using Fire = std::function<void(const std::string& trigger_id, const TriggerOrder& order)>;
+
+private:
+    using Levels = std::multimap<double, uint64_t, std::greater<double>>;  // trigger level, highest first
+    using Offsets = std::multimap<double, uint64_t>;                       // trailing offset, smallest first
+
+    // Orders that fire when the (possibly negated) price falls to their level
+    struct Direction {
+        Levels levels;
+        std::map<double, Offsets> trailing;     // extreme seen -> orders sharing it
+    };
+
+    struct Stream {
+        Direction falling;
+        Direction rising;                       // keys and prices negated
+        double last_price = 0;                  // 0 until the first tick
+    };
+
+    struct Pending {
+        TriggerOrder order;
+        Levels* levels = nullptr;               // stops and takes
+        Levels::iterator level;
+        Offsets* group = nullptr;               // trailing stops; groups keep their address when merged
+        Offsets::iterator offset;
+    };
+
+    mutable std::mutex mutex;
+    Fire fire;
+    std::unordered_map<std::string, std::array<Stream, 3>> streams;
+    std::unordered_map<uint64_t, Pending> pending;
+    uint64_t next_id = 1;
+    size_t fired_count = 0;
+
+    static bool firesOnRise(const TriggerOrder& order);
+    void insert(uint64_t id, Pending& entry);
+    void erase(Pending& entry);
+    void collect(Direction& direction, double price, std::vector<uint64_t>& fired);
+    static JsonValue toJson(uint64_t id, const TriggerOrder& order);
+
+public:
+    explicit TriggerEngine(Fire fire) : fire(std::move(fire)) {}
+
+    // Local ids look like "local-12"
+    static bool isLocalId(const std::string& order_id) { return order_id.rfind("local-", 0) == 0; }
+
+    // Returns the local id, or "" if the order type or trigger values are invalid
+    std::string add(const TriggerOrder& order);
+    bool cancel(const std::string& trigger_id);
+    // Drop every held order `matches` accepts, e.g. for a mass cancel, and return their number
+    size_t cancelIf(const std::function<bool(const TriggerOrder&)>& matches);
+    // Move the trigger; a negative value keeps the current one
+    bool amend(const std::string& trigger_id, double trigger_price, double trigger_offset);
+
+    // Feed one price; fires and removes every order the move crossed and returns their number
+    size_t onPrice(const std::string& instrument_name, TriggerReference reference, double price);
+
+    // The order as an untriggered order in the exchange's format; null if unknown
+    JsonValue orderJson(const std::string& trigger_id) const;
+    // The held orders `matches` accepts, in the same format
+    JsonArray ordersJson(const std::function<bool(const TriggerOrder&)>& matches) const;
+    size_t pendingCount() const;
+    size_t firedCount() const;
+};